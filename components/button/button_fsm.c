@@ -0,0 +1,235 @@
+/* SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include "button_fsm.h"
+
+#define CALL_EVENT_CB(ev)                                                   \
+    if (btn->cb_info[ev]) {                                                 \
+        for (int i = 0; i < btn->size[ev]; i++) {                           \
+            btn->cb_info[ev][i].cb(btn, btn->cb_info[ev][i].usr_data);      \
+        }                                                                   \
+    }                                                                       \
+
+/**
+  * @brief  Button driver core function, driver state machine.
+  */
+void button_handler(button_dev_t *btn)
+{
+    uint8_t read_gpio_level = btn->hal_button_Level(btn->hardware_data);
+
+    /** ticks counter working.. */
+    if ((btn->state) > 0) {
+        btn->ticks++;
+    }
+
+    /**< button debounce handle */
+    if (read_gpio_level != btn->button_level) {
+        if (++(btn->debounce_cnt) >= DEBOUNCE_TICKS) {
+            btn->button_level = read_gpio_level;
+            btn->debounce_cnt = 0;
+        }
+    } else {
+        btn->debounce_cnt = 0;
+    }
+
+    /** State machine */
+    switch (btn->state) {
+    case 0:
+        if (btn->button_level == btn->active_level) {
+            btn->event = (uint8_t)BUTTON_PRESS_DOWN;
+            CALL_EVENT_CB(BUTTON_PRESS_DOWN);
+            btn->ticks = 0;
+            btn->repeat = 1;
+            btn->state = 1;
+        } else {
+            btn->event = (uint8_t)BUTTON_NONE_PRESS;
+        }
+        break;
+
+    case 1:
+        if (btn->button_level != btn->active_level) {
+            btn->event = (uint8_t)BUTTON_PRESS_UP;
+            CALL_EVENT_CB(BUTTON_PRESS_UP);
+            btn->ticks = 0;
+            btn->state = 2;
+
+        } else if (btn->ticks > btn->long_press_ticks) {
+            btn->event = (uint8_t)BUTTON_LONG_PRESS_START;
+            btn->state = 4;
+            /** Calling callbacks for BUTTON_LONG_PRESS_START */
+            uint16_t ticks_time = btn->ticks * TICKS_INTERVAL;
+            if (btn->cb_info[btn->event] && btn->count[0] == 0) {
+                if (abs(ticks_time - (btn->long_press_ticks * TICKS_INTERVAL)) <= TOLERANCE && btn->cb_info[btn->event][btn->count[0]].event_data.long_press.press_time == (btn->long_press_ticks * TICKS_INTERVAL)) {
+                    do {
+                        btn->cb_info[btn->event][btn->count[0]].cb(btn, btn->cb_info[btn->event][btn->count[0]].usr_data);
+                        btn->count[0]++;
+                        if (btn->count[0] >= btn->size[btn->event]) {
+                            break;
+                        }
+                    } while (btn->cb_info[btn->event][btn->count[0]].event_data.long_press.press_time == btn->long_press_ticks * TICKS_INTERVAL);
+                }
+            }
+        }
+        break;
+
+    case 2:
+        if (btn->button_level == btn->active_level) {
+            btn->event = (uint8_t)BUTTON_PRESS_DOWN;
+            CALL_EVENT_CB(BUTTON_PRESS_DOWN);
+            btn->event = (uint8_t)BUTTON_PRESS_REPEAT;
+            btn->repeat++;
+            CALL_EVENT_CB(BUTTON_PRESS_REPEAT); // repeat hit
+            btn->ticks = 0;
+            btn->state = 3;
+        } else if (btn->ticks > btn->short_press_ticks) {
+            if (btn->repeat == 1) {
+                btn->event = (uint8_t)BUTTON_SINGLE_CLICK;
+                CALL_EVENT_CB(BUTTON_SINGLE_CLICK);
+            } else if (btn->repeat == 2) {
+                btn->event = (uint8_t)BUTTON_DOUBLE_CLICK;
+                CALL_EVENT_CB(BUTTON_DOUBLE_CLICK); // repeat hit
+            }
+
+            btn->event = (uint8_t)BUTTON_MULTIPLE_CLICK;
+
+            /** Calling the callbacks for MULTIPLE BUTTON CLICKS */
+            for (int i = 0; i < btn->size[btn->event]; i++) {
+                if (btn->repeat == btn->cb_info[btn->event][i].event_data.multiple_clicks.clicks) {
+                    do {
+                        btn->cb_info[btn->event][i].cb(btn, btn->cb_info[btn->event][i].usr_data);
+                        i++;
+                        if (i >= btn->size[btn->event]) {
+                            break;
+                        }
+                    } while (btn->cb_info[btn->event][i].event_data.multiple_clicks.clicks == btn->repeat);
+                }
+            }
+
+            btn->event = (uint8_t)BUTTON_PRESS_REPEAT_DONE;
+            CALL_EVENT_CB(BUTTON_PRESS_REPEAT_DONE); // repeat hit
+            btn->repeat = 0;
+            btn->state = 0;
+        }
+        break;
+
+    case 3:
+        if (btn->button_level != btn->active_level) {
+            btn->event = (uint8_t)BUTTON_PRESS_UP;
+            CALL_EVENT_CB(BUTTON_PRESS_UP);
+            if (btn->ticks < SHORT_TICKS) {
+                btn->ticks = 0;
+                btn->state = 2; //repeat press
+            } else {
+                btn->state = 0;
+            }
+        }
+        break;
+
+    case 4:
+        if (btn->button_level == btn->active_level) {
+            //continue hold trigger
+            if (btn->ticks >= (btn->long_press_hold_cnt + 1) * SERIAL_TICKS + btn->long_press_ticks) {
+                btn->event = (uint8_t)BUTTON_LONG_PRESS_HOLD;
+                btn->long_press_hold_cnt++;
+                CALL_EVENT_CB(BUTTON_LONG_PRESS_HOLD);
+
+                /** Calling callbacks for BUTTON_LONG_PRESS_START based on press_time */
+                uint16_t ticks_time = btn->ticks * TICKS_INTERVAL;
+                if (btn->cb_info[BUTTON_LONG_PRESS_START]) {
+                    button_cb_info_t *cb_info = btn->cb_info[BUTTON_LONG_PRESS_START];
+                    uint16_t time = cb_info[btn->count[0]].event_data.long_press.press_time;
+                    if (btn->long_press_ticks * TICKS_INTERVAL > time) {
+                        for (int i = btn->count[0] + 1; i < btn->size[BUTTON_LONG_PRESS_START]; i++) {
+                            time = cb_info[i].event_data.long_press.press_time;
+                            if (btn->long_press_ticks * TICKS_INTERVAL <= time) {
+                                btn->count[0] = i;
+                                break;
+                            }
+                        }
+                    }
+                    if (btn->count[0] < btn->size[BUTTON_LONG_PRESS_START] && abs(ticks_time - time) <= TOLERANCE) {
+                        do {
+                            cb_info[btn->count[0]].cb(btn, cb_info[btn->count[0]].usr_data);
+                            btn->count[0]++;
+                            if (btn->count[0] >= btn->size[BUTTON_LONG_PRESS_START]) {
+                                break;
+                            }
+                        } while (time == cb_info[btn->count[0]].event_data.long_press.press_time);
+                    }
+                }
+
+                /** Updating counter for BUTTON_LONG_PRESS_UP press_time */
+                if (btn->cb_info[BUTTON_LONG_PRESS_UP]) {
+                    button_cb_info_t *cb_info = btn->cb_info[BUTTON_LONG_PRESS_UP];
+                    uint16_t time = cb_info[btn->count[1] + 1].event_data.long_press.press_time;
+                    if (btn->long_press_ticks * TICKS_INTERVAL > time) {
+                        for (int i = btn->count[1] + 1; i < btn->size[BUTTON_LONG_PRESS_UP]; i++) {
+                            time = cb_info[i].event_data.long_press.press_time;
+                            if (btn->long_press_ticks * TICKS_INTERVAL <= time) {
+                                btn->count[1] = i;
+                                break;
+                            }
+                        }
+                    }
+                    if (btn->count[1] + 1 < btn->size[BUTTON_LONG_PRESS_UP] && abs(ticks_time - time) <= TOLERANCE) {
+                        do {
+                            btn->count[1]++;
+                            if (btn->count[1] + 1 >= btn->size[BUTTON_LONG_PRESS_UP]) {
+                                break;
+                            }
+                        } while (time == cb_info[btn->count[1] + 1].event_data.long_press.press_time);
+                    }
+                }
+            }
+        } else { //releasd
+
+            btn->event = BUTTON_LONG_PRESS_UP;
+
+            /** calling callbacks for BUTTON_LONG_PRESS_UP press_time */
+            if (btn->cb_info[btn->event] && btn->count[1] >= 0) {
+                button_cb_info_t *cb_info = btn->cb_info[btn->event];
+                do {
+                    cb_info[btn->count[1]].cb(btn, cb_info[btn->count[1]].usr_data);
+                    if (!btn->count[1]) {
+                        break;
+                    }
+                    btn->count[1]--;
+                } while (cb_info[btn->count[1]].event_data.long_press.press_time == cb_info[btn->count[1] + 1].event_data.long_press.press_time);
+
+                /** Reset the counter */
+                btn->count[1] = -1;
+            }
+            /** Reset counter */
+            if (btn->cb_info[BUTTON_LONG_PRESS_START]) {
+                btn->count[0] = 0;
+            }
+
+            btn->event = (uint8_t)BUTTON_PRESS_UP;
+            CALL_EVENT_CB(BUTTON_PRESS_UP);
+            btn->state = 0; //reset
+            btn->long_press_hold_cnt = 0;
+        }
+        break;
+    }
+}
+
+bool button_is_idle(const button_dev_t *btn)
+{
+    /* state 0 does not count ticks, so skipped scans change nothing until the level goes active */
+    return btn->state == 0 && btn->debounce_cnt == 0 && btn->button_level != btn->active_level;
+}
+
+bool button_scan(button_dev_t *head)
+{
+    bool can_stop = true;
+    for (button_dev_t *target = head; target; target = target->next) {
+        button_handler(target);
+        if (!target->power_save || !button_is_idle(target)) {
+            can_stop = false;
+        }
+    }
+    return can_stop;
+}
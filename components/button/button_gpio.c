@@ -4,6 +4,7 @@
  */
 
 #include "esp_log.h"
+#include "esp_sleep.h"
 #include "driver/gpio.h"
 #include "button_gpio.h"
 
@@ -34,15 +35,40 @@ esp_err_t button_gpio_init(const button_gpio_config_t *config)
     }
     gpio_config(&gpio_conf);
 
+    if (config->enable_power_save) {
+        /* The ISR service may already be installed by another driver */
+        esp_err_t ret = gpio_install_isr_service(0);
+        GPIO_BTN_CHECK(ESP_OK == ret || ESP_ERR_INVALID_STATE == ret, "GPIO ISR service install failed", ret);
+        /* Light sleep can only wake on a level */
+        gpio_wakeup_enable(config->gpio_num, config->active_level ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+        esp_sleep_enable_gpio_wakeup();
+    }
+
     return ESP_OK;
 }
 
 esp_err_t button_gpio_deinit(int gpio_num)
 {
+    gpio_isr_handler_remove(gpio_num);
+    gpio_wakeup_disable(gpio_num);
     return gpio_reset_pin(gpio_num);;
 }
 
 uint8_t button_gpio_get_key_level(void *gpio_num)
 {
     return (uint8_t)gpio_get_level((uint32_t)gpio_num);
+}
+
+esp_err_t button_gpio_set_intr(int gpio_num, gpio_int_type_t intr_type, gpio_isr_t isr_handler, void *args)
+{
+    esp_err_t ret = gpio_set_intr_type(gpio_num, intr_type);
+    GPIO_BTN_CHECK(ESP_OK == ret, "Set gpio interrupt type failed", ret);
+    ret = gpio_isr_handler_add(gpio_num, isr_handler, args);
+    GPIO_BTN_CHECK(ESP_OK == ret, "Add gpio interrupt handler failed", ret);
+    return gpio_intr_enable(gpio_num);
+}
+
+esp_err_t button_gpio_intr_control(int gpio_num, bool enable)
+{
+    return enable ? gpio_intr_enable(gpio_num) : gpio_intr_disable(gpio_num);
 }
\ No newline at end of file
@@ -5,3 +5,4 @@
 
 COMPONENT_ADD_INCLUDEDIRS := ./include
 COMPONENT_SRCDIRS := .
+COMPONENT_PRIV_INCLUDEDIRS := ./private_include
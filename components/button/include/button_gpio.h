@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include "driver/gpio.h"
 
 #ifdef __cplusplus
@@ -18,6 +19,7 @@ extern "C" {
 typedef struct {
     int32_t gpio_num;              /**< num of gpio */
     uint8_t active_level;          /**< gpio level when press down */
+    bool enable_power_save;        /**< scan only after a GPIO interrupt until the button is idle again, allows light sleep */
 } button_gpio_config_t;
 
 /**
@@ -49,6 +51,32 @@ esp_err_t button_gpio_deinit(int gpio_num);
  */
 uint8_t button_gpio_get_key_level(void *gpio_num);
 
+/**
+ * @brief Set the interrupt of a gpio button
+ *
+ * @param gpio_num gpio number of button
+ * @param intr_type interrupt type
+ * @param isr_handler interrupt handler
+ * @param args argument of isr_handler
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - Others gpio driver error
+ */
+esp_err_t button_gpio_set_intr(int gpio_num, gpio_int_type_t intr_type, gpio_isr_t isr_handler, void *args);
+
+/**
+ * @brief Enable or disable the interrupt of a gpio button
+ *
+ * @param gpio_num gpio number of button
+ * @param enable true to enable
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - Others gpio driver error
+ */
+esp_err_t button_gpio_intr_control(int gpio_num, bool enable);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -8,56 +8,13 @@
 #include "button_adc.h"
 #include "button_gpio.h"
 #include "button_matrix.h"
+#include "button_types.h"
 #include "esp_err.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-typedef void (* button_cb_t)(void *button_handle, void *usr_data);
-typedef void *button_handle_t;
-
-/**
- * @brief Button events
- *
- */
-typedef enum {
-    BUTTON_PRESS_DOWN = 0,
-    BUTTON_PRESS_UP,
-    BUTTON_PRESS_REPEAT,
-    BUTTON_PRESS_REPEAT_DONE,
-    BUTTON_SINGLE_CLICK,
-    BUTTON_DOUBLE_CLICK,
-    BUTTON_MULTIPLE_CLICK,
-    BUTTON_LONG_PRESS_START,
-    BUTTON_LONG_PRESS_HOLD,
-    BUTTON_LONG_PRESS_UP,
-    BUTTON_EVENT_MAX,
-    BUTTON_NONE_PRESS,
-} button_event_t;
-
-/**
- * @brief Button events data
- *
- */
-typedef union {
-    /**
-     * @brief Long press time event data
-     *
-     */
-    struct long_press_t {
-        uint16_t press_time;    /**< press time(ms) for the corresponding callback to trigger */
-    } long_press;               /**< long press struct, for event BUTTON_LONG_PRESS_START and BUTTON_LONG_PRESS_UP */
-
-    /**
-     * @brief Multiple clicks event data
-     *
-     */
-    struct multiple_clicks_t {
-        uint16_t clicks;        /**< number of clicks, to trigger the callback */
-    } multiple_clicks;          /**< multiple clicks struct, for event BUTTON_MULTIPLE_CLICK */
-} button_event_data_t;
-
 /**
  * @brief Button events configuration
  *
@@ -67,17 +24,6 @@ typedef struct {
     button_event_data_t event_data;     /**< event data corresponding to the event */
 } button_event_config_t;
 
-/**
- * @brief Supported button type
- *
- */
-typedef enum {
-    BUTTON_TYPE_GPIO,
-    BUTTON_TYPE_ADC,
-    BUTTON_TYPE_MATRIX,
-    BUTTON_TYPE_CUSTOM
-} button_type_t;
-
 /**
  * @brief Button parameter
  *
@@ -12,6 +12,7 @@
 #include "esp_log.h"
 #include "driver/gpio.h"
 #include "iot_button.h"
+#include "button_fsm.h"
 #include "esp_timer.h"
 #include "sdkconfig.h"
 
@@ -19,6 +20,8 @@ static const char *TAG = "button";
 static portMUX_TYPE s_button_lock = portMUX_INITIALIZER_UNLOCKED;
 #define BUTTON_ENTER_CRITICAL()           portENTER_CRITICAL(&s_button_lock)
 #define BUTTON_EXIT_CRITICAL()            portEXIT_CRITICAL(&s_button_lock)
+#define BUTTON_ENTER_CRITICAL_ISR()       portENTER_CRITICAL_ISR(&s_button_lock)
+#define BUTTON_EXIT_CRITICAL_ISR()        portEXIT_CRITICAL_ISR(&s_button_lock)
 
 #define BTN_CHECK(a, str, ret_val)                                \
     if (!(a)) {                                                   \
@@ -26,275 +29,57 @@ static portMUX_TYPE s_button_lock = portMUX_INITIALIZER_UNLOCKED;
         return (ret_val);                                         \
     }
 
-/**
- * @brief Structs to store callback info
- *
- */
-typedef struct {
-    button_cb_t cb;
-    void *usr_data;
-    button_event_data_t event_data;
-} button_cb_info_t;
-
-/**
- * @brief Structs to record individual key parameters
- *
- */
-typedef struct Button {
-    uint16_t            ticks;
-    uint16_t            long_press_ticks;     /*! Trigger ticks for long press*/
-    uint16_t            short_press_ticks;    /*! Trigger ticks for repeat press*/
-    uint16_t            long_press_hold_cnt;  /*! Record long press hold count*/
-    uint16_t            long_press_ticks_default;
-    uint8_t             repeat;
-    uint8_t             state: 3;
-    uint8_t             debounce_cnt: 3;
-    uint8_t             active_level: 1;
-    uint8_t             button_level: 1;
-    button_event_t      event;
-    uint8_t (*hal_button_Level)(void *hardware_data);
-    esp_err_t (*hal_button_deinit)(void *hardware_data);
-    void                *hardware_data;
-    button_type_t       type;
-    button_cb_info_t    *cb_info[BUTTON_EVENT_MAX];
-    size_t              size[BUTTON_EVENT_MAX];
-    int                 count[2];
-    struct Button       *next;
-} button_dev_t;
-
 //button handle list head.
 static button_dev_t *g_head_handle = NULL;
 static esp_timer_handle_t g_button_timer_handle = NULL;
 static bool g_is_timer_running = false;
-
-#define TICKS_INTERVAL    CONFIG_BUTTON_PERIOD_TIME_MS
-#define DEBOUNCE_TICKS    CONFIG_BUTTON_DEBOUNCE_TICKS //MAX 8
-#define SHORT_TICKS       (CONFIG_BUTTON_SHORT_PRESS_TIME_MS /TICKS_INTERVAL)
-#define LONG_TICKS        (CONFIG_BUTTON_LONG_PRESS_TIME_MS /TICKS_INTERVAL)
-#define SERIAL_TICKS      (CONFIG_BUTTON_SERIAL_TIME_MS /TICKS_INTERVAL)
-#define TOLERANCE         CONFIG_BUTTON_LONG_PRESS_TOLERANCE_MS
-
-#define CALL_EVENT_CB(ev)                                                   \
-    if (btn->cb_info[ev]) {                                                 \
-        for (int i = 0; i < btn->size[ev]; i++) {                           \
-            btn->cb_info[ev][i].cb(btn, btn->cb_info[ev][i].usr_data);      \
-        }                                                                   \
-    }                                                                       \
+static bool g_is_timer_stopped = false;    /*! Stopped by iot_button_stop(), interrupts must not restart it*/
 
 #define TIME_TO_TICKS(time, congfig_time)  (0 == (time))?congfig_time:(((time) / TICKS_INTERVAL))?((time) / TICKS_INTERVAL):1
 
-/**
-  * @brief  Button driver core function, driver state machine.
-  */
-static void button_handler(button_dev_t *btn)
+static void button_cb(void *args)
 {
-    uint8_t read_gpio_level = btn->hal_button_Level(btn->hardware_data);
-
-    /** ticks counter working.. */
-    if ((btn->state) > 0) {
-        btn->ticks++;
+    if (!button_scan(g_head_handle)) {
+        return;
     }
 
-    /**< button debounce handle */
-    if (read_gpio_level != btn->button_level) {
-        if (++(btn->debounce_cnt) >= DEBOUNCE_TICKS) {
-            btn->button_level = read_gpio_level;
-            btn->debounce_cnt = 0;
-        }
-    } else {
-        btn->debounce_cnt = 0;
+    /* Every button is idle and has its interrupt to restart the scan. Stop the timer before
+     * enabling the interrupts, a press seen from here on starts it again. The interrupts are
+     * level triggered, so a press that began in between fires as soon as it is enabled. */
+    esp_timer_stop(g_button_timer_handle);
+    BUTTON_ENTER_CRITICAL();
+    g_is_timer_running = false;
+    BUTTON_EXIT_CRITICAL();
+    for (button_dev_t *target = g_head_handle; target; target = target->next) {
+        button_gpio_intr_control((int)target->hardware_data, true);
     }
+}
 
-    /** State machine */
-    switch (btn->state) {
-    case 0:
-        if (btn->button_level == btn->active_level) {
-            btn->event = (uint8_t)BUTTON_PRESS_DOWN;
-            CALL_EVENT_CB(BUTTON_PRESS_DOWN);
-            btn->ticks = 0;
-            btn->repeat = 1;
-            btn->state = 1;
-        } else {
-            btn->event = (uint8_t)BUTTON_NONE_PRESS;
-        }
-        break;
-
-    case 1:
-        if (btn->button_level != btn->active_level) {
-            btn->event = (uint8_t)BUTTON_PRESS_UP;
-            CALL_EVENT_CB(BUTTON_PRESS_UP);
-            btn->ticks = 0;
-            btn->state = 2;
-
-        } else if (btn->ticks > btn->long_press_ticks) {
-            btn->event = (uint8_t)BUTTON_LONG_PRESS_START;
-            btn->state = 4;
-            /** Calling callbacks for BUTTON_LONG_PRESS_START */
-            uint16_t ticks_time = iot_button_get_ticks_time(btn);
-            if (btn->cb_info[btn->event] && btn->count[0] == 0) {
-                if (abs(ticks_time - (btn->long_press_ticks * TICKS_INTERVAL)) <= TOLERANCE && btn->cb_info[btn->event][btn->count[0]].event_data.long_press.press_time == (btn->long_press_ticks * TICKS_INTERVAL)) {
-                    do {
-                        btn->cb_info[btn->event][btn->count[0]].cb(btn, btn->cb_info[btn->event][btn->count[0]].usr_data);
-                        btn->count[0]++;
-                        if (btn->count[0] >= btn->size[btn->event]) {
-                            break;
-                        }
-                    } while (btn->cb_info[btn->event][btn->count[0]].event_data.long_press.press_time == btn->long_press_ticks * TICKS_INTERVAL);
-                }
-            }
-        }
-        break;
-
-    case 2:
-        if (btn->button_level == btn->active_level) {
-            btn->event = (uint8_t)BUTTON_PRESS_DOWN;
-            CALL_EVENT_CB(BUTTON_PRESS_DOWN);
-            btn->event = (uint8_t)BUTTON_PRESS_REPEAT;
-            btn->repeat++;
-            CALL_EVENT_CB(BUTTON_PRESS_REPEAT); // repeat hit
-            btn->ticks = 0;
-            btn->state = 3;
-        } else if (btn->ticks > btn->short_press_ticks) {
-            if (btn->repeat == 1) {
-                btn->event = (uint8_t)BUTTON_SINGLE_CLICK;
-                CALL_EVENT_CB(BUTTON_SINGLE_CLICK);
-            } else if (btn->repeat == 2) {
-                btn->event = (uint8_t)BUTTON_DOUBLE_CLICK;
-                CALL_EVENT_CB(BUTTON_DOUBLE_CLICK); // repeat hit
-            }
-
-            btn->event = (uint8_t)BUTTON_MULTIPLE_CLICK;
-
-            /** Calling the callbacks for MULTIPLE BUTTON CLICKS */
-            for (int i = 0; i < btn->size[btn->event]; i++) {
-                if (btn->repeat == btn->cb_info[btn->event][i].event_data.multiple_clicks.clicks) {
-                    do {
-                        btn->cb_info[btn->event][i].cb(btn, btn->cb_info[btn->event][i].usr_data);
-                        i++;
-                        if (i >= btn->size[btn->event]) {
-                            break;
-                        }
-                    } while (btn->cb_info[btn->event][i].event_data.multiple_clicks.clicks == btn->repeat);
-                }
-            }
-
-            btn->event = (uint8_t)BUTTON_PRESS_REPEAT_DONE;
-            CALL_EVENT_CB(BUTTON_PRESS_REPEAT_DONE); // repeat hit
-            btn->repeat = 0;
-            btn->state = 0;
-        }
-        break;
-
-    case 3:
-        if (btn->button_level != btn->active_level) {
-            btn->event = (uint8_t)BUTTON_PRESS_UP;
-            CALL_EVENT_CB(BUTTON_PRESS_UP);
-            if (btn->ticks < SHORT_TICKS) {
-                btn->ticks = 0;
-                btn->state = 2; //repeat press
-            } else {
-                btn->state = 0;
-            }
-        }
-        break;
-
-    case 4:
-        if (btn->button_level == btn->active_level) {
-            //continue hold trigger
-            if (btn->ticks >= (btn->long_press_hold_cnt + 1) * SERIAL_TICKS + btn->long_press_ticks) {
-                btn->event = (uint8_t)BUTTON_LONG_PRESS_HOLD;
-                btn->long_press_hold_cnt++;
-                CALL_EVENT_CB(BUTTON_LONG_PRESS_HOLD);
-
-                /** Calling callbacks for BUTTON_LONG_PRESS_START based on press_time */
-                uint16_t ticks_time = iot_button_get_ticks_time(btn);
-                if (btn->cb_info[BUTTON_LONG_PRESS_START]) {
-                    button_cb_info_t *cb_info = btn->cb_info[BUTTON_LONG_PRESS_START];
-                    uint16_t time = cb_info[btn->count[0]].event_data.long_press.press_time;
-                    if (btn->long_press_ticks * TICKS_INTERVAL > time) {
-                        for (int i = btn->count[0] + 1; i < btn->size[BUTTON_LONG_PRESS_START]; i++) {
-                            time = cb_info[i].event_data.long_press.press_time;
-                            if (btn->long_press_ticks * TICKS_INTERVAL <= time) {
-                                btn->count[0] = i;
-                                break;
-                            }
-                        }
-                    }
-                    if (btn->count[0] < btn->size[BUTTON_LONG_PRESS_START] && abs(ticks_time - time) <= TOLERANCE) {
-                        do {
-                            cb_info[btn->count[0]].cb(btn, cb_info[btn->count[0]].usr_data);
-                            btn->count[0]++;
-                            if (btn->count[0] >= btn->size[BUTTON_LONG_PRESS_START]) {
-                                break;
-                            }
-                        } while (time == cb_info[btn->count[0]].event_data.long_press.press_time);
-                    }
-                }
-
-                /** Updating counter for BUTTON_LONG_PRESS_UP press_time */
-                if (btn->cb_info[BUTTON_LONG_PRESS_UP]) {
-                    button_cb_info_t *cb_info = btn->cb_info[BUTTON_LONG_PRESS_UP];
-                    uint16_t time = cb_info[btn->count[1] + 1].event_data.long_press.press_time;
-                    if (btn->long_press_ticks * TICKS_INTERVAL > time) {
-                        for (int i = btn->count[1] + 1; i < btn->size[BUTTON_LONG_PRESS_UP]; i++) {
-                            time = cb_info[i].event_data.long_press.press_time;
-                            if (btn->long_press_ticks * TICKS_INTERVAL <= time) {
-                                btn->count[1] = i;
-                                break;
-                            }
-                        }
-                    }
-                    if (btn->count[1] + 1 < btn->size[BUTTON_LONG_PRESS_UP] && abs(ticks_time - time) <= TOLERANCE) {
-                        do {
-                            btn->count[1]++;
-                            if (btn->count[1] + 1 >= btn->size[BUTTON_LONG_PRESS_UP]) {
-                                break;
-                            }
-                        } while (time == cb_info[btn->count[1] + 1].event_data.long_press.press_time);
-                    }
-                }
-            }
-        } else { //releasd
-
-            btn->event = BUTTON_LONG_PRESS_UP;
-
-            /** calling callbacks for BUTTON_LONG_PRESS_UP press_time */
-            if (btn->cb_info[btn->event] && btn->count[1] >= 0) {
-                button_cb_info_t *cb_info = btn->cb_info[btn->event];
-                do {
-                    cb_info[btn->count[1]].cb(btn, cb_info[btn->count[1]].usr_data);
-                    if (!btn->count[1]) {
-                        break;
-                    }
-                    btn->count[1]--;
-                } while (cb_info[btn->count[1]].event_data.long_press.press_time == cb_info[btn->count[1] + 1].event_data.long_press.press_time);
-
-                /** Reset the counter */
-                btn->count[1] = -1;
-            }
-            /** Reset counter */
-            if (btn->cb_info[BUTTON_LONG_PRESS_START]) {
-                btn->count[0] = 0;
-            }
-
-            btn->event = (uint8_t)BUTTON_PRESS_UP;
-            CALL_EVENT_CB(BUTTON_PRESS_UP);
-            btn->state = 0; //reset
-            btn->long_press_hold_cnt = 0;
-        }
-        break;
+static void button_power_save_isr_handler(void *arg)
+{
+    button_dev_t *btn = (button_dev_t *)arg;
+    button_gpio_intr_control((int)btn->hardware_data, false);
+    BUTTON_ENTER_CRITICAL_ISR();
+    if (!g_is_timer_running && !g_is_timer_stopped) {
+        esp_timer_start_periodic(g_button_timer_handle, TICKS_INTERVAL * 1000U);
+        g_is_timer_running = true;
     }
+    BUTTON_EXIT_CRITICAL_ISR();
 }
 
-static void button_cb(void *args)
+static esp_err_t button_timer_start(void)
 {
-    button_dev_t *target;
-    for (target = g_head_handle; target; target = target->next) {
-        button_handler(target);
+    esp_err_t err = ESP_OK;
+    BUTTON_ENTER_CRITICAL();
+    if (!g_is_timer_running && !g_is_timer_stopped) {
+        err = esp_timer_start_periodic(g_button_timer_handle, TICKS_INTERVAL * 1000U);
+        g_is_timer_running = (ESP_OK == err);
     }
+    BUTTON_EXIT_CRITICAL();
+    return err;
 }
 
-static button_dev_t *button_create_com(uint8_t active_level, uint8_t (*hal_get_key_state)(void *hardware_data), void *hardware_data, uint16_t long_press_ticks, uint16_t short_press_ticks)
+static button_dev_t *button_create_com(uint8_t active_level, uint8_t (*hal_get_key_state)(void *hardware_data), void *hardware_data, uint16_t long_press_ticks, uint16_t short_press_ticks, bool power_save)
 {
     BTN_CHECK(NULL != hal_get_key_state, "Function pointer is invalid", NULL);
 
@@ -308,20 +93,30 @@ static button_dev_t *button_create_com(uint8_t active_level, uint8_t (*hal_get_k
     btn->long_press_ticks = long_press_ticks;
     btn->long_press_ticks_default = btn->long_press_ticks;
     btn->short_press_ticks = short_press_ticks;
+    btn->power_save = power_save;
 
-    /** Add handle to list */
-    btn->next = g_head_handle;
-    g_head_handle = btn;
-
-    if (false == g_is_timer_running) {
+    if (NULL == g_button_timer_handle) {
         esp_timer_create_args_t button_timer;
         button_timer.arg = NULL;
         button_timer.callback = button_cb;
         button_timer.dispatch_method = ESP_TIMER_TASK;
         button_timer.name = "button_timer";
-        esp_timer_create(&button_timer, &g_button_timer_handle);
-        esp_timer_start_periodic(g_button_timer_handle, TICKS_INTERVAL * 1000U);
-        g_is_timer_running = true;
+        esp_err_t err = esp_timer_create(&button_timer, &g_button_timer_handle);
+        if (ESP_OK != err) {
+            free(btn);
+            BTN_CHECK(false, "Button timer create failed", NULL);
+        }
+    }
+
+    /** Add handle to list */
+    btn->next = g_head_handle;
+    g_head_handle = btn;
+
+    if (power_save) {
+        /** The first press starts the scan timer */
+        button_gpio_set_intr((int)hardware_data, active_level ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL, button_power_save_isr_handler, btn);
+    } else {
+        button_timer_start();
     }
 
     return btn;
@@ -331,6 +126,10 @@ static esp_err_t button_delete_com(button_dev_t *btn)
 {
     BTN_CHECK(NULL != btn, "Pointer of handle is invalid", ESP_ERR_INVALID_ARG);
 
+    if (btn->power_save) {
+        button_gpio_intr_control((int)btn->hardware_data, false);
+    }
+
     button_dev_t **curr;
     for (curr = &g_head_handle; *curr;) {
         button_dev_t *entry = *curr;
@@ -351,10 +150,12 @@ static esp_err_t button_delete_com(button_dev_t *btn)
     }
     ESP_LOGD(TAG, "remain btn number=%d", number);
 
-    if (0 == number && g_is_timer_running) { /**<  if all button is deleted, stop the timer */
+    if (0 == number && g_button_timer_handle) { /**<  if all button is deleted, stop the timer */
         esp_timer_stop(g_button_timer_handle);
         esp_timer_delete(g_button_timer_handle);
+        g_button_timer_handle = NULL;
         g_is_timer_running = false;
+        g_is_timer_stopped = false;
     }
     return ESP_OK;
 }
@@ -372,19 +173,19 @@ button_handle_t iot_button_create(const button_config_t *config)
         const button_gpio_config_t *cfg = &(config->gpio_button_config);
         ret = button_gpio_init(cfg);
         BTN_CHECK(ESP_OK == ret, "gpio button init failed", NULL);
-        btn = button_create_com(cfg->active_level, button_gpio_get_key_level, (void *)cfg->gpio_num, long_press_time, short_press_time);
+        btn = button_create_com(cfg->active_level, button_gpio_get_key_level, (void *)cfg->gpio_num, long_press_time, short_press_time, cfg->enable_power_save);
     } break;
     case BUTTON_TYPE_ADC: {
         const button_adc_config_t *cfg = &(config->adc_button_config);
         ret = button_adc_init(cfg);
         BTN_CHECK(ESP_OK == ret, "adc button init failed", NULL);
-        btn = button_create_com(1, button_adc_get_key_level, (void *)ADC_BUTTON_COMBINE(cfg->adc_channel, cfg->button_index), long_press_time, short_press_time);
+        btn = button_create_com(1, button_adc_get_key_level, (void *)ADC_BUTTON_COMBINE(cfg->adc_channel, cfg->button_index), long_press_time, short_press_time, false);
     } break;
     case BUTTON_TYPE_MATRIX: {
         const button_matrix_config_t *cfg = &(config->matrix_button_config);
         ret = button_matrix_init(cfg);
         BTN_CHECK(ESP_OK == ret, "matrix button init failed", NULL);
-        btn = button_create_com(1, button_matrix_get_key_level, (void *)MATRIX_BUTTON_COMBINE(cfg->row_gpio_num, cfg->col_gpio_num), long_press_time, short_press_time);
+        btn = button_create_com(1, button_matrix_get_key_level, (void *)MATRIX_BUTTON_COMBINE(cfg->row_gpio_num, cfg->col_gpio_num), long_press_time, short_press_time, false);
     } break;
     case BUTTON_TYPE_CUSTOM: {
         if (config->custom_button_config.button_custom_init) {
@@ -395,7 +196,7 @@ button_handle_t iot_button_create(const button_config_t *config)
         btn = button_create_com(config->custom_button_config.active_level,
                                 config->custom_button_config.button_custom_get_key_value,
                                 config->custom_button_config.priv,
-                                long_press_time, short_press_time);
+                                long_press_time, short_press_time, false);
         if (btn) {
             btn->hal_button_deinit = config->custom_button_config.button_custom_deinit;
         }
@@ -681,21 +482,25 @@ esp_err_t iot_button_set_param(button_handle_t btn_handle, button_param_t param,
 esp_err_t iot_button_resume(void)
 {
     BTN_CHECK(g_button_timer_handle, "Button timer handle is invalid", ESP_ERR_INVALID_STATE);
-    BTN_CHECK(!g_is_timer_running, "Button timer is already running", ESP_ERR_INVALID_STATE);
+    BTN_CHECK(g_is_timer_stopped, "Button timer is already running", ESP_ERR_INVALID_STATE);
 
-    esp_err_t err = esp_timer_start_periodic(g_button_timer_handle, TICKS_INTERVAL * 1000U);
+    g_is_timer_stopped = false;
+    /** Power save buttons get their interrupts back once the scan finds them idle */
+    esp_err_t err = button_timer_start();
     BTN_CHECK(ESP_OK == err, "Button timer start failed", ESP_FAIL);
-    g_is_timer_running = true;
     return ESP_OK;
 }
 
 esp_err_t iot_button_stop(void)
 {
     BTN_CHECK(g_button_timer_handle, "Button timer handle is invalid", ESP_ERR_INVALID_STATE);
-    BTN_CHECK(g_is_timer_running, "Button timer is not running", ESP_ERR_INVALID_STATE);
+    BTN_CHECK(!g_is_timer_stopped, "Button timer is not running", ESP_ERR_INVALID_STATE);
 
+    BUTTON_ENTER_CRITICAL();
+    g_is_timer_stopped = true;
+    BUTTON_EXIT_CRITICAL();
     esp_err_t err = esp_timer_stop(g_button_timer_handle);
-    BTN_CHECK(ESP_OK == err, "Button timer stop failed", ESP_FAIL);
+    BTN_CHECK(ESP_OK == err || ESP_ERR_INVALID_STATE == err, "Button timer stop failed", ESP_FAIL);
     g_is_timer_running = false;
     return ESP_OK;
 }
\ No newline at end of file
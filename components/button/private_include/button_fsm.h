@@ -0,0 +1,91 @@
+/* SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "button_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TICKS_INTERVAL    CONFIG_BUTTON_PERIOD_TIME_MS
+#define DEBOUNCE_TICKS    CONFIG_BUTTON_DEBOUNCE_TICKS //MAX 8
+#define SHORT_TICKS       (CONFIG_BUTTON_SHORT_PRESS_TIME_MS /TICKS_INTERVAL)
+#define LONG_TICKS        (CONFIG_BUTTON_LONG_PRESS_TIME_MS /TICKS_INTERVAL)
+#define SERIAL_TICKS      (CONFIG_BUTTON_SERIAL_TIME_MS /TICKS_INTERVAL)
+#define TOLERANCE         CONFIG_BUTTON_LONG_PRESS_TOLERANCE_MS
+
+/**
+ * @brief Structs to store callback info
+ *
+ */
+typedef struct {
+    button_cb_t cb;
+    void *usr_data;
+    button_event_data_t event_data;
+} button_cb_info_t;
+
+/**
+ * @brief Structs to record individual key parameters
+ *
+ */
+typedef struct Button {
+    uint16_t            ticks;
+    uint16_t            long_press_ticks;     /*! Trigger ticks for long press*/
+    uint16_t            short_press_ticks;    /*! Trigger ticks for repeat press*/
+    uint16_t            long_press_hold_cnt;  /*! Record long press hold count*/
+    uint16_t            long_press_ticks_default;
+    uint8_t             repeat;
+    uint8_t             state: 3;
+    uint8_t             debounce_cnt: 3;
+    uint8_t             active_level: 1;
+    uint8_t             button_level: 1;
+    uint8_t             power_save: 1;        /*! Scanned only from an interrupt until idle again*/
+    button_event_t      event;
+    uint8_t (*hal_button_Level)(void *hardware_data);
+    esp_err_t (*hal_button_deinit)(void *hardware_data);
+    void                *hardware_data;
+    button_type_t       type;
+    button_cb_info_t    *cb_info[BUTTON_EVENT_MAX];
+    size_t              size[BUTTON_EVENT_MAX];
+    int                 count[2];
+    struct Button       *next;
+} button_dev_t;
+
+/**
+ * @brief Button driver core function, run the state machine for one scan tick
+ *
+ * @param btn button
+ */
+void button_handler(button_dev_t *btn);
+
+/**
+ * @brief Check whether a button is released and settled
+ *
+ * Scan ticks of an idle button have no effect until its level goes active,
+ * so they can be skipped.
+ *
+ * @param btn button
+ * @return true if idle
+ */
+bool button_is_idle(const button_dev_t *btn);
+
+/**
+ * @brief Run one scan tick on every button of a list
+ *
+ * @param head list head
+ * @return true if the scan timer can stop: every button is in power save mode and idle
+ */
+bool button_scan(button_dev_t *head);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,255 @@
+/* SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "button_fsm.h"
+
+#define ACTIVE_LEVEL        0
+#define EVENTS_MAX          64
+#define MULTI_CLICKS        3
+
+/**
+ * @brief Event seen by a simulated button
+ */
+typedef struct {
+    button_event_t event;
+    uint32_t ms;
+} test_event_t;
+
+/**
+ * @brief Button driven by a simulated GPIO
+ */
+typedef struct {
+    button_dev_t dev;
+    button_cb_info_t cb[BUTTON_EVENT_MAX];
+    uint8_t level;                          /*!< simulated GPIO level */
+    test_event_t events[EVENTS_MAX];
+    int event_num;
+    uint32_t scans;                         /*!< scan ticks run */
+    /* power save only */
+    bool intr_enabled;                      /*!< simulated level interrupt */
+    bool timer_running;
+    uint32_t next_tick;
+    uint32_t wakeups;                       /*!< times the interrupt started the timer */
+} test_button_t;
+
+/**
+ * @brief Level change of the timeline, `pressed` from `ms` on
+ */
+typedef struct {
+    uint32_t ms;
+    bool pressed;
+} test_step_t;
+
+static uint32_t s_now;
+
+static uint8_t test_get_level(void *hardware_data)
+{
+    return ((test_button_t *)hardware_data)->level;
+}
+
+static void test_record_cb(void *button_handle, void *usr_data)
+{
+    test_button_t *b = (test_button_t *)usr_data;
+    TEST_ASSERT_LESS_THAN(EVENTS_MAX, b->event_num);
+    b->events[b->event_num].event = ((button_dev_t *)button_handle)->event;
+    b->events[b->event_num].ms = s_now;
+    b->event_num++;
+}
+
+/**
+ * @brief Set a button up like iot_button_create() + iot_button_register_cb() for every event
+ */
+static void test_button_init(test_button_t *b, bool power_save)
+{
+    memset(b, 0, sizeof(test_button_t));
+    b->dev.hardware_data = b;
+    b->dev.event = BUTTON_NONE_PRESS;
+    b->dev.active_level = ACTIVE_LEVEL;
+    b->dev.hal_button_Level = test_get_level;
+    b->dev.button_level = !ACTIVE_LEVEL;
+    b->dev.long_press_ticks = LONG_TICKS;
+    b->dev.long_press_ticks_default = LONG_TICKS;
+    b->dev.short_press_ticks = SHORT_TICKS;
+    b->dev.power_save = power_save;
+    b->dev.count[0] = 0;
+    b->dev.count[1] = -1;
+    b->level = !ACTIVE_LEVEL;
+    b->intr_enabled = power_save;
+    for (int ev = 0; ev < BUTTON_EVENT_MAX; ev++) {
+        b->cb[ev].cb = test_record_cb;
+        b->cb[ev].usr_data = b;
+        if (ev == BUTTON_LONG_PRESS_START || ev == BUTTON_LONG_PRESS_UP) {
+            b->cb[ev].event_data.long_press.press_time = LONG_TICKS * TICKS_INTERVAL;
+        } else if (ev == BUTTON_MULTIPLE_CLICK) {
+            b->cb[ev].event_data.multiple_clicks.clicks = MULTI_CLICKS;
+        }
+        b->dev.cb_info[ev] = &b->cb[ev];
+        b->dev.size[ev] = 1;
+    }
+}
+
+/**
+ * @brief Run a timeline, 1 ms per step, on a button scanned every tick and on a power save button
+ */
+static void test_run(const test_step_t *steps, int step_num, uint32_t end_ms, test_button_t *ref, test_button_t *ps)
+{
+    int step = 0;
+    test_button_init(ref, false);
+    test_button_init(ps, true);
+
+    for (s_now = 0; s_now < end_ms; s_now++) {
+        while (step < step_num && steps[step].ms == s_now) {
+            uint8_t level = steps[step].pressed ? ACTIVE_LEVEL : !ACTIVE_LEVEL;
+            ref->level = level;
+            ps->level = level;
+            step++;
+        }
+
+        if (s_now % TICKS_INTERVAL == 0) {
+            ref->scans++;
+            TEST_ASSERT_FALSE(button_scan(&ref->dev));
+        }
+
+        /* scan timer of the power save button, as button_cb() */
+        if (ps->timer_running && s_now == ps->next_tick) {
+            ps->scans++;
+            ps->next_tick += TICKS_INTERVAL;
+            if (button_scan(&ps->dev)) {
+                ps->timer_running = false;
+                ps->intr_enabled = true;
+            }
+        }
+        /* level interrupt, as button_power_save_isr_handler() */
+        if (ps->intr_enabled && ps->level == ACTIVE_LEVEL) {
+            ps->intr_enabled = false;
+            if (!ps->timer_running) {
+                ps->timer_running = true;
+                ps->next_tick = s_now + TICKS_INTERVAL;
+                ps->wakeups++;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Both buttons saw the same events, at most one scan period apart, and the power save one went back to sleep
+ */
+static void test_check_same(const test_button_t *ref, const test_button_t *ps, const char *name)
+{
+    TEST_ASSERT_EQUAL_INT_MESSAGE(ref->event_num, ps->event_num, name);
+    for (int i = 0; i < ref->event_num; i++) {
+        TEST_ASSERT_EQUAL_INT_MESSAGE(ref->events[i].event, ps->events[i].event, name);
+        TEST_ASSERT_INT_WITHIN_MESSAGE(TICKS_INTERVAL, ref->events[i].ms, ps->events[i].ms, name);
+    }
+    TEST_ASSERT_FALSE_MESSAGE(ps->timer_running, name);
+    TEST_ASSERT_TRUE_MESSAGE(ps->intr_enabled, name);
+    printf("%-12s events %2d, scan ticks %5u -> %4u, wakeups %u\n", name, ref->event_num,
+           (unsigned)ref->scans, (unsigned)ps->scans, (unsigned)ps->wakeups);
+}
+
+static int test_count(const test_button_t *b, button_event_t event)
+{
+    int n = 0;
+    for (int i = 0; i < b->event_num; i++) {
+        if (b->events[i].event == event) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static test_button_t s_ref;
+static test_button_t s_ps;
+
+static void test_single_click(void)
+{
+    const test_step_t steps[] = { {103, true}, {221, false} };
+    test_run(steps, 2, 1000, &s_ref, &s_ps);
+    test_check_same(&s_ref, &s_ps, "single");
+    TEST_ASSERT_EQUAL_INT(1, test_count(&s_ref, BUTTON_SINGLE_CLICK));
+    TEST_ASSERT_EQUAL_INT(0, test_count(&s_ref, BUTTON_DOUBLE_CLICK));
+    TEST_ASSERT_EQUAL_INT(1, test_count(&s_ref, BUTTON_PRESS_REPEAT_DONE));
+}
+
+static void test_double_click(void)
+{
+    const test_step_t steps[] = { {103, true}, {183, false}, {263, true}, {343, false} };
+    test_run(steps, 4, 1000, &s_ref, &s_ps);
+    test_check_same(&s_ref, &s_ps, "double");
+    TEST_ASSERT_EQUAL_INT(1, test_count(&s_ref, BUTTON_DOUBLE_CLICK));
+    TEST_ASSERT_EQUAL_INT(1, test_count(&s_ref, BUTTON_PRESS_REPEAT));
+    TEST_ASSERT_EQUAL_INT(0, test_count(&s_ref, BUTTON_SINGLE_CLICK));
+}
+
+static void test_triple_click(void)
+{
+    const test_step_t steps[] = { {101, true}, {181, false}, {262, true}, {341, false}, {423, true}, {502, false} };
+    test_run(steps, 6, 1200, &s_ref, &s_ps);
+    test_check_same(&s_ref, &s_ps, "triple");
+    TEST_ASSERT_EQUAL_INT(1, test_count(&s_ref, BUTTON_MULTIPLE_CLICK));
+    TEST_ASSERT_EQUAL_INT(2, test_count(&s_ref, BUTTON_PRESS_REPEAT));
+}
+
+static void test_long_press_hold(void)
+{
+    const test_step_t steps[] = { {103, true}, {2503, false} };
+    test_run(steps, 2, 3000, &s_ref, &s_ps);
+    test_check_same(&s_ref, &s_ps, "long press");
+    TEST_ASSERT_EQUAL_INT(1, test_count(&s_ref, BUTTON_LONG_PRESS_START));
+    TEST_ASSERT_EQUAL_INT(1, test_count(&s_ref, BUTTON_LONG_PRESS_UP));
+    TEST_ASSERT_GREATER_THAN_INT(40, test_count(&s_ref, BUTTON_LONG_PRESS_HOLD));
+    TEST_ASSERT_EQUAL_INT(0, test_count(&s_ref, BUTTON_SINGLE_CLICK));
+}
+
+static void test_bounce(void)
+{
+    /* contact bounce shorter than a scan period on press and release */
+    const test_step_t steps[] = {
+        {103, true}, {104, false}, {106, true}, {107, false}, {108, true},
+        {221, false}, {222, true}, {224, false}, {225, true}, {226, false},
+    };
+    test_run(steps, 10, 1000, &s_ref, &s_ps);
+    test_check_same(&s_ref, &s_ps, "bounce");
+    TEST_ASSERT_EQUAL_INT(1, test_count(&s_ref, BUTTON_PRESS_DOWN));
+    TEST_ASSERT_EQUAL_INT(1, test_count(&s_ref, BUTTON_SINGLE_CLICK));
+}
+
+static void test_glitch_goes_back_to_sleep(void)
+{
+    /* a spike wakes the power save button, which finds nothing and stops again */
+    const test_step_t steps[] = { {303, true}, {305, false}, {5003, true}, {5004, false} };
+    test_run(steps, 4, 10000, &s_ref, &s_ps);
+    test_check_same(&s_ref, &s_ps, "glitch");
+    TEST_ASSERT_EQUAL_INT(0, s_ref.event_num);
+    TEST_ASSERT_EQUAL_UINT32(2, s_ps.wakeups);
+    TEST_ASSERT_LESS_THAN_UINT32(10, s_ps.scans);
+}
+
+static void test_idle_minute(void)
+{
+    /* one click in a minute: the periodic scan runs 12000 ticks, power save about a hundred */
+    const test_step_t steps[] = { {30003, true}, {30121, false} };
+    test_run(steps, 2, 60000, &s_ref, &s_ps);
+    test_check_same(&s_ref, &s_ps, "idle minute");
+    TEST_ASSERT_EQUAL_INT(1, test_count(&s_ref, BUTTON_SINGLE_CLICK));
+    TEST_ASSERT_LESS_THAN_UINT32(s_ref.scans / 50, s_ps.scans);
+}
+
+void app_main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_single_click);
+    RUN_TEST(test_double_click);
+    RUN_TEST(test_triple_click);
+    RUN_TEST(test_long_press_hold);
+    RUN_TEST(test_bounce);
+    RUN_TEST(test_glitch_goes_back_to_sleep);
+    RUN_TEST(test_idle_minute);
+    UNITY_END();
+}
@@ -0,0 +1,338 @@
+#include "cat1_bringup.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_modem_api.h"
+
+#define TAG "-->CAT1"  // Logging tag for CAT1 module
+
+static const int g_allRates[] = {115200, 230400, 460800, 921600};
+static const int g_targetRate[] = {CAT1_BRINGUP_BAUD_RATE};
+
+static void set_status(char *modemStatus, size_t statusLen, const char *status)
+{
+    snprintf(modemStatus, statusLen, "%s", status);
+}
+
+/**
+ * Get current baud rate from module
+ * @param ops Platform callbacks
+ * @return Current baud rate or -1 on error
+ */
+static int32_t get_baud_rate(const cat1BringupOps_t *ops)
+{
+    int32_t baud_rate = -1;
+    char atResp[256];
+
+    memset(atResp, 0, sizeof(atResp));
+    esp_err_t err = ops->write_at(ops->ctx, "AT+IPR?\r", atResp, sizeof(atResp), 300, "OK", "ERROR");
+    if (err != ESP_OK) {
+        ESP_LOGI(TAG, "AT+IPR? failed with %d", err);
+        return baud_rate;
+    }
+    ESP_LOGI(TAG, "AT+IPR?=>%s", atResp);
+    char *p = strstr(atResp, "+IPR:");
+    if (p) {
+        p += strlen("+IPR:");
+        baud_rate = atoi(p);
+    }
+    return baud_rate;
+}
+
+esp_err_t cat1_bringup_baud_rate(const cat1BringupOps_t *ops, uint32_t storedBaud)
+{
+    esp_err_t err = ESP_FAIL;
+    char atCmd[64];
+    char atResp[256];
+
+    // Quectel (EC800E/EG915Q) default baud rate is 115200, needs to be changed to 921600
+    const int *baud_rate_array = NULL;
+    int baud_rate_len = 0;
+    int baud_rate_index = 0;
+    if (storedBaud != CAT1_BRINGUP_BAUD_RATE) {
+        baud_rate_array = g_allRates;
+        baud_rate_len = 4;
+    } else {
+        baud_rate_array = g_targetRate;
+        baud_rate_len = 1;
+    }
+    int try_count = 0;
+    while (true) {
+        try_count++;
+        if (try_count > 30) {
+            ESP_LOGE(TAG, "get baud rate failed");
+            break;
+        }
+        // Error handling to avoid failing to find suitable baud rate
+        if (try_count > 20 && baud_rate_len != 4) {
+            baud_rate_array = g_allRates;
+            baud_rate_len = 4;
+            baud_rate_index = 0;
+        }
+        ESP_LOGI(TAG, "use baud rate %d to get baud rate", baud_rate_array[baud_rate_index]);
+        ops->set_baud(ops->ctx, baud_rate_array[baud_rate_index]);
+
+        int32_t n = get_baud_rate(ops);
+        if (n < 0) {
+            baud_rate_index++;
+            if (baud_rate_index >= baud_rate_len) {
+                baud_rate_index = 0;
+            }
+            ops->delay_ms(ops->ctx, 100);
+            continue;
+        }
+
+        ESP_LOGI(TAG, "current baud rate is %ld", (long)n);
+        err = ESP_OK;
+        if (n != CAT1_BRINGUP_BAUD_RATE) {
+            snprintf(atCmd, sizeof(atCmd), "AT+IPR=%d;&W\r", CAT1_BRINGUP_BAUD_RATE);
+            err = ops->write_at(ops->ctx, atCmd, atResp, sizeof(atResp), 1000, "OK", "ERROR");
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "AT+IPR failed with %d", err);
+                ops->delay_ms(ops->ctx, 100);
+                continue;
+            }
+            ESP_LOGI(TAG, "set baud rate to %d", CAT1_BRINGUP_BAUD_RATE);
+        }
+        break;
+    }
+    return err;
+}
+
+esp_err_t cat1_bringup_pin(const cat1BringupOps_t *ops, esp_modem_dce_t *dce, const cat1BringupParam_t *param,
+                           char *modemStatus, size_t statusLen)
+{
+    char atCmd[256];
+    char atResp[256];
+    esp_err_t err = ESP_OK;
+
+    memset(atResp, 0, sizeof(atResp));
+    snprintf(atCmd, sizeof(atCmd), "%s", "ATE0");
+    err = esp_modem_at(dce, atCmd, atResp, 500);
+    ESP_LOGI(TAG, "%s=>%s", atCmd, atResp);
+
+    // Check if a PIN is required
+    int retry = 0;
+    while (retry++ < 10) {
+        memset(atResp, 0, sizeof(atResp));
+        snprintf(atCmd, sizeof(atCmd), "%s", "AT+CPIN?");
+        err = esp_modem_at(dce, atCmd, atResp, 500);
+        ESP_LOGI(TAG, "%s=>%s", atCmd, atResp);
+        if (err == ESP_OK && strstr(atResp, "+CPIN:") != NULL) {
+            break;
+        }
+        ops->delay_ms(ops->ctx, 1000);
+    }
+    if (err == ESP_OK) {
+        if (strstr(atResp, "READY") != NULL) {
+            // No PIN required
+            set_status(modemStatus, statusLen, "Ready");
+        } else if (strstr(atResp, "SIM PIN")) {
+            // PIN code is required, try to enter the PIN code
+            if (param->pin[0] == '\0') {
+                err = ESP_FAIL;
+                ESP_LOGE(TAG, "PIN code is required, please set it in the configuration");
+                set_status(modemStatus, statusLen, "PIN Required");
+            } else {
+                memset(atResp, 0, sizeof(atResp));
+                snprintf(atCmd, sizeof(atCmd), "AT+CPIN=%s", param->pin);// compatible with EG912U-GL modification
+                err = esp_modem_at(dce, atCmd, atResp, 5000);
+                ESP_LOGI(TAG, "%s=>%s", atCmd, atResp);
+                if (err == ESP_OK) {
+                    ESP_LOGI(TAG, "esp_modem_at(%s) success", atCmd);
+                    set_status(modemStatus, statusLen, "Ready");
+                } else {
+                    ESP_LOGE(TAG, "esp_modem_at(%s) failed with %d(%s)", atCmd, err, atResp);
+                    set_status(modemStatus, statusLen, "PIN Error");
+                }
+            }
+        } else if (strstr(atResp, "SIM PUK")) {
+            // PUK code is required and needs to be solved by the user
+            err = ESP_FAIL;
+            ESP_LOGE(TAG, "PUK code is required, please contact your service provider");
+            set_status(modemStatus, statusLen, "PUK Required");
+        } else {
+            // Other states are not processed yet and are considered SIM card errors.
+            err = ESP_FAIL;
+            ESP_LOGE(TAG, "PIN status is not supported");
+            set_status(modemStatus, statusLen, "SIM Card Error");
+        }
+    } else {
+        ESP_LOGE(TAG, "SIM card error");
+        int errCode = -1;
+        sscanf(atResp, "+CME ERROR: %d", &errCode);
+        switch (errCode) {
+        case 10:
+            set_status(modemStatus, statusLen, "No SIM Card");
+            break;
+        default:
+            set_status(modemStatus, statusLen, "SIM Card Error");
+        }
+    }
+
+    return err;
+}
+
+/**
+ * Check if current operator is Verizon (reference: verizon.c)
+ * Verizon US: IMSI prefix 311480 (MCC 311, MNC 480) or operator name contains "Verizon"
+ */
+static bool is_verizon_network(esp_modem_dce_t *dce)
+{
+    char atResp[256];
+    esp_err_t err;
+
+    /* Check by IMSI: Verizon US uses MCC 311, MNC 480 (IMSI prefix 311480) */
+    memset(atResp, 0, sizeof(atResp));
+    err = esp_modem_get_imsi(dce, atResp);
+    if (err == ESP_OK && strlen(atResp) >= 6) {
+        if (strncmp(atResp, "311480", 6) == 0) {
+            ESP_LOGI(TAG, "Verizon detected by IMSI prefix 311480");
+            return true;
+        }
+    }
+    /* Check by operator name from AT+COPS? */
+    memset(atResp, 0, sizeof(atResp));
+    err = esp_modem_at(dce, "AT+COPS?", atResp, 1000);
+    if (err == ESP_OK && strstr(atResp, "Verizon") != NULL) {
+        ESP_LOGI(TAG, "Verizon detected by operator name");
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * Quectel (EC800E/EG915Q) Verizon compatibility (ref: verizon.c, Quectel LTE TCP/IP App Note):
+ * 1. PDP context 3: Verizon requires context 3 for data (OTA-DM uses ctx1 for attach, ctx3 for bearer)
+ * 2. AT+CGDCONT: define PDP context (APN). Empty APN ok for Verizon auto-provision.
+ * 3. AT+QICSGP: configure TCP/IP context (context_id, protocol, APN, user, pass, auth)
+ * 4. AT+QNETDEVCTL=1,3,1: activate context 3 before dial (in udhcpcd_dialer)
+ * 5. ATD*99***3#: dial using context 3 (via esp_modem pdp context_id)
+ */
+esp_err_t cat1_bringup_network(const cat1BringupOps_t *ops, esp_modem_dce_t *dce, const cat1BringupParam_t *param,
+                               char *modemStatus, size_t statusLen)
+{
+    char atCmd[256];
+    char atResp[256];
+    esp_err_t err = ESP_OK;
+    int reg_state = 0;
+    int reg_retry = 0;
+    int max_retry = 10;
+    int context_id = 1;  /* Default context 1; use 3 for Verizon */
+
+    /* Verizon compatibility: use PDP context 3 when isp_select=verizon or (isp_select=auto/empty and network detected as Verizon) */
+    bool force_verizon = (strcmp(param->isp, "verizon") == 0);
+    bool auto_verizon = is_verizon_network(dce);
+    bool is_auto = (param->isp[0] == '\0' || strcmp(param->isp, "auto") == 0);
+    if (force_verizon || (is_auto && auto_verizon)) {
+        context_id = 3;
+        ESP_LOGI(TAG, "Using PDP context 3 (isp_select=%s, force=%d, auto_detect=%d)",
+                 param->isp, (int)force_verizon, (int)auto_verizon);
+
+        /* Verizon: clear context 1 before configuring context 3 (ref: AT+QICSGP=1,3,"","","",0) */
+        memset(atResp, 0, sizeof(atResp));
+        err = esp_modem_at(dce, "AT+QICSGP=1,3,\"\",\"\",\"\",0", atResp, 500);
+        ESP_LOGI(TAG, "AT+QICSGP=1,3,\"\",\"\",\"\",0=>%s", atResp);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "AT+QICSGP clear ctx1 failed %d(%s)", err, atResp);
+        }
+    }
+
+    /* Configure PDP context (required for Verizon context 3 even when APN is empty)
+     * 1. esp_modem_configure_pdp_context: updates internal pdp context (used by setup_data_mode)
+     * 2. esp_modem_set_pdp_context: sends AT+CGDCONT + sets dial context (ATD*99***X#)
+     * 3. AT+QICSGP: configure TCP/IP context
+     */
+    const char *apn = (param->apn[0] != '\0') ? param->apn : "";
+
+    /* Configure internal PDP context (updates GenericModule::pdp member) */
+    esp_modem_PdpContext_t pdp_ctx = {
+        .context_id = context_id,
+        .protocol_type = "IP",
+        .apn = apn,
+    };
+    err = esp_modem_configure_pdp_context(dce, &pdp_ctx);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_modem_configure_pdp_context failed %d", err);
+        set_status(modemStatus, statusLen, "SIM Card Error");
+    }
+    /* AT+QICSGP: context_id, protocol_type(1=IPv4), APN, user, pass, auth  */
+    memset(atResp, 0, sizeof(atResp));
+    snprintf(atCmd, sizeof(atCmd), "AT+QICSGP=%d,1,\"%s\",\"%s\",\"%s\",%d",
+             context_id, apn, param->user, param->password, param->authentication);
+    err = esp_modem_at(dce, atCmd, atResp, 500);
+    ESP_LOGI(TAG, "%s=>%s", atCmd, atResp);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_modem_at(%s) failed with %d(%s)", atCmd, err, atResp);
+        set_status(modemStatus, statusLen, "SIM Card Error");
+    }
+
+    // Activate roaming service
+    memset(atResp, 0, sizeof(atResp));
+    snprintf(atCmd, sizeof(atCmd), "%s", "AT+QCFG=\"roamservice\",2,1");
+    err = esp_modem_at(dce, atCmd, atResp, 500);
+    ESP_LOGI(TAG, "%s=>%s", atCmd, atResp);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_modem_at(%s) failed with %d(%s)", atCmd, err, atResp);
+        set_status(modemStatus, statusLen, "SIM Card Error");
+    }
+
+    // Enable network registration with location information, otherwise LAC and Cell ID cannot be obtained
+    memset(atResp, 0, sizeof(atResp));
+    snprintf(atCmd, sizeof(atCmd), "%s", "AT+CREG=2");
+    err = esp_modem_at(dce, atCmd, atResp, 500);
+    ESP_LOGI(TAG, "%s=>%s", atCmd, atResp);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_modem_at(%s) failed with %d(%s)", atCmd, err, atResp);
+    }
+    /* Wait for network registration before entering PPP data mode.
+     * When the module is still searching (CREG/CEREG=2 or QENG: "SEARCH"/"NOCONN"),
+     * forcing DATA mode often fails with ESP_FAIL. Here we poll the registration
+     * state for a short period; if it never reaches Registered(1/5), we skip PPP
+     * for this cycle and let upper layers treat it as "no network, save to flash".
+     */
+    while (reg_retry++ < max_retry) {
+        if (esp_modem_get_network_registration_state(dce, &reg_state) == ESP_OK &&
+            (reg_state == 1 || reg_state == 5)) {
+            ESP_LOGI(TAG, "Network registered, state=%d", reg_state);
+            break;
+        }
+        ESP_LOGI(TAG, "Network not registered yet, state=%d, retry=%d/%d",
+                 reg_state, reg_retry, max_retry);
+        ops->delay_ms(ops->ctx, 1000);
+    }
+
+    if (!(reg_state == 1 || reg_state == 5)) {
+        ESP_LOGW(TAG, "Network still not registered, skip PPP dialing this cycle");
+        set_status(modemStatus, statusLen, "Network Searching");
+        return ESP_FAIL;
+    }
+
+    reg_retry = 0;
+    max_retry = 5;
+    while (reg_retry++ < max_retry) {
+        ESP_LOGI(TAG, "Setting mode, retry=%d/%d", reg_retry, max_retry);
+        if (param->cmux) {
+            ESP_LOGI(TAG, "Using CMUX mode");
+            err = esp_modem_set_mode(dce, ESP_MODEM_MODE_CMUX);
+            if (err == ESP_OK) {
+                ESP_LOGI(TAG, "CMUX mode enabled successfully");
+                break;
+            }
+        } else {
+            ESP_LOGI(TAG, "Using DATA mode");
+            err = esp_modem_set_mode(dce, ESP_MODEM_MODE_DATA);
+            if (err == ESP_OK) {
+                ESP_LOGI(TAG, "DATA mode enabled successfully");
+                break;
+            }
+        }
+        esp_modem_set_mode(dce, ESP_MODEM_MODE_UNDEF);
+        ops->delay_ms(ops->ctx, 1000);
+    }
+
+    return ESP_OK;
+}
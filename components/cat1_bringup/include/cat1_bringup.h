@@ -0,0 +1,84 @@
+/**
+ * CAT1 module bring-up AT sequence
+ *
+ * The steps of main/cat1.c that talk to the module: baud rate negotiation,
+ * SIM PIN check and network registration up to the DATA or CMUX mode switch.
+ * They only use the esp_modem C API and the callbacks below, so the host test
+ * of esp_modem runs the same sequence against a simulated module.
+ */
+#ifndef __CAT1_BRINGUP_H__
+#define __CAT1_BRINGUP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_modem_c_api_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CAT1_BRINGUP_BAUD_RATE (921600)     ///< Baud rate the module is switched to
+
+/**
+ * Platform callbacks of the bring-up
+ */
+typedef struct cat1BringupOps {
+    void *ctx;                                                      ///< Passed to every callback
+    void (*delay_ms)(void *ctx, int ms);                            ///< Wait between retries
+    void (*set_baud)(void *ctx, uint32_t baud);                     ///< Switch the host UART rate
+    esp_err_t (*write_at)(void *ctx, const char *atCmd, char *atResp, int atRespLen,
+                          int timeout, const char *pass, const char *fail); ///< Raw AT exchange before the DCE exists
+} cat1BringupOps_t;
+
+/**
+ * Cellular settings the bring-up uses
+ */
+typedef struct cat1BringupParam {
+    bool cmux;                  ///< Enter CMUX mode instead of DATA mode
+    const char *pin;            ///< SIM PIN, empty if none
+    const char *isp;            ///< "auto", "verizon" or empty
+    const char *apn;
+    const char *user;
+    const char *password;
+    uint8_t authentication;
+} cat1BringupParam_t;
+
+/**
+ * Find the module's baud rate and switch it to CAT1_BRINGUP_BAUD_RATE
+ * @param ops Platform callbacks
+ * @param storedBaud Rate the module was last switched to, tried first when it is CAT1_BRINGUP_BAUD_RATE
+ * @return ESP_OK on success
+ */
+esp_err_t cat1_bringup_baud_rate(const cat1BringupOps_t *ops, uint32_t storedBaud);
+
+/**
+ * Check the SIM PIN status and enter the PIN if required
+ * @param ops Platform callbacks
+ * @param dce Modem
+ * @param param Cellular settings
+ * @param modemStatus Output, modem status shown to the user
+ * @param statusLen Size of modemStatus
+ * @return ESP_OK when the SIM is ready
+ */
+esp_err_t cat1_bringup_pin(const cat1BringupOps_t *ops, esp_modem_dce_t *dce, const cat1BringupParam_t *param,
+                           char *modemStatus, size_t statusLen);
+
+/**
+ * Configure the PDP context, wait for the registration and enter DATA or CMUX mode
+ * @param ops Platform callbacks
+ * @param dce Modem
+ * @param param Cellular settings
+ * @param modemStatus Output, modem status shown to the user
+ * @param statusLen Size of modemStatus
+ * @return ESP_OK once registered, ESP_FAIL when the network is not found
+ */
+esp_err_t cat1_bringup_network(const cat1BringupOps_t *ops, esp_modem_dce_t *dce, const cat1BringupParam_t *param,
+                               char *modemStatus, size_t statusLen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CAT1_BRINGUP_H__ */
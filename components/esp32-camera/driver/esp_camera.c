@@ -20,6 +20,7 @@
 #include "freertos/task.h"
 #include "driver/gpio.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "sensor.h"
@@ -145,6 +146,31 @@ static const sensor_func_t g_sensors[] = {
 #endif
 };
 
+/**
+ * Read the sensor ID at slv_addr and initialize the matching driver.
+ * Attention: Some sensors have the same SCCB address. Therefore, several attempts may be made in the detection process
+ */
+static void camera_detect(uint8_t slv_addr, uint16_t pid_hint, camera_model_t *out_camera_model)
+{
+    sensor_id_t *id = &s_state->sensor.id;
+    s_state->sensor.slv_addr = slv_addr;
+    for (size_t i = 0; i < sizeof(g_sensors) / sizeof(sensor_func_t); i++) {
+        memset(id, 0, sizeof(*id));
+        if (g_sensors[i].detect(slv_addr, id)) {
+            if (pid_hint && id->PID != pid_hint) {
+                continue;
+            }
+            camera_sensor_info_t *info = esp_camera_sensor_get_info(id);
+            if (NULL != info) {
+                *out_camera_model = info->model;
+                ESP_LOGI(TAG, "Detected %s camera", info->name);
+                g_sensors[i].init(&s_state->sensor);
+                break;
+            }
+        }
+    }
+}
+
 static esp_err_t camera_probe(const camera_config_t *config, camera_model_t *out_camera_model)
 {
     esp_err_t ret = ESP_OK;
@@ -203,35 +229,32 @@ static esp_err_t camera_probe(const camera_config_t *config, camera_model_t *out
         vTaskDelay(10 / portTICK_PERIOD_MS);
     }
 
-    ESP_LOGD(TAG, "Searching for camera address");
-    vTaskDelay(10 / portTICK_PERIOD_MS);
-
-    uint8_t slv_addr = SCCB_Probe();
+    s_state->sensor.xclk_freq_hz = config->xclk_freq_hz;
 
-    if (slv_addr == 0) {
-        ret = ESP_ERR_NOT_FOUND;
-        goto err;
+    uint8_t slv_addr = 0;
+    if (config->sccb_addr_hint) {
+        // Known-good address from a previous boot: skip the address scan
+        slv_addr = config->sccb_addr_hint;
+        ESP_LOGD(TAG, "Trying cached camera address 0x%02x", slv_addr);
+        camera_detect(slv_addr, config->sensor_pid_hint, out_camera_model);
+        if (CAMERA_NONE == *out_camera_model) {
+            ESP_LOGW(TAG, "Cached camera 0x%02x/0x%x not found, probing", slv_addr, config->sensor_pid_hint);
+        }
     }
 
-    ESP_LOGI(TAG, "Detected camera at address=0x%02x", slv_addr);
-    s_state->sensor.slv_addr = slv_addr;
-    s_state->sensor.xclk_freq_hz = config->xclk_freq_hz;
+    if (CAMERA_NONE == *out_camera_model) {
+        ESP_LOGD(TAG, "Searching for camera address");
+        vTaskDelay(10 / portTICK_PERIOD_MS);
 
-    /**
-     * Read sensor ID and then initialize sensor
-     * Attention: Some sensors have the same SCCB address. Therefore, several attempts may be made in the detection process
-     */
-    sensor_id_t *id = &s_state->sensor.id;
-    for (size_t i = 0; i < sizeof(g_sensors) / sizeof(sensor_func_t); i++) {
-        if (g_sensors[i].detect(slv_addr, id)) {
-            camera_sensor_info_t *info = esp_camera_sensor_get_info(id);
-            if (NULL != info) {
-                *out_camera_model = info->model;
-                ESP_LOGI(TAG, "Detected %s camera", info->name);
-                g_sensors[i].init(&s_state->sensor);
-                break;
-            }
+        slv_addr = SCCB_Probe();
+
+        if (slv_addr == 0) {
+            ret = ESP_ERR_NOT_FOUND;
+            goto err;
         }
+
+        ESP_LOGI(TAG, "Detected camera at address=0x%02x", slv_addr);
+        camera_detect(slv_addr, 0, out_camera_model);
     }
 
     if (CAMERA_NONE == *out_camera_model) { //If no supported sensors are detected
@@ -240,6 +263,7 @@ static esp_err_t camera_probe(const camera_config_t *config, camera_model_t *out
         goto err;
     }
 
+    sensor_id_t *id = &s_state->sensor.id;
     ESP_LOGI(TAG, "Camera PID=0x%02x VER=0x%02x MIDL=0x%02x MIDH=0x%02x",
              id->PID, id->VER, id->MIDH, id->MIDL);
 
@@ -279,6 +303,8 @@ esp_err_t esp_camera_init(const camera_config_t *config)
     }
 
     camera_model_t camera_model = CAMERA_NONE;
+    int64_t sensor_start_us = esp_timer_get_time();
+    SCCB_Reset_Stats();
     err = camera_probe(config, &camera_model);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Camera probe failed with error 0x%x(%s)", err, esp_err_to_name(err));
@@ -334,6 +360,12 @@ esp_err_t esp_camera_init(const camera_config_t *config)
     }
     s_state->sensor.init_status(&s_state->sensor);
 
+    sccb_stats_t sccb_stats;
+    SCCB_Get_Stats(&sccb_stats);
+    ESP_LOGI(TAG, "Sensor init %lld ms, %u SCCB transactions for %u register writes",
+             (esp_timer_get_time() - sensor_start_us) / 1000,
+             (unsigned)sccb_stats.transactions, (unsigned)sccb_stats.writes);
+
     cam_start();
 
     return ESP_OK;
@@ -155,6 +155,9 @@ typedef struct {
 #endif
 
     int sccb_i2c_port;              /*!< If pin_sccb_sda is -1, use the already configured I2C bus by number */
+
+    uint8_t sccb_addr_hint;         /*!< SCCB address of the sensor found last time, 0 to scan all known addresses */
+    uint16_t sensor_pid_hint;       /*!< PID expected at sccb_addr_hint, 0 to accept any supported sensor */
 } camera_config_t;
 
 /**
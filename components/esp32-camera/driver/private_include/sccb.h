@@ -9,6 +9,8 @@
 #ifndef __SCCB_H__
 #define __SCCB_H__
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 int SCCB_Init(int pin_sda, int pin_scl);
 int SCCB_Use_Port(int sccb_i2c_port);
 int SCCB_Deinit(void);
@@ -19,4 +21,50 @@ uint8_t SCCB_Read16(uint8_t slv_addr, uint16_t reg);
 int SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data);
 uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg);
 int SCCB_Write_Addr16_Val16(uint8_t slv_addr, uint16_t reg, uint16_t data);
+
+/*
+ * Batched register writes.
+ *
+ * Writes are buffered and sent as one I2C command link per flush, each run of
+ * consecutive registers as a single auto-increment burst when the sensor
+ * supports it. The batch flushes itself when full; callers must flush before
+ * any delay or read that depends on the written registers.
+ */
+#define SCCB_BATCH_MAX_WRITES   64  // Registers buffered per command link
+#define SCCB_BATCH_MAX_RUN      16  // Longest auto-increment burst
+
+typedef struct {
+    uint16_t reg;       // First register of the run
+    uint8_t len;        // Number of data bytes
+    uint8_t offset;     // Index of the first data byte in the batch buffer
+} sccb_run_t;
+
+// Bus backend: send all runs in one transfer, return 0 on success
+typedef int (*sccb_batch_xfer_t)(void *ctx, uint8_t slv_addr, uint8_t reg_bytes,
+                                 const sccb_run_t *runs, size_t count, const uint8_t *data);
+
+typedef struct {
+    uint8_t slv_addr;
+    uint8_t reg_bytes;  // 1 or 2 address bytes
+    bool auto_inc;      // Merge consecutive registers into bursts
+    sccb_batch_xfer_t xfer;
+    void *ctx;
+    size_t run_count;
+    size_t data_len;
+    sccb_run_t runs[SCCB_BATCH_MAX_WRITES];
+    uint8_t data[SCCB_BATCH_MAX_WRITES];
+} sccb_batch_t;
+
+typedef struct {
+    uint32_t transactions;  // I2C command links executed
+    uint32_t writes;        // Registers written by links that succeeded
+} sccb_stats_t;
+
+void SCCB_Batch_Init(sccb_batch_t *batch, uint8_t slv_addr, uint8_t reg_bytes, bool auto_inc);
+void SCCB_Batch_Init_Bus(sccb_batch_t *batch, uint8_t slv_addr, uint8_t reg_bytes, bool auto_inc,
+                         sccb_batch_xfer_t xfer, void *ctx);
+int SCCB_Batch_Write(sccb_batch_t *batch, uint16_t reg, uint8_t data);
+int SCCB_Batch_Flush(sccb_batch_t *batch);
+void SCCB_Get_Stats(sccb_stats_t *stats);
+void SCCB_Reset_Stats(void);
 #endif // __SCCB_H__
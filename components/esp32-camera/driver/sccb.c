@@ -45,6 +45,13 @@ const int SCCB_I2C_PORT_DEFAULT = 0;
 
 static int sccb_i2c_port;
 static bool sccb_owns_i2c_port;
+static sccb_stats_t sccb_stats;
+
+static esp_err_t sccb_cmd_begin(i2c_cmd_handle_t cmd)
+{
+    sccb_stats.transactions++;
+    return i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+}
 
 int SCCB_Init(int pin_sda, int pin_scl)
 {
@@ -105,7 +112,7 @@ uint8_t SCCB_Probe(void)
         i2c_master_start(cmd);
         i2c_master_write_byte(cmd, ( slave_addr << 1 ) | WRITE_BIT, ACK_CHECK_EN);
         i2c_master_stop(cmd);
-        esp_err_t ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+        esp_err_t ret = sccb_cmd_begin(cmd);
         i2c_cmd_link_delete(cmd);
         if( ret == ESP_OK) {
             return slave_addr;
@@ -123,7 +130,7 @@ uint8_t SCCB_Read(uint8_t slv_addr, uint8_t reg)
     i2c_master_write_byte(cmd, ( slv_addr << 1 ) | WRITE_BIT, ACK_CHECK_EN);
     i2c_master_write_byte(cmd, reg, ACK_CHECK_EN);
     i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+    ret = sccb_cmd_begin(cmd);
     i2c_cmd_link_delete(cmd);
     if(ret != ESP_OK) return -1;
     cmd = i2c_cmd_link_create();
@@ -131,7 +138,7 @@ uint8_t SCCB_Read(uint8_t slv_addr, uint8_t reg)
     i2c_master_write_byte(cmd, ( slv_addr << 1 ) | READ_BIT, ACK_CHECK_EN);
     i2c_master_read_byte(cmd, &data, NACK_VAL);
     i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+    ret = sccb_cmd_begin(cmd);
     i2c_cmd_link_delete(cmd);
     if(ret != ESP_OK) {
         ESP_LOGE(TAG, "SCCB_Read Failed addr:0x%02x, reg:0x%02x, data:0x%02x, ret:%d", slv_addr, reg, data, ret);
@@ -148,10 +155,12 @@ int SCCB_Write(uint8_t slv_addr, uint8_t reg, uint8_t data)
     i2c_master_write_byte(cmd, reg, ACK_CHECK_EN);
     i2c_master_write_byte(cmd, data, ACK_CHECK_EN);
     i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+    ret = sccb_cmd_begin(cmd);
     i2c_cmd_link_delete(cmd);
     if(ret != ESP_OK) {
         ESP_LOGE(TAG, "SCCB_Write Failed addr:0x%02x, reg:0x%02x, data:0x%02x, ret:%d", slv_addr, reg, data, ret);
+    } else {
+        sccb_stats.writes++;
     }
     return ret == ESP_OK ? 0 : -1;
 }
@@ -168,7 +177,7 @@ uint8_t SCCB_Read16(uint8_t slv_addr, uint16_t reg)
     i2c_master_write_byte(cmd, reg_u8[0], ACK_CHECK_EN);
     i2c_master_write_byte(cmd, reg_u8[1], ACK_CHECK_EN);
     i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+    ret = sccb_cmd_begin(cmd);
     i2c_cmd_link_delete(cmd);
     if(ret != ESP_OK) return -1;
     cmd = i2c_cmd_link_create();
@@ -176,7 +185,7 @@ uint8_t SCCB_Read16(uint8_t slv_addr, uint16_t reg)
     i2c_master_write_byte(cmd, ( slv_addr << 1 ) | READ_BIT, ACK_CHECK_EN);
     i2c_master_read_byte(cmd, &data, NACK_VAL);
     i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+    ret = sccb_cmd_begin(cmd);
     i2c_cmd_link_delete(cmd);
     if(ret != ESP_OK) {
         ESP_LOGE(TAG, "W [%04x]=%02x fail\n", reg, data);
@@ -197,10 +206,12 @@ int SCCB_Write16(uint8_t slv_addr, uint16_t reg, uint8_t data)
     i2c_master_write_byte(cmd, reg_u8[1], ACK_CHECK_EN);
     i2c_master_write_byte(cmd, data, ACK_CHECK_EN);
     i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+    ret = sccb_cmd_begin(cmd);
     i2c_cmd_link_delete(cmd);
     if(ret != ESP_OK) {
         ESP_LOGE(TAG, "W [%04x]=%02x %d fail\n", reg, data, i++);
+    } else {
+        sccb_stats.writes++;
     }
     return ret == ESP_OK ? 0 : -1;
 }
@@ -218,7 +229,7 @@ uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg)
     i2c_master_write_byte(cmd, reg_u8[0], ACK_CHECK_EN);
     i2c_master_write_byte(cmd, reg_u8[1], ACK_CHECK_EN);
     i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+    ret = sccb_cmd_begin(cmd);
     i2c_cmd_link_delete(cmd);
     if(ret != ESP_OK) return -1;
 
@@ -228,7 +239,7 @@ uint16_t SCCB_Read_Addr16_Val16(uint8_t slv_addr, uint16_t reg)
     i2c_master_read_byte(cmd, &data_u8[1], ACK_VAL);
     i2c_master_read_byte(cmd, &data_u8[0], NACK_VAL);
     i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+    ret = sccb_cmd_begin(cmd);
     i2c_cmd_link_delete(cmd);
     if(ret != ESP_OK) {
         ESP_LOGE(TAG, "W [%04x]=%04x fail\n", reg, data);
@@ -251,10 +262,62 @@ int SCCB_Write_Addr16_Val16(uint8_t slv_addr, uint16_t reg, uint16_t data)
     i2c_master_write_byte(cmd, data_u8[0], ACK_CHECK_EN);
     i2c_master_write_byte(cmd, data_u8[1], ACK_CHECK_EN);
     i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(sccb_i2c_port, cmd, 1000 / portTICK_RATE_MS);
+    ret = sccb_cmd_begin(cmd);
     i2c_cmd_link_delete(cmd);
     if(ret != ESP_OK) {
         ESP_LOGE(TAG, "W [%04x]=%04x fail\n", reg, data);
+    } else {
+        sccb_stats.writes += 2;
     }
     return ret == ESP_OK ? 0 : -1;
 }
+
+/*
+ * Hardware backend for batched writes: every run becomes one START/address/
+ * burst sequence, all chained with repeated STARTs in a single command link.
+ * A failed link is not replayed: the runs before the failure were already
+ * ACKed, and init tables hold registers such as soft reset, group hold/launch
+ * and stream on/off that must not be written twice. The error goes back to the
+ * caller, as the first failed write did before batching.
+ */
+static int sccb_batch_xfer(void *ctx, uint8_t slv_addr, uint8_t reg_bytes,
+                           const sccb_run_t *runs, size_t count, const uint8_t *data)
+{
+    esp_err_t ret = ESP_FAIL;
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    for (size_t i = 0; i < count; i++) {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, ( slv_addr << 1 ) | WRITE_BIT, ACK_CHECK_EN);
+        if (reg_bytes == 2) {
+            i2c_master_write_byte(cmd, runs[i].reg >> 8, ACK_CHECK_EN);
+        }
+        i2c_master_write_byte(cmd, runs[i].reg & 0xff, ACK_CHECK_EN);
+        i2c_master_write(cmd, &data[runs[i].offset], runs[i].len, ACK_CHECK_EN);
+    }
+    i2c_master_stop(cmd);
+    ret = sccb_cmd_begin(cmd);
+    i2c_cmd_link_delete(cmd);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "SCCB batch of %u runs from [%04x] failed %d", (unsigned)count, runs[0].reg, ret);
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        sccb_stats.writes += runs[i].len;
+    }
+    return 0;
+}
+
+void SCCB_Batch_Init(sccb_batch_t *batch, uint8_t slv_addr, uint8_t reg_bytes, bool auto_inc)
+{
+    SCCB_Batch_Init_Bus(batch, slv_addr, reg_bytes, auto_inc, sccb_batch_xfer, NULL);
+}
+
+void SCCB_Get_Stats(sccb_stats_t *stats)
+{
+    *stats = sccb_stats;
+}
+
+void SCCB_Reset_Stats(void)
+{
+    memset(&sccb_stats, 0, sizeof(sccb_stats));
+}
@@ -0,0 +1,52 @@
+/*
+ * SCCB batched register writes.
+ *
+ * Bus independent: buffers register writes, merges runs of consecutive
+ * registers and hands them to the bus backend in one call per flush.
+ */
+#include <string.h>
+#include "sccb.h"
+
+void SCCB_Batch_Init_Bus(sccb_batch_t *batch, uint8_t slv_addr, uint8_t reg_bytes, bool auto_inc,
+                         sccb_batch_xfer_t xfer, void *ctx)
+{
+    memset(batch, 0, sizeof(*batch));
+    batch->slv_addr = slv_addr;
+    batch->reg_bytes = reg_bytes;
+    batch->auto_inc = auto_inc;
+    batch->xfer = xfer;
+    batch->ctx = ctx;
+}
+
+int SCCB_Batch_Write(sccb_batch_t *batch, uint16_t reg, uint8_t data)
+{
+    int ret = 0;
+    if (batch->data_len == SCCB_BATCH_MAX_WRITES) {
+        ret = SCCB_Batch_Flush(batch);
+    }
+
+    sccb_run_t *last = batch->run_count ? &batch->runs[batch->run_count - 1] : NULL;
+    if (batch->auto_inc && last && last->len < SCCB_BATCH_MAX_RUN &&
+        (uint16_t)(last->reg + last->len) == reg) {
+        last->len++;
+    } else {
+        sccb_run_t *run = &batch->runs[batch->run_count++];
+        run->reg = reg;
+        run->len = 1;
+        run->offset = batch->data_len;
+    }
+    batch->data[batch->data_len++] = data;
+    return ret;
+}
+
+int SCCB_Batch_Flush(sccb_batch_t *batch)
+{
+    int ret = 0;
+    if (batch->run_count) {
+        ret = batch->xfer(batch->ctx, batch->slv_addr, batch->reg_bytes,
+                          batch->runs, batch->run_count, batch->data);
+    }
+    batch->run_count = 0;
+    batch->data_len = 0;
+    return ret;
+}
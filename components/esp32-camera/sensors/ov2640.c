@@ -38,17 +38,29 @@ static int set_bank(sensor_t *sensor, ov2640_bank_t bank)
 static int write_regs(sensor_t *sensor, const uint8_t (*regs)[2])
 {
     int i=0, res = 0;
+    sccb_batch_t batch;
+    // OV2640 has no register auto-increment, so writes are only queued per link
+    SCCB_Batch_Init(&batch, sensor->slv_addr, 1, false);
     while (regs[i][0]) {
         if (regs[i][0] == BANK_SEL) {
-            res = set_bank(sensor, regs[i][1]);
-        } else {
-            res = SCCB_Write(sensor->slv_addr, regs[i][0], regs[i][1]);
+            if (regs[i][1] == reg_bank) {
+                i++;
+                continue;
+            }
+            reg_bank = regs[i][1];
         }
+        res = SCCB_Batch_Write(&batch, regs[i][0], regs[i][1]);
         if (res) {
-            return res;
+            break;
         }
         i++;
     }
+    if (!res) {
+        res = SCCB_Batch_Flush(&batch);
+    }
+    if (res) {
+        reg_bank = BANK_MAX; // bank unknown after a failed batch, force reselect
+    }
     return res;
 }
 
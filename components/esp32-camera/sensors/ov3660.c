@@ -96,14 +96,20 @@ static int set_reg_bits(uint8_t slv_addr, uint16_t reg, uint8_t offset, uint8_t
 static int write_regs(uint8_t slv_addr, const uint16_t (*regs)[2])
 {
     int i = 0, ret = 0;
+    sccb_batch_t batch;
+    SCCB_Batch_Init(&batch, slv_addr, 2, true);
     while (!ret && regs[i][0] != REGLIST_TAIL) {
         if (regs[i][0] == REG_DLY) {
+            ret = SCCB_Batch_Flush(&batch);
             vTaskDelay(regs[i][1] / portTICK_PERIOD_MS);
         } else {
-            ret = write_reg(slv_addr, regs[i][0], regs[i][1]);
+            ret = SCCB_Batch_Write(&batch, regs[i][0], regs[i][1]);
         }
         i++;
     }
+    if (!ret) {
+        ret = SCCB_Batch_Flush(&batch);
+    }
     return ret;
 }
 
@@ -0,0 +1,154 @@
+#include <string.h>
+#include "unity.h"
+#include "sccb.h"
+
+#define MOCK_MAX_WRITES 256
+
+// Mock SCCB bus: counts transfers and replays runs into a flat write log
+typedef struct {
+    int transactions;
+    int runs;
+    int writes;
+    bool fail;          // Fail every transfer
+    uint16_t reg[MOCK_MAX_WRITES];
+    uint8_t val[MOCK_MAX_WRITES];
+} mock_bus_t;
+
+static int mock_xfer(void *ctx, uint8_t slv_addr, uint8_t reg_bytes,
+                     const sccb_run_t *runs, size_t count, const uint8_t *data)
+{
+    mock_bus_t *bus = (mock_bus_t *)ctx;
+    bus->transactions++;
+    if (bus->fail) {
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        bus->runs++;
+        for (uint8_t j = 0; j < runs[i].len && bus->writes < MOCK_MAX_WRITES; j++) {
+            bus->reg[bus->writes] = runs[i].reg + j;
+            bus->val[bus->writes] = data[runs[i].offset + j];
+            bus->writes++;
+        }
+    }
+    return 0;
+}
+
+static void test_merges_consecutive_registers_into_one_burst(void)
+{
+    static mock_bus_t bus;
+    sccb_batch_t batch;
+
+    memset(&bus, 0, sizeof(bus));
+    SCCB_Batch_Init_Bus(&batch, 0x3c, 2, true, mock_xfer, &bus);
+    for (int i = 0; i < 8; i++) {
+        TEST_ASSERT_EQUAL(0, SCCB_Batch_Write(&batch, 0x3800 + i, i));
+    }
+    TEST_ASSERT_EQUAL(0, bus.transactions);
+    TEST_ASSERT_EQUAL(0, SCCB_Batch_Flush(&batch));
+    TEST_ASSERT_EQUAL(1, bus.transactions);
+    TEST_ASSERT_EQUAL(1, bus.runs);
+    TEST_ASSERT_EQUAL(8, bus.writes);
+    TEST_ASSERT_EQUAL_HEX16(0x3807, bus.reg[7]);
+    TEST_ASSERT_EQUAL(7, bus.val[7]);
+}
+
+static void test_without_auto_increment_keeps_one_run_per_register(void)
+{
+    static mock_bus_t bus;
+    sccb_batch_t batch;
+
+    memset(&bus, 0, sizeof(bus));
+    SCCB_Batch_Init_Bus(&batch, 0x30, 1, false, mock_xfer, &bus);
+    for (int i = 0; i < 10; i++) {
+        SCCB_Batch_Write(&batch, 0x10 + i, i);
+    }
+    SCCB_Batch_Flush(&batch);
+    TEST_ASSERT_EQUAL(1, bus.transactions);
+    TEST_ASSERT_EQUAL(10, bus.runs);
+    TEST_ASSERT_EQUAL(10, bus.writes);
+}
+
+static void test_splits_long_runs_and_flushes_when_full(void)
+{
+    static mock_bus_t bus;
+    sccb_batch_t batch;
+    const int total = SCCB_BATCH_MAX_WRITES * 2 + 5;
+
+    memset(&bus, 0, sizeof(bus));
+    SCCB_Batch_Init_Bus(&batch, 0x3c, 2, true, mock_xfer, &bus);
+    for (int i = 0; i < total; i++) {
+        SCCB_Batch_Write(&batch, 0x4000 + i, (uint8_t)i);
+    }
+    SCCB_Batch_Flush(&batch);
+    TEST_ASSERT_EQUAL(3, bus.transactions);
+    TEST_ASSERT_EQUAL((total + SCCB_BATCH_MAX_RUN - 1) / SCCB_BATCH_MAX_RUN, bus.runs);
+    TEST_ASSERT_EQUAL(total, bus.writes);
+    for (int i = 0; i < total; i++) {
+        TEST_ASSERT_EQUAL_HEX16(0x4000 + i, bus.reg[i]);
+        TEST_ASSERT_EQUAL((uint8_t)i, bus.val[i]);
+    }
+}
+
+static void test_replays_a_sensor_table_in_order(void)
+{
+    // Excerpt shaped like the OV5640 init table: short runs mixed with singles
+    static const uint16_t regs[][2] = {
+        {0x3103, 0x11}, {0x3008, 0x42}, {0x3034, 0x1a}, {0x3035, 0x11}, {0x3036, 0x46},
+        {0x3037, 0x13}, {0x3108, 0x01}, {0x3630, 0x36}, {0x3631, 0x0e}, {0x3632, 0xe2},
+        {0x3633, 0x12}, {0x3621, 0xe0}, {0x3704, 0xa0}, {0x3703, 0x5a}, {0x3715, 0x78},
+        {0x3717, 0x01}, {0x370b, 0x60}, {0x3705, 0x1a}, {0x3905, 0x02}, {0x3906, 0x10},
+        {0x3901, 0x0a}, {0x3731, 0x12}, {0x3600, 0x08}, {0x3601, 0x33},
+    };
+    const int count = sizeof(regs) / sizeof(regs[0]);
+    static mock_bus_t bus;
+    sccb_batch_t batch;
+
+    memset(&bus, 0, sizeof(bus));
+    SCCB_Batch_Init_Bus(&batch, 0x3c, 2, true, mock_xfer, &bus);
+    for (int i = 0; i < count; i++) {
+        SCCB_Batch_Write(&batch, regs[i][0], regs[i][1]);
+    }
+    SCCB_Batch_Flush(&batch);
+    TEST_ASSERT_EQUAL(1, bus.transactions);
+    TEST_ASSERT_EQUAL(16, bus.runs);
+    TEST_ASSERT_EQUAL(count, bus.writes);
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_HEX16(regs[i][0], bus.reg[i]);
+        TEST_ASSERT_EQUAL_HEX8(regs[i][1], bus.val[i]);
+    }
+}
+
+static void test_bus_errors_are_returned(void)
+{
+    static mock_bus_t bus;
+    sccb_batch_t batch;
+
+    memset(&bus, 0, sizeof(bus));
+    SCCB_Batch_Init_Bus(&batch, 0x3c, 2, true, mock_xfer, &bus);
+    TEST_ASSERT_EQUAL(0, SCCB_Batch_Flush(&batch));
+    TEST_ASSERT_EQUAL(0, bus.transactions);
+
+    bus.fail = true;
+    for (int i = 0; i < SCCB_BATCH_MAX_WRITES; i++) {
+        TEST_ASSERT_EQUAL(0, SCCB_Batch_Write(&batch, 0x5000 + i, i));
+    }
+    // The full batch flushes on the next write, its error comes back and the new write is kept
+    TEST_ASSERT_EQUAL(-1, SCCB_Batch_Write(&batch, 0x6000, 1));
+    TEST_ASSERT_EQUAL(1, bus.transactions);
+    bus.fail = false;
+    TEST_ASSERT_EQUAL(0, SCCB_Batch_Flush(&batch));
+    TEST_ASSERT_EQUAL(2, bus.transactions);
+    TEST_ASSERT_EQUAL(1, bus.writes);
+    TEST_ASSERT_EQUAL_HEX16(0x6000, bus.reg[0]);
+}
+
+void app_main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_merges_consecutive_registers_into_one_burst);
+    RUN_TEST(test_without_auto_increment_keeps_one_run_per_register);
+    RUN_TEST(test_splits_long_runs_and_flushes_when_full);
+    RUN_TEST(test_replays_a_sensor_table_in_order);
+    RUN_TEST(test_bus_errors_are_returned);
+    UNITY_END();
+}
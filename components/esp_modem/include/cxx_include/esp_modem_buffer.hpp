@@ -42,4 +42,77 @@ struct unique_buffer {
     size_t consumed{};
 };
 
+/**
+ * Fixed capacity linear receive buffer of the DTE command processing
+ *
+ * Data is appended at the tail and released from the head, the storage is never
+ * reallocated. It is not a ring: unread data are kept contiguous, so that line callbacks
+ * could parse replies in place, and are moved to the front when the tail runs out of space.
+ * Line boundaries are tracked as the data arrive, each byte is scanned only once.
+ */
+struct line_buffer {
+    explicit line_buffer(size_t capacity);
+    line_buffer (line_buffer const &) = delete;
+    line_buffer &operator=(line_buffer const &) = delete;
+
+    /**
+     * @brief Provides contiguous space for `len` bytes at the tail
+     * @return pointer to write to, nullptr if there's not enough free space
+     */
+    uint8_t *reserve(size_t len);
+
+    /**
+     * @brief Appends `len` bytes previously written to the reserved space
+     */
+    void commit(size_t len)
+    {
+        tail += len;
+    }
+
+    /**
+     * @brief Scans the data appended since the last scan for line separators
+     * @return true if at least one line has been completed
+     */
+    bool scan(char separator);
+
+    /**
+     * @brief Releases the oldest complete lines until there's `len` bytes of free space
+     * @return number of released bytes
+     */
+    size_t drop_lines(size_t len);
+
+    void clear()
+    {
+        head = tail = scanned = line_end = 0;
+        line_count = 0;
+    }
+
+    [[nodiscard]] uint8_t *begin() const
+    {
+        return data.get() + head;
+    }
+    [[nodiscard]] size_t size() const
+    {
+        return tail - head;
+    }
+    [[nodiscard]] size_t free() const
+    {
+        return capacity - size();
+    }
+    [[nodiscard]] size_t lines() const
+    {
+        return line_count;
+    }
+
+    std::unique_ptr<uint8_t[]> data;
+    size_t capacity{};
+    size_t head{};          /*!< Start of unread data */
+    size_t tail{};          /*!< End of unread data */
+    size_t scanned{};       /*!< End of data scanned for separators */
+    size_t line_end{};      /*!< End of the last complete line */
+    size_t line_count{};    /*!< Number of complete lines in the buffer */
+    size_t dropped{};       /*!< Total bytes dropped to make space for new data */
+    char separator{'\n'};   /*!< Separator of the current line count */
+};
+
 }
@@ -108,7 +108,7 @@ private:
         UNKNOWN
     };
 
-    static uint8_t fcs_crc(const uint8_t frame[6]);     /*!< Utility to calculate FCS CRC */
+    static uint8_t fcs_crc(const uint8_t *data, size_t len); /*!< Utility to calculate FCS CRC over the given header bytes */
     bool data_available(uint8_t *data, size_t len);     /*!< Called when valid data available (returns false on unexpected data format) */
     void send_sabm(size_t i);                           /*!< Sending initial SABM */
     void send_disconnect(size_t i);                     /*!< Sending closing request for each virtual or control terminal */
@@ -126,6 +126,7 @@ private:
     bool on_header(CMuxFrame &frame);
     bool on_payload(CMuxFrame &frame);
     bool on_footer(CMuxFrame &frame);
+    bool parse_header(const uint8_t *header, size_t len);   /*!< Decodes a complete header (without SOF), false on protocol mismatch */
     void recover_protocol(protocol_mismatch_reason reason);
 
     std::function<bool(uint8_t *data, size_t len)> read_cb[MAX_TERMINALS_NUM];  /*!< Function pointers to read callbacks */
@@ -138,8 +139,9 @@ private:
     uint8_t dlci;
     uint8_t type;
     size_t payload_len;
-    uint8_t frame_header[6];
+    uint8_t frame_header[6];                          /*!< Header or footer bytes split across reads */
     size_t frame_header_offset;
+    uint8_t frame_fcs;                                /*!< Expected FCS of the current frame */
     uint8_t *payload_start;
     size_t total_payload_size;
     int sabm_ack;
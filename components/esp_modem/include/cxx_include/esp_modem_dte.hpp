@@ -206,6 +206,8 @@ private:
     [[nodiscard]] bool setup_cmux();                        /*!< Internal setup of CMUX mode */
     [[nodiscard]] bool exit_cmux();                         /*!< Exit of CMUX mode and cleanup  */
     void exit_cmux_internal();                              /*!< Cleanup CMUX */
+    uint8_t *rx_reserve(size_t &len, bool whole);           /*!< Makes space for received data (whole fragment or up to len bytes) */
+    void rx_clear();                                        /*!< Releases all received data */
 
 #ifdef CONFIG_ESP_MODEM_URC_HANDLER
     /**
@@ -236,6 +238,7 @@ private:
 
     Lock internal_lock{};                                   /*!< Locks DTE operations */
     unique_buffer buffer;                                   /*!< DTE buffer */
+    line_buffer rx;                                         /*!< Receive buffer of command replies */
     std::shared_ptr<CMux> cmux_term;                        /*!< Primary terminal for this DTE */
     std::shared_ptr<Terminal> primary_term;                 /*!< Reference to the primary terminal (mostly for sending commands) */
     std::shared_ptr<Terminal> secondary_term;               /*!< Secondary terminal for this DTE */
@@ -243,36 +246,6 @@ private:
     std::function<bool(uint8_t *data, size_t len)> on_data; /*!< on data callback for current terminal */
     std::function<void(terminal_error err)> user_error_cb;  /*!< user callback on error event from attached terminals */
 
-#ifdef CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED
-    /**
-     * @brief Implements an extra buffer that is used to capture partial reads from underlying terminals
-     * when we run out of the standard buffer
-     */
-    struct extra_buffer {
-        extra_buffer(): buffer(nullptr) {}
-        ~extra_buffer()
-        {
-            delete buffer;
-        }
-        std::vector<uint8_t> *buffer;
-        size_t consumed{0};
-        void grow(size_t need_size);
-        void deflate()
-        {
-            grow(0);
-            consumed = 0;
-        }
-        [[nodiscard]] uint8_t *begin() const
-        {
-            return &buffer->at(0);
-        }
-        [[nodiscard]] uint8_t *current() const
-        {
-            return &buffer->at(0) + consumed;
-        }
-    } inflatable;
-#endif // CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED
-
     /**
      * @brief This abstracts command callback processing and implements its locking, signaling of completion and timeouts.
      */
@@ -287,7 +260,7 @@ private:
         char separator{};                                       /*!< Command reply separator (end of line/processing unit) */
         command_result result{};                                /*!< Command return code */
         SignalGroup signal;                                     /*!< Event group used to signal request-response operations */
-        bool process_line(uint8_t *data, size_t consumed, size_t len, DTE* dte = nullptr);  /*!< Lets the processing callback handle one line (processing unit) */
+        bool process_line(uint8_t *data, size_t consumed, size_t len, bool new_line, DTE* dte = nullptr);  /*!< Lets the processing callback handle one line (processing unit) */
         bool wait_for_line(uint32_t time_ms)                    /*!< Waiting for command processing */
         {
             return signal.wait_any(command_cb::GOT_LINE, time_ms);
@@ -36,6 +36,14 @@ enum class terminal_error {
     DEVICE_GONE,
 };
 
+/**
+ * @brief One buffer of a scatter-gather write
+ */
+struct terminal_iovec {
+    uint8_t *data;
+    size_t len;
+};
+
 /**
  * @brief Terminal interface. All communication interfaces must comply to this interface in order to be used as a DTE
  */
@@ -61,6 +69,28 @@ public:
      */
     virtual int write(uint8_t *data, size_t len) = 0;
 
+    /**
+     * @brief Writes several buffers to the terminal as one stream
+     *
+     * The default implementation writes the buffers one by one. Terminals that can
+     * pass them to the device in a single call should override it.
+     * @param parts Buffers to write
+     * @param count Number of buffers
+     * @return length of data written
+     */
+    virtual int writev(const terminal_iovec *parts, size_t count)
+    {
+        int total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            int len = write(parts[i].data, parts[i].len);
+            if (len <= 0) {
+                break;
+            }
+            total += len;
+        }
+        return total;
+    }
+
     /**
      * @brief Read from the terminal. This function doesn't block, but return all available data.
      * @param data Data pointer to store the read payload
@@ -0,0 +1,21 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <cstring>
+
+#ifndef HAVE_STRLCPY
+/* Declared by esp_modem_c_api.cpp, glibc has none before 2.38 */
+size_t strlcpy(char *dest, const char *src, size_t len)
+{
+    size_t src_len = strlen(src);
+    if (len > 0) {
+        size_t n = src_len < len - 1 ? src_len : len - 1;
+        memcpy(dest, src, n);
+        dest[n] = '\0';
+    }
+    return src_len;
+}
+#endif
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <algorithm>
 #include <cstring>
 #include <unistd.h>
 #include <cxx_include/esp_modem_cmux.hpp>
@@ -59,22 +60,44 @@ using namespace esp_modem;
 /* Flag sequence field between messages (start of frame) */
 #define SOF_MARKER 0xF9
 
-uint8_t CMux::fcs_crc(const uint8_t frame[6])
-{
-    //    #define FCS_GOOD_VALUE 0xCF
-    uint8_t crc = 0xFF; // FCS_INIT_VALUE
+/* Frame header size after the leading SOF: address, control and 1 or 2 length bytes */
+#ifdef ESP_MODEM_CMUX_USE_SHORT_PAYLOADS_ONLY
+#define HEADER_SIZE(length) (3)
+#else
+#define HEADER_SIZE(length) (((length) & EA) ? 3 : 4)
+#endif
 
-    for (int i = 1; i < 4; i++) {
-        crc ^= frame[i];
+namespace {
 
-        for (int j = 0; j < 8; j++) {
-            if (crc & 0x01) {
-                crc = (crc >> 1) ^ 0xe0; // FCS_POLYNOMIAL
-            } else {
-                crc >>= 1;
+/**
+ * @brief FCS lookup table (reflected CRC-8, polynomial 0xE0), built at compile time
+ */
+struct FcsTable {
+    uint8_t crc[256];
+    constexpr FcsTable(): crc()
+    {
+        for (int i = 0; i < 256; i++) {
+            uint8_t c = i;
+            for (int j = 0; j < 8; j++) {
+                c = (c & 0x01) ? (c >> 1) ^ 0xe0 : (c >> 1);    // FCS_POLYNOMIAL
             }
+            crc[i] = c;
         }
     }
+};
+
+constexpr FcsTable fcs_table;
+
+} // namespace
+
+uint8_t CMux::fcs_crc(const uint8_t *data, size_t len)
+{
+    //    #define FCS_GOOD_VALUE 0xCF
+    uint8_t crc = 0xFF; // FCS_INIT_VALUE
+
+    while (len--) {
+        crc = fcs_table.crc[crc ^ *data++];
+    }
 
     return crc;
 }
@@ -91,7 +114,7 @@ void CMux::send_disconnect(size_t i)
             SOF_MARKER, 0x3, FT_DISC | PF, 0x1, 0, SOF_MARKER
         };
         frame[1] |= i << 2;
-        frame[4] = 0xFF - fcs_crc(frame);
+        frame[4] = 0xFF - fcs_crc(frame + 1, 3);
         term->write(frame, sizeof(frame));
     }
 }
@@ -103,7 +126,7 @@ void CMux::send_sabm(size_t i)
     frame[1] = (i << 2) | 0x3;
     frame[2] = FT_SABM | PF;
     frame[3] = 1;
-    frame[4] = 0xFF - fcs_crc(frame);
+    frame[4] = 0xFF - fcs_crc(frame + 1, 3);
     frame[5] = SOF_MARKER;
     term->write(frame, 6);
 }
@@ -213,6 +236,29 @@ bool CMux::on_recovery(CMuxFrame &frame)
 }
 
 
+bool CMux::parse_header(const uint8_t *header, size_t len)
+{
+    dlci = header[0] >> 2;
+    type = header[1];
+    // Sanity check for expected values of DLCI and type,
+    // since CRC could be evaluated after the frame payload gets received
+    if (dlci > MAX_TERMINALS_NUM || (header[0] & EA) == 0 ||
+            (((type & FT_UIH) != FT_UIH) &&  type != (FT_UA | PF))) {
+        recover_protocol(protocol_mismatch_reason::UNEXPECTED_HEADER);
+        return false;
+    }
+    payload_len = header[2] >> 1;
+    if (len > 3) {
+        payload_len += header[3] << 7;
+    }
+#ifdef ESP_MODEM_CMUX_USE_SHORT_PAYLOADS_ONLY
+    frame_fcs = 0xFF - fcs_crc(header, len);
+#endif
+    frame_header_offset = 0;    // frame_header now collects a split footer
+    state = cmux_state::PAYLOAD;
+    return true;
+}
+
 bool CMux::on_header(CMuxFrame &frame)
 {
     if (frame.len > 0 && frame_header_offset == 1 && frame.ptr[0] == SOF_MARKER) {
@@ -220,42 +266,25 @@ bool CMux::on_header(CMuxFrame &frame)
         frame.advance();
         return true;
     }
-    if (frame.len + frame_header_offset < 4) {
-        memcpy(frame_header + frame_header_offset, frame.ptr, frame.len);
-        frame_header_offset += frame.len;
-        return false; // need read more
-    }
-    size_t payload_offset = std::min(frame.len, 4 - frame_header_offset);
-    memcpy(frame_header + frame_header_offset, frame.ptr, payload_offset);
-#ifndef ESP_MODEM_CMUX_USE_SHORT_PAYLOADS_ONLY
-    if ((frame_header[3] & 1) == 0) {
-        if (frame_header_offset + frame.len <= 4) {
-            frame_header_offset += frame.len;
-            return false; // need read more
+    if (frame_header_offset == 1 && frame.len >= 3 && frame.len >= HEADER_SIZE(frame.ptr[2])) {
+        // The whole header is in the buffer, parse it in place
+        size_t header_len = HEADER_SIZE(frame.ptr[2]);
+        if (parse_header(frame.ptr, header_len)) {
+            frame.advance(header_len);
         }
-        payload_offset = std::min(frame.len, 5 - frame_header_offset);
-        memcpy(frame_header + frame_header_offset, frame.ptr, payload_offset);
-        payload_len = frame_header[4] << 7;
-        frame_header_offset += payload_offset - 1; // rewind frame_header back to hold only 6 bytes size
-    } else
-#endif // ! ESP_MODEM_CMUX_USE_SHORT_PAYLOADS_ONLY
-    {
-        payload_len = 0;
-        frame_header_offset += payload_offset;
-    }
-    dlci = frame_header[1] >> 2;
-    type = frame_header[2];
-    // Sanity check for expected values of DLCI and type,
-    // since CRC could be evaluated after the frame payload gets received
-    if (dlci > MAX_TERMINALS_NUM || (frame_header[1] & 0x01) == 0 ||
-            (((type & FT_UIH) != FT_UIH) &&  type != (FT_UA | PF))) {
-        recover_protocol(protocol_mismatch_reason::UNEXPECTED_HEADER);
         return true;
     }
-    payload_len += (frame_header[3] >> 1);
-    frame.advance(payload_offset);
-    state = cmux_state::PAYLOAD;
-    return true;
+    // The header is split across reads, collect it in frame_header
+    while (frame.len > 0) {
+        frame_header[frame_header_offset++] = frame.ptr[0];
+        frame.advance();
+        size_t header_len = frame_header_offset - 1;
+        if (header_len >= 3 && header_len == HEADER_SIZE(frame_header[3])) {
+            parse_header(frame_header + 1, header_len);
+            return true;
+        }
+    }
+    return false; // need read more
 }
 
 bool CMux::on_payload(CMuxFrame &frame)
@@ -285,35 +314,37 @@ bool CMux::on_payload(CMuxFrame &frame)
 
 bool CMux::on_footer(CMuxFrame &frame)
 {
-    size_t footer_offset = 0;
-    if (frame.len + frame_header_offset < 6) {
-        memcpy(frame_header + frame_header_offset, frame.ptr, frame.len);
-        frame_header_offset += frame.len;
-        return false; // need read more
-    } else {
-        footer_offset = std::min(frame.len, 6 - frame_header_offset);
+    const uint8_t *footer = frame.ptr;
+    size_t footer_offset = 2;
+    if (frame_header_offset > 0 || frame.len < 2) {
+        // The footer is split across reads, collect it in frame_header
+        footer_offset = std::min(frame.len, 2 - frame_header_offset);
         memcpy(frame_header + frame_header_offset, frame.ptr, footer_offset);
-        if (frame_header[5] != SOF_MARKER) {
-            recover_protocol(protocol_mismatch_reason::MISSED_TRAIL_SOF);
-            return true;
+        frame_header_offset += footer_offset;
+        if (frame_header_offset < 2) {
+            return false; // need read more
         }
+        footer = frame_header;
+    }
+    if (footer[1] != SOF_MARKER) {
+        recover_protocol(protocol_mismatch_reason::MISSED_TRAIL_SOF);
+        return true;
+    }
 #ifdef ESP_MODEM_CMUX_USE_SHORT_PAYLOADS_ONLY
-        uint8_t crc = 0xFF - fcs_crc(frame_header);
-        if (crc != frame_header[4]) {
-            recover_protocol(protocol_mismatch_reason::WRONG_CRC);
-            return true;
-        }
+    if (footer[0] != frame_fcs) {
+        recover_protocol(protocol_mismatch_reason::WRONG_CRC);
+        return true;
+    }
 #endif
-        frame.advance(footer_offset);
-        state = cmux_state::INIT;
-        frame_header_offset = 0;
-        if (!data_available(nullptr, 0)) {
-            recover_protocol(protocol_mismatch_reason::UNEXPECTED_DATA);
-            return true;
-        }
-        payload_start = nullptr;
-        total_payload_size = 0;
+    frame.advance(footer_offset);
+    state = cmux_state::INIT;
+    frame_header_offset = 0;
+    if (!data_available(nullptr, 0)) {
+        recover_protocol(protocol_mismatch_reason::UNEXPECTED_DATA);
+        return true;
     }
+    payload_start = nullptr;
+    total_payload_size = 0;
     return true;
 }
 
@@ -464,30 +495,36 @@ bool CMux::init()
 int CMux::write(int virtual_term, uint8_t *data, size_t len)
 {
     const size_t cmux_max_len = 127;
+    const size_t frames_per_write = 8;  // frames passed to the terminal in one writev()
+    uint8_t header[frames_per_write][4];
+    uint8_t footer[frames_per_write][2];
+    terminal_iovec parts[frames_per_write * 3];
     Scoped<Lock> l(lock);
     int i = virtual_term + 1;
     size_t need_write = len;
     while (need_write > 0) {
-        size_t batch_len = need_write;
-        if (batch_len > cmux_max_len) {
-            batch_len = cmux_max_len;
+        size_t frames = 0;
+        for (; need_write > 0 && frames < frames_per_write; frames++) {
+            size_t batch_len = std::min(need_write, cmux_max_len);
+            uint8_t *frame = header[frames];
+            frame[0] = SOF_MARKER;
+            frame[1] = (i << 2) + 1;
+            frame[2] = FT_UIH;
+            frame[3] = (batch_len << 1) + 1;
+            footer[frames][0] = 0xFF - fcs_crc(frame + 1, 3);
+            footer[frames][1] = SOF_MARKER;
+
+            // header, payload and footer go out without copying the payload
+            parts[frames * 3] = { frame, 4 };
+            parts[frames * 3 + 1] = { data, batch_len };
+            parts[frames * 3 + 2] = { footer[frames], 2 };
+            ESP_LOG_BUFFER_HEXDUMP("Send", frame, 4, ESP_LOG_VERBOSE);
+            ESP_LOG_BUFFER_HEXDUMP("Send", data, batch_len, ESP_LOG_VERBOSE);
+            ESP_LOG_BUFFER_HEXDUMP("Send", footer[frames], 2, ESP_LOG_VERBOSE);
+            need_write -= batch_len;
+            data += batch_len;
         }
-        uint8_t frame[6];
-        frame[0] = SOF_MARKER;
-        frame[1] = (i << 2) + 1;
-        frame[2] = FT_UIH;
-        frame[3] = (batch_len << 1) + 1;
-        frame[4] = 0xFF - fcs_crc(frame);
-        frame[5] = SOF_MARKER;
-
-        term->write(frame, 4);
-        term->write(data, batch_len);
-        term->write(frame + 4, 2);
-        ESP_LOG_BUFFER_HEXDUMP("Send", frame, 4, ESP_LOG_VERBOSE);
-        ESP_LOG_BUFFER_HEXDUMP("Send", data, batch_len, ESP_LOG_VERBOSE);
-        ESP_LOG_BUFFER_HEXDUMP("Send", frame + 4, 2, ESP_LOG_VERBOSE);
-        need_write -= batch_len;
-        data += batch_len;
+        term->writev(parts, frames * 3);
     }
     return len;
 }
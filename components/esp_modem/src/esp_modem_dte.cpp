@@ -16,6 +16,7 @@ static const size_t dte_default_buffer_size = 1000;
 
 DTE::DTE(const esp_modem_dte_config *config, std::unique_ptr<Terminal> terminal)
     : buffer(config->dte_buffer_size),
+      rx(config->dte_buffer_size),
       cmux_term(nullptr),
       primary_term(std::move(terminal)),
       secondary_term(primary_term),
@@ -27,6 +28,7 @@ DTE::DTE(const esp_modem_dte_config *config, std::unique_ptr<Terminal> terminal)
 
 DTE::DTE(std::unique_ptr<Terminal> terminal)
     : buffer(dte_default_buffer_size),
+      rx(dte_default_buffer_size),
       cmux_term(nullptr),
       primary_term(std::move(terminal)),
       secondary_term(primary_term),
@@ -38,6 +40,7 @@ DTE::DTE(std::unique_ptr<Terminal> terminal)
 
 DTE::DTE(const esp_modem_dte_config *config, std::unique_ptr<Terminal> t, std::unique_ptr<Terminal> s)
     : buffer(config->dte_buffer_size),
+      rx(config->dte_buffer_size),
       cmux_term(nullptr),
       primary_term(std::move(t)),
       secondary_term(std::move(s)),
@@ -50,6 +53,7 @@ DTE::DTE(const esp_modem_dte_config *config, std::unique_ptr<Terminal> t, std::u
 
 DTE::DTE(std::unique_ptr<Terminal> t, std::unique_ptr<Terminal> s)
     : buffer(dte_default_buffer_size),
+      rx(dte_default_buffer_size),
       cmux_term(nullptr),
       primary_term(std::move(t)),
       secondary_term(std::move(s)),
@@ -76,65 +80,34 @@ void DTE::set_command_callbacks()
 #endif
         if (data) {
             // For terminals which post data directly with the callback (CMUX)
-            // we cannot defragment unless we allocate, but
-            // we'll try to process the data on the actual buffer
-#ifdef CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED
-            if (inflatable.consumed != 0) {
-                inflatable.grow(inflatable.consumed + len);
-                std::memcpy(inflatable.current(), data, len);
-                data = inflatable.begin();
-            }
-            if (command_cb.process_line(data, inflatable.consumed, len, this)) {
-                return true;
-            }
-            // at this point we're sure that the data processing hasn't finished,
-            // and we have to grow the inflatable buffer (if enabled) or give up
-            if (inflatable.consumed == 0) {
-                inflatable.grow(len);
-                std::memcpy(inflatable.begin(), data, len);
-            }
-            inflatable.consumed += len;
-            return false;
-#else
-            if (command_cb.process_line(data, 0, len, this)) {
-                return true;
+            // we copy the fragments to the receive buffer to defragment replies
+            auto space = rx_reserve(len, true);
+            if (space == nullptr) {
+                // cannot defragment, but we'll try to process the fragment on the actual buffer
+                // (and collect the next fragments again, since we might be just missing a last token or OK)
+                rx_clear();
+                return command_cb.process_line(data, 0, len, std::memchr(data, command_cb.separator, len) != nullptr, this);
             }
-            // cannot inflate and the processing hasn't finishes in the first iteration, but continue
-            // (will post next fragments to the parser, since we might be just missing a last token or OK
-            return false;
-#endif
-        }
-        // data == nullptr: Terminals which request users to read current data
-        // we're able to use DTE's buffer to defragment it; as long as we consume less that the buffer size
-        if (buffer.size > buffer.consumed) {
-            data = buffer.get();
-            len = primary_term->read(data + buffer.consumed, buffer.size - buffer.consumed);
-            if (command_cb.process_line(data, buffer.consumed, len, this)) {
+            std::memcpy(space, data, len);
+        } else {
+            // data == nullptr: Terminals which request users to read current data
+            // we read directly to the free space of the receive buffer
+            len = len ? len : rx.capacity;
+            auto space = rx_reserve(len, false);
+            if (space == nullptr) {
+                // cannot make space -> report a failure
+                command_cb.give_up();
+                rx_clear();
                 return true;
             }
-            buffer.consumed += len;
-            return false;
+            len = primary_term->read(space, len);
         }
-        // we have used the entire DTE's buffer, need to use the inflatable buffer to continue
-#ifdef CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED
-        if (inflatable.consumed == 0) {
-            inflatable.grow(buffer.size + len);
-            std::memcpy(inflatable.begin(), buffer.get(), buffer.size);
-            inflatable.consumed = buffer.size;
-        } else {
-            inflatable.grow(inflatable.consumed + len);
-        }
-        len = primary_term->read(inflatable.current(), len);
-        if (command_cb.process_line(inflatable.begin(), inflatable.consumed, len, this)) {
+        rx.commit(len);
+        if (command_cb.process_line(rx.begin(), rx.size() - len, len, rx.scan(command_cb.separator), this)) {
+            rx_clear();
             return true;
         }
-        inflatable.consumed += len;
         return false;
-#else
-        // cannot inflate -> report a failure
-        command_cb.give_up();
-        return true;
-#endif
     });
     primary_term->set_error_cb([this](terminal_error err) {
         if (user_error_cb) {
@@ -167,10 +140,10 @@ command_result DTE::command(const std::string &command, got_line_cb got_line, ui
     // Track command end
     buffer_state.command_waiting = false;
 #endif
-    buffer.consumed = 0;
-#ifdef CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED
-    inflatable.deflate();
-#endif
+    {
+        Scoped<Lock> l2(command_cb.line_lock);
+        rx_clear();
+    }
     return command_cb.result;
 }
 
@@ -314,8 +287,15 @@ void DTE::set_read_cb(std::function<bool(uint8_t *, size_t)> f)
     on_data = std::move(f);
     secondary_term->set_read_cb([this](uint8_t *data, size_t len) {
         if (!data) { // if no data available from terminal callback -> need to explicitly read some
-            data = buffer.get();
-            len = secondary_term->read(buffer.get(), buffer.size);
+            // read until the terminal drains, passing each buffer sized chunk in place
+            bool ret = false;
+            do {
+                len = secondary_term->read(buffer.get(), buffer.size);
+                if (on_data) {
+                    ret = on_data(buffer.get(), len);
+                }
+            } while (len == buffer.size);
+            return ret;
         }
         if (on_data) {
             return on_data(data, len);
@@ -378,7 +358,7 @@ void DTE::on_read(got_line_cb on_read_cb)
     });
 }
 
-bool DTE::command_cb::process_line(uint8_t *data, size_t consumed, size_t len, DTE* dte)
+bool DTE::command_cb::process_line(uint8_t *data, size_t consumed, size_t len, bool new_line, DTE* dte)
 {
     // returning true indicates that the processing finished and lower layers can destroy the accumulated buffer
 #ifdef CONFIG_ESP_MODEM_URC_HANDLER
@@ -426,7 +406,7 @@ bool DTE::command_cb::process_line(uint8_t *data, size_t consumed, size_t len, D
         return false;  // Command processing continues
     }
 
-    if (memchr(data + consumed, separator, len)) {
+    if (new_line) {
         result = got_line(data, consumed + len);
         if (result == command_result::OK || result == command_result::FAIL) {
             signal.set(GOT_LINE);
@@ -453,19 +433,38 @@ void DTE::handle_error(terminal_error err)
     }
 }
 
-#ifdef CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED
-void DTE::extra_buffer::grow(size_t need_size)
+uint8_t *DTE::rx_reserve(size_t &len, bool whole)
 {
-    if (need_size == 0) {
-        delete buffer;
-        buffer = nullptr;
-    } else if (buffer == nullptr) {
-        buffer = new std::vector<uint8_t>(need_size);
-    } else {
-        buffer->resize(need_size);
+#ifdef CONFIG_ESP_MODEM_USE_INFLATABLE_BUFFER_IF_NEEDED
+    // whole fragments need all the space, reads need at least one byte to progress
+    size_t need = whole ? len : 1;
+    if (rx.free() < need) {
+        // run out of the buffer: give up the oldest lines of the ongoing reply
+        auto dropped = rx.drop_lines(need);
+        if (dropped) {
+            ESP_LOGD("esp_modem_dte", "Dropped %d bytes of received lines", (int)dropped);
+        }
+#ifdef CONFIG_ESP_MODEM_URC_HANDLER
+        buffer_state.last_urc_processed -= std::min(dropped, buffer_state.last_urc_processed);
+#endif
     }
+#endif
+    if (!whole) {
+        len = std::min(len, rx.free());
+        if (len == 0) {
+            return nullptr;
+        }
+    }
+    return rx.reserve(len);
 }
+
+void DTE::rx_clear()
+{
+    rx.clear();
+#ifdef CONFIG_ESP_MODEM_URC_HANDLER
+    buffer_state.last_urc_processed = 0;
 #endif
+}
 
 /**
  * Implemented here to keep all headers C++11 compliant
@@ -473,6 +472,60 @@ void DTE::extra_buffer::grow(size_t need_size)
 unique_buffer::unique_buffer(size_t size):
     data(std::make_unique<uint8_t[]>(size)), size(size), consumed(0) {}
 
+line_buffer::line_buffer(size_t capacity):
+    data(std::make_unique<uint8_t[]>(capacity)), capacity(capacity) {}
+
+uint8_t *line_buffer::reserve(size_t len)
+{
+    if (capacity - tail < len) {
+        if (free() < len) {
+            return nullptr;
+        }
+        // out of space at the end: move the unread data to the front
+        std::memmove(data.get(), data.get() + head, size());
+        tail -= head;
+        scanned -= head;
+        line_end -= head;
+        head = 0;
+    }
+    return data.get() + tail;
+}
+
+bool line_buffer::scan(char sep)
+{
+    if (sep != separator) {     // line boundaries of another separator, start over
+        separator = sep;
+        scanned = line_end = head;
+        line_count = 0;
+    }
+    auto found = line_count;
+    auto end = data.get() + tail;
+    auto p = data.get() + scanned;
+    while (p < end && (p = static_cast<uint8_t *>(std::memchr(p, separator, end - p))) != nullptr) {
+        line_end = ++p - data.get();
+        ++line_count;
+    }
+    scanned = tail;
+    return line_count != found;
+}
+
+size_t line_buffer::drop_lines(size_t len)
+{
+    size_t released = 0;
+    while (free() < len && line_count > 0) {
+        auto p = static_cast<uint8_t *>(std::memchr(begin(), separator, line_end - head));
+        auto line_len = p + 1 - begin();
+        head += line_len;
+        released += line_len;
+        --line_count;
+    }
+    if (head == tail) {
+        clear();
+    }
+    dropped += released;
+    return released;
+}
+
 #ifdef CONFIG_ESP_MODEM_URC_HANDLER
 void DTE::update_buffer_state(size_t new_data_size)
 {
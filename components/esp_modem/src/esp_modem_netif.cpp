@@ -13,6 +13,11 @@
 #include "cxx_include/esp_modem_netif.hpp"
 #include "cxx_include/esp_modem_dte.hpp"
 #include "esp_netif_ppp.h"
+#ifdef CONFIG_ESP_MODEM_PPP_DIRECT_INPUT
+#include "esp_netif_net_stack.h"
+#include "lwip/tcpip.h"
+#include "netif/ppp/pppos.h"
+#endif
 
 namespace esp_modem {
 
@@ -66,6 +71,17 @@ esp_err_t Netif::esp_modem_post_attach(esp_netif_t *esp_netif, void *args)
 
 void Netif::receive(uint8_t *data, size_t len)
 {
+#ifdef CONFIG_ESP_MODEM_PPP_DIRECT_INPUT
+    // decode the PPP frames in place from the DTE buffer, holding the core lock
+    // instead of posting a copy of each chunk to the tcpip thread
+    auto *ppp_netif = static_cast<struct netif *>(esp_netif_get_netif_impl(driver.base.netif));
+    if (ppp_netif && ppp_netif->state) {   // lwIP keeps the PPP control block as the netif state
+        LOCK_TCPIP_CORE();
+        pppos_input(static_cast<ppp_pcb *>(ppp_netif->state), data, len);
+        UNLOCK_TCPIP_CORE();
+        return;
+    }
+#endif
     esp_netif_receive(driver.base.netif, data, len, nullptr);
 }
 
@@ -55,6 +55,14 @@ void Netif::stop()
     signal.clear(PPP_STARTED);
 }
 
+void Netif::resume()
+{
+}
+
+void Netif::pause()
+{
+}
+
 Netif::~Netif() = default;
 
 void Netif::wait_until_ppp_exits()
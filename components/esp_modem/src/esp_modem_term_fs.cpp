@@ -5,11 +5,15 @@
  */
 
 #include <optional>
+#include <algorithm>
 #include <unistd.h>
 #include "cxx_include/esp_modem_dte.hpp"
 #include "esp_log.h"
 #include "esp_modem_config.h"
 #include "exception_stub.hpp"
+#ifdef CONFIG_IDF_TARGET_LINUX
+#include <sys/uio.h>
+#endif
 
 static const char *TAG = "fs_terminal";
 
@@ -50,6 +54,10 @@ public:
 
     int write(uint8_t *data, size_t len) override;
 
+#ifdef CONFIG_IDF_TARGET_LINUX
+    int writev(const terminal_iovec *parts, size_t count) override;
+#endif
+
     int read(uint8_t *data, size_t len) override;
 
     void set_read_cb(std::function<bool(uint8_t *data, size_t len)> f) override
@@ -60,6 +68,7 @@ public:
 
 private:
     void task();
+    bool wait_writable();
 
     static const size_t TASK_INIT = SignalGroup::bit0;
     static const size_t TASK_START = SignalGroup::bit1;
@@ -143,15 +152,73 @@ int FdTerminal::read(uint8_t *data, size_t len)
     return size;
 }
 
+bool FdTerminal::wait_writable()
+{
+    fd_set wfds;
+    struct timeval tv = {
+        .tv_sec = 1,
+        .tv_usec = 0,
+    };
+    FD_ZERO(&wfds);
+    FD_SET(f.fd, &wfds);
+    return select(f.fd + 1, nullptr, &wfds, nullptr, &tv) > 0;
+}
+
 int FdTerminal::write(uint8_t *data, size_t len)
 {
-    int size = ::write(f.fd, data, len);
+    // the fd is non-blocking: wait for space rather than dropping the rest of the data
+    size_t written = 0;
+    while (written < len) {
+        int size = ::write(f.fd, data + written, len - written);
+        if (size < 0) {
+            if (errno == EAGAIN && wait_writable()) {
+                continue;
+            }
+            ESP_LOGE(TAG, "Error occurred during write: %d", errno);
+            break;
+        }
+        written += size;
+    }
+    return written;
+}
+
+#ifdef CONFIG_IDF_TARGET_LINUX
+int FdTerminal::writev(const terminal_iovec *parts, size_t count)
+{
+    // terminal_iovec mirrors struct iovec, translate on the stack to keep the API platform neutral
+    constexpr size_t max_parts = 64;
+    struct iovec iov[max_parts];
+    count = std::min(count, max_parts);
+    for (size_t i = 0; i < count; ++i) {
+        iov[i].iov_base = parts[i].data;
+        iov[i].iov_len = parts[i].len;
+    }
+    int size = ::writev(f.fd, iov, count);
     if (size < 0) {
-        ESP_LOGE(TAG, "Error occurred during read: %d", errno);
-        return 0;
+        if (errno != EAGAIN) {
+            ESP_LOGE(TAG, "Error occurred during write: %d", errno);
+            return 0;
+        }
+        size = 0;
+    }
+    // complete a partial write part by part
+    size_t skip = size;
+    for (size_t i = 0; i < count; ++i) {
+        if (skip >= parts[i].len) {
+            skip -= parts[i].len;
+            continue;
+        }
+        size_t len = parts[i].len - skip;
+        size_t written = write(parts[i].data + skip, len);
+        size += written;
+        if (written < len) {
+            break;
+        }
+        skip = 0;
     }
     return size;
 }
+#endif
 
 FdTerminal::~FdTerminal()
 {
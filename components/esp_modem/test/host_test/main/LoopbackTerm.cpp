@@ -20,6 +20,11 @@ void LoopbackTerm::stop()
 
 int LoopbackTerm::write(uint8_t *data, size_t len)
 {
+    if (sink) {
+        sink_write_calls++;
+        sink_written += len;
+        return len;
+    }
     if (inject_by) {    // injection test: ignore what we write, but respond with injected data
         signal.clear(1);
         auto ret = std::async(&LoopbackTerm::batch_read, this);
@@ -91,6 +96,20 @@ int LoopbackTerm::write(uint8_t *data, size_t len)
     return len;
 }
 
+int LoopbackTerm::writev(const terminal_iovec *parts, size_t count)
+{
+    if (sink) {     // a scatter-gather write reaches the device as one call
+        size_t len = 0;
+        for (size_t i = 0; i < count; ++i) {
+            len += parts[i].len;
+        }
+        sink_write_calls++;
+        sink_written += len;
+        return len;
+    }
+    return Terminal::writev(parts, count);
+}
+
 int LoopbackTerm::read(uint8_t *data, size_t len)
 {
     size_t read_len = std::min(data_len, len);
@@ -108,12 +127,14 @@ int LoopbackTerm::read(uint8_t *data, size_t len)
     return read_len;
 }
 
-LoopbackTerm::LoopbackTerm(bool is_bg96): loopback_data(), data_len(0), pin_ok(false), is_bg96(is_bg96), inject_by(0)
+LoopbackTerm::LoopbackTerm(bool is_bg96): loopback_data(), data_len(0), pin_ok(false), is_bg96(is_bg96), inject_by(0),
+    sink(false), post_data(false), sink_write_calls(0), sink_written(0)
 {
     init_signal();
 }
 
-LoopbackTerm::LoopbackTerm(): loopback_data(), data_len(0), pin_ok(false), is_bg96(false), inject_by(0)
+LoopbackTerm::LoopbackTerm(): loopback_data(), data_len(0), pin_ok(false), is_bg96(false), inject_by(0),
+    sink(false), post_data(false), sink_write_calls(0), sink_written(0)
 {
     init_signal();
 }
@@ -134,13 +155,47 @@ int LoopbackTerm::inject(uint8_t *data, size_t len, size_t injected_by, size_t d
     return len;
 }
 
+int LoopbackTerm::feed(uint8_t *data, size_t len, size_t feed_by)
+{
+    Scoped<Lock> lock(on_read_guard);
+    for (size_t offset = 0; offset < len; offset += feed_by) {
+        size_t chunk = std::min(feed_by, len - offset);
+        loopback_data.assign(data + offset, data + offset + chunk);
+        data_len = chunk;
+        while (data_len > 0) {  // the reader may consume less than available
+            size_t before = data_len;
+            on_read(nullptr, data_len);
+            if (data_len == before) {
+                break;
+            }
+        }
+    }
+    return len;
+}
+
+void LoopbackTerm::set_sink(bool enable)
+{
+    sink = enable;
+    sink_write_calls = 0;
+    sink_written = 0;
+}
+
 void LoopbackTerm::batch_read()
 {
     while (data_len > 0) {
         Task::Delay(delay_before_inject);
         {
             Scoped<Lock> lock(on_read_guard);
-            on_read(nullptr, std::min(inject_by, data_len));
+            if (post_data) {
+                std::vector<uint8_t> chunk(std::min(inject_by, data_len));
+                if (chunk.empty()) {
+                    break;
+                }
+                read(chunk.data(), chunk.size());
+                on_read(chunk.data(), chunk.size());
+            } else {
+                on_read(nullptr, std::min(inject_by, data_len));
+            }
         }
         Task::Delay(delay_after_inject);
     }
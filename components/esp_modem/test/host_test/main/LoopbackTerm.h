@@ -24,11 +24,42 @@ public:
      */
     int inject(uint8_t *data, size_t len, size_t inject_by, size_t delay_before = 0, size_t delay_after = 1);
 
+    /**
+     * @brief Deliver received data synchronously from the caller's context,
+     * calling the read callback per `feed_by` bytes (for throughput tests)
+     */
+    int feed(uint8_t *data, size_t len, size_t feed_by);
+
+    /**
+     * @brief Drop written data instead of looping it back, counting the
+     * write calls and bytes (for throughput tests)
+     */
+    void set_sink(bool enable);
+    size_t sink_calls() const
+    {
+        return sink_write_calls;
+    }
+    size_t sink_bytes() const
+    {
+        return sink_written;
+    }
+
+    /**
+     * @brief Post injected data with the read callback (as CMUX terminals do),
+     * instead of letting the reader read it
+     */
+    void set_post_data(bool enable)
+    {
+        post_data = enable;
+    }
+
     void start() override;
     void stop() override;
 
     int write(uint8_t *data, size_t len) override;
 
+    int writev(const terminal_iovec *parts, size_t count) override;
+
     int read(uint8_t *data, size_t len) override;
 
     void set_read_cb(std::function<bool(uint8_t *data, size_t len)> f) override;
@@ -52,5 +83,9 @@ private:
     size_t delay_after_inject;
     std::vector<std::future<void>> async_results;
     Lock on_read_guard;
+    bool sink;
+    bool post_data;
+    size_t sink_write_calls;
+    size_t sink_written;
 
 };
@@ -0,0 +1,520 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+#include <algorithm>
+#include <cstring>
+#include "QuectelSim.h"
+
+namespace {
+
+constexpr uint8_t cmux_sof = 0xF9;
+constexpr uint8_t cmux_sabm = 0x2F;
+constexpr uint8_t cmux_disc = 0x43;
+constexpr uint8_t cmux_ua = 0x63;
+constexpr uint8_t cmux_uih = 0xEF;
+constexpr uint8_t cmux_pf = 0x10;
+constexpr uint8_t cmux_cld = 0xC3;      // close down (multiplexer control command on DLCI 0)
+constexpr size_t cmux_max_payload = 127;
+
+constexpr uint8_t ppp_flag = 0x7E;
+constexpr uint8_t ppp_escape = 0x7D;
+
+uint8_t cmux_fcs(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0xFF;
+    while (len--) {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 0x01) ? (crc >> 1) ^ 0xE0 : (crc >> 1);
+        }
+    }
+    return 0xFF - crc;
+}
+
+uint16_t ppp_fcs(const std::vector<uint8_t> &data)
+{
+    uint16_t fcs = 0xFFFF;
+    for (auto byte : data) {
+        fcs ^= byte;
+        for (int i = 0; i < 8; i++) {
+            fcs = (fcs & 0x01) ? (fcs >> 1) ^ 0x8408 : (fcs >> 1);
+        }
+    }
+    return fcs ^ 0xFFFF;
+}
+
+bool starts_with(const std::string &str, const char *prefix)
+{
+    return str.compare(0, strlen(prefix), prefix) == 0;
+}
+
+} // namespace
+
+QuectelSim::QuectelSim(quectel_scenario s):
+    scenario(std::move(s)), baud(scenario.baud), host_baud(scenario.baud), powered(false), mux(false), pin_ok(false),
+    creg_mode(0), counters(), exiting(false)
+{
+}
+
+QuectelSim::~QuectelSim()
+{
+    power_off();
+}
+
+void QuectelSim::power_on()
+{
+    {
+        std::lock_guard<std::mutex> l(state_lock);
+        powered = true;
+        mux = false;
+        ready_at = clock::now() + modem_time(scenario.boot_ms);
+        line_free = clock::now();
+        for (auto &ch : channels) {
+            ch = channel();
+        }
+    }
+    exiting = false;
+    worker = std::thread(&QuectelSim::run, this);
+
+    // Boot URCs of the EG91x, the SIM state is posted once the SIM has been read
+    std::string sim_state = scenario.sim_error == 10 ? "+CPIN: NOT INSERTED" :
+                            scenario.sim_error ? "" :
+                            scenario.pin ? "+CPIN: SIM PIN" : "+CPIN: READY";
+    std::lock_guard<std::mutex> l(state_lock);
+    reply(0, "RDY\n+CFUN: 1", scenario.boot_ms);
+    counters.urcs += 2;
+    if (!sim_state.empty()) {
+        reply(0, sim_state + "\n+QIND: PB DONE", scenario.boot_ms + scenario.sim_busy_ms);
+        counters.urcs += 2;
+    }
+}
+
+void QuectelSim::power_off()
+{
+    {
+        std::lock_guard<std::mutex> l(events_lock);
+        exiting = true;
+        events.clear();
+    }
+    events_cv.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    std::lock_guard<std::mutex> l(state_lock);
+    powered = false;
+}
+
+void QuectelSim::set_host_baud(int rate)
+{
+    host_baud = rate;
+}
+
+void QuectelSim::delay(int ms) const
+{
+    std::this_thread::sleep_for(modem_time(ms));
+}
+
+QuectelSim::stats QuectelSim::get_stats()
+{
+    std::lock_guard<std::mutex> l(state_lock);
+    return counters;
+}
+
+void QuectelSim::start()
+{
+}
+
+void QuectelSim::stop()
+{
+}
+
+int QuectelSim::write(uint8_t *data, size_t len)
+{
+    std::lock_guard<std::mutex> l(state_lock);
+    if (!powered) {
+        return len;
+    }
+    if (host_baud != baud || !ready()) {
+        // the module doesn't understand (or doesn't listen yet), count the lost commands
+        if (!mux && !channels[0].data_mode) {
+            counters.commands += std::count(data, data + len, '\r');
+            counters.unanswered += std::count(data, data + len, '\r');
+        }
+        return len;
+    }
+    if (mux) {
+        on_cmux(data, len);
+    } else {
+        on_bytes(0, data, len);
+    }
+    return len;
+}
+
+int QuectelSim::read(uint8_t *data, size_t len)
+{
+    std::lock_guard<std::mutex> l(rx_lock);
+    size_t read_len = std::min(len, rx.size());
+    memcpy(data, rx.data(), read_len);
+    rx.erase(rx.begin(), rx.begin() + read_len);
+    return read_len;
+}
+
+void QuectelSim::set_read_cb(std::function<bool(uint8_t *, size_t)> f)
+{
+    Scoped<Lock> l(on_read_guard);
+    on_read = std::move(f);
+}
+
+void QuectelSim::on_bytes(int dlci, const uint8_t *data, size_t len)
+{
+    auto &ch = channels[dlci];
+    if (ch.data_mode) {
+        if (len == 3 && memcmp(data, "+++", 3) == 0) {  // escape sequence (the guard time is not simulated)
+            ch.data_mode = false;
+            ch.ppp.clear();
+            reply(dlci, "OK", scenario.command_ms);
+            return;
+        }
+        ch.ppp.insert(ch.ppp.end(), data, data + len);
+        on_ppp(dlci);
+        return;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == '\r') {
+            std::string cmd;
+            std::swap(cmd, ch.line);
+            if (!cmd.empty()) {
+                on_command(dlci, cmd);
+            }
+        } else if (data[i] != '\n') {
+            ch.line += static_cast<char>(data[i]);
+        }
+    }
+}
+
+void QuectelSim::on_command(int dlci, const std::string &cmd)
+{
+    auto &ch = channels[dlci];
+    counters.commands++;
+    if (ch.echo) {
+        send(dlci, reinterpret_cast<const uint8_t *>((cmd + "\r").data()), cmd.size() + 1, 0);
+    }
+    for (auto &rule : scenario.rules) {
+        if (rule.times != 0 && starts_with(cmd, rule.command.c_str())) {
+            if (rule.times > 0) {
+                rule.times--;
+            }
+            reply(dlci, rule.reply, rule.latency_ms);
+            return;
+        }
+    }
+    int latency_ms = scenario.command_ms;
+    auto text = builtin_reply(dlci, cmd, latency_ms);
+    if (text.empty()) {
+        counters.unanswered++;
+        return;
+    }
+    reply(dlci, text, latency_ms);
+    if (starts_with(cmd, "AT+CMUX=0") && text == "OK") {
+        mux = true;     // the module expects CMUX frames right after the reply
+        cmux_rx.clear();
+        channels[1].echo = channels[2].echo = channels[0].echo;
+    } else if (starts_with(cmd, "AT+IPR=") && text == "OK") {
+        baud = atoi(cmd.c_str() + strlen("AT+IPR="));   // switches once the reply is sent
+    }
+}
+
+std::string QuectelSim::builtin_reply(int dlci, const std::string &cmd, int &latency_ms)
+{
+    auto &ch = channels[dlci];
+    bool sim_ready = since_ready() >= scenario.sim_busy_ms;
+    const std::string sim_fail = "+CME ERROR: " + std::to_string(sim_ready ? scenario.sim_error : 14);
+    bool sim_ok = sim_ready && scenario.sim_error == 0;
+
+    if (cmd == "AT") {
+        return "OK";
+    } else if (cmd == "ATE0" || cmd == "ATE1") {
+        ch.echo = cmd[3] == '1';
+        return "OK";
+    } else if (cmd == "AT+IPR?") {
+        return "+IPR: " + std::to_string(baud) + "\nOK";
+    } else if (starts_with(cmd, "AT+IPR=")) {
+        return "OK";
+    } else if (cmd == "AT+CPIN?") {
+        if (!sim_ok) {
+            return sim_fail;
+        }
+        return (scenario.pin && !pin_ok) ? "+CPIN: SIM PIN\nOK" : "+CPIN: READY\nOK";
+    } else if (starts_with(cmd, "AT+CPIN=")) {
+        if (!sim_ok) {
+            return sim_fail;
+        }
+        latency_ms += 200;  // the SIM verifies the PIN
+        pin_ok = scenario.pin && cmd.substr(strlen("AT+CPIN=")) == scenario.pin;
+        return pin_ok ? "OK" : "+CME ERROR: 16";
+    } else if (cmd == "AT+CREG?" || cmd == "AT+CEREG?") {
+        int state = registered() ? scenario.reg_state : (sim_ok ? 2 : 0);
+        return cmd.substr(2, cmd.size() - 3) + ": " + std::to_string(creg_mode) + "," + std::to_string(state) + "\nOK";
+    } else if (starts_with(cmd, "AT+CREG=") || starts_with(cmd, "AT+CEREG=")) {
+        creg_mode = atoi(cmd.c_str() + cmd.find('=') + 1);
+        return "OK";
+    } else if (cmd == "AT+CIMI") {
+        return sim_ok ? std::string(scenario.imsi) + "\nOK" : sim_fail;
+    } else if (cmd == "AT+QCCID") {
+        return sim_ok ? "+QCCID: 89860012345678901234\nOK" : sim_fail;
+    } else if (cmd == "AT+CGSN") {
+        return "861234567890123\nOK";
+    } else if (cmd == "AT+CGMM") {
+        return "EG915U\nOK";
+    } else if (cmd == "AT+CGMR") {
+        return "EG915UEUABR03A01M08\nOK";
+    } else if (cmd == "AT+CSQ") {
+        return registered() ? "+CSQ: 24,99\nOK" : "+CSQ: 99,99\nOK";
+    } else if (cmd == "AT+COPS?") {
+        return registered() ? "+COPS: 0,0,\"" + std::string(scenario.operator_name) + "\",7\nOK" : "+COPS: 0\nOK";
+    } else if (cmd == "AT+QNWINFO") {
+        return registered() ? "+QNWINFO: \"FDD LTE\",\"46000\",\"LTE BAND 3\",1650\nOK" : "+QNWINFO: No Service\nOK";
+    } else if (cmd == "AT+QENG=\"servingcell\"") {
+        return registered() ?
+               "+QENG: \"servingcell\",\"NOCONN\",\"LTE\",\"FDD\",460,00,1A2D001,123,1650,3,5,5,5E8F,-95,-10,-65,12,-\nOK" :
+               "+QENG: \"servingcell\",\"SEARCH\"\nOK";
+    } else if (starts_with(cmd, "AT+CGDCONT=") || starts_with(cmd, "AT+QICSGP=") || starts_with(cmd, "AT+QCFG=")) {
+        return "OK";
+    } else if (cmd == "AT+CMUX=0") {
+        return dlci == 0 ? "OK" : "ERROR";
+    } else if (starts_with(cmd, "ATD")) {
+        latency_ms = scenario.dial_ms;
+        if (!registered()) {
+            return "NO CARRIER";
+        }
+        ch.data_mode = ch.connected = true;     // data mode starts right after CONNECT
+        return "CONNECT 150000000";
+    } else if (cmd == "ATO") {
+        if (!ch.connected) {
+            return "NO CARRIER";
+        }
+        ch.data_mode = true;
+        return "CONNECT 150000000";
+    } else if (starts_with(cmd, "AT")) {
+        return "ERROR";
+    }
+    return "";
+}
+
+void QuectelSim::on_ppp(int dlci)
+{
+    auto &buf = channels[dlci].ppp;
+    while (true) {
+        auto start = std::find(buf.begin(), buf.end(), ppp_flag);
+        if (start == buf.end()) {
+            buf.clear();
+            return;
+        }
+        auto end = std::find(start + 1, buf.end(), ppp_flag);
+        if (end == buf.end()) {
+            buf.erase(buf.begin(), start);
+            return;
+        }
+        std::vector<uint8_t> frame;     // unescaped, without the FCS
+        for (auto it = start + 1; it != end; ++it) {
+            if (*it == ppp_escape && it + 1 != end) {
+                frame.push_back(*++it ^ 0x20);
+            } else {
+                frame.push_back(*it);
+            }
+        }
+        buf.erase(buf.begin(), end);    // the closing flag may open the next frame
+        if (frame.size() < 4) {         // empty frame between two flags
+            continue;
+        }
+        frame.resize(frame.size() - 2);
+        counters.ppp_frames++;
+        // LCP frame (ff 03 c0 21 code id len...): reply with the next code,
+        // i.e. Configure-Ack to Configure-Request, Echo-Reply to Echo-Request
+        if (frame.size() < 5 || frame[0] != 0xFF || frame[2] != 0xC0 || frame[3] != 0x21) {
+            continue;
+        }
+        frame[4]++;
+        uint16_t fcs = ppp_fcs(frame);
+        frame.push_back(fcs & 0xFF);
+        frame.push_back(fcs >> 8);
+        std::vector<uint8_t> out = { ppp_flag };
+        for (auto byte : frame) {
+            if (byte < 0x20 || byte == ppp_flag || byte == ppp_escape) {
+                out.push_back(ppp_escape);
+                byte ^= 0x20;
+            }
+            out.push_back(byte);
+        }
+        out.push_back(ppp_flag);
+        send(dlci, out.data(), out.size(), counters.ppp_frames == 1 ? scenario.ppp_ms : scenario.command_ms);
+    }
+}
+
+void QuectelSim::on_cmux(const uint8_t *data, size_t len)
+{
+    cmux_rx.insert(cmux_rx.end(), data, data + len);
+    while (true) {
+        auto start = std::find(cmux_rx.begin(), cmux_rx.end(), cmux_sof);
+        cmux_rx.erase(cmux_rx.begin(), start);
+        while (cmux_rx.size() > 1 && cmux_rx[1] == cmux_sof) {  // closing flag of the previous frame
+            cmux_rx.erase(cmux_rx.begin());
+        }
+        if (cmux_rx.size() < 4) {
+            return;
+        }
+        size_t header = (cmux_rx[3] & 0x01) ? 3 : 4;
+        size_t payload = cmux_rx[3] >> 1;
+        if (header == 4) {
+            if (cmux_rx.size() < 5) {
+                return;
+            }
+            payload += cmux_rx[4] << 7;
+        }
+        size_t total = 1 + header + payload + 2;
+        if (cmux_rx.size() < total) {
+            return;
+        }
+        int dlci = cmux_rx[1] >> 2;
+        uint8_t type = cmux_rx[2] & ~cmux_pf;
+        std::vector<uint8_t> info(cmux_rx.begin() + 1 + header, cmux_rx.begin() + 1 + header + payload);
+        cmux_rx.erase(cmux_rx.begin(), cmux_rx.begin() + total - 1);
+        if (dlci > 2) {
+            continue;
+        }
+        if (type == cmux_sabm || type == cmux_disc) {
+            send_frame(dlci, cmux_ua | cmux_pf, nullptr, 0, scenario.command_ms);
+        } else if (type == cmux_uih && dlci == 0) {
+            if (!info.empty() && info[0] == cmux_cld) {
+                const uint8_t cld_response[] = { 0xC1, 0x01 };
+                send_frame(0, cmux_uih, cld_response, sizeof(cld_response), scenario.command_ms);
+                mux = false;
+                channels[0] = channel();
+                return;
+            }
+        } else if (type == cmux_uih && !info.empty()) {
+            on_bytes(dlci, info.data(), info.size());
+        }
+    }
+}
+
+void QuectelSim::reply(int dlci, const std::string &text, int latency_ms)
+{
+    // ATV1 format: every line of the reply is enclosed in CRLF
+    std::string out;
+    size_t pos = 0;
+    while (pos <= text.size()) {
+        size_t end = std::min(text.find('\n', pos), text.size());
+        out += "\r\n" + text.substr(pos, end - pos) + "\r\n";
+        pos = end + 1;
+    }
+    send(dlci, reinterpret_cast<const uint8_t *>(out.data()), out.size(), latency_ms);
+}
+
+void QuectelSim::send(int dlci, const uint8_t *data, size_t len, int latency_ms)
+{
+    if (!mux || dlci == 0) {
+        schedule(std::vector<uint8_t>(data, data + len), latency_ms);
+        return;
+    }
+    for (size_t offset = 0; offset < len; offset += cmux_max_payload) {
+        send_frame(dlci, cmux_uih, data + offset, std::min(cmux_max_payload, len - offset), latency_ms);
+    }
+}
+
+void QuectelSim::send_frame(int dlci, uint8_t control, const uint8_t *data, size_t len, int latency_ms)
+{
+    std::vector<uint8_t> frame = { cmux_sof, static_cast<uint8_t>((dlci << 2) | 0x03), control,
+                                   static_cast<uint8_t>((len << 1) | 0x01)
+                                 };
+    uint8_t fcs = cmux_fcs(&frame[1], 3);
+    if (data) {
+        frame.insert(frame.end(), data, data + len);
+    }
+    frame.push_back(fcs);
+    frame.push_back(cmux_sof);
+    schedule(std::move(frame), latency_ms);
+}
+
+void QuectelSim::schedule(std::vector<uint8_t> bytes, int latency_ms)
+{
+    // the reply waits for the latency and for the previous bytes to leave the UART (10 bits per byte)
+    auto due = std::max(clock::now() + modem_time(latency_ms), line_free);
+    due += std::chrono::duration_cast<clock::duration>(std::chrono::microseconds(
+                static_cast<int64_t>(bytes.size() * 10'000'000.0 / baud * scenario.time_scale)));
+    line_free = due;
+    std::lock_guard<std::mutex> l(events_lock);
+    auto pos = std::upper_bound(events.begin(), events.end(), due, [](const clock::time_point & t, const event & e) {
+        return t < e.due;
+    });
+    events.insert(pos, event{due, std::move(bytes), baud});
+    events_cv.notify_one();
+}
+
+bool QuectelSim::ready() const
+{
+    return clock::now() >= ready_at;
+}
+
+int QuectelSim::since_ready() const
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - ready_at);
+    return static_cast<int>(elapsed.count() / scenario.time_scale);
+}
+
+bool QuectelSim::registered() const
+{
+    bool sim_ok = since_ready() >= scenario.sim_busy_ms && scenario.sim_error == 0 && (scenario.pin == nullptr || pin_ok);
+    return sim_ok && scenario.register_ms >= 0 && since_ready() >= scenario.register_ms;
+}
+
+QuectelSim::clock::duration QuectelSim::modem_time(int ms) const
+{
+    return std::chrono::duration_cast<clock::duration>(std::chrono::microseconds(
+                static_cast<int64_t>(ms * 1000.0 * scenario.time_scale)));
+}
+
+void QuectelSim::run()
+{
+    std::unique_lock<std::mutex> l(events_lock);
+    while (!exiting) {
+        if (events.empty()) {
+            events_cv.wait(l);
+            continue;
+        }
+        auto due = events.front().due;
+        if (clock::now() < due) {
+            events_cv.wait_until(l, due);
+            continue;
+        }
+        event e = std::move(events.front());
+        events.erase(events.begin());
+        l.unlock();
+        deliver(e);
+        l.lock();
+    }
+}
+
+void QuectelSim::deliver(event &e)
+{
+    if (e.baud != host_baud) {  // sampled at a wrong rate, the host sees only noise
+        std::fill(e.bytes.begin(), e.bytes.end(), 0xFF);
+    }
+    size_t available;
+    {
+        std::lock_guard<std::mutex> l(rx_lock);
+        rx.insert(rx.end(), e.bytes.begin(), e.bytes.end());
+        available = rx.size();
+    }
+    Scoped<Lock> l(on_read_guard);
+    while (available > 0 && on_read) {  // the reader may consume less than available
+        on_read(nullptr, available);
+        std::lock_guard<std::mutex> lr(rx_lock);
+        if (rx.size() == available) {
+            break;
+        }
+        available = rx.size();
+    }
+}
@@ -0,0 +1,165 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include "cxx_include/esp_modem_api.hpp"
+#include "cxx_include/esp_modem_terminal.hpp"
+
+using namespace esp_modem;
+
+/**
+ * @brief Scripted reply of the simulated modem
+ *
+ * Rules are checked before the built-in Quectel behaviour, so a scenario can override
+ * any command (to inject CME errors, slow replies, etc.)
+ */
+struct quectel_rule {
+    std::string command;    /*!< Command prefix to match (without the trailing CR) */
+    std::string reply;      /*!< Reply lines, without the leading CRLF (e.g. "+CME ERROR: 3") */
+    int latency_ms;         /*!< Time from the command to the reply */
+    int times;              /*!< Number of commands the rule applies to, -1 for all */
+};
+
+/**
+ * @brief Behaviour of the simulated EG91x module
+ *
+ * All times are in milliseconds of the modem's time, see `time_scale`
+ */
+struct quectel_scenario {
+    const char *name;               /*!< Scenario name for reports */
+    int baud = 921600;              /*!< UART rate the module currently runs (AT+IPR) */
+    int boot_ms = 0;                /*!< Power on to the RDY URC, the module ignores commands before */
+    int sim_busy_ms = 0;            /*!< After RDY, AT+CPIN? replies +CME ERROR: 14 (SIM busy) */
+    int sim_error = 0;              /*!< CME error of AT+CPIN? once the SIM is not busy (10: no SIM), 0 if present */
+    const char *pin = nullptr;      /*!< PIN the SIM asks for, nullptr if not locked */
+    int register_ms = 0;            /*!< After RDY until the network registration, -1 never */
+    int reg_state = 1;              /*!< Registration state once registered (1 home, 5 roaming) */
+    int command_ms = 5;             /*!< Processing time of a plain AT command */
+    int dial_ms = 150;              /*!< ATD to CONNECT */
+    int ppp_ms = 300;               /*!< First LCP frame to the LCP reply of the module (PPP negotiation) */
+    const char *imsi = "460001234567890";
+    const char *operator_name = "CHINA MOBILE";
+    std::vector<quectel_rule> rules{};  /*!< Scripted replies, checked in order */
+    float time_scale = 1.0f;        /*!< Real time per modem time, less than 1 runs the scenario faster */
+};
+
+/**
+ * @brief Terminal simulating a Quectel EG91x module on the UART
+ *
+ * Replies to AT commands (echo, registration, SIM states, PDP and dial commands), boots with
+ * the usual URCs, runs CMUX (DLCI 0-2) after AT+CMUX=0 and answers LCP frames in data mode.
+ * Replies are delivered from a separate thread after the scripted latency plus the time
+ * the bytes take on the UART, commands are ignored and replies garbled while the host
+ * uses a different baud rate than the module.
+ */
+class QuectelSim : public Terminal {
+public:
+    explicit QuectelSim(quectel_scenario scenario);
+
+    ~QuectelSim() override;
+
+    /**
+     * @brief Pulls PWRKEY: the module boots and posts RDY after `boot_ms`
+     */
+    void power_on();
+
+    /**
+     * @brief Cuts the power: pending replies are dropped and the delivery thread stops
+     * (must be called before destroying the DTE that owns the terminal)
+     */
+    void power_off();
+
+    /**
+     * @brief Sets the baud rate of the host UART
+     */
+    void set_host_baud(int baud);
+
+    /**
+     * @brief Sleeps for the modem time `ms` (scaled by the scenario time scale)
+     */
+    void delay(int ms) const;
+
+    struct stats {
+        size_t commands;        /*!< AT command lines received, i.e. round trips */
+        size_t unanswered;      /*!< Commands ignored (module booting or baud rate mismatch) */
+        size_t ppp_frames;      /*!< PPP frames received in data mode */
+        size_t urcs;            /*!< Unsolicited lines sent */
+    };
+    stats get_stats();
+
+    void start() override;
+    void stop() override;
+
+    int write(uint8_t *data, size_t len) override;
+
+    int read(uint8_t *data, size_t len) override;
+
+    void set_read_cb(std::function<bool(uint8_t *data, size_t len)> f) override;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct channel {
+        std::string line;       /*!< Command being received */
+        bool echo = true;
+        bool data_mode = false;
+        bool connected = false; /*!< PPP session exists (ATO resumes it) */
+        std::vector<uint8_t> ppp;   /*!< PPP bytes received in data mode */
+    };
+
+    struct event {
+        clock::time_point due;
+        std::vector<uint8_t> bytes;
+        int baud;               /*!< Rate the module used to send the bytes */
+    };
+
+    void on_bytes(int dlci, const uint8_t *data, size_t len);
+    void on_command(int dlci, const std::string &cmd);
+    void on_ppp(int dlci);
+    void on_cmux(const uint8_t *data, size_t len);
+    std::string builtin_reply(int dlci, const std::string &cmd, int &latency_ms);
+    void reply(int dlci, const std::string &text, int latency_ms);
+    void send(int dlci, const uint8_t *data, size_t len, int latency_ms);
+    void send_frame(int dlci, uint8_t control, const uint8_t *data, size_t len, int latency_ms);
+    void schedule(std::vector<uint8_t> bytes, int latency_ms);
+    bool ready() const;
+    int since_ready() const;
+    bool registered() const;
+    clock::duration modem_time(int ms) const;
+    void run();
+    void deliver(event &e);
+
+    quectel_scenario scenario;
+    int baud;
+    std::atomic<int> host_baud;
+    bool powered;
+    bool mux;
+    bool pin_ok;
+    int creg_mode;
+    clock::time_point ready_at;
+    clock::time_point line_free;    /*!< Time when the module finishes sending the previous bytes */
+    channel channels[3];            /*!< UART (or DLCI 0) and the CMUX virtual terminals */
+    std::vector<uint8_t> cmux_rx;
+    stats counters;
+    std::mutex state_lock;
+
+    std::vector<event> events;      /*!< Pending replies, sorted by due time */
+    std::mutex events_lock;
+    std::condition_variable events_cv;
+    std::thread worker;
+    bool exiting;
+
+    std::vector<uint8_t> rx;        /*!< Delivered bytes, not yet read by the DTE */
+    std::mutex rx_lock;
+    Lock on_read_guard;
+};
@@ -0,0 +1,291 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * Bring-up of the application's cellular module (main/cat1.c) against the simulated EG91x.
+ *
+ * cat1.c needs the IDF UART driver, GPIO, NVS and esp_netif, so it cannot be linked here.
+ * Its AT sequence (baud rate negotiation, SIM PIN check, network registration and the mode
+ * switch) lives in the cat1_bringup component, which the test calls with the same esp_modem
+ * C API and callbacks that drive the simulator instead of the UART driver and FreeRTOS.
+ */
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <catch2/catch_test_macros.hpp>
+#include "cxx_include/esp_modem_api.hpp"
+#include "cxx_include/esp_modem_dce_factory.hpp"
+#include "esp_private/c_api_wrapper.hpp"
+#include "esp_modem_config.h"
+#include "cat1_bringup.h"
+#include "QuectelSim.h"
+
+using namespace esp_modem;
+
+static std::shared_ptr<DTE> s_sim_dte;
+
+/**
+ * @brief The linux port has no UART DTE, esp_modem_new_dev() gets the DTE on the simulator
+ */
+std::shared_ptr<DTE> esp_modem::create_uart_dte(const dte_config *config)
+{
+    return s_sim_dte;
+}
+
+namespace {
+
+/**
+ * @brief State of one bring-up (mirrors mdCat1_t of cat1.c)
+ */
+struct cat1_harness {
+    QuectelSim *sim;
+    std::shared_ptr<DTE> dte;
+    esp_modem_dce_t *dce;
+    esp_netif_t netif;
+    uint32_t stored_baud;       /*!< Baud rate stored in NVS (cfg_get_cellular_baud_rate) */
+    cat1BringupParam_t param;
+    char modem_status[32];      /*!< g_cat1.status.modemStatus */
+};
+
+void sim_delay_ms(void *ctx, int ms)
+{
+    static_cast<cat1_harness *>(ctx)->sim->delay(ms);
+}
+
+void sim_set_baud(void *ctx, uint32_t baud)
+{
+    static_cast<cat1_harness *>(ctx)->sim->set_host_baud(baud);
+}
+
+/**
+ * @brief cat1_write_at(): the firmware polls the UART by 100 ms reads which return early
+ * only when the response buffer fills up, so each raw exchange takes whole 100 ms periods
+ */
+esp_err_t sim_write_at(void *ctx, const char *cmd, char *resp, int resp_len, int timeout, const char *pass, const char *fail)
+{
+    auto &h = *static_cast<cat1_harness *>(ctx);
+    auto start = std::chrono::steady_clock::now();
+    std::string out;
+    auto ret = h.dte->command(cmd, [&](uint8_t *data, size_t len) {
+        out.assign(reinterpret_cast<char *>(data), len);
+        if (out.find(pass) != std::string::npos) {
+            return command_result::OK;
+        } else if (out.find(fail) != std::string::npos) {
+            return command_result::FAIL;
+        }
+        return command_result::TIMEOUT;
+    }, timeout);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    h.sim->delay(100 - elapsed % 100);
+    snprintf(resp, resp_len, "%s", out.c_str());
+    return ret == command_result::OK ? ESP_OK : ret == command_result::FAIL ? ESP_FAIL : ESP_ERR_TIMEOUT;
+}
+
+/**
+ * @brief power_on_modem() and check_baud_rate(): PWRKEY pulse, baud rate and the EG91X DCE
+ */
+esp_err_t check_baud_rate(cat1_harness &h, const cat1BringupOps_t &ops)
+{
+    h.sim->power_on();
+    h.sim->delay(2000);
+    if (cat1_bringup_baud_rate(&ops, h.stored_baud) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    h.stored_baud = CAT1_BRINGUP_BAUD_RATE;
+    h.sim->set_host_baud(CAT1_BRINGUP_BAUD_RATE);
+
+    esp_modem_dte_config_t dte_config = {};
+    esp_modem_dce_config_t dce_config = ESP_MODEM_DCE_DEFAULT_CONFIG("");
+    s_sim_dte = h.dte;
+    h.dce = esp_modem_new_dev(ESP_MODEM_DCE_EG91X, &dte_config, &dce_config, &h.netif);
+    s_sim_dte = nullptr;
+    return h.dce ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * @brief get_status(): the status page queries, on the command DLCI in CMUX mode
+ */
+void get_status(cat1_harness &h)
+{
+    auto &dce = *h.dce->dce;
+    std::string resp;
+    int rssi, ber;
+    dce.at("AT+CPIN?", resp, 500);
+    dce.at("AT+QENG=\"servingcell\"", resp, 500);
+    dce.get_imsi(resp);
+    dce.get_imei(resp);
+    dce.at("AT+CGMM", resp, 500);
+    dce.at("AT+CGMR", resp, 500);
+    dce.get_signal_quality(rssi, ber);
+    dce.at_raw("AT+CREG?\r", resp, "+CREG", "+CME ERROR", 500);
+    dce.at_raw("AT+QCCID\r", resp, "+QCCID", "+CME ERROR", 500);
+    dce.at("AT+COPS?", resp, 500);
+    dce.at_raw("AT+QNWINFO\r", resp, "+QNWINFO", "+CME ERROR", 500);
+}
+
+/**
+ * @brief The first LCP exchange after entering data mode, as lwIP starts it on netif start
+ */
+bool ppp_up(cat1_harness &h)
+{
+    static uint8_t lcp_echo_request[] = {0x7e, 0xff, 0x03, 0xc0, 0x21, 0x09, 0x01, 0x00, 0x08, 0x99, 0xd1, 0x35, 0xc1, 0x8e, 0x2c, 0x7e };
+    SignalGroup signal;
+    h.dte->set_read_cb([&signal](uint8_t *data, size_t len) {
+        std::string_view frame(reinterpret_cast<char *>(data), len);
+        if (frame.find("\xc0\x21") != std::string_view::npos) {
+            signal.set(1);
+        }
+        return true;
+    });
+    h.dte->write(lcp_echo_request, sizeof(lcp_echo_request));
+    bool up = signal.wait(1, 5000);
+    h.dte->set_read_cb(nullptr);
+    return up;
+}
+
+struct cat1_expect {
+    bool cmux;
+    uint32_t stored_baud;
+    const char *pin;
+    bool ppp;                   /*!< PPP is expected to come up */
+    const char *modem_status;
+};
+
+struct cat1_result {
+    bool ppp;
+    long ppp_ms;                /*!< Power on to the first LCP reply */
+    QuectelSim::stats bringup;
+    long status_ms;             /*!< get_status() duration, -1 if not run */
+    size_t status_commands;
+    std::string modem_status;
+};
+
+cat1_result run_cat1(const quectel_scenario &scenario, const cat1_expect &expect)
+{
+    auto term = std::make_unique<QuectelSim>(scenario);
+    cat1_harness h = {};
+    h.sim = term.get();
+    h.stored_baud = expect.stored_baud;
+    h.param = { .cmux = expect.cmux, .pin = expect.pin ? expect.pin : "", .isp = "auto",
+                .apn = "", .user = "", .password = "", .authentication = 0 };
+    snprintf(h.modem_status, sizeof(h.modem_status), "%s", "No SIM Card");
+    h.dte = std::make_shared<DTE>(std::move(term));
+    const cat1BringupOps_t ops = { .ctx = &h, .delay_ms = sim_delay_ms, .set_baud = sim_set_baud, .write_at = sim_write_at };
+
+    cat1_result res = {};
+    res.status_ms = -1;
+    auto start = std::chrono::steady_clock::now();
+    if (check_baud_rate(h, ops) == ESP_OK &&
+            cat1_bringup_pin(&ops, h.dce, &h.param, h.modem_status, sizeof(h.modem_status)) == ESP_OK &&
+            cat1_bringup_network(&ops, h.dce, &h.param, h.modem_status, sizeof(h.modem_status)) == ESP_OK) {
+        res.ppp = ppp_up(h);
+    }
+    auto done = std::chrono::steady_clock::now();
+    res.ppp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(done - start).count();
+    res.bringup = h.sim->get_stats();
+    res.modem_status = h.modem_status;
+    if (res.ppp && h.param.cmux) {
+        get_status(h);
+        res.status_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - done).count();
+        res.status_commands = h.sim->get_stats().commands - res.bringup.commands;
+    }
+    h.sim->power_off();
+    esp_modem_destroy(h.dce);
+    return res;
+}
+
+} // namespace
+
+TEST_CASE("cat1 bring-up on simulated EG91x", "[cat1][sim]")
+{
+    struct {
+        quectel_scenario scenario;
+        cat1_expect expect;
+    } runs[] = {
+        {   { .name = "warm start, DATA" },
+            { .cmux = false, .stored_baud = 921600, .pin = nullptr, .ppp = true, .modem_status = "Ready" }
+        },
+        {   { .name = "warm start, CMUX" },
+            { .cmux = true, .stored_baud = 921600, .pin = nullptr, .ppp = true, .modem_status = "Ready" }
+        },
+        {   { .name = "cold boot at 115200, SIM busy, registration 4s", .baud = 115200, .boot_ms = 2500, .sim_busy_ms = 1500, .register_ms = 4000 },
+            { .cmux = false, .stored_baud = 0, .pin = nullptr, .ppp = true, .modem_status = "Ready" }
+        },
+        {   { .name = "locked SIM, roaming, CME error on roamservice", .pin = "1234", .register_ms = 1500, .reg_state = 5,
+                .rules = { { "AT+QCFG=\"roamservice\"", "+CME ERROR: 3", 20, -1 } }
+            },
+            // a failed AT command after the PIN check is reported as "SIM Card Error", even though PPP comes up
+            { .cmux = true, .stored_baud = 921600, .pin = "1234", .ppp = true, .modem_status = "SIM Card Error" }
+        },
+        {   { .name = "first dial rejected", .rules = { { "ATD", "NO CARRIER", 2000, 1 } } },
+            { .cmux = false, .stored_baud = 921600, .pin = nullptr, .ppp = true, .modem_status = "Ready" }
+        },
+        {   { .name = "no SIM (x0.1 time)", .sim_error = 10, .time_scale = 0.1f },
+            { .cmux = false, .stored_baud = 921600, .pin = nullptr, .ppp = false, .modem_status = nullptr }
+        },
+        {   { .name = "no network (x0.1 time)", .register_ms = -1, .time_scale = 0.1f },
+            { .cmux = false, .stored_baud = 921600, .pin = nullptr, .ppp = false, .modem_status = "Network Searching" }
+        },
+    };
+
+    for (auto &run : runs) {
+        auto res = run_cat1(run.scenario, run.expect);
+        std::cout << "cat1 [" << run.scenario.name << "]: ";
+        if (res.ppp) {
+            std::cout << "PPP up in " << res.ppp_ms << " ms";
+        } else {
+            std::cout << "no PPP after " << res.ppp_ms << " ms";
+        }
+        std::cout << ", " << res.bringup.commands << " AT round trips (" << res.bringup.unanswered << " unanswered), "
+                  << "status '" << res.modem_status << "'";
+        if (res.status_ms >= 0) {
+            std::cout << ", get_status " << res.status_commands << " round trips in " << res.status_ms << " ms";
+        }
+        std::cout << std::endl;
+
+        CHECK(res.ppp == run.expect.ppp);
+        if (run.expect.modem_status) {
+            CHECK(res.modem_status == run.expect.modem_status);
+        }
+    }
+}
+
+TEST_CASE("Quectel simulator scripts", "[cat1][sim]")
+{
+    quectel_scenario scenario = { .name = "script", .command_ms = 1,
+                                  .rules = { { "AT+CSQ", "+CME ERROR: 100", 1, 2 } }
+                                };
+    auto term = std::make_unique<QuectelSim>(scenario);
+    auto sim = term.get();
+    auto dte = std::make_shared<DTE>(std::move(term));
+    esp_modem_dce_config_t dce_config = ESP_MODEM_DCE_DEFAULT_CONFIG("");
+    esp_netif_t netif{};
+    auto dce = create_generic_dce(&dce_config, dte, &netif);
+    sim->power_on();
+
+    // the rule fails the first two queries, the built-in reply takes over
+    int rssi = 0, ber = 0;
+    CHECK(dce->get_signal_quality(rssi, ber) == command_result::FAIL);
+    CHECK(dce->get_signal_quality(rssi, ber) == command_result::FAIL);
+    CHECK(dce->get_signal_quality(rssi, ber) == command_result::OK);
+    CHECK(rssi == 24);
+
+    // nothing gets through at a wrong baud rate
+    sim->set_host_baud(115200);
+    CHECK(dce->sync() == command_result::TIMEOUT);
+    sim->set_host_baud(921600);
+    CHECK(dce->sync() == command_result::OK);
+
+    // CMUX: commands on the command DLCI, PPP on the data DLCI
+    CHECK(dce->set_mode(modem_mode::CMUX_MODE) == true);
+    std::string out;
+    CHECK(dce->get_imsi(out) == command_result::OK);
+    CHECK(out == "460001234567890");
+    auto stats = sim->get_stats();
+    CHECK(stats.unanswered == 1);
+    sim->power_off();
+}
@@ -9,8 +9,21 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/catch_session.hpp>
 #include "cxx_include/esp_modem_api.hpp"
+#include "cxx_include/esp_modem_cmux.hpp"
+#include "cxx_include/esp_modem_netif.hpp"
+#include "esp_modem_config.h"
+#include "vfs_resource/vfs_create.hpp"
 #include "LoopbackTerm.h"
 #include <iostream>
+#include <chrono>
+#include <ctime>
+#include <cstring>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 
 using namespace esp_modem;
 
@@ -349,6 +362,315 @@ TEST_CASE("CMUX manual mode transitions", "[esp_modem][transitions]")
 
 }
 
+/**
+ * Builds `count` CMUX UIH frames for the given DLCI, each carrying `payload`
+ */
+static std::vector<uint8_t> cmux_frames(uint8_t dlci, const std::vector<uint8_t> &payload, size_t count)
+{
+    std::vector<uint8_t> stream;
+    for (size_t n = 0; n < count; ++n) {
+        uint8_t header[] = { 0xf9, static_cast<uint8_t>((dlci << 2) | 0x01), 0xef, static_cast<uint8_t>((payload.size() << 1) | 0x01) };
+        uint8_t fcs = 0xff;     // bitwise reference FCS over address, control and length
+        for (int i = 1; i < 4; ++i) {
+            fcs ^= header[i];
+            for (int j = 0; j < 8; ++j) {
+                fcs = (fcs & 0x01) ? (fcs >> 1) ^ 0xe0 : (fcs >> 1);
+            }
+        }
+        stream.insert(stream.end(), header, header + sizeof(header));
+        stream.insert(stream.end(), payload.begin(), payload.end());
+        stream.push_back(0xff - fcs);
+        stream.push_back(0xf9);
+    }
+    return stream;
+}
+
+TEST_CASE("CMUX throughput", "[esp_modem][cmux][benchmark]")
+{
+    auto term = std::make_shared<LoopbackTerm>();
+    auto loopback = term.get();
+    auto cmux = std::make_shared<CMux>(term, unique_buffer(1024));
+    REQUIRE(cmux->init());
+
+    const std::string at_reply = "\r\n+CSQ: 21,99\r\n\r\nOK\r\n";
+    struct {
+        const char *name;
+        int term;
+        std::vector<uint8_t> payload;
+    } channels[] = {
+        { "data", 0, std::vector<uint8_t>(127, 0x7e) },
+        { "AT", 1, std::vector<uint8_t>(at_reply.begin(), at_reply.end()) },
+    };
+    const size_t frames = 2000;
+    const size_t rounds = 10;
+
+    for (auto &ch : channels) {
+        size_t received = 0;
+        cmux->set_read_cb(ch.term, [&](uint8_t *data, size_t len) {
+            received += len;
+            return false;
+        });
+        auto stream = cmux_frames(ch.term + 1, ch.payload, frames);
+        // whole reads, then reads splitting headers, payloads and footers
+        for (size_t feed_by : { static_cast<size_t>(512), static_cast<size_t>(61), static_cast<size_t>(5) }) {
+            received = 0;
+            auto cpu = std::clock();
+            auto start = std::chrono::steady_clock::now();
+            for (size_t r = 0; r < rounds; ++r) {
+                loopback->feed(&stream[0], stream.size(), feed_by);
+            }
+            std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+            double cpu_us = 1e6 * (std::clock() - cpu) / CLOCKS_PER_SEC;
+            CHECK(received == rounds * frames * ch.payload.size());
+            std::cout << "CMUX rx " << ch.name << " (reads of " << feed_by << "B): "
+                      << (rounds * stream.size()) / wall.count() / 1e6 << " MB/s, "
+                      << cpu_us / (rounds * frames) << " us CPU/frame" << std::endl;
+        }
+        cmux->set_read_cb(ch.term, nullptr);
+
+        // transmit: payloads are framed and passed to the terminal by reference
+        std::vector<uint8_t> tx(ch.term == 0 ? 1500 : ch.payload.size(), 0x7e);
+        loopback->set_sink(true);
+        auto cpu = std::clock();
+        auto start = std::chrono::steady_clock::now();
+        for (size_t n = 0; n < frames; ++n) {
+            CHECK(cmux->write(ch.term, &tx[0], tx.size()) == static_cast<int>(tx.size()));
+        }
+        std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+        double cpu_us = 1e6 * (std::clock() - cpu) / CLOCKS_PER_SEC;
+        size_t tx_frames = frames * ((tx.size() + 126) / 127);
+        CHECK(loopback->sink_bytes() == frames * tx.size() + tx_frames * 6);
+        std::cout << "CMUX tx " << ch.name << ": " << loopback->sink_bytes() / wall.count() / 1e6 << " MB/s, "
+                  << cpu_us / tx_frames << " us CPU/frame, "
+                  << static_cast<double>(loopback->sink_calls()) / tx_frames << " terminal writes/frame" << std::endl;
+        loopback->set_sink(false);
+    }
+}
+
+TEST_CASE("DTE receive line buffer", "[esp_modem][dte]")
+{
+    line_buffer rx(32);
+    auto append = [&](const std::string & str) {
+        auto space = rx.reserve(str.size());
+        if (space == nullptr) {
+            return false;
+        }
+        memcpy(space, str.data(), str.size());
+        rx.commit(str.size());
+        return true;
+    };
+
+    SECTION("Lines are tracked incrementally") {
+        CHECK(append("+CREG: 1"));
+        CHECK(rx.scan('\n') == false);
+        CHECK(append("\r\n\r\nOK"));
+        CHECK(rx.scan('\n') == true);
+        CHECK(rx.lines() == 2);
+        CHECK(rx.scan('\n') == false);      // nothing new to scan
+        CHECK(append("\r\n"));
+        CHECK(rx.scan('\n') == true);
+        CHECK(rx.lines() == 3);
+        CHECK(std::string((char *)rx.begin(), rx.size()) == "+CREG: 1\r\n\r\nOK\r\n");
+        CHECK(rx.scan('>') == false);       // another separator starts over
+        CHECK(rx.lines() == 0);
+    }
+
+    SECTION("Oldest lines are dropped and the space reused") {
+        CHECK(append("0123456789\n"));
+        CHECK(append("abcdefghij\n"));
+        CHECK(append("ABCDEF"));
+        rx.scan('\n');
+        CHECK(rx.free() == 4);
+        CHECK(rx.reserve(8) == nullptr);
+        CHECK(rx.drop_lines(8) == 11);
+        CHECK(rx.lines() == 1);
+        CHECK(append("GHIJKLMN"));          // wraps around, unread data stay contiguous
+        CHECK(std::string((char *)rx.begin(), rx.size()) == "abcdefghij\nABCDEFGHIJKLMN");
+        CHECK(rx.scan('\n') == false);
+        CHECK(rx.drop_lines(rx.capacity) == 11);
+        CHECK(rx.drop_lines(rx.capacity) == 0); // partial lines are kept
+        CHECK(std::string((char *)rx.begin(), rx.size()) == "ABCDEFGHIJKLMN");
+        CHECK(rx.dropped == 22);
+        rx.clear();
+        CHECK(rx.free() == rx.capacity);
+    }
+}
+
+static std::string urc_lines(size_t count)
+{
+    std::string urcs;
+    for (size_t i = 0; i < count; ++i) {
+        urcs += "\r\n+CREG: 1,\"1A2B\",\"01C3D4E5\",7\r\n";
+    }
+    return urcs;
+}
+
+TEST_CASE("DTE URC heavy replies", "[esp_modem][dte]")
+{
+    auto term = std::make_unique<LoopbackTerm>();
+    auto loopback = term.get();
+    auto dte = std::make_unique<DTE>(std::move(term));
+    CHECK(dte->set_mode(esp_modem::modem_mode::COMMAND_MODE) == true);
+
+    std::string csq;
+    auto got_csq = [&](uint8_t *data, size_t len) {
+        std::string_view response((char *)data, len);
+        if (response.find("\r\nOK\r\n") == std::string_view::npos) {
+            return command_result::TIMEOUT;
+        }
+        auto pos = response.find("+CSQ: ");
+        if (pos == std::string_view::npos) {
+            return command_result::FAIL;
+        }
+        csq = response.substr(pos, response.find('\r', pos) - pos);
+        return command_result::OK;
+    };
+
+    // replies fragmented by the terminal reads and by the posted (CMUX) payloads
+    std::string reply = urc_lines(20) + "\r\n+CSQ: 21,99\r\n\r\nOK\r\n";
+    for (bool post : { false, true }) {
+        loopback->set_post_data(post);
+        for (size_t inject_by : { static_cast<size_t>(1), static_cast<size_t>(7), static_cast<size_t>(64), reply.size() }) {
+            csq.clear();
+            loopback->inject((uint8_t *)&reply[0], reply.size(), inject_by, 0, 0);
+            CHECK(dte->command("AT+CSQ\r", got_csq, 1000) == command_result::OK);
+            CHECK(csq == "+CSQ: 21,99");
+        }
+    }
+
+    // replies longer than the receive buffer, posted: a fragment which doesn't fit is processed on its own
+    // and the next ones are collected again, a fragment longer than the buffer is processed in place
+    loopback->set_post_data(true);
+    std::string long_reply = urc_lines(80) + "\r\n+CSQ: 21,99\r\n\r\nOK\r\n";
+    for (size_t inject_by : { static_cast<size_t>(64), long_reply.size() }) {
+        csq.clear();
+        loopback->inject((uint8_t *)&long_reply[0], long_reply.size(), inject_by, 0, 0);
+        CHECK(dte->command("AT+CSQ\r", got_csq, 1000) == command_result::OK);
+        CHECK(csq == "+CSQ: 21,99");
+    }
+    loopback->inject(nullptr, 0, 0);
+    loopback->set_post_data(false);
+}
+
+TEST_CASE("DTE receive throughput", "[esp_modem][dte][benchmark]")
+{
+    auto term = std::make_unique<LoopbackTerm>();
+    auto loopback = term.get();
+    auto dte = std::make_unique<DTE>(std::move(term));
+    CHECK(dte->set_mode(esp_modem::modem_mode::COMMAND_MODE) == true);
+
+    size_t calls = 0;
+    auto got_ok = [&](uint8_t *data, size_t len) {
+        ++calls;
+        std::string_view response((char *)data, len);
+        return response.find("\r\nOK\r\n") != std::string_view::npos ? command_result::OK : command_result::TIMEOUT;
+    };
+    const std::string reply = urc_lines(27) + "\r\n+CSQ: 21,99\r\n\r\nOK\r\n";
+    const size_t commands = 500;
+
+    for (bool post : { false, true }) {
+        loopback->set_post_data(post);
+        for (size_t inject_by : { static_cast<size_t>(16), static_cast<size_t>(128) }) {
+            calls = 0;
+            auto cpu = std::clock();
+            auto start = std::chrono::steady_clock::now();
+            for (size_t n = 0; n < commands; ++n) {
+                loopback->inject((uint8_t *)&reply[0], reply.size(), inject_by, 0, 0);
+                CHECK(dte->command("AT+CSQ\r", got_ok, 1000) == command_result::OK);
+            }
+            std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+            double cpu_us = 1e6 * (std::clock() - cpu) / CLOCKS_PER_SEC;
+            std::cout << "DTE rx " << (post ? "posted" : "read") << " (by " << inject_by << "B): "
+                      << (commands * reply.size()) / wall.count() / 1e6 << " MB/s, "
+                      << cpu_us / commands << " us CPU/reply, "
+                      << static_cast<double>(calls) / commands << " line callbacks/reply" << std::endl;
+        }
+    }
+    loopback->inject(nullptr, 0, 0);
+    loopback->set_post_data(false);
+}
+
+TEST_CASE("PPP data path over pty", "[esp_modem][netif][benchmark]")
+{
+    // the pty master plays the modem, the DTE opens the slave as a VFS UART
+    int modem = posix_openpt(O_RDWR | O_NOCTTY);
+    REQUIRE(modem >= 0);
+    REQUIRE(grantpt(modem) == 0);
+    REQUIRE(unlockpt(modem) == 0);
+    esp_modem_vfs_uart_creator uart_config = { .dev_name = ptsname(modem), .uart = {} };
+    esp_modem_dte_config_t dte_config = {
+        .dte_buffer_size = 512,
+        .task_stack_size = 4096,
+        .task_priority = 5,
+        .vfs_config = {}
+    };
+    REQUIRE(vfs_create_uart(&uart_config, &dte_config.vfs_config) == true);
+    auto dte = create_vfs_dte(&dte_config);
+    REQUIRE(dte != nullptr);
+    CHECK(dte->set_mode(esp_modem::modem_mode::DATA_MODE) == true);
+    esp_netif_t netif{};
+    Netif ppp(dte, &netif);
+    ppp.start();
+
+    // receive: the DTE reads until the terminal drains and passes its buffer in place
+    // (the same read callback Netif::start() sets, counting instead of decoding PPP)
+    const size_t total = 8 * 1024 * 1024;
+    std::atomic<size_t> received{0};
+    std::atomic<size_t> callbacks{0};
+    dte->set_read_cb([&](uint8_t *data, size_t len) {
+        received += len;
+        callbacks++;
+        return true;
+    });
+    std::vector<uint8_t> chunk(4096, 0x7e);
+    auto cpu = std::clock();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t sent = 0; sent < total;) {
+        auto len = ::write(modem, &chunk[0], std::min(chunk.size(), total - sent));
+        REQUIRE(len > 0);
+        sent += len;
+    }
+    while (received < total && std::chrono::steady_clock::now() - start < std::chrono::seconds(10)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+    double cpu_ms = 1e3 * (std::clock() - cpu) / CLOCKS_PER_SEC;
+    CHECK(received == total);
+    std::cout << "PPP rx over pty: " << total / wall.count() / 1e6 << " MB/s, "
+              << cpu_ms << " ms CPU, " << static_cast<double>(received) / callbacks << " bytes/callback" << std::endl;
+
+    // transmit: PPP frames go from the netif transmit hook straight to the terminal
+    std::vector<uint8_t> frame(1502, 0x21);
+    const size_t frames = 4000;
+    size_t drained = 0;
+    std::thread reader([&]() {
+        std::vector<uint8_t> buf(4096);
+        struct pollfd pfd = { .fd = modem, .events = POLLIN, .revents = 0 };
+        while (drained < frames * frame.size() && poll(&pfd, 1, 1000) > 0) {
+            auto len = ::read(modem, &buf[0], buf.size());
+            if (len <= 0) {
+                break;
+            }
+            drained += len;
+        }
+    });
+    cpu = std::clock();
+    start = std::chrono::steady_clock::now();
+    for (size_t n = 0; n < frames; ++n) {
+        netif.transmit(netif.ctx, &frame[0], frame.size());
+    }
+    reader.join();
+    wall = std::chrono::steady_clock::now() - start;
+    cpu_ms = 1e3 * (std::clock() - cpu) / CLOCKS_PER_SEC;
+    CHECK(drained == frames * frame.size());
+    std::cout << "PPP tx over pty: " << drained / wall.count() / 1e6 << " MB/s, "
+              << cpu_ms << " ms CPU" << std::endl;
+
+    ppp.stop();
+    dte->set_read_cb(nullptr);
+    close(modem);
+}
+
 #define CATCH_CONFIG_RUNNER
 extern "C" int app_main(void)
 {
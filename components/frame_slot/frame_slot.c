@@ -0,0 +1,161 @@
+/**
+ * Latest-frame slot
+ *
+ * Hands the newest camera frame from a producer that must never wait to any
+ * number of consumers. Frames are reference counted and go back to the
+ * producer once they are neither the latest frame nor held by a consumer.
+ * Nothing takes a lock, so a consumer preempted anywhere cannot hold up the
+ * usb_stream task: the producer claims a free entry with a compare-exchange,
+ * swaps it in as the latest and drops the previous latest's reference.
+ * Consumers only add a reference to an entry that is not free, and retry if
+ * it was freed after they read the latest index.
+ */
+#include <string.h>
+#include "frame_slot.h"
+
+#define SLOT_CLAIMED 0x80000000u  // refs of an entry the producer is filling
+
+/**
+ * Drop one reference to an entry, release its frame with the last one
+ * The frame is read while the reference still pins it: a free entry can be
+ * refilled at once.
+ */
+static void slot_entry_unref(frameSlot_t *fs, frameSlotEntry_t *e)
+{
+    void *frame = atomic_load_explicit(&e->frame, memory_order_relaxed);
+
+    if (atomic_fetch_sub_explicit(&e->refs, 1, memory_order_acq_rel) == 1) {
+        fs->release(frame, fs->arg);
+    }
+}
+
+/**
+ * Take a reference to an entry unless it is free or being filled
+ */
+static bool slot_entry_ref(frameSlotEntry_t *e)
+{
+    unsigned int refs = atomic_load_explicit(&e->refs, memory_order_relaxed);
+
+    do {
+        if (refs == 0 || (refs & SLOT_CLAIMED)) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&e->refs, &refs, refs + 1,
+                                                    memory_order_acquire, memory_order_relaxed));
+    return true;
+}
+
+void frame_slot_init(frameSlot_t *fs, frame_slot_release_t release, void *arg)
+{
+    memset(fs, 0, sizeof(frameSlot_t));
+    for (int i = 0; i < FRAME_SLOT_NUM; i++) {
+        atomic_init(&fs->entry[i].frame, NULL);
+        atomic_init(&fs->entry[i].refs, 0);
+        atomic_init(&fs->entry[i].seq, 0);
+        atomic_init(&fs->entry[i].taken, false);
+    }
+    atomic_init(&fs->latest, -1);
+    atomic_init(&fs->seq, 0);
+    atomic_init(&fs->published, 0);
+    atomic_init(&fs->overwritten, 0);
+    atomic_init(&fs->dropped, 0);
+    atomic_init(&fs->taken, 0);
+    fs->release = release;
+    fs->arg = arg;
+}
+
+bool frame_slot_publish(frameSlot_t *fs, void *frame)
+{
+    frameSlotEntry_t *e = NULL;
+    int i;
+
+    for (i = 0; i < FRAME_SLOT_NUM; i++) {
+        unsigned int free_refs = 0;
+        if (atomic_compare_exchange_strong_explicit(&fs->entry[i].refs, &free_refs, SLOT_CLAIMED,
+                                                    memory_order_acquire, memory_order_relaxed)) {
+            e = &fs->entry[i];
+            break;
+        }
+    }
+    if (e == NULL) {
+        atomic_fetch_add_explicit(&fs->dropped, 1, memory_order_relaxed);
+        fs->release(frame, fs->arg);
+        return false;
+    }
+    atomic_store_explicit(&e->frame, frame, memory_order_relaxed);
+    atomic_store_explicit(&e->seq, atomic_fetch_add_explicit(&fs->seq, 1, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    atomic_store_explicit(&e->taken, false, memory_order_relaxed);
+    // the reference of the latest frame, consumers see the entry filled from here on
+    atomic_store_explicit(&e->refs, 1, memory_order_release);
+    atomic_fetch_add_explicit(&fs->published, 1, memory_order_relaxed);
+
+    int prev = atomic_exchange_explicit(&fs->latest, i, memory_order_acq_rel);
+    if (prev >= 0) {
+        if (!atomic_load_explicit(&fs->entry[prev].taken, memory_order_relaxed)) {
+            atomic_fetch_add_explicit(&fs->overwritten, 1, memory_order_relaxed);
+        }
+        slot_entry_unref(fs, &fs->entry[prev]);
+    }
+    return true;
+}
+
+void *frame_slot_get(frameSlot_t *fs, uint32_t *seq)
+{
+    for (;;) {
+        int i = atomic_load_explicit(&fs->latest, memory_order_acquire);
+        if (i < 0) {
+            return NULL;
+        }
+        frameSlotEntry_t *e = &fs->entry[i];
+        // freed and maybe refilled since latest was read: look again
+        if (!slot_entry_ref(e)) {
+            continue;
+        }
+        uint32_t eseq = atomic_load_explicit(&e->seq, memory_order_relaxed);
+        if (eseq <= *seq) {
+            slot_entry_unref(fs, e);
+            return NULL;
+        }
+        atomic_store_explicit(&e->taken, true, memory_order_relaxed);
+        atomic_fetch_add_explicit(&fs->taken, 1, memory_order_relaxed);
+        *seq = eseq;
+        return atomic_load_explicit(&e->frame, memory_order_relaxed);
+    }
+}
+
+void frame_slot_put(frameSlot_t *fs, void *frame)
+{
+    for (int i = 0; i < FRAME_SLOT_NUM; i++) {
+        frameSlotEntry_t *e = &fs->entry[i];
+        unsigned int refs = atomic_load_explicit(&e->refs, memory_order_relaxed);
+        // the caller's reference pins the entry, a free one may still name the frame
+        if (refs == 0 || (refs & SLOT_CLAIMED) || atomic_load_explicit(&e->frame, memory_order_relaxed) != frame) {
+            continue;
+        }
+        slot_entry_unref(fs, e);
+        break;
+    }
+}
+
+uint32_t frame_slot_seq(frameSlot_t *fs)
+{
+    return atomic_load_explicit(&fs->seq, memory_order_relaxed);
+}
+
+void frame_slot_flush(frameSlot_t *fs)
+{
+    int prev = atomic_exchange_explicit(&fs->latest, -1, memory_order_acq_rel);
+
+    if (prev >= 0) {
+        slot_entry_unref(fs, &fs->entry[prev]);
+    }
+}
+
+void frame_slot_stats(frameSlot_t *fs, frameSlotStats_t *stats)
+{
+    stats->published = atomic_load_explicit(&fs->published, memory_order_relaxed);
+    stats->overwritten = atomic_load_explicit(&fs->overwritten, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&fs->dropped, memory_order_relaxed);
+    stats->taken = atomic_load_explicit(&fs->taken, memory_order_relaxed);
+}
@@ -0,0 +1,115 @@
+#ifndef __FRAME_SLOT_H__
+#define __FRAME_SLOT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Frames tracked at once: the latest, one being published and two held by
+ * consumers. The slot takes no lock: the latest entry is swapped with an
+ * atomic exchange and every entry has an atomic reference count, the latest
+ * frame holding one of its own.
+ */
+#define FRAME_SLOT_NUM 4
+
+/**
+ * Gives a frame back to the producer
+ * @param frame Frame no longer referenced
+ * @param arg User argument given to frame_slot_init()
+ */
+typedef void (*frame_slot_release_t)(void *frame, void *arg);
+
+/**
+ * Slot counters
+ */
+typedef struct frameSlotStats {
+    uint32_t published;    ///< Frames published
+    uint32_t overwritten;  ///< Frames replaced before any consumer took them
+    uint32_t dropped;      ///< Frames refused, every entry held by consumers
+    uint32_t taken;        ///< Snapshots taken by consumers
+} frameSlotStats_t;
+
+typedef struct frameSlotEntry {
+    _Atomic(void *) frame;     ///< Frame, stale once refs drops to 0
+    atomic_uint refs;          ///< References, 0 when free, a claim bit while being filled
+    atomic_uint seq;           ///< Publish sequence number, from 1
+    atomic_bool taken;         ///< Taken by a consumer at least once
+} frameSlotEntry_t;
+
+/**
+ * Latest-frame slot, frames are opaque pointers owned by the producer.
+ * One task publishes, any number of tasks get, put and flush.
+ */
+typedef struct frameSlot {
+    frameSlotEntry_t entry[FRAME_SLOT_NUM];
+    atomic_int latest;              ///< Entry of the latest frame, -1 if none
+    atomic_uint seq;                ///< Sequence number of the last published frame
+    frame_slot_release_t release;
+    void *arg;
+    atomic_uint published;          ///< Counters, see frameSlotStats_t
+    atomic_uint overwritten;
+    atomic_uint dropped;
+    atomic_uint taken;
+} frameSlot_t;
+
+/**
+ * Initialize an empty slot
+ * @param fs Slot
+ * @param release Called by whichever call drops the last reference to a frame
+ * @param arg User argument of release
+ */
+void frame_slot_init(frameSlot_t *fs, frame_slot_release_t release, void *arg);
+
+/**
+ * Publish a frame as the latest one, never blocks
+ * @param fs Slot
+ * @param frame Frame, owned by the slot until released
+ * @return false if the frame was refused and released right away
+ */
+bool frame_slot_publish(frameSlot_t *fs, void *frame);
+
+/**
+ * Take a reference to the latest frame if it is newer than *seq
+ * @param fs Slot
+ * @param seq In: sequence number already seen (0 for any). Out: sequence number of the frame returned
+ * @return Frame, to be given back with frame_slot_put(), or NULL if there is no newer frame
+ */
+void *frame_slot_get(frameSlot_t *fs, uint32_t *seq);
+
+/**
+ * Drop a reference taken with frame_slot_get()
+ * @param fs Slot
+ * @param frame Frame returned by frame_slot_get()
+ */
+void frame_slot_put(frameSlot_t *fs, void *frame);
+
+/**
+ * Sequence number of the last published frame
+ * @param fs Slot
+ */
+uint32_t frame_slot_seq(frameSlot_t *fs);
+
+/**
+ * Release the latest frame if no consumer holds it, e.g. when the stream stops
+ * @param fs Slot
+ */
+void frame_slot_flush(frameSlot_t *fs);
+
+/**
+ * Copy the counters. A frame a consumer takes at the moment it is replaced may
+ * also count as overwritten.
+ * @param fs Slot
+ * @param stats Output
+ */
+void frame_slot_stats(frameSlot_t *fs, frameSlotStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FRAME_SLOT_H__ */
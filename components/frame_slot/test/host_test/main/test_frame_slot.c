@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "unity.h"
+#include "frame_slot.h"
+
+/** Frame buffers of the synthetic camera */
+#define FB_COUNT 3
+/** Run time of the producer thread test */
+#define RUN_MS 1000
+/** Frame period of the producer, about 5000 fps so that consumers fall behind */
+#define FRAME_US 200
+
+typedef struct testFrame {
+    uint32_t seq;               ///< Producer sequence number, written before publishing
+    atomic_int owner;           ///< 0 producer, 1 slot
+    atomic_int readers;         ///< Consumers reading it now
+} testFrame_t;
+
+static testFrame_t s_fb[FB_COUNT];
+static frameSlot_t s_slot;
+static atomic_int s_errors;
+static atomic_int s_released;
+
+static void frame_release(void *frame, void *arg)
+{
+    testFrame_t *f = frame;
+    if (atomic_load(&f->owner) != 1 || atomic_load(&f->readers) != 0) {
+        atomic_fetch_add(&s_errors, 1);
+    }
+    atomic_store(&f->owner, 0);
+    atomic_fetch_add(&s_released, 1);
+}
+
+static void frames_reset(void)
+{
+    memset(s_fb, 0, sizeof(s_fb));
+    atomic_store(&s_errors, 0);
+    atomic_store(&s_released, 0);
+    frame_slot_init(&s_slot, frame_release, NULL);
+}
+
+static testFrame_t *frame_fill(int i)
+{
+    atomic_store(&s_fb[i].owner, 1);
+    return &s_fb[i];
+}
+
+static void test_latest_frame_replaces_previous(void)
+{
+    frameSlotStats_t st;
+    uint32_t seq = 0;
+    frames_reset();
+
+    TEST_ASSERT_NULL(frame_slot_get(&s_slot, &seq));
+    TEST_ASSERT_TRUE(frame_slot_publish(&s_slot, frame_fill(0)));
+    TEST_ASSERT_TRUE(frame_slot_publish(&s_slot, frame_fill(1)));
+    // nobody took frame 0, it went back to the producer
+    TEST_ASSERT_EQUAL_INT(0, atomic_load(&s_fb[0].owner));
+
+    TEST_ASSERT_EQUAL_PTR(&s_fb[1], frame_slot_get(&s_slot, &seq));
+    TEST_ASSERT_EQUAL_UINT32(2, seq);
+    // nothing newer than what this consumer has seen
+    TEST_ASSERT_NULL(frame_slot_get(&s_slot, &seq));
+    frame_slot_put(&s_slot, &s_fb[1]);
+    TEST_ASSERT_EQUAL_INT(1, atomic_load(&s_fb[1].owner));
+
+    frame_slot_flush(&s_slot);
+    TEST_ASSERT_EQUAL_INT(0, atomic_load(&s_fb[1].owner));
+    frame_slot_stats(&s_slot, &st);
+    TEST_ASSERT_EQUAL_UINT32(2, st.published);
+    TEST_ASSERT_EQUAL_UINT32(1, st.overwritten);
+    TEST_ASSERT_EQUAL_UINT32(1, st.taken);
+    TEST_ASSERT_EQUAL_INT(0, atomic_load(&s_errors));
+}
+
+static void test_held_frame_outlives_publish(void)
+{
+    uint32_t seq1 = 0, seq2 = 0;
+    frames_reset();
+
+    frame_slot_publish(&s_slot, frame_fill(0));
+    TEST_ASSERT_EQUAL_PTR(&s_fb[0], frame_slot_get(&s_slot, &seq1));
+    TEST_ASSERT_EQUAL_PTR(&s_fb[0], frame_slot_get(&s_slot, &seq2));
+    frame_slot_publish(&s_slot, frame_fill(1));
+    // two references left, the frame stays out of the producer's hands
+    frame_slot_put(&s_slot, &s_fb[0]);
+    TEST_ASSERT_EQUAL_INT(1, atomic_load(&s_fb[0].owner));
+    frame_slot_put(&s_slot, &s_fb[0]);
+    TEST_ASSERT_EQUAL_INT(0, atomic_load(&s_fb[0].owner));
+    TEST_ASSERT_EQUAL_INT(1, atomic_load(&s_fb[1].owner));
+    TEST_ASSERT_EQUAL_INT(1, atomic_load(&s_released));
+}
+
+static void test_drop_when_every_entry_held(void)
+{
+    static testFrame_t extra[FRAME_SLOT_NUM + 1];
+    frameSlotStats_t st;
+    frames_reset();
+    memset(extra, 0, sizeof(extra));
+
+    for (int i = 0; i < FRAME_SLOT_NUM; i++) {
+        uint32_t seq = 0;
+        atomic_store(&extra[i].owner, 1);
+        TEST_ASSERT_TRUE(frame_slot_publish(&s_slot, &extra[i]));
+        TEST_ASSERT_EQUAL_PTR(&extra[i], frame_slot_get(&s_slot, &seq));
+    }
+    // the producer is not blocked, the frame comes straight back
+    atomic_store(&extra[FRAME_SLOT_NUM].owner, 1);
+    TEST_ASSERT_FALSE(frame_slot_publish(&s_slot, &extra[FRAME_SLOT_NUM]));
+    TEST_ASSERT_EQUAL_INT(0, atomic_load(&extra[FRAME_SLOT_NUM].owner));
+    frame_slot_stats(&s_slot, &st);
+    TEST_ASSERT_EQUAL_UINT32(1, st.dropped);
+
+    for (int i = 0; i < FRAME_SLOT_NUM; i++) {
+        frame_slot_put(&s_slot, &extra[i]);
+    }
+    frame_slot_flush(&s_slot);
+    for (int i = 0; i <= FRAME_SLOT_NUM; i++) {
+        TEST_ASSERT_EQUAL_INT(0, atomic_load(&extra[i].owner));
+    }
+}
+
+static atomic_int s_run;
+static long s_produced;
+static long s_noBuffer;
+
+static void *producer_task(void *arg)
+{
+    uint32_t seq = 0;
+    while (atomic_load(&s_run)) {
+        testFrame_t *f = NULL;
+        for (int i = 0; i < FB_COUNT; i++) {
+            if (atomic_load(&s_fb[i].owner) == 0) {
+                f = &s_fb[i];
+                break;
+            }
+        }
+        if (f == NULL) {
+            // the camera driver would drop this frame
+            s_noBuffer++;
+            usleep(FRAME_US / 2);
+            continue;
+        }
+        f->seq = ++seq;
+        atomic_store(&f->owner, 1);
+        frame_slot_publish(&s_slot, f);
+        s_produced++;
+        usleep(FRAME_US);
+    }
+    return NULL;
+}
+
+typedef struct consumer {
+    int workUs;                 ///< Time spent on each frame
+    long frames;
+} consumer_t;
+
+static void *consumer_task(void *arg)
+{
+    consumer_t *c = arg;
+    uint32_t seen = 0;
+    uint32_t last = 0;
+    while (atomic_load(&s_run)) {
+        testFrame_t *f = frame_slot_get(&s_slot, &seen);
+        if (f == NULL) {
+            usleep(50);
+            continue;
+        }
+        atomic_fetch_add(&f->readers, 1);
+        uint32_t seq = f->seq;
+        if (atomic_load(&f->owner) != 1 || seq <= last) {
+            atomic_fetch_add(&s_errors, 1);
+        }
+        last = seq;
+        usleep(c->workUs);
+        // the producer must not have refilled the buffer under us
+        if (f->seq != seq) {
+            atomic_fetch_add(&s_errors, 1);
+        }
+        atomic_fetch_sub(&f->readers, 1);
+        frame_slot_put(&s_slot, f);
+        c->frames++;
+    }
+    return NULL;
+}
+
+static void test_producer_thread(void)
+{
+    consumer_t fast = { .workUs = 0 };
+    consumer_t slow = { .workUs = 3000 };
+    pthread_t producer, c1, c2;
+    frameSlotStats_t st;
+    frames_reset();
+    s_produced = 0;
+    s_noBuffer = 0;
+
+    atomic_store(&s_run, 1);
+    pthread_create(&producer, NULL, producer_task, NULL);
+    pthread_create(&c1, NULL, consumer_task, &fast);
+    pthread_create(&c2, NULL, consumer_task, &slow);
+    usleep(RUN_MS * 1000);
+    atomic_store(&s_run, 0);
+    pthread_join(producer, NULL);
+    pthread_join(c1, NULL);
+    pthread_join(c2, NULL);
+    frame_slot_flush(&s_slot);
+
+    frame_slot_stats(&s_slot, &st);
+    printf("produced %ld, no free buffer %ld, published %u, overwritten %u, dropped %u, taken %u\n",
+           s_produced, s_noBuffer, st.published, st.overwritten, st.dropped, st.taken);
+    printf("fast consumer %ld frames, slow consumer %ld frames\n", fast.frames, slow.frames);
+
+    TEST_ASSERT_EQUAL_INT(0, atomic_load(&s_errors));
+    for (int i = 0; i < FB_COUNT; i++) {
+        TEST_ASSERT_EQUAL_INT(0, atomic_load(&s_fb[i].owner));
+    }
+    TEST_ASSERT_EQUAL_UINT32(s_produced, st.published + st.dropped);
+    TEST_ASSERT_EQUAL_INT(s_produced, atomic_load(&s_released));
+    TEST_ASSERT_GREATER_THAN(0, slow.frames);
+    // the slow consumer only ever holds one buffer, the producer keeps going
+    TEST_ASSERT_GREATER_THAN(slow.frames * 4, s_produced);
+}
+
+void app_main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_latest_frame_replaces_previous);
+    RUN_TEST(test_held_frame_outlives_publish);
+    RUN_TEST(test_drop_when_every_entry_held);
+    RUN_TEST(test_producer_thread);
+    UNITY_END();
+}
@@ -29,6 +29,10 @@
 /** Invalid key token */
 #define DICT_INVALID_KEY    ((char*)-1)
 
+/** Hash index cell states */
+#define DICT_INDEX_EMPTY    0
+#define DICT_INDEX_DELETED  (-1)
+
 /*---------------------------------------------------------------------------
                             Private functions
  ---------------------------------------------------------------------------*/
@@ -58,6 +62,83 @@ static char * xstrdup(const char * s)
     return t ;
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Rebuild the hash index for the current storage size
+  @param    d Dictionary to index
+  @return   This function returns non-zero in case of failure
+
+  The index holds at least twice as many cells as storage slots so the
+  load factor stays below one half. Deleted cells are dropped.
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_reindex(dictionary * d)
+{
+    ssize_t  * new_index ;
+    size_t     new_size ;
+    size_t     mask ;
+    size_t     pos ;
+    ssize_t    i ;
+
+    for (new_size = 1 ; new_size < (size_t)d->size * 2 ; new_size <<= 1)
+        ;
+    new_index = (ssize_t*) calloc(new_size, sizeof *new_index);
+    if (!new_index)
+        return -1 ;
+
+    mask = new_size - 1 ;
+    d->index_used = 0 ;
+    for (i=0 ; i<d->size ; i++) {
+        if (d->key[i]==NULL)
+            continue ;
+        for (pos = d->hash[i] & mask ; new_index[pos] != DICT_INDEX_EMPTY ; pos = (pos + 1) & mask)
+            ;
+        new_index[pos] = i + 1 ;
+        d->index_used++ ;
+    }
+    free(d->index);
+    d->index = new_index ;
+    d->index_size = new_size ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the index cell of a key
+  @param    d    Dictionary to search
+  @param    key  Key to look for
+  @param    hash Hash of the key
+  @param    pos  Set to the matching cell, or to the cell to insert into
+  @return   Storage slot of the key, -1 if not found
+ */
+/*--------------------------------------------------------------------------*/
+static ssize_t dictionary_lookup(const dictionary * d, const char * key,
+                                 unsigned hash, size_t * pos)
+{
+    size_t   mask = d->index_size - 1 ;
+    size_t   p ;
+    size_t   first_free = d->index_size ;
+    ssize_t  slot ;
+
+    for (p = hash & mask ; d->index[p] != DICT_INDEX_EMPTY ; p = (p + 1) & mask) {
+        if (d->index[p] == DICT_INDEX_DELETED) {
+            if (first_free == d->index_size)
+                first_free = p ;
+            continue ;
+        }
+        slot = d->index[p] - 1 ;
+        /* Compare hash, then string to avoid hash collisions */
+        if (hash==d->hash[slot] && !strcmp(key, d->key[slot])) {
+            if (pos)
+                *pos = p ;
+            return slot ;
+        }
+    }
+    if (pos)
+        *pos = (first_free != d->index_size) ? first_free : p ;
+    return -1 ;
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Double the size of the dictionary
@@ -97,7 +178,7 @@ static int dictionary_grow(dictionary * d)
     d->val = new_val;
     d->key = new_key;
     d->hash = new_hash;
-    return 0 ;
+    return dictionary_reindex(d) ;
 }
 
 /*---------------------------------------------------------------------------
@@ -161,6 +242,13 @@ dictionary * dictionary_new(size_t size)
         d->val  = (char**) calloc(size, sizeof *d->val);
         d->key  = (char**) calloc(size, sizeof *d->key);
         d->hash = (unsigned*) calloc(size, sizeof *d->hash);
+        if (!d->val || !d->key || !d->hash || dictionary_reindex(d) != 0) {
+            free(d->val);
+            free(d->key);
+            free(d->hash);
+            free(d);
+            return NULL ;
+        }
     }
     return d ;
 }
@@ -188,6 +276,7 @@ void dictionary_del(dictionary * d)
     free(d->val);
     free(d->key);
     free(d->hash);
+    free(d->index);
     free(d);
     return ;
 }
@@ -208,22 +297,10 @@ void dictionary_del(dictionary * d)
 /*--------------------------------------------------------------------------*/
 const char * dictionary_get(const dictionary * d, const char * key, const char * def)
 {
-    unsigned    hash ;
     ssize_t      i ;
 
-    hash = dictionary_hash(key);
-    for (i=0 ; i<d->size ; i++) {
-        if (d->key[i]==NULL)
-            continue ;
-        /* Compare hash */
-        if (hash==d->hash[i]) {
-            /* Compare string, to avoid hash collisions */
-            if (!strcmp(key, d->key[i])) {
-                return d->val[i] ;
-            }
-        }
-    }
-    return def ;
+    i = dictionary_lookup(d, key, dictionary_hash(key), NULL);
+    return (i < 0) ? def : d->val[i] ;
 }
 
 /*-------------------------------------------------------------------------*/
@@ -256,27 +333,21 @@ int dictionary_set(dictionary * d, const char * key, const char * val)
 {
     ssize_t         i ;
     unsigned       hash ;
+    size_t         pos ;
 
     if (d==NULL || key==NULL) return -1 ;
 
     /* Compute hash for this key */
     hash = dictionary_hash(key) ;
     /* Find if value is already in dictionary */
-    if (d->n>0) {
-        for (i=0 ; i<d->size ; i++) {
-            if (d->key[i]==NULL)
-                continue ;
-            if (hash==d->hash[i]) { /* Same hash value */
-                if (!strcmp(key, d->key[i])) {   /* Same key */
-                    /* Found a value: modify and return */
-                    if (d->val[i]!=NULL)
-                        free(d->val[i]);
-                    d->val[i] = (val ? xstrdup(val) : NULL);
-                    /* Value has been modified: return */
-                    return 0 ;
-                }
-            }
-        }
+    i = dictionary_lookup(d, key, hash, &pos);
+    if (i >= 0) {
+        /* Found a value: modify and return */
+        if (d->val[i]!=NULL)
+            free(d->val[i]);
+        d->val[i] = (val ? xstrdup(val) : NULL);
+        /* Value has been modified: return */
+        return 0 ;
     }
     /* Add a new value */
     /* See if dictionary needs to grow */
@@ -284,6 +355,13 @@ int dictionary_set(dictionary * d, const char * key, const char * val)
         /* Reached maximum size: reallocate dictionary */
         if (dictionary_grow(d) != 0)
             return -1;
+        dictionary_lookup(d, key, hash, &pos);
+    } else if (d->index[pos] == DICT_INDEX_EMPTY &&
+               (d->index_used + 1) * 4 > d->index_size * 3) {
+        /* Too many deleted cells: drop them */
+        if (dictionary_reindex(d) != 0)
+            return -1;
+        dictionary_lookup(d, key, hash, &pos);
     }
 
     /* Insert key in the first empty slot. Start at d->n and wrap at
@@ -296,6 +374,9 @@ int dictionary_set(dictionary * d, const char * key, const char * val)
     d->key[i]  = xstrdup(key);
     d->val[i]  = (val ? xstrdup(val) : NULL) ;
     d->hash[i] = hash;
+    if (d->index[pos] == DICT_INDEX_EMPTY)
+        d->index_used++ ;
+    d->index[pos] = i + 1 ;
     d->n ++ ;
     return 0 ;
 }
@@ -313,30 +394,19 @@ int dictionary_set(dictionary * d, const char * key, const char * val)
 /*--------------------------------------------------------------------------*/
 void dictionary_unset(dictionary * d, const char * key)
 {
-    unsigned    hash ;
     ssize_t      i ;
+    size_t       pos ;
 
     if (key == NULL || d == NULL) {
         return;
     }
 
-    hash = dictionary_hash(key);
-    for (i=0 ; i<d->size ; i++) {
-        if (d->key[i]==NULL)
-            continue ;
-        /* Compare hash */
-        if (hash==d->hash[i]) {
-            /* Compare string, to avoid hash collisions */
-            if (!strcmp(key, d->key[i])) {
-                /* Found key */
-                break ;
-            }
-        }
-    }
-    if (i>=d->size)
+    i = dictionary_lookup(d, key, dictionary_hash(key), &pos);
+    if (i < 0)
         /* Key not found */
         return ;
 
+    d->index[pos] = DICT_INDEX_DELETED ;
     free(d->key[i]);
     d->key[i] = NULL ;
     if (d->val[i]!=NULL) {
@@ -37,9 +37,9 @@ extern "C" {
   @brief    Dictionary object
 
   This object contains a list of string/string associations. Each
-  association is identified by a unique string key. Looking up values
-  in the dictionary is speeded up by the use of a (hopefully collision-free)
-  hash function.
+  association is identified by a unique string key. Entries are kept in
+  the key/val/hash arrays in insertion order; an open-addressing table
+  of slot numbers indexed by hash gives constant time lookups.
  */
 /*-------------------------------------------------------------------------*/
 typedef struct _dictionary_ {
@@ -48,6 +48,9 @@ typedef struct _dictionary_ {
     char        **  val ;   /** List of string values */
     char        **  key ;   /** List of string keys */
     unsigned     *  hash ;  /** List of hash values for keys */
+    ssize_t      *  index ; /** Hash index: slot+1, 0 if empty, -1 if deleted */
+    size_t          index_size ; /** Index capacity, power of two */
+    size_t          index_used ; /** Index cells used, deleted ones included */
 } dictionary ;
 
 
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "CuTest.h"
 
@@ -235,3 +236,88 @@ void Test_dictionary_dump(CuTest *tc)
 
     dictionary_del(dic);
 }
+
+void Test_dictionary_index(CuTest *tc)
+{
+    int i;
+    char key_name[32];
+    dictionary *dic;
+
+    dic = dictionary_new(DICTMINSZ);
+    CuAssertPtrNotNull(tc, dic);
+
+    /* Churn far more keys than slots through the dictionary so that
+       deleted index cells pile up and get reclaimed */
+    for (i = 0 ; i < 20 * DICTMINSZ ; ++i) {
+        sprintf(key_name, "churn:key%d", i);
+        CuAssertIntEquals(tc, 0, dictionary_set(dic, key_name, key_name));
+        CuAssertStrEquals(tc, key_name, dictionary_get(dic, key_name, NULL));
+        dictionary_unset(dic, key_name);
+        CuAssertPtrEquals(tc, NULL, (void*)dictionary_get(dic, key_name, NULL));
+    }
+    CuAssertIntEquals(tc, 0, dic->n);
+    CuAssertIntEquals(tc, DICTMINSZ, dic->size);
+    CuAssertTrue(tc, dic->index_used * 4 <= dic->index_size * 3);
+
+    /* Re-inserting an unset key must not duplicate it */
+    CuAssertIntEquals(tc, 0, dictionary_set(dic, "sec:a", "1"));
+    CuAssertIntEquals(tc, 0, dictionary_set(dic, "sec:b", "2"));
+    dictionary_unset(dic, "sec:a");
+    CuAssertIntEquals(tc, 0, dictionary_set(dic, "sec:b", "3"));
+    CuAssertIntEquals(tc, 0, dictionary_set(dic, "sec:a", "4"));
+    CuAssertIntEquals(tc, 2, dic->n);
+    CuAssertStrEquals(tc, "4", dictionary_get(dic, "sec:a", NULL));
+    CuAssertStrEquals(tc, "3", dictionary_get(dic, "sec:b", NULL));
+
+    dictionary_del(dic);
+}
+
+void Test_dictionary_bench(CuTest *tc)
+{
+    const int nkeys = 8192;
+    int i, j;
+    char sec_name[32];
+    char key_name[64];
+    dictionary *dic;
+    clock_t start;
+    double set_ms, get_ms, unset_ms;
+
+    dic = dictionary_new(0);
+    CuAssertPtrNotNull(tc, dic);
+
+    /* Same layout as a parsed ini file: sections of 16 keys */
+    start = clock();
+    for (i = 0 ; i < nkeys / 16 ; ++i) {
+        sprintf(sec_name, "sec%d", i);
+        for (j = 0 ; j < 16 ; ++j) {
+            sprintf(key_name, "%s:key%d", sec_name, j);
+            CuAssertIntEquals(tc, 0, dictionary_set(dic, key_name, "value"));
+        }
+    }
+    set_ms = (double)(clock() - start) * 1000 / CLOCKS_PER_SEC;
+    CuAssertIntEquals(tc, nkeys, dic->n);
+
+    /* Read everything back, as cfg_import() does through iniparser_getstring() */
+    start = clock();
+    for (i = 0 ; i < nkeys / 16 ; ++i) {
+        for (j = 0 ; j < 16 ; ++j) {
+            sprintf(key_name, "sec%d:key%d", i, j);
+            CuAssertStrEquals(tc, "value", dictionary_get(dic, key_name, NULL));
+        }
+    }
+    get_ms = (double)(clock() - start) * 1000 / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (i = 0 ; i < nkeys / 16 ; ++i) {
+        for (j = 0 ; j < 16 ; ++j) {
+            sprintf(key_name, "sec%d:key%d", i, j);
+            dictionary_unset(dic, key_name);
+        }
+    }
+    unset_ms = (double)(clock() - start) * 1000 / CLOCKS_PER_SEC;
+    CuAssertIntEquals(tc, 0, dic->n);
+
+    printf("\ndictionary bench, %d keys: set %.1f ms, get %.1f ms, unset %.1f ms\n",
+           nkeys, set_ms, get_ms, unset_ms);
+    dictionary_del(dic);
+}
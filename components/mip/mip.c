@@ -1,5 +1,6 @@
 #include "mip.h"
 #include "pthread.h"
+#include "s2j_arena.h"
 
 #define GOTO_END(code) {\
         ret = code;\
@@ -97,6 +98,33 @@ mip_dm_update_con_status g_dm_update_status_cb = NULL;
 
 static pthread_mutex_t msg_id_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+//cJSON trees are built in an arena, reset after each message
+S2J_ARENA_DEFINE(s_json_arena, "mip", 8 * 1024);
+static size_t s_json_peak = 0;
+
+static void json_scope_end(bool scoped, const char *what)
+{
+    S2jArenaStats st;
+
+    if (!scoped) {
+        return;
+    }
+    s2j_arena_end(&s_json_arena, &st);
+    if (st.peak > s_json_peak || st.heap_allocs) {
+        s_json_peak = st.peak > s_json_peak ? st.peak : s_json_peak;
+        LOG_PRINTF("DEBUG: %s json allocs(%u) heap(%u) arena peak(%u)\n", what,
+                   (unsigned)st.allocs, (unsigned)st.heap_allocs, (unsigned)st.peak);
+    }
+}
+
+static int json_to_struct(j2s_cb j2s, const char *j, void *s)
+{
+    bool scoped = s2j_arena_begin(&s_json_arena);
+    int ret = j2s(j, s);
+    json_scope_end(scoped, "resp");
+    return ret;
+}
+
 //static functions
 static int get_jsonobj_string_value(cJSON *root, const char *name, char *value, int size)
 {
@@ -287,12 +315,14 @@ static char *s2j_dm_uplink(dm_downlink_header_t *dh, dm_uplink_t *s)
     cJSON *data = NULL;
     cJSON *child_data = NULL;
     cJSON *context = NULL;
+    bool scoped;
 
     if (!s) {
         LOG_PRINTF("ERR: ack is null\n");
         return NULL;
     }
 
+    scoped = s2j_arena_begin(&s_json_arena);
     root = cJSON_CreateObject();
     cJSON_AddStringToObject(root, "ts", s->ts);
     cJSON_AddStringToObject(root, "msgId", s->msg_id);
@@ -331,6 +361,9 @@ static char *s2j_dm_uplink(dm_downlink_header_t *dh, dm_uplink_t *s)
 
     j = cJSON_PrintUnformatted(root);
     cJSON_Delete(root);
+    //callers release it with mip_free(), keep it off any arena
+    j = s2j_arena_detach(j);
+    json_scope_end(scoped, "uplink");
     return j;
 }
 
@@ -382,7 +415,7 @@ static int do_http_req(char *url, char *method, int is_devicehub, j2s_cb j2s, ch
         GOTO_END(-2);
     }
 
-    if (j2s(*json_resp, resp)) {
+    if (json_to_struct(j2s, *json_resp, resp)) {
         mip_free((void **)json_resp);
         LOG_PRINTF("ERR: json to struct failed\n");
         GOTO_END(-3);
@@ -456,7 +489,7 @@ static int do_http_upload_data(char *url, const char *token, const char *type, c
         GOTO_END(-2);
     }
 
-    if (j2s(*json_resp, resp)) {
+    if (json_to_struct(j2s, *json_resp, resp)) {
         mip_free((void **)json_resp);
         LOG_PRINTF("ERR: json to struct failed\n");
         GOTO_END(-3);
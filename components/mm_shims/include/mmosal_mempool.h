@@ -0,0 +1,52 @@
+/*
+ * Copyright 2023 Morse Micro
+ *
+ * This file is licensed under terms that can be found in the LICENSE.md file in the root
+ * directory of the Morse Micro IoT SDK software package.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Counters of one size class of the @c mmosal_malloc() block pools. */
+struct mmosal_mempool_stats
+{
+    /** Block size in bytes. */
+    uint32_t block_size;
+    /** Blocks in the class. */
+    uint32_t block_count;
+    /** Blocks handed out now. */
+    uint32_t in_use;
+    /** Highest @c in_use. */
+    uint32_t high_water;
+    /** Allocations served by the class. */
+    uint32_t hits;
+    /** Allocations of this class that went to the heap because every block was in use. */
+    uint32_t misses;
+};
+
+/**
+ * Copy the counters of a size class.
+ *
+ * @param index  Class index, from 0.
+ * @param stats  Output.
+ *
+ * @returns false if there is no such class, or the pools are disabled.
+ */
+bool mmosal_mempool_get_stats(unsigned index, struct mmosal_mempool_stats *stats);
+
+/**
+ * Allocations that went to the heap because they are bigger than every size class.
+ */
+uint32_t mmosal_mempool_get_oversize_count(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2023 Morse Micro
+ *
+ * This file is licensed under terms that can be found in the LICENSE.md file in the root
+ * directory of the Morse Micro IoT SDK software package.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** SPI counters of the WLAN HAL, since boot or the last reset */
+struct wlan_hal_spi_stats
+{
+    /** Transactions issued to the SPI driver */
+    uint32_t transactions;
+    /** Of which polling transactions */
+    uint32_t polling_transactions;
+    /** Of which interrupt/DMA transactions */
+    uint32_t dma_transactions;
+    /** Bytes sent in a transaction shared by several @c mmhal_wlan_spi_write_buf() or
+     * @c mmhal_wlan_spi_rw() calls of the same CS assertion */
+    uint32_t coalesced_bytes;
+    /** DMA chunks copied through a bounce buffer */
+    uint32_t bounced_chunks;
+    /** CS assertions */
+    uint32_t cs_assertions;
+    /** Most transactions seen in one CS assertion */
+    uint32_t max_assertion_transactions;
+    /** Bytes transferred */
+    uint64_t bytes;
+    /** Time spent in transactions, in microseconds */
+    uint64_t busy_us;
+};
+
+/**
+ * Copy the SPI counters.
+ *
+ * @param stats Output.
+ */
+void wlan_hal_spi_get_stats(struct wlan_hal_spi_stats *stats);
+
+/**
+ * Clear the SPI counters.
+ */
+void wlan_hal_spi_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
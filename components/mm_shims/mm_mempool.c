@@ -0,0 +1,156 @@
+/*
+ * Copyright 2023 Morse Micro
+ *
+ * This file is licensed under terms that can be found in the LICENSE.md file in the root
+ * directory of the Morse Micro IoT SDK software package.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mm_mempool.h"
+
+#ifdef MM_MEMPOOL_HOST
+#define POOL_LOCK(_p)   pthread_mutex_lock(&(_p)->lock)
+#define POOL_UNLOCK(_p) pthread_mutex_unlock(&(_p)->lock)
+#else
+#define POOL_LOCK(_p)   portENTER_CRITICAL_SAFE(&(_p)->lock)
+#define POOL_UNLOCK(_p) portEXIT_CRITICAL_SAFE(&(_p)->lock)
+#endif
+
+/** Class a pool block belongs to, or NULL for heap memory. */
+static struct mm_mempool_class *mm_mempool_class_of(struct mm_mempool *pool, const void *p)
+{
+    const uint8_t *b = p;
+    unsigned ii;
+
+    for (ii = 0; ii < pool->num_classes; ii++)
+    {
+        struct mm_mempool_class *c = &pool->classes[ii];
+        if (b >= c->storage && b < c->storage + c->block_count * c->block_size)
+        {
+            return c;
+        }
+    }
+    return NULL;
+}
+
+void *mm_mempool_malloc(struct mm_mempool *pool, size_t size)
+{
+    void *p = NULL;
+    unsigned ii;
+
+    POOL_LOCK(pool);
+    for (ii = 0; ii < pool->num_classes; ii++)
+    {
+        struct mm_mempool_class *c = &pool->classes[ii];
+        if (size > c->block_size)
+        {
+            continue;
+        }
+
+        if (c->free_list != NULL)
+        {
+            p = c->free_list;
+            c->free_list = *(void **)p;
+        }
+        else if (c->used < c->block_count)
+        {
+            p = c->storage + c->used * c->block_size;
+            c->used++;
+        }
+
+        if (p == NULL)
+        {
+            c->stats.misses++;
+        }
+        else
+        {
+            c->stats.hits++;
+            c->stats.in_use++;
+            if (c->stats.in_use > c->stats.high_water)
+            {
+                c->stats.high_water = c->stats.in_use;
+            }
+        }
+        break;
+    }
+    if (ii == pool->num_classes)
+    {
+        pool->oversize++;
+    }
+    POOL_UNLOCK(pool);
+
+    if (p == NULL)
+    {
+        p = malloc(size);
+    }
+    return p;
+}
+
+void mm_mempool_free(struct mm_mempool *pool, void *p)
+{
+    struct mm_mempool_class *c;
+
+    if (p == NULL)
+    {
+        return;
+    }
+
+    c = mm_mempool_class_of(pool, p);
+    if (c == NULL)
+    {
+        free(p);
+        return;
+    }
+
+    POOL_LOCK(pool);
+    *(void **)p = c->free_list;
+    c->free_list = p;
+    c->stats.in_use--;
+    POOL_UNLOCK(pool);
+}
+
+void *mm_mempool_realloc(struct mm_mempool *pool, void *p, size_t size)
+{
+    struct mm_mempool_class *c;
+    void *n;
+
+    if (p == NULL)
+    {
+        return mm_mempool_malloc(pool, size);
+    }
+
+    c = mm_mempool_class_of(pool, p);
+    if (c == NULL)
+    {
+        return realloc(p, size);
+    }
+    if (size <= c->block_size)
+    {
+        return p;
+    }
+
+    n = mm_mempool_malloc(pool, size);
+    if (n != NULL)
+    {
+        memcpy(n, p, c->block_size);
+        mm_mempool_free(pool, p);
+    }
+    return n;
+}
+
+bool mm_mempool_get_stats(struct mm_mempool *pool, unsigned index, struct mmosal_mempool_stats *stats)
+{
+    if (index >= pool->num_classes)
+    {
+        return false;
+    }
+
+    POOL_LOCK(pool);
+    *stats = pool->classes[index].stats;
+    POOL_UNLOCK(pool);
+    stats->block_size = pool->classes[index].block_size;
+    stats->block_count = pool->classes[index].block_count;
+    return true;
+}
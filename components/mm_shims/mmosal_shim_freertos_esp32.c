@@ -17,6 +17,7 @@
 
 #include "mmosal.h"
 #include "mmhal.h"
+#include "mm_mempool.h"
 
 /* --------------------------------------------------------------------------------------------- */
 
@@ -141,9 +142,92 @@ ESP_SYSTEM_INIT_FN(mmosal_dump_failure_info, BIT(0), 999)
 
 /* --------------------------------------------------------------------------------------------- */
 
+#if CONFIG_MM_MEMPOOL_TRACE
+/** Allocation trace, replayed by the allocator benchmark in test/host_test. ets_printf() does
+ *  not allocate, so it can be used from the allocator. */
+#define MEMPOOL_TRACE(...) ets_printf(__VA_ARGS__)
+#else
+#define MEMPOOL_TRACE(...) do {} while (0)
+#endif
+
+#if CONFIG_MM_MEMPOOL
+
+/** Size class built from the Kconfig options of class @p _n. */
+#define MEMPOOL_BLOCK_SIZE(_n)  CONFIG_MM_MEMPOOL_BLOCK_SIZE_##_n
+#define MEMPOOL_BLOCK_COUNT(_n) CONFIG_MM_MEMPOOL_BLOCK_COUNT_##_n
+#define MEMPOOL_STORAGE_SIZE(_n) \
+    (MEMPOOL_BLOCK_COUNT(_n) ? MEMPOOL_BLOCK_COUNT(_n) * MEMPOOL_BLOCK_SIZE(_n) : 1)
+#define MEMPOOL_CLASS(_n) \
+    { .block_size = MEMPOOL_BLOCK_SIZE(_n), .block_count = MEMPOOL_BLOCK_COUNT(_n), \
+      .storage = mempool_storage_##_n }
+
+_Static_assert(MEMPOOL_BLOCK_SIZE(0) % 8 == 0 && MEMPOOL_BLOCK_SIZE(1) % 8 == 0 &&
+               MEMPOOL_BLOCK_SIZE(2) % 8 == 0 && MEMPOOL_BLOCK_SIZE(3) % 8 == 0,
+               "mempool block sizes must be multiples of 8");
+_Static_assert(MEMPOOL_BLOCK_SIZE(0) < MEMPOOL_BLOCK_SIZE(1) &&
+               MEMPOOL_BLOCK_SIZE(1) < MEMPOOL_BLOCK_SIZE(2) &&
+               MEMPOOL_BLOCK_SIZE(2) < MEMPOOL_BLOCK_SIZE(3),
+               "mempool block sizes must increase");
+
+/* Pool storage lives in .bss, which is internal RAM. It is used in place, so allocations made
+ * before any init code runs are served too. */
+static uint8_t mempool_storage_0[MEMPOOL_STORAGE_SIZE(0)] __attribute__((aligned(8)));
+static uint8_t mempool_storage_1[MEMPOOL_STORAGE_SIZE(1)] __attribute__((aligned(8)));
+static uint8_t mempool_storage_2[MEMPOOL_STORAGE_SIZE(2)] __attribute__((aligned(8)));
+static uint8_t mempool_storage_3[MEMPOOL_STORAGE_SIZE(3)] __attribute__((aligned(8)));
+
+static struct mm_mempool_class mempool_classes[] = {
+    MEMPOOL_CLASS(0),
+    MEMPOOL_CLASS(1),
+    MEMPOOL_CLASS(2),
+    MEMPOOL_CLASS(3),
+};
+
+static struct mm_mempool mempool = {
+    .classes = mempool_classes,
+    .num_classes = sizeof(mempool_classes) / sizeof(mempool_classes[0]),
+    .lock = MM_MEMPOOL_LOCK_INIT,
+};
+
+#define MEMPOOL_MALLOC(_size)        mm_mempool_malloc(&mempool, (_size))
+#define MEMPOOL_FREE(_p)             mm_mempool_free(&mempool, (_p))
+#define MEMPOOL_REALLOC(_p, _size)   mm_mempool_realloc(&mempool, (_p), (_size))
+
+bool mmosal_mempool_get_stats(unsigned index, struct mmosal_mempool_stats *stats)
+{
+    return mm_mempool_get_stats(&mempool, index, stats);
+}
+
+uint32_t mmosal_mempool_get_oversize_count(void)
+{
+    return mempool.oversize;
+}
+
+#else
+
+#define MEMPOOL_MALLOC(_size)        malloc(_size)
+#define MEMPOOL_FREE(_p)             free(_p)
+#define MEMPOOL_REALLOC(_p, _size)   realloc((_p), (_size))
+
+bool mmosal_mempool_get_stats(unsigned index, struct mmosal_mempool_stats *stats)
+{
+    (void)index;
+    (void)stats;
+    return false;
+}
+
+uint32_t mmosal_mempool_get_oversize_count(void)
+{
+    return 0;
+}
+
+#endif
+
 void *mmosal_malloc_(size_t size)
 {
-    return malloc(size);
+    void *p = MEMPOOL_MALLOC(size);
+    MEMPOOL_TRACE("mmtrace a %p %u\n", p, (unsigned)size);
+    return p;
 }
 
 #ifdef MMOSAL_TRACK_ALLOCATIONS
@@ -156,23 +240,26 @@ void *mmosal_malloc_dbg(size_t size, const char *name, unsigned line_number)
 {
     (void)name;
     (void)line_number;
-    return malloc(size);
+    return mmosal_malloc_(size);
 }
 #endif
 
 void mmosal_free(void *p)
 {
-    free(p);
+    MEMPOOL_TRACE("mmtrace f %p\n", p);
+    MEMPOOL_FREE(p);
 }
 
 void *mmosal_realloc(void *ptr, size_t size)
 {
-    return realloc(ptr, size);
+    void *p = MEMPOOL_REALLOC(ptr, size);
+    MEMPOOL_TRACE("mmtrace r %p %p %u\n", ptr, p, (unsigned)size);
+    return p;
 }
 
 void *mmosal_calloc(size_t nitems, size_t size)
 {
-    void* ptr = malloc(nitems * size);
+    void* ptr = mmosal_malloc_(nitems * size);
     if (ptr == NULL)
     {
       return NULL;
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2023 Morse Micro
+ *
+ * This file is licensed under terms that can be found in the LICENSE.md file in the root
+ * directory of the Morse Micro IoT SDK software package.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef MM_MEMPOOL_HOST
+#include <pthread.h>
+#else
+#include "freertos/FreeRTOS.h"
+#endif
+
+#include "mmosal_mempool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** One size class: @c block_count blocks of @c block_size bytes. */
+struct mm_mempool_class
+{
+    /** Block size, a multiple of 8. */
+    size_t block_size;
+    /** Number of blocks in @c storage. */
+    uint32_t block_count;
+    /** @c block_count * @c block_size bytes, 8 byte aligned. */
+    uint8_t *storage;
+    /** Freed blocks, linked through their first word. */
+    void *free_list;
+    /** Blocks of @c storage handed out at least once. Blocks past it are free and need no list,
+     *  so a pool can be defined statically and used before any init code runs. */
+    uint32_t used;
+    /** Counters. */
+    struct mmosal_mempool_stats stats;
+};
+
+/** Fixed-block pools with heap fallback. */
+struct mm_mempool
+{
+    /** Size classes, in increasing @c block_size order. */
+    struct mm_mempool_class *classes;
+    /** Number of entries in @c classes. */
+    unsigned num_classes;
+    /** Allocations bigger than the largest class. */
+    uint32_t oversize;
+#ifdef MM_MEMPOOL_HOST
+    pthread_mutex_t lock;
+#else
+    portMUX_TYPE lock;
+#endif
+};
+
+#ifdef MM_MEMPOOL_HOST
+#define MM_MEMPOOL_LOCK_INIT PTHREAD_MUTEX_INITIALIZER
+#else
+#define MM_MEMPOOL_LOCK_INIT portMUX_INITIALIZER_UNLOCKED
+#endif
+
+/**
+ * Allocate from the smallest class that fits, or from the heap if that class is empty or the
+ * size is bigger than every class.
+ *
+ * @param pool  Pool.
+ * @param size  Bytes needed.
+ *
+ * @returns the block (not zeroed), or NULL.
+ */
+void *mm_mempool_malloc(struct mm_mempool *pool, size_t size);
+
+/**
+ * Give back memory from @c mm_mempool_malloc() or @c mm_mempool_realloc().
+ *
+ * @param pool  Pool.
+ * @param p     Memory, may be NULL.
+ */
+void mm_mempool_free(struct mm_mempool *pool, void *p);
+
+/**
+ * Resize memory from @c mm_mempool_malloc(). Pool blocks stay in place while the new size fits
+ * their class.
+ *
+ * @param pool  Pool.
+ * @param p     Memory, may be NULL.
+ * @param size  New size.
+ *
+ * @returns the memory, or NULL with @p p left untouched.
+ */
+void *mm_mempool_realloc(struct mm_mempool *pool, void *p, size_t size);
+
+/**
+ * Copy the counters of a class.
+ *
+ * @param pool   Pool.
+ * @param index  Class index.
+ * @param stats  Output.
+ *
+ * @returns false if there is no such class.
+ */
+bool mm_mempool_get_stats(struct mm_mempool *pool, unsigned index, struct mmosal_mempool_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
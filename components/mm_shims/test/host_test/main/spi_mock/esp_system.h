@@ -0,0 +1,3 @@
+/* Host build of wlan_hal.c, see spi_mock.h */
+#pragma once
+#include "spi_mock.h"
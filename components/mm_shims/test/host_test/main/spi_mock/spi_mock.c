@@ -0,0 +1,303 @@
+/*
+ * Copyright 2023 Morse Micro
+ *
+ * This file is licensed under terms that can be found in the LICENSE.md file in the root
+ * directory of the Morse Micro IoT SDK software package.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mmosal.h"
+#include "spi_mock.h"
+
+struct spi_mock_log spi_mock;
+
+/** Queued transactions waiting for @c spi_device_get_trans_result() */
+#define QUEUE_MAX 8
+
+static uint8_t psram[16384];
+static int cs_level = 1;
+static bool bus_held;
+static uint32_t window_pos;
+static spi_transaction_t *queue[QUEUE_MAX];
+static unsigned queue_head;
+static unsigned queue_tail;
+static int64_t now_us;
+static int malloc_skip;
+static int malloc_fail;
+
+void spi_mock_reset(void)
+{
+    memset(spi_mock.trans, 0, sizeof(spi_mock.trans));
+    spi_mock.num_trans = 0;
+    spi_mock.mosi_len = 0;
+    spi_mock.max_queued = 0;
+    spi_mock.errors = 0;
+}
+
+uint8_t spi_mock_slave_byte(uint32_t pos)
+{
+    return (uint8_t)(pos * 7 + 0x31);
+}
+
+uint8_t *spi_mock_psram(size_t *size)
+{
+    *size = sizeof(psram);
+    return psram;
+}
+
+void spi_mock_fail_malloc(int skip, int count)
+{
+    malloc_skip = skip;
+    malloc_fail = count;
+}
+
+struct mmosal_semb *mmosal_semb_create(const char *name)
+{
+    static int semb;
+    (void)name;
+    return (struct mmosal_semb *)&semb;
+}
+
+void mmosal_semb_delete(struct mmosal_semb *semb)
+{
+    (void)semb;
+}
+
+void mmosal_task_sleep(uint32_t duration_ms)
+{
+    now_us += duration_ms * 1000;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return now_us += 3;
+}
+
+bool esp_ptr_dma_capable(const void *p)
+{
+    return (const uint8_t *)p < psram || (const uint8_t *)p >= psram + sizeof(psram);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    if (malloc_skip)
+    {
+        malloc_skip--;
+    }
+    else if (malloc_fail)
+    {
+        malloc_fail--;
+        return NULL;
+    }
+    return aligned_alloc(4, (size + 3) & ~(size_t)3);
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    (void)config;
+    return ESP_OK;
+}
+
+int gpio_get_level(int gpio_num)
+{
+    (void)gpio_num;
+    return 1;
+}
+
+esp_err_t gpio_set_level(int gpio_num, uint32_t level)
+{
+    if (gpio_num == CONFIG_MM_SPI_CS)
+    {
+        if (level == 0 && cs_level == 1)
+        {
+            spi_mock.windows++;
+            window_pos = 0;
+        }
+        cs_level = level;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(int gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    (void)gpio_num;
+    (void)isr_handler;
+    (void)args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(int gpio_num)
+{
+    (void)gpio_num;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(int gpio_num, gpio_int_type_t intr_type)
+{
+    (void)gpio_num;
+    (void)intr_type;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_initialize(int host_id, const spi_bus_config_t *bus_config, int dma_chan)
+{
+    (void)host_id;
+    (void)bus_config;
+    (void)dma_chan;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_free(int host_id)
+{
+    (void)host_id;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(int host_id, const spi_device_interface_config_t *dev_config,
+                             spi_device_handle_t *handle)
+{
+    static int device;
+    (void)host_id;
+    spi_mock.queue_size = dev_config->queue_size;
+    *handle = (spi_device_handle_t)&device;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_actual_freq(spi_device_handle_t handle, int *freq_khz)
+{
+    (void)handle;
+    *freq_khz = 40000;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_acquire_bus(spi_device_handle_t device, uint32_t wait)
+{
+    (void)device;
+    (void)wait;
+    if (bus_held)
+    {
+        spi_mock.errors++;
+    }
+    bus_held = true;
+    return ESP_OK;
+}
+
+void spi_device_release_bus(spi_device_handle_t dev)
+{
+    (void)dev;
+    if (!bus_held)
+    {
+        spi_mock.errors++;
+    }
+    bus_held = false;
+}
+
+static bool dma_buffer_ok(const spi_transaction_t *t, uint32_t flag, const void *buf)
+{
+    return (t->flags & flag) || buf == NULL || (esp_ptr_dma_capable(buf) && ((uintptr_t)buf & 3) == 0);
+}
+
+/**
+ * Run a transaction: MOSI bytes go to the log, MISO comes from @c spi_mock_slave_byte().
+ */
+static void wire(spi_transaction_t *t, enum spi_mock_kind kind)
+{
+    size_t len = t->length / 8;
+    const uint8_t *tx = (t->flags & SPI_TRANS_USE_TXDATA) ? t->tx_data : t->tx_buffer;
+    uint8_t *rx = (t->flags & SPI_TRANS_USE_RXDATA) ? t->rx_data : t->rx_buffer;
+
+    /* Only the training sequence runs with CS high, and without holding the bus */
+    bool in_window = cs_level == 0 && bus_held;
+    bool training = cs_level == 1 && !bus_held && len == 16;
+    if ((!in_window && !training) || len == 0 || len > 4092 ||
+        !dma_buffer_ok(t, SPI_TRANS_USE_TXDATA, t->tx_buffer) ||
+        !dma_buffer_ok(t, SPI_TRANS_USE_RXDATA, t->rx_buffer) ||
+        spi_mock.num_trans == SPI_MOCK_MAX_TRANS || spi_mock.mosi_len + len > SPI_MOCK_MAX_MOSI)
+    {
+        spi_mock.errors++;
+        return;
+    }
+
+    struct spi_mock_trans *r = &spi_mock.trans[spi_mock.num_trans++];
+    r->window = spi_mock.windows;
+    r->len = len;
+    r->kind = kind;
+    for (size_t i = 0; i < len; i++)
+    {
+        spi_mock.mosi[spi_mock.mosi_len++] = tx ? tx[i] : 0xee;
+        if (rx)
+        {
+            rx[i] = spi_mock_slave_byte(window_pos);
+        }
+        window_pos++;
+    }
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc)
+{
+    (void)handle;
+    if (queue_head != queue_tail)
+    {
+        spi_mock.errors++;
+    }
+    wire(trans_desc, SPI_MOCK_POLLING);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc)
+{
+    (void)handle;
+    if (queue_head != queue_tail)
+    {
+        spi_mock.errors++;
+    }
+    wire(trans_desc, SPI_MOCK_TRANSMIT);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans_desc,
+                                 uint32_t ticks_to_wait)
+{
+    (void)handle;
+    (void)ticks_to_wait;
+    if ((int)(queue_tail - queue_head) >= spi_mock.queue_size)
+    {
+        spi_mock.errors++;
+        return ESP_FAIL;
+    }
+    wire(trans_desc, SPI_MOCK_QUEUED);
+    queue[queue_tail++ % QUEUE_MAX] = trans_desc;
+    if ((int)(queue_tail - queue_head) > spi_mock.max_queued)
+    {
+        spi_mock.max_queued = queue_tail - queue_head;
+    }
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans_desc,
+                                      uint32_t ticks_to_wait)
+{
+    (void)handle;
+    (void)ticks_to_wait;
+    if (queue_head == queue_tail)
+    {
+        spi_mock.errors++;
+        return ESP_FAIL;
+    }
+    *trans_desc = queue[queue_head++ % QUEUE_MAX];
+    return ESP_OK;
+}
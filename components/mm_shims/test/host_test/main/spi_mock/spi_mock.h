@@ -0,0 +1,208 @@
+/*
+ * Copyright 2023 Morse Micro
+ *
+ * This file is licensed under terms that can be found in the LICENSE.md file in the root
+ * directory of the Morse Micro IoT SDK software package.
+ */
+
+/*
+ * The parts of the ESP-IDF GPIO, SPI master, heap and timer APIs that wlan_hal.c uses, on a
+ * simulated bus. Every transaction is logged with its CS assertion, so the tests can check where
+ * the HAL puts the transaction boundaries and that the bytes on the wire are unchanged.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+#define IRAM_ATTR
+#define portMAX_DELAY 0xffffffffUL
+
+#define MALLOC_CAP_DMA      (1 << 3)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+typedef enum
+{
+    GPIO_INTR_DISABLE = 0,
+    GPIO_INTR_POSEDGE,
+    GPIO_INTR_NEGEDGE,
+    GPIO_INTR_ANYEDGE,
+    GPIO_INTR_LOW_LEVEL,
+    GPIO_INTR_HIGH_LEVEL,
+} gpio_int_type_t;
+
+typedef enum
+{
+    GPIO_MODE_INPUT = 1,
+    GPIO_MODE_OUTPUT = 2,
+} gpio_mode_t;
+
+typedef struct
+{
+    uint64_t pin_bit_mask;
+    gpio_mode_t mode;
+    int pull_up_en;
+    int pull_down_en;
+    gpio_int_type_t intr_type;
+} gpio_config_t;
+
+typedef void (*gpio_isr_t)(void *arg);
+
+#define SPI2_HOST                1
+#define SPI_DMA_CH_AUTO          3
+#define SPI_MASTER_FREQ_40M      (80 * 1000 * 1000 / 2)
+#define SPICOMMON_BUSFLAG_MASTER (1 << 0)
+#define SPI_TRANS_USE_RXDATA     (1 << 2)
+#define SPI_TRANS_USE_TXDATA     (1 << 3)
+
+typedef struct
+{
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int max_transfer_sz;
+    uint32_t flags;
+} spi_bus_config_t;
+
+typedef struct
+{
+    int clock_speed_hz;
+    uint8_t mode;
+    int spics_io_num;
+    int queue_size;
+    uint32_t flags;
+} spi_device_interface_config_t;
+
+typedef struct
+{
+    uint32_t flags;
+    size_t length;
+    size_t rxlength;
+    void *user;
+    union
+    {
+        const void *tx_buffer;
+        uint8_t tx_data[4];
+    };
+    union
+    {
+        void *rx_buffer;
+        uint8_t rx_data[4];
+    };
+} spi_transaction_t;
+
+typedef struct spi_device_t *spi_device_handle_t;
+
+int64_t esp_timer_get_time(void);
+bool esp_ptr_dma_capable(const void *p);
+void *heap_caps_malloc(size_t size, uint32_t caps);
+void heap_caps_free(void *ptr);
+
+esp_err_t gpio_config(const gpio_config_t *config);
+int gpio_get_level(int gpio_num);
+esp_err_t gpio_set_level(int gpio_num, uint32_t level);
+esp_err_t gpio_isr_handler_add(int gpio_num, gpio_isr_t isr_handler, void *args);
+esp_err_t gpio_isr_handler_remove(int gpio_num);
+esp_err_t gpio_set_intr_type(int gpio_num, gpio_int_type_t intr_type);
+
+esp_err_t spi_bus_initialize(int host_id, const spi_bus_config_t *bus_config, int dma_chan);
+esp_err_t spi_bus_free(int host_id);
+esp_err_t spi_bus_add_device(int host_id, const spi_device_interface_config_t *dev_config,
+                             spi_device_handle_t *handle);
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle);
+esp_err_t spi_device_get_actual_freq(spi_device_handle_t handle, int *freq_khz);
+esp_err_t spi_device_acquire_bus(spi_device_handle_t device, uint32_t wait);
+void spi_device_release_bus(spi_device_handle_t dev);
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc);
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc);
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans_desc,
+                                 uint32_t ticks_to_wait);
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans_desc,
+                                      uint32_t ticks_to_wait);
+
+/** How a transaction reached the driver */
+enum spi_mock_kind
+{
+    SPI_MOCK_POLLING,
+    SPI_MOCK_TRANSMIT,
+    SPI_MOCK_QUEUED,
+};
+
+/** One transaction on the simulated wire */
+struct spi_mock_trans
+{
+    /** CS assertion it ran in, counted from 1 */
+    uint32_t window;
+    /** Length in bytes */
+    size_t len;
+    enum spi_mock_kind kind;
+};
+
+/** Maximum transactions logged between two @c spi_mock_reset() calls */
+#define SPI_MOCK_MAX_TRANS 256
+
+/** Maximum MOSI bytes logged between two @c spi_mock_reset() calls */
+#define SPI_MOCK_MAX_MOSI 16384
+
+/** Wire log */
+struct spi_mock_log
+{
+    struct spi_mock_trans trans[SPI_MOCK_MAX_TRANS];
+    uint32_t num_trans;
+    /** Bytes sent by the master, 0xee where it had no TX buffer */
+    uint8_t mosi[SPI_MOCK_MAX_MOSI];
+    size_t mosi_len;
+    /** CS assertions since start */
+    uint32_t windows;
+    /** Queue size given to @c spi_bus_add_device() */
+    int queue_size;
+    /** Most transactions queued at once */
+    int max_queued;
+    /** Driver API misuse: a transaction outside a CS assertion or without the bus, a buffer the
+     * DMA cannot reach, a queue overflow */
+    uint32_t errors;
+};
+
+extern struct spi_mock_log spi_mock;
+
+/**
+ * Clear the wire log, the CS and bus state are kept.
+ */
+void spi_mock_reset(void);
+
+/**
+ * Byte the slave sends at a position of its CS assertion.
+ */
+uint8_t spi_mock_slave_byte(uint32_t pos);
+
+/**
+ * Memory the DMA cannot reach, like PSRAM.
+ *
+ * @param size Output, size of the region.
+ */
+uint8_t *spi_mock_psram(size_t *size);
+
+/**
+ * Make the next @c heap_caps_malloc() calls fail.
+ *
+ * @param skip Calls that still succeed first.
+ * @param count Calls that fail after them.
+ */
+void spi_mock_fail_malloc(int skip, int count);
+
+#ifdef __cplusplus
+}
+#endif
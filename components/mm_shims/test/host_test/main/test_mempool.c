@@ -0,0 +1,502 @@
+/*
+ * Copyright 2023 Morse Micro
+ *
+ * This file is licensed under terms that can be found in the LICENSE.md file in the root
+ * directory of the Morse Micro IoT SDK software package.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "mm_mempool.h"
+
+/** Replay passes over the trace, for stable timings */
+#define REPLAY_PASSES 200
+
+/** Small pool for the functional tests: 2 x 16 and 2 x 64 bytes */
+static uint8_t s_small_16[2 * 16] __attribute__((aligned(8)));
+static uint8_t s_small_64[2 * 64] __attribute__((aligned(8)));
+static struct mm_mempool_class s_small_classes[2];
+static struct mm_mempool s_small;
+
+static void small_pool_init(void)
+{
+    memset(s_small_classes, 0, sizeof(s_small_classes));
+    s_small_classes[0].block_size = 16;
+    s_small_classes[0].block_count = 2;
+    s_small_classes[0].storage = s_small_16;
+    s_small_classes[1].block_size = 64;
+    s_small_classes[1].block_count = 2;
+    s_small_classes[1].storage = s_small_64;
+    memset(&s_small, 0, sizeof(s_small));
+    s_small.classes = s_small_classes;
+    s_small.num_classes = 2;
+    pthread_mutex_init(&s_small.lock, NULL);
+}
+
+static bool in_storage(const void *p, const uint8_t *storage, size_t len)
+{
+    return (const uint8_t *)p >= storage && (const uint8_t *)p < storage + len;
+}
+
+static void test_smallest_class(void)
+{
+    struct mmosal_mempool_stats st;
+    small_pool_init();
+
+    void *a = mm_mempool_malloc(&s_small, 1);
+    void *b = mm_mempool_malloc(&s_small, 16);
+    void *c = mm_mempool_malloc(&s_small, 17);
+    TEST_ASSERT_TRUE(in_storage(a, s_small_16, sizeof(s_small_16)));
+    TEST_ASSERT_TRUE(in_storage(b, s_small_16, sizeof(s_small_16)));
+    TEST_ASSERT_TRUE(in_storage(c, s_small_64, sizeof(s_small_64)));
+    TEST_ASSERT_TRUE(a != b);
+
+    TEST_ASSERT_TRUE(mm_mempool_get_stats(&s_small, 0, &st));
+    TEST_ASSERT_EQUAL_UINT32(16, st.block_size);
+    TEST_ASSERT_EQUAL_UINT32(2, st.hits);
+    TEST_ASSERT_EQUAL_UINT32(2, st.in_use);
+    TEST_ASSERT_FALSE(mm_mempool_get_stats(&s_small, 2, &st));
+
+    mm_mempool_free(&s_small, a);
+    mm_mempool_free(&s_small, b);
+    mm_mempool_free(&s_small, c);
+    mm_mempool_get_stats(&s_small, 0, &st);
+    TEST_ASSERT_EQUAL_UINT32(0, st.in_use);
+    TEST_ASSERT_EQUAL_UINT32(2, st.high_water);
+}
+
+static void test_empty_class_uses_heap(void)
+{
+    struct mmosal_mempool_stats st;
+    small_pool_init();
+
+    void *a = mm_mempool_malloc(&s_small, 8);
+    void *b = mm_mempool_malloc(&s_small, 8);
+    void *h = mm_mempool_malloc(&s_small, 8);
+    TEST_ASSERT_NOT_NULL(h);
+    TEST_ASSERT_FALSE(in_storage(h, s_small_16, sizeof(s_small_16)));
+    /* a full class does not spill into the bigger one */
+    TEST_ASSERT_FALSE(in_storage(h, s_small_64, sizeof(s_small_64)));
+    mm_mempool_get_stats(&s_small, 0, &st);
+    TEST_ASSERT_EQUAL_UINT32(2, st.hits);
+    TEST_ASSERT_EQUAL_UINT32(1, st.misses);
+    TEST_ASSERT_EQUAL_UINT32(2, st.in_use);
+
+    /* heap memory goes back to the heap, the freed block is handed out again */
+    mm_mempool_free(&s_small, h);
+    mm_mempool_free(&s_small, a);
+    TEST_ASSERT_EQUAL_PTR(a, mm_mempool_malloc(&s_small, 8));
+    mm_mempool_free(&s_small, a);
+    mm_mempool_free(&s_small, b);
+    mm_mempool_free(&s_small, NULL);
+    mm_mempool_get_stats(&s_small, 0, &st);
+    TEST_ASSERT_EQUAL_UINT32(0, st.in_use);
+}
+
+static void test_oversize(void)
+{
+    struct mmosal_mempool_stats st;
+    small_pool_init();
+
+    void *p = mm_mempool_malloc(&s_small, 65);
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EQUAL_UINT32(1, s_small.oversize);
+    mm_mempool_get_stats(&s_small, 1, &st);
+    TEST_ASSERT_EQUAL_UINT32(0, st.hits + st.misses);
+    mm_mempool_free(&s_small, p);
+}
+
+static void test_realloc(void)
+{
+    struct mmosal_mempool_stats st;
+    small_pool_init();
+
+    uint8_t *p = mm_mempool_realloc(&s_small, NULL, 10);
+    TEST_ASSERT_TRUE(in_storage(p, s_small_16, sizeof(s_small_16)));
+    memset(p, 0x5a, 10);
+    /* fits the block: stays */
+    TEST_ASSERT_EQUAL_PTR(p, mm_mempool_realloc(&s_small, p, 16));
+    /* moves to the next class, the block goes back */
+    uint8_t *q = mm_mempool_realloc(&s_small, p, 40);
+    TEST_ASSERT_TRUE(in_storage(q, s_small_64, sizeof(s_small_64)));
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL_HEX8(0x5a, q[i]);
+    }
+    mm_mempool_get_stats(&s_small, 0, &st);
+    TEST_ASSERT_EQUAL_UINT32(0, st.in_use);
+    /* out of the pools */
+    uint8_t *r = mm_mempool_realloc(&s_small, q, 1000);
+    TEST_ASSERT_FALSE(in_storage(r, s_small_64, sizeof(s_small_64)));
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL_HEX8(0x5a, r[i]);
+    }
+    r = mm_mempool_realloc(&s_small, r, 2000);
+    TEST_ASSERT_EQUAL_HEX8(0x5a, r[9]);
+    mm_mempool_free(&s_small, r);
+    mm_mempool_get_stats(&s_small, 1, &st);
+    TEST_ASSERT_EQUAL_UINT32(0, st.in_use);
+}
+
+/* ---------------------------------------------------------------------------------------------
+ * Trace replay
+ */
+
+/**
+ * @brief Allocation trace operation, addresses of the trace mapped to slot numbers
+ */
+typedef struct {
+    char op;                /*!< 'a', 'f' or 'r' */
+    uint32_t slot;          /*!< slot allocated, freed or reallocated */
+    uint32_t new_slot;      /*!< realloc only: slot of the result */
+    uint32_t size;
+} trace_op_t;
+
+typedef struct {
+    trace_op_t *ops;
+    uint32_t num_ops;
+    uint32_t num_slots;
+} trace_t;
+
+/**
+ * @brief Trace address to slot map, open addressing
+ */
+typedef struct {
+    unsigned long *addr;
+    uint32_t *slot;
+    uint32_t cap;
+} addr_map_t;
+
+static uint32_t *addr_map_find(addr_map_t *m, unsigned long addr)
+{
+    uint32_t i = (uint32_t)((addr >> 3) * 2654435761u) & (m->cap - 1);
+    while (m->addr[i] != 0 && m->addr[i] != addr) {
+        i = (i + 1) & (m->cap - 1);
+    }
+    m->addr[i] = addr;
+    return &m->slot[i];
+}
+
+/**
+ * @brief Parse a "mmtrace" log: every live address gets a fresh slot number, so the replay does not
+ * depend on the addresses the recording heap gave out. Other log lines are skipped.
+ */
+static void trace_load(trace_t *t, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    TEST_ASSERT_NOT_NULL_MESSAGE(f, path);
+    char line[256];
+    uint32_t cap = 0;
+    while (fgets(line, sizeof(line), f)) {
+        cap++;
+    }
+    rewind(f);
+
+    addr_map_t m = { .cap = 1 };
+    while (m.cap < cap * 2) {
+        m.cap <<= 1;
+    }
+    m.addr = calloc(m.cap, sizeof(*m.addr));
+    m.slot = calloc(m.cap, sizeof(*m.slot));
+    t->ops = calloc(cap, sizeof(trace_op_t));
+    t->num_ops = 0;
+    t->num_slots = 1;       /* slot 0: not live */
+    TEST_ASSERT_TRUE(m.addr && m.slot && t->ops);
+
+    while (fgets(line, sizeof(line), f)) {
+        const char *s = strstr(line, "mmtrace ");
+        unsigned long a, b;
+        unsigned size;
+        trace_op_t *op = &t->ops[t->num_ops];
+        if (s == NULL) {
+            continue;
+        }
+        if (sscanf(s, "mmtrace a %lx %u", &a, &size) == 2) {
+            op->op = 'a';
+            op->size = size;
+            op->slot = t->num_slots++;
+            if (a) {
+                *addr_map_find(&m, a) = op->slot;
+            }
+        } else if (sscanf(s, "mmtrace f %lx", &a) == 1) {
+            op->op = 'f';
+            op->slot = a ? *addr_map_find(&m, a) : 0;
+            if (a) {
+                *addr_map_find(&m, a) = 0;
+            }
+        } else if (sscanf(s, "mmtrace r %lx %lx %u", &a, &b, &size) == 3) {
+            op->op = 'r';
+            op->size = size;
+            op->slot = a ? *addr_map_find(&m, a) : 0;
+            if (a) {
+                *addr_map_find(&m, a) = 0;
+            }
+            op->new_slot = t->num_slots++;
+            if (b) {
+                *addr_map_find(&m, b) = op->new_slot;
+            }
+        } else {
+            continue;
+        }
+        t->num_ops++;
+    }
+    fclose(f);
+    free(m.addr);
+    free(m.slot);
+}
+
+/**
+ * @brief Allocation kind of the synthetic workload
+ */
+typedef struct {
+    uint32_t size;
+    uint32_t percent;       /*!< share of the allocations */
+    uint32_t min_life;      /*!< lifetime, in allocations made meanwhile */
+    uint32_t max_life;
+} synth_kind_t;
+
+/** Frequent short lived control and descriptor allocations, some packet buffers */
+static const synth_kind_t s_synth_kinds[] = {
+    { 24, 30, 1, 6 }, { 40, 20, 2, 30 }, { 56, 15, 1, 10 }, { 96, 12, 3, 40 },
+    { 120, 6, 5, 80 }, { 200, 7, 2, 20 }, { 312, 3, 2, 15 }, { 1664, 7, 1, 8 },
+};
+/** Long lived allocations made at start up, never freed */
+static const uint32_t s_synth_init_sizes[] = { 16, 32, 48, 72, 144, 512, 2048 };
+
+#define SYNTH_INIT_ALLOCS 60
+#define SYNTH_ALLOCS 2000
+/** One allocation in this many grows a live one to twice its size */
+#define SYNTH_REALLOC_EVERY 100
+
+static uint32_t s_seed;
+
+static uint32_t synth_rand(void)
+{
+    s_seed = s_seed * 1103515245 + 12345;
+    return s_seed >> 8;
+}
+
+/**
+ * @brief Generate the synthetic workload used when no captured trace is given, the same on every run
+ */
+static void trace_synth(trace_t *t)
+{
+    struct {
+        uint32_t expire;
+        uint32_t slot;
+        uint32_t size;
+    } live[SYNTH_ALLOCS];
+    uint32_t num_live = 0;
+
+    s_seed = 6108;
+    t->ops = calloc(SYNTH_INIT_ALLOCS + 3 * SYNTH_ALLOCS, sizeof(trace_op_t));
+    TEST_ASSERT_NOT_NULL(t->ops);
+    t->num_ops = 0;
+    t->num_slots = 1;       /* slot 0: not live */
+
+    for (uint32_t i = 0; i < SYNTH_INIT_ALLOCS; i++) {
+        trace_op_t *op = &t->ops[t->num_ops++];
+        op->op = 'a';
+        op->size = s_synth_init_sizes[synth_rand() % (sizeof(s_synth_init_sizes) / sizeof(s_synth_init_sizes[0]))];
+        op->slot = t->num_slots++;
+    }
+    for (uint32_t step = 0; step < SYNTH_ALLOCS; step++) {
+        const synth_kind_t *k = s_synth_kinds;
+        uint32_t r = synth_rand() % 100;
+        while (r >= k->percent) {
+            r -= k->percent;
+            k++;
+        }
+        trace_op_t *op = &t->ops[t->num_ops++];
+        op->op = 'a';
+        op->size = k->size;
+        op->slot = t->num_slots++;
+        live[num_live].expire = step + k->min_life + synth_rand() % (k->max_life - k->min_life + 1);
+        live[num_live].slot = op->slot;
+        live[num_live].size = op->size;
+        num_live++;
+
+        if (synth_rand() % SYNTH_REALLOC_EVERY == 0) {
+            uint32_t i = synth_rand() % num_live;
+            op = &t->ops[t->num_ops++];
+            op->op = 'r';
+            op->slot = live[i].slot;
+            op->new_slot = t->num_slots++;
+            op->size = live[i].size * 2;
+            live[i].slot = op->new_slot;
+            live[i].size = op->size;
+        }
+        for (uint32_t i = 0; i < num_live;) {
+            if (live[i].expire > step) {
+                i++;
+                continue;
+            }
+            op = &t->ops[t->num_ops++];
+            op->op = 'f';
+            op->slot = live[i].slot;
+            live[i] = live[--num_live];
+        }
+    }
+}
+
+typedef void *(*replay_malloc_t)(void *ctx, size_t size);
+typedef void (*replay_free_t)(void *ctx, void *p);
+typedef void *(*replay_realloc_t)(void *ctx, void *p, size_t size);
+
+static void *heap_malloc(void *ctx, size_t size)
+{
+    (void)ctx;
+    return malloc(size);
+}
+
+static void heap_free(void *ctx, void *p)
+{
+    (void)ctx;
+    free(p);
+}
+
+static void *heap_realloc(void *ctx, void *p, size_t size)
+{
+    (void)ctx;
+    return realloc(p, size);
+}
+
+static void *pool_malloc(void *ctx, size_t size)
+{
+    return mm_mempool_malloc(ctx, size);
+}
+
+static void pool_free(void *ctx, void *p)
+{
+    mm_mempool_free(ctx, p);
+}
+
+static void *pool_realloc(void *ctx, void *p, size_t size)
+{
+    return mm_mempool_realloc(ctx, p, size);
+}
+
+/**
+ * @brief Replay a trace, touching every allocation like its user would, and free what is left at the end
+ * @return nanoseconds per operation
+ */
+static double trace_replay(const trace_t *t, void **live, replay_malloc_t m, replay_free_t f, replay_realloc_t r, void *ctx)
+{
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int pass = 0; pass < REPLAY_PASSES; pass++) {
+        for (uint32_t i = 0; i < t->num_ops; i++) {
+            const trace_op_t *op = &t->ops[i];
+            switch (op->op) {
+            case 'a':
+                live[op->slot] = m(ctx, op->size);
+                ((volatile uint8_t *)live[op->slot])[0] = (uint8_t)i;
+                break;
+            case 'f':
+                f(ctx, live[op->slot]);
+                live[op->slot] = NULL;
+                break;
+            default:
+                live[op->new_slot] = r(ctx, live[op->slot], op->size);
+                ((volatile uint8_t *)live[op->new_slot])[op->size - 1] = (uint8_t)i;
+                if (op->slot != 0) {
+                    live[op->slot] = NULL;
+                }
+                break;
+            }
+            live[0] = NULL;
+        }
+        for (uint32_t s = 0; s < t->num_slots; s++) {
+            if (live[s]) {
+                f(ctx, live[s]);
+                live[s] = NULL;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    return ns / ((double)t->num_ops * REPLAY_PASSES);
+}
+
+/** Pool with the Kconfig defaults of the component */
+#define KCONFIG_CLASS_STORAGE(_n) \
+    static uint8_t s_storage_##_n[CONFIG_MM_MEMPOOL_BLOCK_SIZE_##_n * CONFIG_MM_MEMPOOL_BLOCK_COUNT_##_n] \
+    __attribute__((aligned(8)))
+#define KCONFIG_CLASS(_n) \
+    { .block_size = CONFIG_MM_MEMPOOL_BLOCK_SIZE_##_n, .block_count = CONFIG_MM_MEMPOOL_BLOCK_COUNT_##_n, \
+      .storage = s_storage_##_n }
+
+KCONFIG_CLASS_STORAGE(0);
+KCONFIG_CLASS_STORAGE(1);
+KCONFIG_CLASS_STORAGE(2);
+KCONFIG_CLASS_STORAGE(3);
+
+static void test_replay_trace(void)
+{
+    struct mm_mempool_class classes[] = {
+        KCONFIG_CLASS(0), KCONFIG_CLASS(1), KCONFIG_CLASS(2), KCONFIG_CLASS(3),
+    };
+    struct mm_mempool pool = {
+        .classes = classes,
+        .num_classes = sizeof(classes) / sizeof(classes[0]),
+        .lock = MM_MEMPOOL_LOCK_INIT,
+    };
+    const char *path = getenv("MM_TRACE_FILE");
+    trace_t t;
+
+    if (path) {
+        trace_load(&t, path);
+    } else {
+        path = "synthetic workload";
+        trace_synth(&t);
+    }
+    TEST_ASSERT_GREATER_THAN_UINT32(0, t.num_ops);
+    void **live = calloc(t.num_slots, sizeof(void *));
+    TEST_ASSERT_NOT_NULL(live);
+
+    double heap_ns = trace_replay(&t, live, heap_malloc, heap_free, heap_realloc, NULL);
+    double pool_ns = trace_replay(&t, live, pool_malloc, pool_free, pool_realloc, &pool);
+
+    printf("%s: %lu operations x %d passes\n", path, (unsigned long)t.num_ops, REPLAY_PASSES);
+    printf("heap only      %6.1f ns/op\n", heap_ns);
+    printf("pools + heap   %6.1f ns/op\n", pool_ns);
+    uint32_t hits = 0, misses = 0;
+    for (unsigned i = 0; i < pool.num_classes; i++) {
+        struct mmosal_mempool_stats st;
+        mm_mempool_get_stats(&pool, i, &st);
+        printf("class %4lu x %3lu: hits %8lu misses %7lu high water %3lu\n", (unsigned long)st.block_size,
+               (unsigned long)st.block_count, (unsigned long)st.hits, (unsigned long)st.misses,
+               (unsigned long)st.high_water);
+        TEST_ASSERT_EQUAL_UINT32(0, st.in_use);
+        hits += st.hits;
+        misses += st.misses;
+    }
+    /* On the host the C library heap has per-thread caches and no lock to take, on the target every
+     * heap call goes through the locked multi_heap, so the heap calls saved are what matters there */
+    printf("oversize %lu, pool hit rate %.1f%%, heap allocations %lu -> %lu per pass\n",
+           (unsigned long)pool.oversize, 100.0 * hits / (hits + misses + pool.oversize),
+           (unsigned long)((hits + misses + pool.oversize) / REPLAY_PASSES),
+           (unsigned long)((misses + pool.oversize) / REPLAY_PASSES));
+    TEST_ASSERT_GREATER_THAN_UINT32(0, hits);
+
+    free(live);
+    free(t.ops);
+}
+
+/** In test_wlan_hal_spi.c */
+void run_wlan_hal_spi_tests(void);
+
+void app_main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_smallest_class);
+    RUN_TEST(test_empty_class_uses_heap);
+    RUN_TEST(test_oversize);
+    RUN_TEST(test_realloc);
+    RUN_TEST(test_replay_trace);
+    run_wlan_hal_spi_tests();
+    UNITY_END();
+}
@@ -0,0 +1,249 @@
+/*
+ * Copyright 2023 Morse Micro
+ *
+ * This file is licensed under terms that can be found in the LICENSE.md file in the root
+ * directory of the Morse Micro IoT SDK software package.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "unity.h"
+#include "mmhal.h"
+#include "spi_mock.h"
+#include "wlan_hal.h"
+
+/** Single byte writes of the byte write test */
+#define BYTE_WRITES 200
+
+/** Large transfer, more than two DMA chunks */
+#define LARGE_LEN 5000
+
+static void wire_reset(void)
+{
+    spi_mock_reset();
+    wlan_hal_spi_reset_stats();
+}
+
+static void test_training_sequence(void)
+{
+    wire_reset();
+    mmhal_wlan_send_training_seq();
+    TEST_ASSERT_EQUAL_UINT32(0, spi_mock.errors);
+    TEST_ASSERT_EQUAL_UINT32(1, spi_mock.num_trans);
+    TEST_ASSERT_EQUAL_size_t(16, spi_mock.trans[0].len);
+    TEST_ASSERT_EQUAL_INT(2, spi_mock.queue_size);
+}
+
+/**
+ * Register access as morselib does it: command bytes, two response bytes polled one at a time,
+ * a short write, the data, then the trailer. Seven calls, five transactions.
+ */
+static void test_command_sequence(void)
+{
+    static const uint8_t expected[] = {
+        0x41, 1, 2, 3, 4, 0x55, 0xff, 0xff, 0x41, 1,
+        0xee, 0xee, 0xee, 0xee, 0xee, 0xee, 0xee, 0xee, 2, 3, 4
+    };
+    uint8_t cmd[6] = {0x41, 1, 2, 3, 4, 0x55};
+    uint8_t data[8] = {0};
+    struct wlan_hal_spi_stats st;
+    wire_reset();
+
+    mmhal_wlan_spi_cs_assert();
+    mmhal_wlan_spi_write_buf(cmd, 6);
+    uint8_t r1 = mmhal_wlan_spi_rw(0xff);
+    uint8_t r2 = mmhal_wlan_spi_rw(0xff);
+    mmhal_wlan_spi_write_buf(cmd, 2);
+    mmhal_wlan_spi_read_buf(data, 8);
+    mmhal_wlan_spi_write_buf(cmd + 2, 3);
+    mmhal_wlan_spi_cs_deassert();
+
+    TEST_ASSERT_EQUAL_UINT32(0, spi_mock.errors);
+    // the bytes on the wire are the ones of the seven calls, in order
+    TEST_ASSERT_EQUAL_size_t(sizeof(expected), spi_mock.mosi_len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, spi_mock.mosi, sizeof(expected));
+    // each read gets the bytes clocked in at its position of the assertion
+    TEST_ASSERT_EQUAL_HEX8(spi_mock_slave_byte(6), r1);
+    TEST_ASSERT_EQUAL_HEX8(spi_mock_slave_byte(7), r2);
+    for (int i = 0; i < 8; i++)
+    {
+        TEST_ASSERT_EQUAL_HEX8(spi_mock_slave_byte(10 + i), data[i]);
+    }
+
+    // 6+1 | 1 | 2 | 8 | 3
+    TEST_ASSERT_EQUAL_UINT32(5, spi_mock.num_trans);
+    TEST_ASSERT_EQUAL_size_t(7, spi_mock.trans[0].len);
+    TEST_ASSERT_EQUAL_size_t(1, spi_mock.trans[1].len);
+    TEST_ASSERT_EQUAL_size_t(2, spi_mock.trans[2].len);
+    TEST_ASSERT_EQUAL_size_t(8, spi_mock.trans[3].len);
+    TEST_ASSERT_EQUAL_size_t(3, spi_mock.trans[4].len);
+    for (uint32_t i = 0; i < spi_mock.num_trans; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(spi_mock.windows, spi_mock.trans[i].window);
+        TEST_ASSERT_EQUAL_INT(SPI_MOCK_POLLING, spi_mock.trans[i].kind);
+    }
+
+    wlan_hal_spi_get_stats(&st);
+    TEST_ASSERT_EQUAL_UINT32(5, st.transactions);
+    TEST_ASSERT_EQUAL_UINT32(5, st.polling_transactions);
+    TEST_ASSERT_EQUAL_UINT32(7, st.coalesced_bytes);
+    TEST_ASSERT_EQUAL_UINT32(1, st.cs_assertions);
+    TEST_ASSERT_EQUAL_UINT32(5, st.max_assertion_transactions);
+    TEST_ASSERT_EQUAL_UINT64(sizeof(expected), st.bytes);
+}
+
+static void test_byte_writes(void)
+{
+    wire_reset();
+
+    mmhal_wlan_spi_cs_assert();
+    for (int i = 0; i < BYTE_WRITES; i++)
+    {
+        uint8_t b = i;
+        mmhal_wlan_spi_write_buf(&b, 1);
+    }
+    mmhal_wlan_spi_cs_deassert();
+
+    TEST_ASSERT_EQUAL_UINT32(0, spi_mock.errors);
+    TEST_ASSERT_EQUAL_size_t(BYTE_WRITES, spi_mock.mosi_len);
+    for (int i = 0; i < BYTE_WRITES; i++)
+    {
+        TEST_ASSERT_EQUAL_HEX8((uint8_t)i, spi_mock.mosi[i]);
+    }
+    // 74 + 74 + 52, every one below the interrupt transfer threshold
+    TEST_ASSERT_EQUAL_UINT32(3, spi_mock.num_trans);
+    for (uint32_t i = 0; i < spi_mock.num_trans; i++)
+    {
+        TEST_ASSERT_LESS_THAN(75, spi_mock.trans[i].len);
+        TEST_ASSERT_EQUAL_INT(SPI_MOCK_POLLING, spi_mock.trans[i].kind);
+    }
+
+    // an empty assertion sends nothing
+    wire_reset();
+    mmhal_wlan_spi_cs_assert();
+    mmhal_wlan_spi_cs_deassert();
+    TEST_ASSERT_EQUAL_UINT32(0, spi_mock.num_trans);
+}
+
+/**
+ * Write then read back @p len bytes at @p buf, check the data and the DMA chunks.
+ *
+ * @return Chunks copied through a bounce buffer.
+ */
+static uint32_t large_transfer(uint8_t *buf, size_t len, bool bounce)
+{
+    struct wlan_hal_spi_stats st;
+    uint8_t *src = malloc(len);
+    TEST_ASSERT_NOT_NULL(src);
+    for (size_t i = 0; i < len; i++)
+    {
+        src[i] = (uint8_t)(i * 13);
+    }
+    memcpy(buf, src, len);
+    wire_reset();
+
+    mmhal_wlan_spi_cs_assert();
+    mmhal_wlan_spi_write_buf(buf, len);
+    mmhal_wlan_spi_cs_deassert();
+    TEST_ASSERT_EQUAL_size_t(len, spi_mock.mosi_len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(src, spi_mock.mosi, len);
+    uint32_t writes = spi_mock.num_trans;
+
+    mmhal_wlan_spi_cs_assert();
+    mmhal_wlan_spi_read_buf(buf, len);
+    mmhal_wlan_spi_cs_deassert();
+    for (size_t i = 0; i < len; i++)
+    {
+        TEST_ASSERT_EQUAL_HEX8(spi_mock_slave_byte(i), buf[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, spi_mock.errors);
+    TEST_ASSERT_EQUAL_UINT32(2 * writes, spi_mock.num_trans);
+    for (uint32_t i = 0; i < spi_mock.num_trans; i++)
+    {
+        TEST_ASSERT_LESS_OR_EQUAL(CONFIG_MM_SPI_DMA_CHUNK_SIZE, spi_mock.trans[i].len);
+    }
+
+    wlan_hal_spi_get_stats(&st);
+    printf("%zu bytes %s: %u transactions each way, %d queued at most, %u chunks bounced\n",
+           len, bounce ? "from PSRAM" : "DMA capable", (unsigned)writes, spi_mock.max_queued,
+           (unsigned)st.bounced_chunks);
+    free(src);
+    return st.bounced_chunks;
+}
+
+static void test_large_dma_capable(void)
+{
+    uint8_t *buf = heap_caps_malloc(LARGE_LEN, MALLOC_CAP_DMA);
+    TEST_ASSERT_NOT_NULL(buf);
+
+    TEST_ASSERT_EQUAL_UINT32(0, large_transfer(buf, LARGE_LEN, false));
+    // 2048 + 2048 + 904, two in flight
+    TEST_ASSERT_EQUAL_UINT32(6, spi_mock.num_trans);
+    TEST_ASSERT_EQUAL_INT(SPI_MOCK_QUEUED, spi_mock.trans[0].kind);
+    TEST_ASSERT_EQUAL_INT(2, spi_mock.max_queued);
+
+    // short enough for one transaction, no queueing
+    TEST_ASSERT_EQUAL_UINT32(0, large_transfer(buf, 200, false));
+    TEST_ASSERT_EQUAL_UINT32(2, spi_mock.num_trans);
+    TEST_ASSERT_EQUAL_INT(SPI_MOCK_TRANSMIT, spi_mock.trans[0].kind);
+    TEST_ASSERT_EQUAL_INT(0, spi_mock.max_queued);
+    heap_caps_free(buf);
+}
+
+static void test_large_from_psram(void)
+{
+    size_t size;
+    uint8_t *psram = spi_mock_psram(&size);
+    TEST_ASSERT_GREATER_OR_EQUAL(LARGE_LEN + 3, size);
+
+    TEST_ASSERT_EQUAL_UINT32(6, large_transfer(psram, LARGE_LEN, true));
+    TEST_ASSERT_EQUAL_UINT32(6, spi_mock.num_trans);
+    TEST_ASSERT_EQUAL_INT(2, spi_mock.max_queued);
+    // unaligned, through the bounce buffers as well
+    TEST_ASSERT_EQUAL_UINT32(2, large_transfer(psram + 1, 1537, true));
+    TEST_ASSERT_EQUAL_UINT32(2, spi_mock.num_trans);
+    // the short write is coalesced in the first bounce buffer anyway, the read is bounced by the
+    // HAL rather than the driver
+    TEST_ASSERT_EQUAL_UINT32(1, large_transfer(psram + 3, 40, true));
+    TEST_ASSERT_EQUAL_UINT32(2, spi_mock.num_trans);
+    TEST_ASSERT_EQUAL_INT(SPI_MOCK_POLLING, spi_mock.trans[0].kind);
+}
+
+/**
+ * Without the second bounce buffer, writes must not be held back: the coalesced read answers
+ * from it.
+ */
+static void test_missing_bounce_buffer(void)
+{
+    uint8_t cmd[4] = {1, 2, 3, 4};
+    mmhal_wlan_deinit();
+    spi_mock_fail_malloc(1, 1);
+    mmhal_wlan_init();
+    wire_reset();
+
+    mmhal_wlan_spi_cs_assert();
+    mmhal_wlan_spi_write_buf(cmd, 4);
+    uint8_t r = mmhal_wlan_spi_rw(0xff);
+    mmhal_wlan_spi_cs_deassert();
+
+    TEST_ASSERT_EQUAL_UINT32(0, spi_mock.errors);
+    TEST_ASSERT_EQUAL_UINT32(2, spi_mock.num_trans);
+    TEST_ASSERT_EQUAL_HEX8(spi_mock_slave_byte(4), r);
+
+    mmhal_wlan_deinit();
+    mmhal_wlan_init();
+}
+
+void run_wlan_hal_spi_tests(void)
+{
+    mmhal_wlan_init();
+    RUN_TEST(test_training_sequence);
+    RUN_TEST(test_command_sequence);
+    RUN_TEST(test_byte_writes);
+    RUN_TEST(test_large_dma_capable);
+    RUN_TEST(test_large_from_psram);
+    RUN_TEST(test_missing_bounce_buffer);
+    mmhal_wlan_deinit();
+}
@@ -14,10 +14,15 @@
 
 #include "esp_system.h"
 #include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h"
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
 #include "driver/spi_common.h"
 
+#include "wlan_hal.h"
+
 /** 10x8bit training seq */
 #define BYTE_TRAIN 16
 
@@ -32,6 +37,30 @@ static mmhal_irq_handler_t busy_irq_handler = NULL;
 
 static spi_device_handle_t spi_handle;
 
+/** Bytes moved by one DMA transaction, and size of each bounce buffer */
+#define DMA_CHUNK_SIZE CONFIG_MM_SPI_DMA_CHUNK_SIZE
+
+/** Transactions in flight for double buffering */
+#define DMA_QUEUE_DEPTH 2
+
+/** DMA capable bounce buffers, used in turn by large transfers. The first one also holds the
+ * coalesced writes, which are always sent before a large transfer starts. */
+static uint8_t *dma_buf[DMA_QUEUE_DEPTH];
+
+/** Writes held back in dma_buf[0], sent with the next transfer of the same CS assertion */
+static size_t pending_len;
+
+/** Calls whose data is in pending_len */
+static uint32_t pending_calls;
+
+/** Bus acquired for the current CS assertion */
+static bool bus_acquired;
+
+/** Transactions issued in the current CS assertion */
+static uint32_t window_transactions;
+
+static struct wlan_hal_spi_stats spi_stats;
+
 static void wlan_hal_gpio_init(void)
 {
     gpio_config_t io_conf = {};
@@ -94,7 +123,7 @@ static void wlan_hal_spi_init(void)
         .clock_speed_hz = SPI_MASTER_FREQ_40M,
         .mode = 0,
         .spics_io_num = -1,
-        .queue_size = 1,
+        .queue_size = DMA_QUEUE_DEPTH,
     };
     ret = spi_bus_add_device(SPI2_HOST, &dev_cfg, &spi_handle);
     if (ret != ESP_OK)
@@ -108,10 +137,33 @@ static void wlan_hal_spi_init(void)
     int actual_freq_khz = 0;
     spi_device_get_actual_freq(spi_handle, &actual_freq_khz);
     printf("Actual SPI CLK %dkHz\n", actual_freq_khz);
+
+    for (int i = 0; i < DMA_QUEUE_DEPTH; i++)
+    {
+        dma_buf[i] = heap_caps_malloc(DMA_CHUNK_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        if (dma_buf[i] == NULL)
+        {
+            printf("SPI DMA buffer allocation failed\n");
+        }
+    }
+    pending_len = 0;
+    pending_calls = 0;
+    bus_acquired = false;
 }
 
 static void wlan_hal_spi_deinit(void)
 {
+    if (bus_acquired)
+    {
+        spi_device_release_bus(spi_handle);
+        bus_acquired = false;
+    }
+    for (int i = 0; i < DMA_QUEUE_DEPTH; i++)
+    {
+        heap_caps_free(dma_buf[i]);
+        dma_buf[i] = NULL;
+    }
+
     esp_err_t ret = spi_bus_remove_device(spi_handle);
     if (ret != ESP_OK)
     {
@@ -140,7 +192,26 @@ static void wlan_hal_spi_deinit(void)
  */
 #define INTERRUPT_TRANSFER_MIN_LENGTH 75
 
-static void spi_master_rw(const uint8_t *w_data, uint8_t *r_data, size_t len)
+/** Writes shorter than this are held back and coalesced with the next transfer */
+#define COALESCE_WRITE_MAX_LENGTH INTERRUPT_TRANSFER_MIN_LENGTH
+
+static inline bool dma_direct_ok(const void *buf)
+{
+    return buf == NULL || (esp_ptr_dma_capable(buf) && ((uintptr_t)buf & 3) == 0);
+}
+
+static void spi_stats_account(uint32_t transactions, size_t len, int64_t start_us)
+{
+    spi_stats.transactions += transactions;
+    spi_stats.bytes += len;
+    spi_stats.busy_us += esp_timer_get_time() - start_us;
+    window_transactions += transactions;
+}
+
+/**
+ * One transaction of up to DMA_CHUNK_SIZE bytes, waits for its completion.
+ */
+static void spi_master_rw_single(const uint8_t *w_data, uint8_t *r_data, size_t len)
 {
     spi_transaction_t trans_desc = {
         .rx_buffer = r_data,
@@ -148,21 +219,184 @@ static void spi_master_rw(const uint8_t *w_data, uint8_t *r_data, size_t len)
         .length = (len * 8),
         .flags = 0,
     };
+    int64_t start_us = esp_timer_get_time();
+
+    if (len == 1)
+    {
+        /* Data lives in the descriptor, no DMA buffer to check or bounce */
+        trans_desc.tx_buffer = NULL;
+        trans_desc.rx_buffer = NULL;
+        trans_desc.flags = SPI_TRANS_USE_RXDATA | (w_data ? SPI_TRANS_USE_TXDATA : 0);
+        if (w_data)
+        {
+            trans_desc.tx_data[0] = w_data[0];
+        }
+    }
 
     esp_err_t err;
     if (len < INTERRUPT_TRANSFER_MIN_LENGTH)
     {
         err = spi_device_polling_transmit(spi_handle, &trans_desc);
+        spi_stats.polling_transactions++;
     }
     else
     {
         err = spi_device_transmit(spi_handle, &trans_desc);
+        spi_stats.dma_transactions++;
     }
 
     if (err!= ESP_OK)
     {
         printf("SPI rw error = %x\n", err);
     }
+    else if (len == 1 && r_data)
+    {
+        r_data[0] = trans_desc.rx_data[0];
+    }
+    spi_stats_account(1, len, start_us);
+}
+
+/**
+ * Large transfer, split in DMA_CHUNK_SIZE transactions with two of them queued at once. Buffers
+ * the DMA cannot reach directly go through the two bounce buffers in turn, so copying one chunk
+ * overlaps the transfer of the other.
+ */
+static void spi_master_rw_dma(const uint8_t *w_data, uint8_t *r_data, size_t len)
+{
+    spi_transaction_t trans_desc[DMA_QUEUE_DEPTH];
+    size_t chunk_off[DMA_QUEUE_DEPTH];
+    bool bounce = !dma_direct_ok(w_data) || !dma_direct_ok(r_data);
+    size_t off = 0;
+    unsigned queued = 0;
+    unsigned done = 0;
+    int64_t start_us = esp_timer_get_time();
+
+    while (done < queued || off < len)
+    {
+        if (off < len && queued - done < DMA_QUEUE_DEPTH)
+        {
+            unsigned slot = queued % DMA_QUEUE_DEPTH;
+            size_t n = len - off < DMA_CHUNK_SIZE ? len - off : DMA_CHUNK_SIZE;
+            spi_transaction_t *t = &trans_desc[slot];
+
+            memset(t, 0, sizeof(*t));
+            t->length = n * 8;
+            if (bounce)
+            {
+                if (w_data)
+                {
+                    memcpy(dma_buf[slot], w_data + off, n);
+                    t->tx_buffer = dma_buf[slot];
+                }
+                if (r_data)
+                {
+                    t->rx_buffer = dma_buf[slot];
+                }
+                spi_stats.bounced_chunks++;
+            }
+            else
+            {
+                t->tx_buffer = w_data ? w_data + off : NULL;
+                t->rx_buffer = r_data ? r_data + off : NULL;
+            }
+            chunk_off[slot] = off;
+            if (spi_device_queue_trans(spi_handle, t, portMAX_DELAY) != ESP_OK)
+            {
+                printf("SPI queue error\n");
+                break;
+            }
+            queued++;
+            off += n;
+            spi_stats.dma_transactions++;
+            continue;
+        }
+
+        spi_transaction_t *result;
+        if (spi_device_get_trans_result(spi_handle, &result, portMAX_DELAY) != ESP_OK)
+        {
+            printf("SPI rw error\n");
+            break;
+        }
+        unsigned slot = done % DMA_QUEUE_DEPTH;
+        if (bounce && r_data)
+        {
+            memcpy(r_data + chunk_off[slot], dma_buf[slot], result->length / 8);
+        }
+        done++;
+    }
+
+    /* Nothing may stay queued, the next call can be a polling transaction */
+    while (done < queued)
+    {
+        spi_transaction_t *result;
+        if (spi_device_get_trans_result(spi_handle, &result, portMAX_DELAY) != ESP_OK)
+        {
+            break;
+        }
+        done++;
+    }
+    spi_stats_account(queued, len, start_us);
+}
+
+/**
+ * Send the coalesced writes.
+ */
+static void spi_flush_pending(void)
+{
+    if (pending_len)
+    {
+        size_t len = pending_len;
+        if (pending_calls > 1)
+        {
+            spi_stats.coalesced_bytes += len;
+        }
+        pending_len = 0;
+        pending_calls = 0;
+        spi_master_rw_single(dma_buf[0], NULL, len);
+    }
+}
+
+static void spi_master_rw(const uint8_t *w_data, uint8_t *r_data, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    spi_flush_pending();
+    if (dma_buf[0] == NULL || dma_buf[1] == NULL ||
+        (len <= DMA_CHUNK_SIZE && (len == 1 || (dma_direct_ok(w_data) && dma_direct_ok(r_data)))))
+    {
+        spi_master_rw_single(w_data, r_data, len);
+    }
+    else if (len < INTERRUPT_TRANSFER_MIN_LENGTH)
+    {
+        /* Short transfer from memory the DMA cannot reach: bounce it here rather than have the
+         * driver allocate a buffer for it */
+        if (w_data)
+        {
+            memcpy(dma_buf[0], w_data, len);
+        }
+        spi_master_rw_single(w_data ? dma_buf[0] : NULL, r_data ? dma_buf[1] : NULL, len);
+        spi_stats.bounced_chunks++;
+        if (r_data)
+        {
+            memcpy(r_data, dma_buf[1], len);
+        }
+    }
+    else
+    {
+        spi_master_rw_dma(w_data, r_data, len);
+    }
+}
+
+void wlan_hal_spi_get_stats(struct wlan_hal_spi_stats *stats)
+{
+    *stats = spi_stats;
+}
+
+void wlan_hal_spi_reset_stats(void)
+{
+    memset(&spi_stats, 0, sizeof(spi_stats));
 }
 
 void mmhal_wlan_hard_reset(void)
@@ -175,17 +409,47 @@ void mmhal_wlan_hard_reset(void)
 
 void mmhal_wlan_spi_cs_assert(void)
 {
+    /* Keep the bus for the whole assertion, so the transactions in it skip the bus lock */
+    if (!bus_acquired && spi_device_acquire_bus(spi_handle, portMAX_DELAY) == ESP_OK)
+    {
+        bus_acquired = true;
+    }
+    window_transactions = 0;
+    spi_stats.cs_assertions++;
     gpio_set_level(CONFIG_MM_SPI_CS, 0);
 }
 
 void mmhal_wlan_spi_cs_deassert(void)
 {
+    spi_flush_pending();
     gpio_set_level(CONFIG_MM_SPI_CS, 1);
+    if (window_transactions > spi_stats.max_assertion_transactions)
+    {
+        spi_stats.max_assertion_transactions = window_transactions;
+    }
+    window_transactions = 0;
+    if (bus_acquired)
+    {
+        spi_device_release_bus(spi_handle);
+        bus_acquired = false;
+    }
 }
 
 uint8_t mmhal_wlan_spi_rw(uint8_t data)
 {
     uint8_t readval;
+
+    if (pending_len)
+    {
+        /* Send the coalesced writes and this byte as one transaction, the reply is the last byte */
+        size_t len = pending_len + 1;
+        dma_buf[0][pending_len] = data;
+        pending_len = 0;
+        pending_calls = 0;
+        spi_master_rw_single(dma_buf[0], dma_buf[1], len);
+        spi_stats.coalesced_bytes += len;
+        return dma_buf[1][len - 1];
+    }
     spi_master_rw(&data, &readval, 1);
     return readval;
 }
@@ -197,6 +461,17 @@ void mmhal_wlan_spi_read_buf(uint8_t *buf, unsigned len)
 
 void mmhal_wlan_spi_write_buf(const uint8_t *buf, unsigned len)
 {
+    if (len < COALESCE_WRITE_MAX_LENGTH && bus_acquired && dma_buf[0] != NULL && dma_buf[1] != NULL)
+    {
+        if (pending_len + len >= COALESCE_WRITE_MAX_LENGTH)
+        {
+            spi_flush_pending();
+        }
+        memcpy(dma_buf[0] + pending_len, buf, len);
+        pending_len += len;
+        pending_calls++;
+        return;
+    }
     spi_master_rw(buf, NULL, len);
 }
 
@@ -224,6 +499,7 @@ void mmhal_wlan_register_spi_irq_handler(mmhal_irq_handler_t handler)
 
 bool mmhal_wlan_spi_irq_is_asserted(void)
 {
+    spi_flush_pending();
     return !gpio_get_level(CONFIG_MM_SPI_IRQ);
 }
 
@@ -283,6 +559,7 @@ void mmhal_wlan_wake_deassert(void)
 
 bool mmhal_wlan_busy_is_asserted(void)
 {
+    spi_flush_pending();
     return gpio_get_level(CONFIG_MM_BUSY);
 }
 
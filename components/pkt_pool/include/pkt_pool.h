@@ -0,0 +1,92 @@
+#ifndef __PKT_POOL_H__
+#define __PKT_POOL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef PKT_POOL_HOST
+#include <pthread.h>
+#else
+#include "freertos/FreeRTOS.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Pool counters
+ */
+typedef struct pktPoolStats {
+    uint32_t count;        ///< Blocks in the pool
+    uint32_t inUse;        ///< Blocks handed out now
+    uint32_t peak;         ///< Highest inUse
+    uint32_t poolAllocs;   ///< Allocations served by the pool
+    uint32_t heapAllocs;   ///< Allocations that fell back to the heap (pool empty or packet too big)
+    uint32_t heapFails;    ///< Heap fallbacks that failed
+    uint64_t bytes;        ///< Bytes allocated, both sources
+} pktPoolStats_t;
+
+/**
+ * Fixed-size packet buffer pool with heap fallback
+ */
+typedef struct pktPool {
+    uint8_t *storage;      ///< count blocks of blockSize bytes
+    size_t blockSize;
+    uint32_t count;
+    void *freeList;        ///< Free blocks, linked through their first word
+    pktPoolStats_t stats;
+#ifdef PKT_POOL_HOST
+    pthread_mutex_t lock;
+#else
+    portMUX_TYPE lock;
+#endif
+} pktPool_t;
+
+/**
+ * Initialize a pool over caller provided storage
+ * @param pool Pool
+ * @param storage count * blockSize bytes, pointer aligned; NULL for a heap-only pool
+ * @param blockSize Block size, multiple of the pointer size
+ * @param count Number of blocks
+ */
+void pkt_pool_init(pktPool_t *pool, void *storage, size_t blockSize, uint32_t count);
+
+/**
+ * Get a buffer, from the pool if one is free and big enough, else from the heap
+ * @param pool Pool
+ * @param size Bytes needed
+ * @return Buffer (not zeroed) or NULL
+ */
+void *pkt_pool_alloc(pktPool_t *pool, size_t size);
+
+/**
+ * Get a buffer from pkt_pool_alloc() holding a header followed by a payload
+ * @param pool Pool
+ * @param header Header bytes
+ * @param headSize Header size
+ * @param payload Payload bytes
+ * @param len Payload size
+ * @return Buffer of headSize + len bytes or NULL
+ */
+void *pkt_pool_alloc_frame(pktPool_t *pool, const void *header, size_t headSize, const void *payload, size_t len);
+
+/**
+ * Give back a buffer from pkt_pool_alloc()
+ * @param pool Pool
+ * @param buf Buffer, may be NULL
+ */
+void pkt_pool_free(pktPool_t *pool, void *buf);
+
+/**
+ * Copy the counters
+ * @param pool Pool
+ * @param stats Output
+ */
+void pkt_pool_stats(pktPool_t *pool, pktPoolStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PKT_POOL_H__ */
@@ -0,0 +1,106 @@
+/**
+ * Packet buffer pool
+ *
+ * Hands out fixed-size blocks from preallocated storage so that the receive
+ * path does not go through malloc/free for every packet. Packets bigger than
+ * a block, or arriving while every block is in use, get a heap buffer instead.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "pkt_pool.h"
+
+#ifdef PKT_POOL_HOST
+#define POOL_LOCK(p)        pthread_mutex_lock(&(p)->lock)
+#define POOL_UNLOCK(p)      pthread_mutex_unlock(&(p)->lock)
+#else
+#define POOL_LOCK(p)        portENTER_CRITICAL(&(p)->lock)
+#define POOL_UNLOCK(p)      portEXIT_CRITICAL(&(p)->lock)
+#endif
+
+void pkt_pool_init(pktPool_t *pool, void *storage, size_t blockSize, uint32_t count)
+{
+    memset(pool, 0, sizeof(pktPool_t));
+    if (storage == NULL) {
+        count = 0;
+    }
+    pool->storage = storage;
+    pool->blockSize = blockSize;
+    pool->count = count;
+    pool->stats.count = count;
+    for (uint32_t i = count; i > 0; i--) {
+        void **block = (void **)(pool->storage + (i - 1) * blockSize);
+        *block = pool->freeList;
+        pool->freeList = block;
+    }
+#ifdef PKT_POOL_HOST
+    pthread_mutex_init(&pool->lock, NULL);
+#else
+    portMUX_INITIALIZE(&pool->lock);
+#endif
+}
+
+void *pkt_pool_alloc(pktPool_t *pool, size_t size)
+{
+    void *buf = NULL;
+
+    POOL_LOCK(pool);
+    if (size <= pool->blockSize && pool->freeList) {
+        buf = pool->freeList;
+        pool->freeList = *(void **)buf;
+        pool->stats.poolAllocs++;
+        pool->stats.inUse++;
+        if (pool->stats.inUse > pool->stats.peak) {
+            pool->stats.peak = pool->stats.inUse;
+        }
+    } else {
+        pool->stats.heapAllocs++;
+    }
+    pool->stats.bytes += size;
+    POOL_UNLOCK(pool);
+
+    if (buf == NULL) {
+        buf = malloc(size);
+        if (buf == NULL) {
+            POOL_LOCK(pool);
+            pool->stats.heapFails++;
+            POOL_UNLOCK(pool);
+        }
+    }
+    return buf;
+}
+
+void *pkt_pool_alloc_frame(pktPool_t *pool, const void *header, size_t headSize, const void *payload, size_t len)
+{
+    uint8_t *buf = pkt_pool_alloc(pool, headSize + len);
+
+    if (buf) {
+        memcpy(buf, header, headSize);
+        memcpy(buf + headSize, payload, len);
+    }
+    return buf;
+}
+
+void pkt_pool_free(pktPool_t *pool, void *buf)
+{
+    uint8_t *p = buf;
+
+    if (p == NULL) {
+        return;
+    }
+    if (pool->count == 0 || p < pool->storage || p >= pool->storage + pool->count * pool->blockSize) {
+        free(buf);
+        return;
+    }
+    POOL_LOCK(pool);
+    *(void **)buf = pool->freeList;
+    pool->freeList = buf;
+    pool->stats.inUse--;
+    POOL_UNLOCK(pool);
+}
+
+void pkt_pool_stats(pktPool_t *pool, pktPoolStats_t *stats)
+{
+    POOL_LOCK(pool);
+    *stats = pool->stats;
+    POOL_UNLOCK(pool);
+}
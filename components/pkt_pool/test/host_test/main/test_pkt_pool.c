@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "pkt_pool.h"
+
+/** Pool of the HaLow receive path, MM_RX_POOL_NUM and MM_RX_BUF_SIZE in main/morse.c */
+#define RX_POOL_NUM 8
+#define RX_BUF_SIZE 1536
+/** Frames of the generator run */
+#define GEN_FRAMES 100000
+/** Most buffers lwIP holds at once in the generator run */
+#define GEN_HELD_MAX 11
+/** 802.3 header in front of the payload */
+#define GEN_HEADER 14
+
+static uint8_t s_storage[RX_POOL_NUM * RX_BUF_SIZE] __attribute__((aligned(8)));
+static pktPool_t s_pool;
+
+static bool in_storage(const void *p)
+{
+    return (const uint8_t *)p >= s_storage && (const uint8_t *)p < s_storage + sizeof(s_storage);
+}
+
+static void test_pool_then_heap(void)
+{
+    void *buf[RX_POOL_NUM + 1];
+    pktPoolStats_t st;
+    pkt_pool_init(&s_pool, s_storage, RX_BUF_SIZE, RX_POOL_NUM);
+
+    for (int i = 0; i < RX_POOL_NUM; i++) {
+        buf[i] = pkt_pool_alloc(&s_pool, RX_BUF_SIZE);
+        TEST_ASSERT_TRUE(in_storage(buf[i]));
+    }
+    // every block handed out, the next frame goes to the heap
+    buf[RX_POOL_NUM] = pkt_pool_alloc(&s_pool, 64);
+    TEST_ASSERT_NOT_NULL(buf[RX_POOL_NUM]);
+    TEST_ASSERT_FALSE(in_storage(buf[RX_POOL_NUM]));
+
+    pkt_pool_stats(&s_pool, &st);
+    TEST_ASSERT_EQUAL_UINT32(RX_POOL_NUM, st.inUse);
+    TEST_ASSERT_EQUAL_UINT32(RX_POOL_NUM, st.peak);
+    TEST_ASSERT_EQUAL_UINT32(RX_POOL_NUM, st.poolAllocs);
+    TEST_ASSERT_EQUAL_UINT32(1, st.heapAllocs);
+
+    for (int i = 0; i <= RX_POOL_NUM; i++) {
+        pkt_pool_free(&s_pool, buf[i]);
+    }
+    pkt_pool_stats(&s_pool, &st);
+    TEST_ASSERT_EQUAL_UINT32(0, st.inUse);
+    // the last block freed is the next one handed out
+    TEST_ASSERT_EQUAL_PTR(buf[RX_POOL_NUM - 1], pkt_pool_alloc(&s_pool, 1));
+}
+
+static void test_oversize_uses_heap(void)
+{
+    pktPoolStats_t st;
+    pkt_pool_init(&s_pool, s_storage, RX_BUF_SIZE, RX_POOL_NUM);
+
+    void *big = pkt_pool_alloc(&s_pool, RX_BUF_SIZE + 1);
+    TEST_ASSERT_NOT_NULL(big);
+    TEST_ASSERT_FALSE(in_storage(big));
+    pkt_pool_free(&s_pool, big);
+    pkt_pool_free(&s_pool, NULL);
+
+    pkt_pool_stats(&s_pool, &st);
+    TEST_ASSERT_EQUAL_UINT32(0, st.poolAllocs);
+    TEST_ASSERT_EQUAL_UINT32(1, st.heapAllocs);
+    TEST_ASSERT_EQUAL_UINT32(0, st.inUse);
+    TEST_ASSERT_EQUAL_UINT64(RX_BUF_SIZE + 1, st.bytes);
+}
+
+static void test_heap_only_pool(void)
+{
+    pktPoolStats_t st;
+    // no internal RAM for the storage at init
+    pkt_pool_init(&s_pool, NULL, RX_BUF_SIZE, RX_POOL_NUM);
+
+    void *buf = pkt_pool_alloc(&s_pool, 100);
+    TEST_ASSERT_NOT_NULL(buf);
+    pkt_pool_free(&s_pool, buf);
+    pkt_pool_stats(&s_pool, &st);
+    TEST_ASSERT_EQUAL_UINT32(0, st.count);
+    TEST_ASSERT_EQUAL_UINT32(0, st.poolAllocs);
+    TEST_ASSERT_EQUAL_UINT32(1, st.heapAllocs);
+}
+
+static void test_packet_generator(void)
+{
+    static uint8_t payload[2000];
+    uint8_t header[GEN_HEADER] = {0};
+    void *held[GEN_HELD_MAX + 1];
+    int heldNum = 0;
+    uint32_t seed = 1;
+    pktPoolStats_t st;
+    pkt_pool_init(&s_pool, s_storage, RX_BUF_SIZE, RX_POOL_NUM);
+    memset(payload, 0xab, sizeof(payload));
+
+    for (int i = 0; i < GEN_FRAMES; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t r = seed >> 16;
+        // bulk upload traffic: 90% full frames, the rest any size up to an oversized 1600 bytes
+        unsigned len = r % 100 < 90 ? 1500 : 1 + (r / 100) % 1600;
+        // what wifi_rx_cb() does with each frame
+        uint8_t *buf = pkt_pool_alloc_frame(&s_pool, header, sizeof(header), payload, len);
+        TEST_ASSERT_NOT_NULL(buf);
+        held[heldNum++] = buf;
+        // lwIP keeps a varying number of pbufs queued (TCP reassembly, the socket)
+        int keep = (seed >> 8) % (GEN_HELD_MAX + 1);
+        while (heldNum > keep) {
+            pkt_pool_free(&s_pool, held[0]);
+            memmove(held, held + 1, --heldNum * sizeof(void *));
+        }
+    }
+    while (heldNum) {
+        pkt_pool_free(&s_pool, held[--heldNum]);
+    }
+
+    pkt_pool_stats(&s_pool, &st);
+    double mb = st.bytes / 1048576.0;
+    double heapPerMb = st.heapAllocs / mb;
+    double callocPerMb = (st.poolAllocs + st.heapAllocs) / mb;
+    printf("%.1f MB in %u frames: %u pool, %u heap, peak %u blocks in use\n",
+           mb, GEN_FRAMES, st.poolAllocs, st.heapAllocs, st.peak);
+    printf("heap allocations per MB %.1f, per-frame calloc %.1f\n", heapPerMb, callocPerMb);
+
+    TEST_ASSERT_EQUAL_UINT32(GEN_FRAMES, st.poolAllocs + st.heapAllocs);
+    TEST_ASSERT_EQUAL_UINT32(0, st.inUse);
+    TEST_ASSERT_EQUAL_UINT32(RX_POOL_NUM, st.peak);
+    TEST_ASSERT_EQUAL_UINT32(0, st.heapFails);
+    TEST_ASSERT_LESS_THAN_FLOAT(callocPerMb / 20, heapPerMb);
+}
+
+void app_main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_pool_then_heap);
+    RUN_TEST(test_oversize_uses_heap);
+    RUN_TEST(test_heap_only_pool);
+    RUN_TEST(test_packet_generator);
+    UNITY_END();
+}
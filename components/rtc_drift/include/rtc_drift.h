@@ -0,0 +1,157 @@
+#ifndef __RTC_DRIFT_H__
+#define __RTC_DRIFT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RTC_DRIFT_TEMP_NUM 4      ///< Temperature buckets: <10, 10-25, 25-40, >=40 C
+#define RTC_DRIFT_VOLT_NUM 3      ///< Battery buckets: <4600, 4600-5400, >=5400 mV (misc_get_battery_voltage scale)
+#define RTC_DRIFT_BUCKET_NUM (RTC_DRIFT_TEMP_NUM * RTC_DRIFT_VOLT_NUM)
+#define RTC_DRIFT_GLOBAL RTC_DRIFT_BUCKET_NUM  ///< Fit of every sample, also used when the conditions are unknown
+
+#define RTC_DRIFT_MIN_WEIGHT 3.0f ///< Sample weight before a fit is trusted over the global fit or the prior
+#define RTC_DRIFT_EARLY_S 1       ///< Wakes landing earlier than this before the target are early
+#define RTC_DRIFT_ONTIME_S 30     ///< Wakes landing up to this after the target are on time
+
+/**
+ * Weighted least squares sums of one bucket, for the model
+ * error = a * sleeps + b * hours slept
+ * where error is real time minus RTC time over a sample, in seconds
+ */
+typedef struct rtcDriftFit {
+    float snn;             ///< Sum of sleeps^2
+    float snx;             ///< Sum of sleeps * hours
+    float sxx;             ///< Sum of hours^2
+    float sny;             ///< Sum of sleeps * error
+    float sxy;             ///< Sum of hours * error
+    float syy;             ///< Sum of error^2
+    float weight;          ///< Sum of sample weights, older samples decay
+    uint16_t samples;      ///< Samples added
+} rtcDriftFit_t;
+
+/**
+ * Where timer wakes landed against their target
+ */
+typedef struct rtcDriftWakes {
+    uint32_t measured;     ///< Wakes whose real wake time was measured
+    uint32_t early;        ///< Measured more than RTC_DRIFT_EARLY_S before the target
+    uint32_t onTime;       ///< Measured within the on-time window
+    uint32_t late;         ///< Measured more than RTC_DRIFT_ONTIME_S after the target
+    float lateSum;         ///< Sum of the lateness of the wakes that were not early, seconds
+    float lateMax;         ///< Largest lateness, seconds
+    uint32_t resleeps;     ///< Wakes that found the target not reached and slept again
+} rtcDriftWakes_t;
+
+/**
+ * Sleeps between two syncs, per bucket
+ */
+typedef struct rtcDriftSpan {
+    float sleptS[RTC_DRIFT_BUCKET_NUM + 1];    ///< RTC seconds slept
+    uint16_t sleeps[RTC_DRIFT_BUCKET_NUM + 1]; ///< Deep sleeps
+} rtcDriftSpan_t;
+
+/**
+ * Drift model, kept in RTC memory and saved to flash as a blob
+ */
+typedef struct rtcDrift {
+    uint32_t magic;                               ///< RTC_DRIFT_MAGIC when valid
+    float seedRate;                               ///< Drift rate (real - RTC) / RTC used before any sample
+    rtcDriftFit_t fit[RTC_DRIFT_BUCKET_NUM + 1];  ///< Per bucket, then RTC_DRIFT_GLOBAL
+    rtcDriftWakes_t wakes;
+} rtcDrift_t;
+
+#define RTC_DRIFT_MAGIC 0x44524631  // "DRF1", change with the layout
+
+/**
+ * Prediction for one sleep
+ */
+typedef struct rtcDriftPrediction {
+    float errorS;          ///< Expected real - RTC time, seconds
+    float sigmaS;          ///< Uncertainty of errorS, seconds
+    uint8_t bucket;        ///< Fit used, RTC_DRIFT_GLOBAL when the bucket has too little sample weight
+} rtcDriftPrediction_t;
+
+/**
+ * Start an empty model
+ * @param m Model
+ * @param seedRate Drift rate to assume until samples arrive, e.g. from an older firmware
+ */
+void rtc_drift_init(rtcDrift_t *m, float seedRate);
+
+/**
+ * Check a model restored from memory
+ */
+bool rtc_drift_valid(const rtcDrift_t *m);
+
+/**
+ * Bucket of the conditions during a sleep
+ * @param tempC Chip temperature, NAN if unknown
+ * @param batteryMv Battery voltage, 0 if unknown
+ * @return Bucket, RTC_DRIFT_GLOBAL if either is unknown
+ */
+uint8_t rtc_drift_bucket(float tempC, int batteryMv);
+
+/**
+ * Account one sleep to a span
+ * @param span Span since the last sync
+ * @param bucket Conditions during the sleep
+ * @param sleptS RTC seconds slept
+ */
+void rtc_drift_span_add(rtcDriftSpan_t *span, uint8_t bucket, float sleptS);
+
+/**
+ * Add an observation: the RTC error over a span. The global fit takes it as is,
+ * each bucket takes its own prediction plus its share (by time slept) of what
+ * the model did not predict
+ * @param m Model
+ * @param span Sleeps of the observation
+ * @param errorS Real time minus RTC time over the span
+ * @return false if rejected as implausible (too short, more than 10% off)
+ */
+bool rtc_drift_add(rtcDrift_t *m, const rtcDriftSpan_t *span, float errorS);
+
+/**
+ * Predict the error of one sleep
+ * @param m Model
+ * @param bucket Conditions during the sleep
+ * @param sleptS RTC seconds
+ * @param p Output
+ */
+void rtc_drift_predict(const rtcDrift_t *m, uint8_t bucket, float sleptS, rtcDriftPrediction_t *p);
+
+/**
+ * RTC time whose predicted real length is realS, the inverse of rtc_drift_predict
+ * @param m Model
+ * @param bucket Conditions during the sleep
+ * @param realS Real seconds
+ * @return RTC seconds, no bias and no cap
+ */
+double rtc_drift_rtc_for(const rtcDrift_t *m, uint8_t bucket, double realS);
+
+/**
+ * RTC sleep to program so that the wake lands realS later, plus a small late bias
+ * sized from the model uncertainty so that waking early is unlikely
+ * @param m Model
+ * @param bucket Conditions during the sleep
+ * @param realS Real seconds to the target
+ * @param biasS Output, late bias added (may be NULL)
+ * @return RTC seconds, at least 1
+ */
+uint32_t rtc_drift_sleep_for(const rtcDrift_t *m, uint8_t bucket, uint32_t realS, float *biasS);
+
+/**
+ * Record where a timer wake landed
+ * @param m Model
+ * @param lateS Real wake time minus target, negative when early
+ */
+void rtc_drift_wake_landed(rtcDrift_t *m, float lateS);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RTC_DRIFT_H__ */
@@ -0,0 +1,227 @@
+/**
+ * RTC drift model
+ *
+ * The RTC slow clock runs off the internal RC oscillator, its error depends on
+ * temperature and supply and has a fixed part per sleep (clock calibration,
+ * boot). Every NTP sync gives one observation: how far real time moved from
+ * the RTC-counted time over the sleeps since the previous sync. Observations
+ * are fitted per temperature/battery bucket by least squares on
+ * error = a * sleeps + b * hours slept, older ones fading out. Sleeps are then
+ * programmed from the fit, with a small late bias so the wake does not land
+ * before the target and cost a full boot just to sleep again.
+ */
+#include <math.h>
+#include <string.h>
+#include "rtc_drift.h"
+
+#define FORGET 0.95f              // Weight kept by older samples when one is added
+#define PRIOR_OFFSET_W 0.5f       // Prior weight pulling a to 0 (sleeps^2)
+#define PRIOR_RATE_W 0.5f         // Prior weight pulling b to the seed rate (hours^2)
+#define PRIOR_SIGMA 0.002f        // Uncertainty of a prediction without enough samples, fraction of the sleep
+#define MIN_SLEPT_S 300           // Shorter observations are mostly sync jitter
+#define MAX_RATE 0.1f             // Larger errors are clock jumps, not drift
+#define BIAS_MIN_S 1.0f           // Late bias floor
+#define BIAS_SIGMAS 2.0f          // Late bias in uncertainties
+#define BIAS_MAX_FRAC 0.02f       // Late bias cap, fraction of the sleep
+#define COMP_MAX_FRAC 0.3f        // Compensation cap, fraction of the sleep
+
+static const float g_tempEdges[RTC_DRIFT_TEMP_NUM - 1] = {10.0f, 25.0f, 40.0f};
+static const int g_voltEdges[RTC_DRIFT_VOLT_NUM - 1] = {4600, 5400};
+
+void rtc_drift_init(rtcDrift_t *m, float seedRate)
+{
+    memset(m, 0, sizeof(rtcDrift_t));
+    m->magic = RTC_DRIFT_MAGIC;
+    m->seedRate = (seedRate > -MAX_RATE && seedRate < MAX_RATE) ? seedRate : 0.0f;
+}
+
+bool rtc_drift_valid(const rtcDrift_t *m)
+{
+    return m->magic == RTC_DRIFT_MAGIC && isfinite(m->seedRate);
+}
+
+uint8_t rtc_drift_bucket(float tempC, int batteryMv)
+{
+    int t = 0;
+    int v = 0;
+
+    if (isnan(tempC) || batteryMv <= 0) {
+        return RTC_DRIFT_GLOBAL;
+    }
+    while (t < RTC_DRIFT_TEMP_NUM - 1 && tempC >= g_tempEdges[t]) {
+        t++;
+    }
+    while (v < RTC_DRIFT_VOLT_NUM - 1 && batteryMv >= g_voltEdges[v]) {
+        v++;
+    }
+    return t * RTC_DRIFT_VOLT_NUM + v;
+}
+
+/**
+ * Solve a fit, with weak priors so one sample (or samples all of the same
+ * length) still gives a usable answer
+ * @return Residual standard deviation per hour slept, negative if not enough samples
+ */
+static float fit_solve(const rtcDriftFit_t *f, float seedRate, float *a, float *b)
+{
+    float b0 = seedRate * 3600.0f;
+    float m00 = f->snn + PRIOR_OFFSET_W;
+    float m01 = f->snx;
+    float m11 = f->sxx + PRIOR_RATE_W;
+    float r0 = f->sny;
+    float r1 = f->sxy + PRIOR_RATE_W * b0;
+    float det = m00 * m11 - m01 * m01;
+
+    if (f->samples == 0 || det <= 0.0f) {
+        *a = 0.0f;
+        *b = b0;
+        return -1.0f;
+    }
+    *a = (r0 * m11 - r1 * m01) / det;
+    *b = (m00 * r1 - m01 * r0) / det;
+    if (f->weight < RTC_DRIFT_MIN_WEIGHT) {
+        return -1.0f;
+    }
+    float rss = f->syy - 2.0f * (*a * f->sny + *b * f->sxy)
+                + *a * *a * f->snn + 2.0f * *a * *b * f->snx + *b * *b * f->sxx;
+    // Samples span several sleeps, scale the residual to their typical length
+    return sqrtf(fmaxf(rss, 0.0f) / (f->weight - 2.0f)) / sqrtf(f->sxx / f->weight);
+}
+
+void rtc_drift_predict(const rtcDrift_t *m, uint8_t bucket, float sleptS, rtcDriftPrediction_t *p)
+{
+    float a, b;
+
+    if (bucket > RTC_DRIFT_GLOBAL || m->fit[bucket].weight < RTC_DRIFT_MIN_WEIGHT) {
+        bucket = RTC_DRIFT_GLOBAL;
+    }
+    float sigma = fit_solve(&m->fit[bucket], m->seedRate, &a, &b);
+    p->bucket = bucket;
+    p->errorS = a + b * sleptS / 3600.0f;
+    p->sigmaS = sigma < 0.0f ? PRIOR_SIGMA * sleptS : sigma * sleptS / 3600.0f;
+}
+
+static void fit_add(rtcDriftFit_t *f, float w, float n, float x, float y)
+{
+    f->snn = f->snn * FORGET + w * n * n;
+    f->snx = f->snx * FORGET + w * n * x;
+    f->sxx = f->sxx * FORGET + w * x * x;
+    f->sny = f->sny * FORGET + w * n * y;
+    f->sxy = f->sxy * FORGET + w * x * y;
+    f->syy = f->syy * FORGET + w * y * y;
+    f->weight = f->weight * FORGET + w;
+    if (f->samples < UINT16_MAX) {
+        f->samples++;
+    }
+}
+
+void rtc_drift_span_add(rtcDriftSpan_t *span, uint8_t bucket, float sleptS)
+{
+    if (bucket > RTC_DRIFT_GLOBAL) {
+        bucket = RTC_DRIFT_GLOBAL;
+    }
+    span->sleptS[bucket] += sleptS;
+    if (span->sleeps[bucket] < UINT16_MAX) {
+        span->sleeps[bucket]++;
+    }
+}
+
+bool rtc_drift_add(rtcDrift_t *m, const rtcDriftSpan_t *span, float errorS)
+{
+    float slept = 0;
+    float sleeps = 0;
+    float predicted = 0;
+    float share[RTC_DRIFT_BUCKET_NUM];
+    float a, b;
+
+    for (int i = 0; i <= RTC_DRIFT_BUCKET_NUM; i++) {
+        slept += span->sleptS[i];
+        sleeps += span->sleeps[i];
+    }
+    if (sleeps == 0 || slept < MIN_SLEPT_S || fabsf(errorS) > slept * MAX_RATE) {
+        return false;
+    }
+
+    // What each bucket's own fit expects of its part, the rest is split by time
+    for (int i = 0; i < RTC_DRIFT_BUCKET_NUM; i++) {
+        int f = m->fit[i].weight < RTC_DRIFT_MIN_WEIGHT ? RTC_DRIFT_GLOBAL : i;
+        fit_solve(&m->fit[f], m->seedRate, &a, &b);
+        share[i] = a * span->sleeps[i] + b * span->sleptS[i] / 3600.0f;
+        predicted += share[i];
+    }
+    fit_solve(&m->fit[RTC_DRIFT_GLOBAL], m->seedRate, &a, &b);
+    predicted += a * span->sleeps[RTC_DRIFT_GLOBAL] + b * span->sleptS[RTC_DRIFT_GLOBAL] / 3600.0f;
+
+    for (int i = 0; i < RTC_DRIFT_BUCKET_NUM; i++) {
+        if (span->sleptS[i] < MIN_SLEPT_S) {
+            continue;
+        }
+        float frac = span->sleptS[i] / slept;
+        fit_add(&m->fit[i], frac, span->sleeps[i], span->sleptS[i] / 3600.0f,
+                share[i] + (errorS - predicted) * frac);
+    }
+    fit_add(&m->fit[RTC_DRIFT_GLOBAL], 1.0f, sleeps, slept / 3600.0f, errorS);
+    return true;
+}
+
+double rtc_drift_rtc_for(const rtcDrift_t *m, uint8_t bucket, double realS)
+{
+    rtcDriftPrediction_t p;
+    float a, b;
+
+    /* Real time of an RTC sleep s is s + a + b * s / 3600, solve for realS */
+    rtc_drift_predict(m, bucket, 0, &p);
+    fit_solve(&m->fit[p.bucket], m->seedRate, &a, &b);
+    return (realS - a) / (1.0 + b / 3600.0);
+}
+
+uint32_t rtc_drift_sleep_for(const rtcDrift_t *m, uint8_t bucket, uint32_t realS, float *biasS)
+{
+    rtcDriftPrediction_t p;
+    float bias;
+
+    if (realS <= 1) {
+        if (biasS) {
+            *biasS = 0.0f;
+        }
+        return 1;
+    }
+    rtc_drift_predict(m, bucket, realS, &p);
+    bias = BIAS_MIN_S + BIAS_SIGMAS * p.sigmaS;
+    if (bias > BIAS_MAX_FRAC * realS && BIAS_MAX_FRAC * realS > BIAS_MIN_S) {
+        bias = BIAS_MAX_FRAC * realS;
+    }
+    float sleep = (float)rtc_drift_rtc_for(m, p.bucket, realS + bias);
+
+    if (sleep > realS * (1.0f + COMP_MAX_FRAC)) {
+        sleep = realS * (1.0f + COMP_MAX_FRAC);
+    } else if (sleep < realS * (1.0f - COMP_MAX_FRAC)) {
+        sleep = realS * (1.0f - COMP_MAX_FRAC);
+    }
+    if (biasS) {
+        *biasS = bias;
+    }
+    return sleep < 1.0f ? 1 : (uint32_t)lroundf(sleep);
+}
+
+void rtc_drift_wake_landed(rtcDrift_t *m, float lateS)
+{
+    rtcDriftWakes_t *w = &m->wakes;
+
+    w->measured++;
+    if (lateS < -RTC_DRIFT_EARLY_S) {
+        w->early++;
+        return;
+    }
+    if (lateS > RTC_DRIFT_ONTIME_S) {
+        w->late++;
+    } else {
+        w->onTime++;
+    }
+    if (lateS > 0.0f) {
+        w->lateSum += lateS;
+        if (lateS > w->lateMax) {
+            w->lateMax = lateS;
+        }
+    }
+}
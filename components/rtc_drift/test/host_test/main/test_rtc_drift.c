@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "unity.h"
+#include "rtc_drift.h"
+
+/** Days of the wake log replay */
+#define REPLAY_DAYS 28
+/** Time awake after each timer wake, on the RTC as well as in real time */
+#define AWAKE_S 20
+/** Wakes planned before the model has samples, from the seed rate and the prior uncertainty only */
+#define WARMUP_WAKES 3
+/** Boot of a wake that found its target not reached, before it sleeps again */
+#define RESLEEP_BOOT_S 1.5
+
+/**
+ * Conditions of one sleep of the synthetic wake log
+ */
+typedef struct wakeLog {
+    double tempC;
+    int batteryMv;
+    double noiseS;          ///< Random part of the RTC error of the sleep
+} wakeLog_t;
+
+/**
+ * Simulated RC slow clock
+ */
+typedef struct rcClock {
+    double rate;            ///< (real - RTC) / RTC at 25 C and 5000 mV
+    double offsetS;         ///< Fixed error per sleep: calibration, boot
+} rcClock_t;
+
+static uint32_t s_seed;
+
+/** Uniform in [-0.5, 0.5) */
+static double noise(void)
+{
+    s_seed = s_seed * 1103515245 + 12345;
+    return (s_seed >> 8) / (double)(1 << 24) - 0.5;
+}
+
+/**
+ * Real duration of an RTC sleep: the rate moves with temperature and supply
+ */
+static double real_sleep(const rcClock_t *c, double rtcS, const wakeLog_t *w)
+{
+    double rate = c->rate + 0.00008 * (w->tempC - 25) - 0.000001 * (w->batteryMv - 5000);
+    return rtcS + c->offsetS + rate * rtcS + w->noiseS;
+}
+
+/**
+ * 20 +/- 8 C daily swing, battery slowly draining, 0.6 s of noise per sleep
+ */
+static wakeLog_t *log_generate(int n, int intervalS)
+{
+    wakeLog_t *l = calloc(n, sizeof(wakeLog_t));
+    double t = 0;
+    s_seed = 1;
+    for (int i = 0; i < n; i++) {
+        double hour = fmod(t / 3600, 24);
+        l[i].tempC = 20 + 8 * sin((hour - 9) / 24 * 2 * M_PI);
+        l[i].batteryMv = 5600 - (int)(t / 86400 * 30);
+        l[i].noiseS = noise() * 0.6;
+        t += intervalS;
+    }
+    return l;
+}
+
+typedef struct replayResult {
+    int wakes;
+    int resleeps;           ///< Wakes whose corrected clock was short of the target
+    int early;              ///< Wakes after the warm-up more than RTC_DRIFT_EARLY_S before the target
+    int late30;             ///< Wakes more than 30 s after the target
+    double lateMean;        ///< Mean lateness, seconds
+    rtcDrift_t model;
+} replayResult_t;
+
+/**
+ * The firmware's sleep cycle with NTP on every wake: sleep_start() programs
+ * rtc_drift_sleep_for(), time_compensation_boot() moves the clock by the
+ * predicted error, a wake short of its target sleeps the rest and
+ * record_sync_event() adds the sample
+ */
+static void replay(const rcClock_t *c, int intervalS, replayResult_t *r)
+{
+    int n = REPLAY_DAYS * 86400 / intervalS;
+    wakeLog_t *l = log_generate(n, intervalS);
+    rtcDriftSpan_t span;
+    double real = 0, sys = 0, corr = 0, syncReal = 0;
+    double lateSum = 0;
+
+    memset(r, 0, sizeof(replayResult_t));
+    memset(&span, 0, sizeof(span));
+    rtc_drift_init(&r->model, 0);
+    for (int i = 0; i < n; i++) {
+        rtcDriftPrediction_t p;
+        uint8_t b = rtc_drift_bucket(l[i].tempC, l[i].batteryMv);
+        double target = real + intervalS;
+        uint32_t rtc = rtc_drift_sleep_for(&r->model, b, intervalS, NULL);
+
+        real += real_sleep(c, rtc, &l[i]);
+        rtc_drift_predict(&r->model, b, rtc, &p);
+        sys += rtc + p.errorS;
+        corr += p.errorS;
+        rtc_drift_span_add(&span, b, rtc);
+        if (sys < target) {
+            uint32_t rest = rtc_drift_sleep_for(&r->model, b, (uint32_t)ceil(target - sys), NULL);
+            r->resleeps++;
+            real += RESLEEP_BOOT_S + real_sleep(c, rest, &l[i]);
+            rtc_drift_predict(&r->model, b, rest, &p);
+            sys += RESLEEP_BOOT_S + rest + p.errorS;
+            corr += p.errorS;
+            rtc_drift_span_add(&span, b, rest);
+        }
+
+        double late = real - target;
+        rtc_drift_wake_landed(&r->model, late);
+        if (late < -RTC_DRIFT_EARLY_S && i >= WARMUP_WAKES) {
+            r->early++;
+        }
+        if (late > 30) {
+            r->late30++;
+        }
+        if (late > 0) {
+            lateSum += late;
+        }
+        real += AWAKE_S;
+        sys += AWAKE_S;
+
+        if (syncReal != 0) {
+            rtc_drift_add(&r->model, &span, (float)(floor(real) - floor(sys) + corr));
+        }
+        memset(&span, 0, sizeof(span));
+        sys = real;
+        syncReal = real;
+        corr = 0;
+    }
+    r->wakes = n;
+    r->lateMean = lateSum / n;
+    free(l);
+}
+
+static void test_bucket(void)
+{
+    TEST_ASSERT_EQUAL_INT(RTC_DRIFT_GLOBAL, rtc_drift_bucket(NAN, 5000));
+    TEST_ASSERT_EQUAL_INT(RTC_DRIFT_GLOBAL, rtc_drift_bucket(20.0f, 0));
+    TEST_ASSERT_EQUAL_INT(0, rtc_drift_bucket(-5.0f, 4000));
+    TEST_ASSERT_EQUAL_INT(1 * RTC_DRIFT_VOLT_NUM + 1, rtc_drift_bucket(10.0f, 4600));
+    TEST_ASSERT_EQUAL_INT(2 * RTC_DRIFT_VOLT_NUM + 2, rtc_drift_bucket(39.9f, 5400));
+    TEST_ASSERT_EQUAL_INT(RTC_DRIFT_BUCKET_NUM - 1, rtc_drift_bucket(60.0f, 6000));
+}
+
+static void test_seed_prediction(void)
+{
+    rtcDrift_t m;
+    rtcDriftPrediction_t p;
+    float bias;
+
+    rtc_drift_init(&m, 0.004f);
+    TEST_ASSERT_TRUE(rtc_drift_valid(&m));
+    rtc_drift_predict(&m, 0, 3600, &p);
+    TEST_ASSERT_EQUAL_INT(RTC_DRIFT_GLOBAL, p.bucket);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 14.4f, p.errorS);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 7.2f, p.sigmaS);
+
+    // the clock runs slow: sleep less RTC time, the bias keeps the wake after the target
+    uint32_t rtc = rtc_drift_sleep_for(&m, 0, 3600, &bias);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 15.4f, bias);
+    TEST_ASSERT_INT_WITHIN(1, (int)lround((3600 + bias) / 1.004), rtc);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, (3600 + bias) / 1.004, rtc_drift_rtc_for(&m, 0, 3600 + bias));
+    TEST_ASSERT_EQUAL_UINT32(1, rtc_drift_sleep_for(&m, 0, 1, &bias));
+
+    // an implausible seed is ignored
+    rtc_drift_init(&m, 0.5f);
+    rtc_drift_predict(&m, RTC_DRIFT_GLOBAL, 3600, &p);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, p.errorS);
+}
+
+static void test_add_rejects_implausible(void)
+{
+    rtcDrift_t m;
+    rtcDriftSpan_t span;
+    rtc_drift_init(&m, 0);
+
+    memset(&span, 0, sizeof(span));
+    TEST_ASSERT_FALSE(rtc_drift_add(&m, &span, 0.0f));
+    rtc_drift_span_add(&span, 0, 200);
+    TEST_ASSERT_FALSE(rtc_drift_add(&m, &span, 0.5f));
+    rtc_drift_span_add(&span, 0, 1000);
+    // more than 10% of the time slept is a clock jump, not drift
+    TEST_ASSERT_FALSE(rtc_drift_add(&m, &span, 200.0f));
+    TEST_ASSERT_EQUAL_UINT32(0, m.fit[RTC_DRIFT_GLOBAL].samples);
+    TEST_ASSERT_TRUE(rtc_drift_add(&m, &span, 5.0f));
+    TEST_ASSERT_EQUAL_UINT32(1, m.fit[RTC_DRIFT_GLOBAL].samples);
+    // bucket 0 slept long enough to get its share
+    TEST_ASSERT_EQUAL_UINT32(1, m.fit[0].samples);
+}
+
+static void test_fit_recovers_model(void)
+{
+    rtcDrift_t m;
+    rtcDriftPrediction_t p;
+    rtc_drift_init(&m, 0);
+
+    // 0.4 s per sleep and 0.4%, alternating one long sleep and many short ones so that both show
+    for (int i = 0; i < 40; i++) {
+        rtcDriftSpan_t span;
+        int sleeps = i % 2 ? 1 : 8;
+        float sleptS = i % 2 ? 4 * 3600 : 300;
+        memset(&span, 0, sizeof(span));
+        for (int k = 0; k < sleeps; k++) {
+            rtc_drift_span_add(&span, 4, sleptS);
+        }
+        TEST_ASSERT_TRUE(rtc_drift_add(&m, &span, 0.4f * sleeps + 0.004f * sleeps * sleptS));
+    }
+    rtc_drift_predict(&m, 4, 3600, &p);
+    TEST_ASSERT_EQUAL_INT(4, p.bucket);
+    TEST_ASSERT_FLOAT_WITHIN(0.2f, 0.4f + 14.4f, p.errorS);
+    TEST_ASSERT_LESS_THAN_FLOAT(0.5f, p.sigmaS);
+    // no sample in another bucket, the global fit answers
+    rtc_drift_predict(&m, 7, 3600, &p);
+    TEST_ASSERT_EQUAL_INT(RTC_DRIFT_GLOBAL, p.bucket);
+    TEST_ASSERT_FLOAT_WITHIN(0.2f, 0.4f + 14.4f, p.errorS);
+}
+
+static void test_wake_landed(void)
+{
+    rtcDrift_t m;
+    rtc_drift_init(&m, 0);
+
+    rtc_drift_wake_landed(&m, -5.0f);
+    rtc_drift_wake_landed(&m, -0.5f);
+    rtc_drift_wake_landed(&m, 12.0f);
+    rtc_drift_wake_landed(&m, 45.0f);
+    TEST_ASSERT_EQUAL_UINT32(4, m.wakes.measured);
+    TEST_ASSERT_EQUAL_UINT32(1, m.wakes.early);
+    TEST_ASSERT_EQUAL_UINT32(2, m.wakes.onTime);
+    TEST_ASSERT_EQUAL_UINT32(1, m.wakes.late);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 57.0f, m.wakes.lateSum);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 45.0f, m.wakes.lateMax);
+}
+
+static void test_replay_28_days(void)
+{
+    static const rcClock_t clocks[] = {
+        { .rate = 0.004, .offsetS = 0.4 },
+        { .rate = -0.004, .offsetS = 0.4 },
+        { .rate = 0.0005, .offsetS = 0.4 },
+    };
+    static const int intervals[] = {600, 1800, 3600};
+    replayResult_t r;
+
+    for (size_t c = 0; c < sizeof(clocks) / sizeof(clocks[0]); c++) {
+        for (size_t k = 0; k < sizeof(intervals) / sizeof(intervals[0]); k++) {
+            rtcDriftPrediction_t p;
+            replay(&clocks[c], intervals[k], &r);
+            rtc_drift_predict(&r.model, RTC_DRIFT_GLOBAL, intervals[k], &p);
+            printf("rate %+.4f interval %4ds: %d wakes, %d resleeps, %u early (%d after warm-up), %d late>30s, "
+                   "mean late %.2fs, predicted error %+.2fs +/-%.2f\n", clocks[c].rate, intervals[k], r.wakes,
+                   r.resleeps, r.model.wakes.early, r.early, r.late30, r.lateMean, p.errorS, p.sigmaS);
+
+            // none costing a boot just to sleep again, no wake before its target once the model has samples
+            TEST_ASSERT_EQUAL_INT(0, r.resleeps);
+            TEST_ASSERT_EQUAL_INT(0, r.early);
+            TEST_ASSERT_LESS_OR_EQUAL(WARMUP_WAKES, r.model.wakes.early);
+            TEST_ASSERT_EQUAL_INT(0, r.late30);
+            TEST_ASSERT_LESS_THAN_FLOAT(5.0f, r.lateMean);
+        }
+    }
+}
+
+void app_main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bucket);
+    RUN_TEST(test_seed_prediction);
+    RUN_TEST(test_add_rejects_implausible);
+    RUN_TEST(test_fit_recovers_model);
+    RUN_TEST(test_wake_landed);
+    RUN_TEST(test_replay_28_days);
+    UNITY_END();
+}
@@ -0,0 +1,87 @@
+/*
+ * This file is part of the struct2json Library.
+ *
+ * Function: Scoped arena allocator for cJSON trees.
+ *
+ * s2j_arena_install() points the cJSON hooks at this allocator. Between
+ * s2j_arena_begin() and s2j_arena_end() every cJSON allocation made by the
+ * calling task is carved out of the arena buffer and freeing it is a no-op,
+ * the whole arena is reset at the end of the scope. Allocations that do not
+ * fit, and all allocations outside a scope, go to the heap as before.
+ *
+ * Nothing allocated inside a scope may be used after s2j_arena_end(); use
+ * s2j_arena_detach() for printed strings that leave the scope.
+ */
+
+#ifndef __S2J_ARENA_H__
+#define __S2J_ARENA_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Allocation granularity, enough for the doubles inside cJSON items */
+#define S2J_ARENA_ALIGN               8
+
+typedef struct S2jArenaStats {
+    uint32_t allocs;                  /* allocations served from the arena */
+    uint32_t heap_allocs;             /* allocations that overflowed to the heap */
+    size_t peak;                      /* highest arena usage in bytes */
+} S2jArenaStats;
+
+typedef struct S2jArena {
+    const char *name;
+    size_t size;                      /* buffer size, allocated on first use and kept */
+    uint8_t *buf;
+    size_t used;
+    size_t last;                      /* offset of the newest allocation, for LIFO frees */
+    void *owner;                      /* task running the scope, NULL when idle */
+    S2jArenaStats stats;              /* current scope */
+    struct S2jArena *next;
+} S2jArena;
+
+/* Define an arena; the buffer is allocated the first time a scope opens */
+#define S2J_ARENA_DEFINE(var, arena_name, arena_size) \
+    static S2jArena var = { .name = arena_name, .size = arena_size }
+
+/**
+ * Install the arena allocator as cJSON hooks, once at startup before any
+ * scope is opened. Outside scopes it behaves like malloc/free.
+ */
+void s2j_arena_install(void);
+
+/**
+ * Open a scope on the calling task.
+ *
+ * @return true if the scope was opened and s2j_arena_end() must be called;
+ *         false if the arena is busy on another task, the calling task is
+ *         already inside a scope (allocations keep going to that one) or the
+ *         buffer could not be allocated.
+ */
+bool s2j_arena_begin(S2jArena *arena);
+
+/**
+ * Close the scope and reset the arena.
+ *
+ * @param stats optional, receives the scope statistics
+ */
+void s2j_arena_end(S2jArena *arena, S2jArenaStats *stats);
+
+/**
+ * Move a string allocated inside a scope to the heap so it outlives the
+ * scope; the result is freed with cJSON_free() or free(). Strings already
+ * on the heap are returned unchanged.
+ *
+ * @return the heap string, NULL on allocation failure (str is released)
+ */
+char *s2j_arena_detach(char *str);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __S2J_ARENA_H__ */
@@ -0,0 +1,161 @@
+/*
+ * This file is part of the struct2json Library.
+ *
+ * Function: Scoped arena allocator for cJSON trees.
+ */
+
+#include "../inc/s2j_arena.h"
+#include "cJSON.h"
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+
+static S2jArena *s_arenas;            /* arenas that own a buffer */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Arena of the scope opened by the calling task.
+ * Owners only change from their own task, so no lock is needed to find ours.
+ */
+static S2jArena *arena_current(void) {
+    void *self = xTaskGetCurrentTaskHandle();
+    S2jArena *arena;
+
+    for (arena = s_arenas; arena; arena = arena->next) {
+        if (arena->owner == self) {
+            return arena;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Arena whose buffer holds the pointer, NULL for heap pointers
+ */
+static S2jArena *arena_of(const void *ptr) {
+    const uint8_t *p = (const uint8_t *)ptr;
+    S2jArena *arena;
+
+    for (arena = s_arenas; arena; arena = arena->next) {
+        if (p >= arena->buf && p < arena->buf + arena->size) {
+            return arena;
+        }
+    }
+    return NULL;
+}
+
+static void *arena_malloc(size_t sz) {
+    S2jArena *arena = arena_current();
+    size_t need = (sz + S2J_ARENA_ALIGN - 1) & ~(size_t)(S2J_ARENA_ALIGN - 1);
+    void *p;
+
+    if (arena) {
+        if (need <= arena->size - arena->used) {
+            p = arena->buf + arena->used;
+            arena->last = arena->used;
+            arena->used += need;
+            arena->stats.allocs++;
+            if (arena->used > arena->stats.peak) {
+                arena->stats.peak = arena->used;
+            }
+            return p;
+        }
+        arena->stats.heap_allocs++;
+    }
+    return malloc(sz);
+}
+
+static void arena_free(void *ptr) {
+    S2jArena *arena = arena_of(ptr);
+
+    if (!arena) {
+        free(ptr);
+        return;
+    }
+    /* Arena memory is reclaimed at the end of the scope, only give back the newest block */
+    if (arena->owner == xTaskGetCurrentTaskHandle() && (uint8_t *)ptr == arena->buf + arena->last) {
+        arena->used = arena->last;
+    }
+}
+
+void s2j_arena_install(void) {
+    cJSON_Hooks hooks = {
+        .malloc_fn = arena_malloc,
+        .free_fn = arena_free,
+    };
+
+    cJSON_InitHooks(&hooks);
+}
+
+bool s2j_arena_begin(S2jArena *arena) {
+    void *self = xTaskGetCurrentTaskHandle();
+    uint8_t *buf = NULL;
+    S2jArena *it;
+    bool opened = false;
+
+    if (arena_current()) {
+        return false;
+    }
+    if (!arena->buf) {
+        buf = heap_caps_malloc(arena->size, MALLOC_CAP_SPIRAM);
+        if (!buf) {
+            buf = malloc(arena->size);
+        }
+        if (!buf) {
+            return false;
+        }
+    }
+
+    taskENTER_CRITICAL(&s_lock);
+    if (!arena->buf) {
+        arena->buf = buf;
+        buf = NULL;
+        for (it = s_arenas; it && it != arena; it = it->next) {
+        }
+        if (!it) {
+            arena->next = s_arenas;
+            s_arenas = arena;
+        }
+    }
+    if (!arena->owner) {
+        arena->used = 0;
+        arena->last = 0;
+        memset(&arena->stats, 0, sizeof(arena->stats));
+        arena->owner = self;
+        opened = true;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    /* Lost the race to allocate the buffer */
+    free(buf);
+    return opened;
+}
+
+void s2j_arena_end(S2jArena *arena, S2jArenaStats *stats) {
+    if (stats) {
+        *stats = arena->stats;
+    }
+    taskENTER_CRITICAL(&s_lock);
+    arena->used = 0;
+    arena->last = 0;
+    arena->owner = NULL;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+char *s2j_arena_detach(char *str) {
+    size_t len;
+    char *p;
+
+    if (!str || !arena_of(str)) {
+        return str;
+    }
+    len = strlen(str) + 1;
+    p = malloc(len);
+    if (p) {
+        memcpy(p, str, len);
+    }
+    arena_free(str);
+    return p;
+}
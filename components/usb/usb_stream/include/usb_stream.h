@@ -31,6 +31,7 @@ extern "C" {
 #define FLAG_UVC_SUSPEND_AFTER_START      (1 << 0)              /*!< suspend uvc after usb_streaming_start */
 #define FLAG_UAC_SPK_SUSPEND_AFTER_START  (1 << 1)              /*!< suspend uac speaker after usb_streaming_start */
 #define FLAG_UAC_MIC_SUSPEND_AFTER_START  (1 << 2)              /*!< suspend uac microphone after usb_streaming_start */
+#define UVC_FRAME_POOL_MAX                8                     /*!< max buffers of the uvc frame pool */
 
 /**
  * @brief UVC stream usb transfer type, most camera using isochronous mode,
@@ -116,10 +117,13 @@ typedef struct uvc_config {
     uint16_t frame_height;          /*!< Picture height, set FRAME_RESOLUTION_ANY for any resolution */
     uint32_t frame_interval;        /*!< Frame interval in 100-ns units, 666666 ~ 15 Fps*/
     uint32_t xfer_buffer_size;      /*!< Transfer buffer size, using double buffer here, must larger than one frame size */
-    uint8_t *xfer_buffer_a;         /*!< Buffer a for usb payload */
-    uint8_t *xfer_buffer_b;         /*!< Buffer b for usb payload */
-    uint32_t frame_buffer_size;     /*!< Frame buffer size, must larger than one frame size */
-    uint8_t *frame_buffer;          /*!< Buffer for one frame */
+    uint8_t *xfer_buffer_a;         /*!< Buffer a for usb payload, not used with frame_pool */
+    uint8_t *xfer_buffer_b;         /*!< Buffer b for usb payload, not used with frame_pool */
+    uint32_t frame_buffer_size;     /*!< Frame buffer size, must larger than one frame size, defaults to xfer_buffer_size with frame_pool */
+    uint8_t *frame_buffer;          /*!< Buffer for one frame, not used with frame_pool */
+    uint8_t frame_pool_num;         /*!< (optional) Number of frame_pool buffers (2 ~ UVC_FRAME_POOL_MAX), 0 to copy frames through xfer_buffer_a/b and frame_buffer */
+    uint8_t **frame_pool;           /*!< (optional) Buffers of xfer_buffer_size bytes, frames are assembled in place and passed to frame_cb
+                                         by reference, each frame must be returned with uvc_frame_release() */
     uvc_frame_callback_t frame_cb;  /*!< callback function to handle incoming frame */
     void *frame_cb_arg;             /*!< callback function arg */
     uvc_format_t format;            /*!< (optional) UVC stream format, default using MJPEG */
@@ -222,6 +226,20 @@ typedef struct {
  */
 esp_err_t uvc_streaming_config(const uvc_config_t *config);
 
+/**
+ * @brief Return a frame passed to frame_cb to the frame pool, only used when
+ * uvc_config_t::frame_pool_num is set. Each frame must be released exactly once, either
+ * inside frame_cb or later from any task. Frames not released are skipped by the driver,
+ * which drops the new frames when no pool buffer is free.
+ *
+ * @param frame frame passed to frame_cb
+ * @return esp_err_t
+ *      ESP_ERR_INVALID_STATE frame pool not configured, or the frame is not held by the user
+ *      ESP_ERR_INVALID_ARG frame is not a pool frame
+ *      ESP_OK Success
+ */
+esp_err_t uvc_frame_release(uvc_frame_t *frame);
+
 /**
  * @brief Config UAC streaming with user defined parameters.For normal use, user only need to specify
  * no-optional parameters, and set optional parameters to 0 (the driver will find the correct value from the device descriptors).
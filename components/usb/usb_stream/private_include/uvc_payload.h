@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Assembler behaviour flags, set from the stream config and Kconfig
+ */
+#define UVC_PAYLOAD_FLAG_BULK               (1 << 0)    /*!< Payloads come from bulk transfers */
+#define UVC_PAYLOAD_FLAG_REASSEMBLE         (1 << 1)    /*!< Bulk payloads are split across several transfers */
+#define UVC_PAYLOAD_FLAG_CHECK_EOH          (1 << 2)    /*!< Headers must have the EOH bit set */
+#define UVC_PAYLOAD_FLAG_CHECK_EOF          (1 << 3)    /*!< The EOF bit completes a frame */
+#define UVC_PAYLOAD_FLAG_CHECK_BULK_JPEG    (1 << 4)    /*!< Reassembled bulk payloads must start with a JPEG SOI */
+#define UVC_PAYLOAD_FLAG_DROP_NO_EOF        (1 << 5)    /*!< Drop frames ended by a FID toggle instead of an EOF */
+#define UVC_PAYLOAD_FLAG_DROP_OVERFLOW      (1 << 6)    /*!< Drop frames larger than the buffer instead of publishing them truncated */
+
+/**
+ * @brief Events reported by uvc_payload_process(), or-ed together
+ */
+#define UVC_PAYLOAD_EV_FRAME                (1 << 0)    /*!< A frame was handed to frame_done */
+#define UVC_PAYLOAD_EV_ERROR                (1 << 1)    /*!< Header with the error bit set, payload ignored */
+#define UVC_PAYLOAD_EV_BOGUS                (1 << 2)    /*!< Payload without a valid header outside of reassembly */
+#define UVC_PAYLOAD_EV_DROP_NO_EOF          (1 << 3)    /*!< Frame dropped on a FID toggle */
+#define UVC_PAYLOAD_EV_DROP_OVERFLOW        (1 << 4)    /*!< Frame dropped, larger than the buffer */
+#define UVC_PAYLOAD_EV_NO_BUFFER            (1 << 5)    /*!< Data discarded, no buffer to assemble into */
+
+typedef struct uvc_payload uvc_payload_t;
+
+/**
+ * @brief Called when a frame is complete
+ *
+ * The frame is the first `got_bytes` of `buf`, `pts` and `last_scr` hold its timestamps.
+ * The callback may replace `buf` with another buffer of `buf_size` bytes to keep the
+ * frame; the assembler then restarts at the beginning of `buf`.
+ * `got_bytes` is 0 at the end of a frame discarded because `buf` was NULL, so the
+ * callback can supply a buffer for the next frame.
+ *
+ * @return true if the frame was handed over, false if it was dropped and `buf` is reused as is
+ */
+typedef bool (*uvc_payload_frame_cb_t)(uvc_payload_t *pl, void *arg);
+
+/**
+ * @brief Assembler statistics, counted since uvc_payload_init()
+ */
+typedef struct {
+    uint32_t payloads;          /*!< Payloads processed */
+    uint32_t frames;            /*!< Frames handed over by frame_done */
+    uint32_t errors;            /*!< Payloads with the error bit set */
+    uint32_t bogus;             /*!< Payloads without a valid header */
+    uint32_t dropped;           /*!< Frames dropped (no EOF, overflow, refused by frame_done) */
+    uint32_t no_buffer;         /*!< Payloads discarded for lack of a buffer */
+    uint64_t bytes_copied;      /*!< Payload data copied into the frame buffers */
+} uvc_payload_stats_t;
+
+/**
+ * @brief UVC payload assembler, joins the data of payloads into frames
+ */
+struct uvc_payload {
+    uint32_t flags;                 /*!< UVC_PAYLOAD_FLAG_* */
+    uint8_t *buf;                   /*!< Frame being assembled, NULL to discard the data */
+    size_t buf_size;                /*!< Size of `buf` */
+    uvc_payload_frame_cb_t frame_done;  /*!< Frame completion callback */
+    void *arg;                      /*!< Argument of frame_done */
+    size_t got_bytes;               /*!< Bytes of the frame assembled so far */
+    uint32_t pts;                   /*!< PTS of the frame, 0 if none */
+    uint32_t last_scr;              /*!< SCR of the frame, 0 if none */
+    uint8_t fid;                    /*!< Frame ID bit of the last header */
+    uint8_t reassembling;           /*!< A bulk payload continues in the next transfer */
+    uint8_t no_buffer;              /*!< Data of the current frame was discarded, `buf` was NULL */
+    uint8_t overflow;               /*!< Current frame overflowed `buf`, its data is skipped until the next frame */
+    uvc_payload_stats_t stats;      /*!< Statistics */
+};
+
+/**
+ * @brief Reset the assembler
+ *
+ * @param pl assembler
+ * @param flags UVC_PAYLOAD_FLAG_*
+ * @param buf first frame buffer, may be NULL
+ * @param buf_size size of each frame buffer
+ * @param frame_done frame completion callback
+ * @param arg argument of frame_done
+ */
+void uvc_payload_init(uvc_payload_t *pl, uint32_t flags, uint8_t *buf, size_t buf_size,
+                      uvc_payload_frame_cb_t frame_done, void *arg);
+
+/**
+ * @brief Process one payload of a UVC transfer
+ *
+ * @param pl assembler
+ * @param req_len requested transfer length
+ * @param payload payload received
+ * @param payload_len payload length
+ * @return UVC_PAYLOAD_EV_* that happened while processing the payload
+ */
+uint32_t uvc_payload_process(uvc_payload_t *pl, size_t req_len, const uint8_t *payload, size_t payload_len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,404 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "unity.h"
+#include "uvc_payload.h"
+
+#define TEST_MPS            512             /* isoc payload size */
+#define TEST_BULK_XFER      2048            /* bulk transfer size */
+#define TEST_BUF_SIZE       (64 * 1024)     /* frame pool buffer size */
+#define TEST_POOL_MAX       4
+#define TEST_FRAMES_MAX     32
+
+#define HEADER_FID          (1 << 0)
+#define HEADER_EOF          (1 << 1)
+#define HEADER_PTS          (1 << 2)
+#define HEADER_SCR          (1 << 3)
+#define HEADER_ERR          (1 << 6)
+#define HEADER_EOH          (1 << 7)
+
+#define FLAGS_ISOC          (UVC_PAYLOAD_FLAG_CHECK_EOF | UVC_PAYLOAD_FLAG_DROP_OVERFLOW)
+
+/**
+ * @brief Frame pool of the test, works like the zero-copy pool of usb_stream:
+ * frame_done hands the buffer to the "user" and continues in a free one
+ */
+typedef struct {
+    uint8_t pool[TEST_POOL_MAX][TEST_BUF_SIZE];
+    int num;                                /*!< buffers in use */
+    int fill;                               /*!< buffer being assembled, -1 if none */
+    bool held[TEST_POOL_MAX];               /*!< buffer delivered and not released */
+    bool auto_release;                      /*!< release each frame once checked */
+    int frames;                             /*!< frames delivered */
+    int dropped;                            /*!< frames dropped, no buffer free */
+    uint32_t id[TEST_FRAMES_MAX];           /*!< frame id found in the delivered data */
+    size_t size[TEST_FRAMES_MAX];
+    uint32_t pts[TEST_FRAMES_MAX];
+    bool intact[TEST_FRAMES_MAX];           /*!< data matches the frame id */
+    int slot[TEST_FRAMES_MAX];
+} test_pool_t;
+
+static test_pool_t s_pool;
+
+/* Frames are a JPEG SOI, the frame id and a pattern derived from the id */
+#define FRAME_MIN_SIZE      6
+
+static uint8_t frame_byte(uint32_t id, size_t offset)
+{
+    if (offset < 2) {
+        return offset ? 0xd8 : 0xff;
+    }
+    if (offset < FRAME_MIN_SIZE) {
+        return (id >> (8 * (offset - 2))) & 0xff;
+    }
+    return (id * 31 + offset) & 0xff;
+}
+
+static bool frame_intact(const uint8_t *data, size_t size, uint32_t *id)
+{
+    if (size < FRAME_MIN_SIZE || data[0] != 0xff || data[1] != 0xd8) {
+        return false;
+    }
+    *id = data[2] | (data[3] << 8) | (data[4] << 16) | ((uint32_t)data[5] << 24);
+    for (size_t i = FRAME_MIN_SIZE; i < size; i++) {
+        if (data[i] != frame_byte(*id, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int pool_take_free(test_pool_t *p)
+{
+    for (int i = 0; i < p->num; i++) {
+        if (i != p->fill && !p->held[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool pool_frame_done(uvc_payload_t *pl, void *arg)
+{
+    test_pool_t *p = (test_pool_t *)arg;
+    int next = pool_take_free(p);
+
+    if (pl->got_bytes == 0) {
+        p->fill = next;
+        pl->buf = (next < 0) ? NULL : p->pool[next];
+        return false;
+    }
+    if (next < 0) {
+        p->dropped++;
+        return false;
+    }
+    TEST_ASSERT_TRUE(p->frames < TEST_FRAMES_MAX);
+    TEST_ASSERT_TRUE(pl->buf == p->pool[p->fill]);
+    int n = p->frames++;
+    p->size[n] = pl->got_bytes;
+    p->pts[n] = pl->pts;
+    p->slot[n] = p->fill;
+    p->intact[n] = frame_intact(pl->buf, pl->got_bytes, &p->id[n]);
+    p->held[p->fill] = !p->auto_release;
+    p->fill = next;
+    pl->buf = p->pool[next];
+    return true;
+}
+
+static void pool_init(uvc_payload_t *pl, uint32_t flags, int num, bool auto_release, bool start_empty)
+{
+    memset(&s_pool, 0, sizeof(s_pool));
+    s_pool.num = num;
+    s_pool.auto_release = auto_release;
+    s_pool.fill = start_empty ? -1 : 0;
+    uvc_payload_init(pl, flags, start_empty ? NULL : s_pool.pool[0], TEST_BUF_SIZE, pool_frame_done, &s_pool);
+}
+
+static void pool_release(int slot)
+{
+    TEST_ASSERT_TRUE(s_pool.held[slot]);
+    s_pool.held[slot] = false;
+}
+
+/**
+ * @brief Send a frame as isochronous payloads with 12 bytes headers (PTS + SCR)
+ *
+ * @param skip_eof send the last payload without EOF, as cameras relying on the FID toggle do
+ * @return events of all payloads
+ */
+static uint32_t send_isoc_frame(uvc_payload_t *pl, uint32_t id, size_t size, bool skip_eof)
+{
+    uint8_t payload[TEST_MPS];
+    uint8_t fid = id & 1;
+    uint32_t pts = id * 1000;
+    uint32_t events = 0;
+    size_t sent = 0;
+
+    while (sent < size) {
+        size_t chunk = size - sent;
+        if (chunk > TEST_MPS - 12) {
+            chunk = TEST_MPS - 12;
+        }
+        bool last = (sent + chunk == size);
+        payload[0] = 12;
+        payload[1] = HEADER_EOH | HEADER_PTS | HEADER_SCR | fid | ((last && !skip_eof) ? HEADER_EOF : 0);
+        memcpy(payload + 2, &pts, 4);
+        memset(payload + 6, 0x5a, 6);
+        for (size_t i = 0; i < chunk; i++) {
+            payload[12 + i] = frame_byte(id, sent + i);
+        }
+        events |= uvc_payload_process(pl, TEST_MPS, payload, 12 + chunk);
+        sent += chunk;
+    }
+    return events;
+}
+
+/**
+ * @brief Send a frame as one bulk payload split across transfers, only the first one has a header
+ */
+static uint32_t send_bulk_frame(uvc_payload_t *pl, uint32_t id, size_t size)
+{
+    uint8_t xfer[TEST_BULK_XFER];
+    uint32_t events = 0;
+    size_t sent = 0;
+    bool first = true;
+
+    while (first || sent < size) {
+        size_t header = first ? 2 : 0;
+        size_t chunk = size - sent;
+        if (chunk > TEST_BULK_XFER - header) {
+            chunk = TEST_BULK_XFER - header;
+        }
+        if (first) {
+            xfer[0] = 2;
+            xfer[1] = HEADER_EOH | (id & 1);
+        }
+        for (size_t i = 0; i < chunk; i++) {
+            xfer[header + i] = frame_byte(id, sent + i);
+        }
+        events |= uvc_payload_process(pl, TEST_BULK_XFER, xfer, header + chunk);
+        if (sent + chunk == size && header + chunk == TEST_BULK_XFER) {
+            // the payload ends on a transfer boundary, close it with a zero length packet
+            events |= uvc_payload_process(pl, TEST_BULK_XFER, xfer, 0);
+        }
+        sent += chunk;
+        first = false;
+    }
+    return events;
+}
+
+static void test_isoc_frames_assembled_in_place(void)
+{
+    uvc_payload_t pl;
+    const size_t sizes[] = {30000, FRAME_MIN_SIZE, TEST_MPS - 12, TEST_MPS - 11, TEST_BUF_SIZE, 12345};
+    const int count = sizeof(sizes) / sizeof(sizes[0]);
+    size_t total = 0;
+
+    pool_init(&pl, FLAGS_ISOC, 3, true, false);
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_UINT32(UVC_PAYLOAD_EV_FRAME, send_isoc_frame(&pl, 100 + i, sizes[i], false));
+        TEST_ASSERT_EQUAL(sizes[i], s_pool.size[i]);
+        total += sizes[i];
+    }
+    TEST_ASSERT_EQUAL(count, s_pool.frames);
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(s_pool.intact[i]);
+        TEST_ASSERT_EQUAL_UINT32(100 + i, s_pool.id[i]);
+        TEST_ASSERT_EQUAL_UINT32((100 + i) * 1000, s_pool.pts[i]);
+    }
+    // buffers rotate through the pool
+    TEST_ASSERT_EQUAL(0, s_pool.slot[0]);
+    TEST_ASSERT_EQUAL(1, s_pool.slot[1]);
+    TEST_ASSERT_EQUAL(0, s_pool.slot[2]);
+    // each byte of the frames is copied once, from the USB transfer into the pool buffer
+    TEST_ASSERT_EQUAL_UINT32(total, (uint32_t)pl.stats.bytes_copied);
+    TEST_ASSERT_EQUAL_UINT32(count, pl.stats.frames);
+    TEST_ASSERT_EQUAL_UINT32(0, pl.stats.dropped);
+    printf("assembled %d frames, %u B: %u B copied per frame in place, "
+           "%u B computed for the copy path (3 x copied bytes: xfer buffer -> frame_buffer -> user buffer)\n",
+           count, (unsigned)total, (unsigned)(pl.stats.bytes_copied / count),
+           (unsigned)(3 * pl.stats.bytes_copied / count));
+}
+
+static void test_fid_toggle_completes_frame(void)
+{
+    uvc_payload_t pl;
+
+    pool_init(&pl, UVC_PAYLOAD_FLAG_DROP_OVERFLOW, 3, true, false);
+    TEST_ASSERT_EQUAL_UINT32(0, send_isoc_frame(&pl, 1, 5000, true));
+    TEST_ASSERT_EQUAL(0, s_pool.frames);
+    // the first payload of the next frame toggles FID and publishes the previous one
+    TEST_ASSERT_EQUAL_UINT32(UVC_PAYLOAD_EV_FRAME, send_isoc_frame(&pl, 2, 3000, true));
+    TEST_ASSERT_EQUAL(1, s_pool.frames);
+    send_isoc_frame(&pl, 3, 100, true);
+    TEST_ASSERT_EQUAL(2, s_pool.frames);
+    TEST_ASSERT_TRUE(s_pool.intact[0] && s_pool.intact[1]);
+    TEST_ASSERT_EQUAL(5000, s_pool.size[0]);
+    TEST_ASSERT_EQUAL(3000, s_pool.size[1]);
+}
+
+static void test_missing_eof_dropped(void)
+{
+    uvc_payload_t pl;
+
+    pool_init(&pl, FLAGS_ISOC | UVC_PAYLOAD_FLAG_DROP_NO_EOF, 3, true, false);
+    TEST_ASSERT_EQUAL_UINT32(0, send_isoc_frame(&pl, 1, 5000, true));
+    TEST_ASSERT_EQUAL_UINT32(UVC_PAYLOAD_EV_DROP_NO_EOF | UVC_PAYLOAD_EV_FRAME, send_isoc_frame(&pl, 2, 3000, false));
+    TEST_ASSERT_EQUAL(1, s_pool.frames);
+    TEST_ASSERT_EQUAL_UINT32(2, s_pool.id[0]);
+    TEST_ASSERT_TRUE(s_pool.intact[0]);
+    TEST_ASSERT_EQUAL_UINT32(1, pl.stats.dropped);
+
+    // without DROP_NO_EOF the frame is published on the toggle
+    pool_init(&pl, FLAGS_ISOC, 3, true, false);
+    send_isoc_frame(&pl, 1, 5000, true);
+    send_isoc_frame(&pl, 2, 3000, false);
+    TEST_ASSERT_EQUAL(2, s_pool.frames);
+}
+
+static void test_error_and_bogus_payloads(void)
+{
+    uvc_payload_t pl;
+    uint8_t payload[TEST_MPS] = {0};
+
+    pool_init(&pl, FLAGS_ISOC, 3, true, false);
+    send_isoc_frame(&pl, 1, 2000, false);
+
+    payload[0] = 2;
+    payload[1] = HEADER_EOH | HEADER_ERR | HEADER_EOF;
+    TEST_ASSERT_EQUAL_UINT32(UVC_PAYLOAD_EV_ERROR, uvc_payload_process(&pl, TEST_MPS, payload, 100));
+    // no header: length byte does not match
+    payload[0] = 0x33;
+    payload[1] = 0x44;
+    TEST_ASSERT_EQUAL_UINT32(UVC_PAYLOAD_EV_BOGUS, uvc_payload_process(&pl, TEST_MPS, payload, 20));
+    // reserved bits set
+    payload[0] = 2;
+    payload[1] = 0x30;
+    TEST_ASSERT_EQUAL_UINT32(UVC_PAYLOAD_EV_BOGUS, uvc_payload_process(&pl, TEST_MPS, payload, 20));
+    // empty isochronous payloads are ignored
+    TEST_ASSERT_EQUAL_UINT32(0, uvc_payload_process(&pl, TEST_MPS, payload, 0));
+
+    send_isoc_frame(&pl, 2, 2000, false);
+    TEST_ASSERT_EQUAL(2, s_pool.frames);
+    TEST_ASSERT_TRUE(s_pool.intact[1]);
+    TEST_ASSERT_EQUAL(2000, s_pool.size[1]);
+    TEST_ASSERT_EQUAL_UINT32(1, pl.stats.errors);
+    TEST_ASSERT_EQUAL_UINT32(2, pl.stats.bogus);
+}
+
+static void test_overflow(void)
+{
+    uvc_payload_t pl;
+
+    pool_init(&pl, FLAGS_ISOC, 3, true, false);
+    uint32_t events = send_isoc_frame(&pl, 1, TEST_BUF_SIZE + 1000, false);
+    TEST_ASSERT_TRUE(events & UVC_PAYLOAD_EV_DROP_OVERFLOW);
+    TEST_ASSERT_EQUAL(0, s_pool.frames);
+    send_isoc_frame(&pl, 2, 1000, false);
+    TEST_ASSERT_EQUAL(1, s_pool.frames);
+    TEST_ASSERT_EQUAL_UINT32(2, s_pool.id[0]);
+    TEST_ASSERT_TRUE(s_pool.intact[0]);
+
+    // without DROP_OVERFLOW the truncated frame is published, and the rest is not a frame of its own
+    pool_init(&pl, UVC_PAYLOAD_FLAG_CHECK_EOF, 3, true, false);
+    send_isoc_frame(&pl, 1, TEST_BUF_SIZE + 1000, false);
+    TEST_ASSERT_EQUAL(1, s_pool.frames);
+    TEST_ASSERT_TRUE(s_pool.size[0] <= TEST_BUF_SIZE);
+    TEST_ASSERT_TRUE(s_pool.intact[0]);
+    send_isoc_frame(&pl, 2, 1000, false);
+    TEST_ASSERT_EQUAL(2, s_pool.frames);
+    TEST_ASSERT_EQUAL(1000, s_pool.size[1]);
+}
+
+static void test_bulk_reassembly(void)
+{
+    uvc_payload_t pl;
+    uint32_t flags = UVC_PAYLOAD_FLAG_BULK | UVC_PAYLOAD_FLAG_REASSEMBLE | UVC_PAYLOAD_FLAG_CHECK_EOF
+                     | UVC_PAYLOAD_FLAG_CHECK_BULK_JPEG | UVC_PAYLOAD_FLAG_DROP_OVERFLOW;
+
+    pool_init(&pl, flags, 3, true, false);
+    send_bulk_frame(&pl, 2, 10000);
+    send_bulk_frame(&pl, 3, 2 * TEST_BULK_XFER - 2);   // ends with a zero length packet
+    send_bulk_frame(&pl, 4, 100);
+    TEST_ASSERT_EQUAL(2, s_pool.frames);
+    TEST_ASSERT_EQUAL(10000, s_pool.size[0]);
+    TEST_ASSERT_EQUAL(2 * TEST_BULK_XFER - 2, s_pool.size[1]);
+    TEST_ASSERT_TRUE(s_pool.intact[0] && s_pool.intact[1]);
+
+    // a transfer that is neither a header nor a continuation is bogus
+    uint8_t junk[64];
+    memset(junk, 0x11, sizeof(junk));
+    TEST_ASSERT_EQUAL_UINT32(0, uvc_payload_process(&pl, TEST_BULK_XFER, junk, 0));
+    TEST_ASSERT_EQUAL_UINT32(UVC_PAYLOAD_EV_BOGUS, uvc_payload_process(&pl, TEST_BULK_XFER, junk, sizeof(junk)));
+}
+
+static void test_pool_exhausted(void)
+{
+    uvc_payload_t pl;
+
+    // the user keeps every frame: the second frame has no buffer to go to and is dropped
+    pool_init(&pl, FLAGS_ISOC, 2, false, false);
+    send_isoc_frame(&pl, 1, 4000, false);
+    send_isoc_frame(&pl, 2, 4000, false);
+    TEST_ASSERT_EQUAL(1, s_pool.frames);
+    TEST_ASSERT_EQUAL(1, s_pool.dropped);
+    TEST_ASSERT_EQUAL_UINT32(1, pl.stats.frames);
+    TEST_ASSERT_EQUAL_UINT32(1, pl.stats.dropped);
+    pool_release(s_pool.slot[0]);
+    send_isoc_frame(&pl, 3, 4000, false);
+    TEST_ASSERT_EQUAL(2, s_pool.frames);
+    TEST_ASSERT_EQUAL_UINT32(3, s_pool.id[1]);
+    TEST_ASSERT_TRUE(s_pool.intact[1]);
+
+    // no buffer at all when the stream starts: the first frame is discarded, not torn
+    pool_init(&pl, FLAGS_ISOC, 2, true, true);
+    s_pool.held[0] = s_pool.held[1] = true;
+    uint32_t events = send_isoc_frame(&pl, 1, 4000, false);
+    TEST_ASSERT_TRUE(events & UVC_PAYLOAD_EV_NO_BUFFER);
+    TEST_ASSERT_NULL(pl.buf);
+    pool_release(1);
+    send_isoc_frame(&pl, 2, 4000, false);   // starts without buffer, the EOF gets one
+    TEST_ASSERT_EQUAL(0, s_pool.frames);
+    TEST_ASSERT_TRUE(pl.buf == s_pool.pool[1]);
+    pool_release(0);
+    send_isoc_frame(&pl, 3, 4000, false);
+    TEST_ASSERT_EQUAL(1, s_pool.frames);
+    TEST_ASSERT_EQUAL_UINT32(3, s_pool.id[0]);
+    TEST_ASSERT_TRUE(s_pool.intact[0]);
+}
+
+static void test_no_buffer_until_fid_toggle(void)
+{
+    uvc_payload_t pl;
+
+    // cameras without EOF: the FID toggle is the only boundary to pick up a buffer
+    pool_init(&pl, UVC_PAYLOAD_FLAG_DROP_OVERFLOW, 2, true, true);
+    send_isoc_frame(&pl, 1, 3000, true);
+    TEST_ASSERT_NULL(pl.buf);
+    send_isoc_frame(&pl, 2, 3000, true);
+    send_isoc_frame(&pl, 3, 3000, true);
+    TEST_ASSERT_EQUAL(1, s_pool.frames);
+    TEST_ASSERT_EQUAL_UINT32(2, s_pool.id[0]);
+    TEST_ASSERT_TRUE(s_pool.intact[0]);
+    TEST_ASSERT_EQUAL(3000, s_pool.size[0]);
+}
+
+void app_main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_isoc_frames_assembled_in_place);
+    RUN_TEST(test_fid_toggle_completes_frame);
+    RUN_TEST(test_missing_eof_dropped);
+    RUN_TEST(test_error_and_bogus_payloads);
+    RUN_TEST(test_overflow);
+    RUN_TEST(test_bulk_reassembly);
+    RUN_TEST(test_pool_exhausted);
+    RUN_TEST(test_no_buffer_until_fid_toggle);
+    UNITY_END();
+}
@@ -34,6 +34,7 @@
 #include "usb_host_helpers.h"
 #include "usb_stream.h"
 #include "usb_stream_sysview.h"
+#include "uvc_payload.h"
 
 static const char *TAG = "USB_STREAM";
 
@@ -432,14 +433,15 @@ typedef struct {
     uint8_t running;
     /** Current control block */
     struct uvc_stream_ctrl cur_ctrl;
-    uint8_t fid;
     uint8_t reassemble_flag;
-    uint8_t reassembling;
+    /** Assembles the payloads into the xfer buffer not held, or into a frame pool buffer */
+    uvc_payload_t payload;
+    int8_t fill_slot;
     uint32_t seq, hold_seq;
-    uint32_t pts, hold_pts;
-    uint32_t last_scr, hold_last_scr;
-    size_t got_bytes, hold_bytes;
-    uint8_t *outbuf, *holdbuf;
+    uint32_t hold_pts;
+    uint32_t hold_last_scr;
+    size_t hold_bytes;
+    uint8_t *holdbuf;
     uvc_frame_callback_t user_cb;
     void *user_ptr;
     SemaphoreHandle_t cb_mutex;
@@ -602,6 +604,25 @@ static portMUX_TYPE s_uvc_lock = portMUX_INITIALIZER_UNLOCKED;
 #define UVC_ENTER_CRITICAL()           portENTER_CRITICAL(&s_uvc_lock)
 #define UVC_EXIT_CRITICAL()            portEXIT_CRITICAL(&s_uvc_lock)
 
+typedef enum {
+    POOL_SLOT_FREE = 0,
+    POOL_SLOT_FILLING,
+    POOL_SLOT_READY,
+    POOL_SLOT_USER,
+} _pool_slot_state_t;
+
+/**
+ * @brief Frame pool for zero-copy delivery, see uvc_config_t::frame_pool
+ * Kept out of the stream handle, frames held by the user survive a stream restart
+ */
+typedef struct {
+    uint8_t num;
+    uvc_frame_t frames[UVC_FRAME_POOL_MAX];
+    _pool_slot_state_t state[UVC_FRAME_POOL_MAX];
+} _uvc_frame_pool_t;
+
+static _uvc_frame_pool_t s_frame_pool = {0};
+
 typedef enum {
     USER_EVENT,
     PORT_EVENT,
@@ -2249,8 +2270,9 @@ static esp_err_t uvc_camera_control(stream_ctrl_t ctrl_type, void *ctrl_value)
 /**
  * @brief Swap the working buffer with the presented buffer and notify consumers
  */
-IRAM_ATTR static void _uvc_swap_buffers(_uvc_stream_handle_t *strmh)
+IRAM_ATTR static bool _uvc_swap_buffers(uvc_payload_t *pl, void *arg)
 {
+    _uvc_stream_handle_t *strmh = (_uvc_stream_handle_t *)arg;
     /* to prevent the latest data from being lost
     * if take mutex timeout, we should drop the last frame */
     size_t timeout_ms = 0;
@@ -2268,33 +2290,85 @@ IRAM_ATTR static void _uvc_swap_buffers(_uvc_stream_handle_t *strmh)
         /* code */
         /* swap the buffers */
         uint8_t *tmp_buf = strmh->holdbuf;
-        strmh->hold_bytes = strmh->got_bytes;
-        strmh->holdbuf = strmh->outbuf;
-        strmh->outbuf = tmp_buf;
-        strmh->hold_last_scr = strmh->last_scr;
-        strmh->hold_pts = strmh->pts;
+        strmh->hold_bytes = pl->got_bytes;
+        strmh->holdbuf = pl->buf;
+        pl->buf = tmp_buf;
+        strmh->hold_last_scr = pl->last_scr;
+        strmh->hold_pts = pl->pts;
         strmh->hold_seq = strmh->seq;
         ESP_LOGV(TAG, "uvc swap buffer length = %d", strmh->hold_bytes);
         xTaskNotifyGive(strmh->taskh);
         xSemaphoreGive(strmh->cb_mutex);
     } else {
         ESP_LOGD(TAG, "timeout drop frame = %"PRIu32"", strmh->seq);
+        strmh->seq++;
+        return false;
     }
 
     strmh->seq++;
-    strmh->got_bytes = 0;
-    strmh->last_scr = 0;
-    strmh->pts = 0;
+    return true;
 }
 
 /**
- * @brief Clean buffer without swap
+ * @brief Take a frame pool slot and move it to another state
+ *
+ * @param from state of the slot to take, the oldest frame is taken first
+ * @param to new state of the slot
+ * @return slot index, -1 if no slot is in the from state
  */
-IRAM_ATTR static void _uvc_drop_buffers(_uvc_stream_handle_t *strmh)
+IRAM_ATTR static int _uvc_pool_take(_pool_slot_state_t from, _pool_slot_state_t to)
 {
-    strmh->got_bytes = 0;
-    strmh->last_scr = 0;
-    strmh->pts = 0;
+    int slot = -1;
+    UVC_ENTER_CRITICAL();
+    for (int i = 0; i < s_frame_pool.num; i++) {
+        if (s_frame_pool.state[i] == from
+                && (slot < 0 || (int32_t)(s_frame_pool.frames[i].sequence - s_frame_pool.frames[slot].sequence) < 0)) {
+            slot = i;
+        }
+    }
+    if (slot >= 0) {
+        s_frame_pool.state[slot] = to;
+    }
+    UVC_EXIT_CRITICAL();
+    return slot;
+}
+
+/**
+ * @brief Hand the assembled pool buffer to the sample task and continue in a free one,
+ * the frame is dropped if no buffer is free
+ */
+IRAM_ATTR static bool _uvc_pool_frame_done(uvc_payload_t *pl, void *arg)
+{
+    _uvc_stream_handle_t *strmh = (_uvc_stream_handle_t *)arg;
+    int next = _uvc_pool_take(POOL_SLOT_FREE, POOL_SLOT_FILLING);
+
+    if (pl->got_bytes == 0) {
+        // the frame was discarded for lack of a buffer, continue in the one found if any
+        strmh->fill_slot = next;
+        pl->buf = (next < 0) ? NULL : s_frame_pool.frames[next].data;
+        return false;
+    }
+    if (next < 0) {
+        // keep assembling into the current buffer
+        ESP_LOGD(TAG, "no free frame buffer, drop frame = %"PRIu32"", strmh->seq);
+        strmh->seq++;
+        return false;
+    }
+    uvc_frame_t *frame = &s_frame_pool.frames[strmh->fill_slot];
+    frame->frame_format = strmh->frame_format;
+    frame->width = s_usb_dev.uvc->frame_width;
+    frame->height = s_usb_dev.uvc->frame_height;
+    frame->step = 0;
+    frame->sequence = strmh->seq;
+    frame->data_bytes = pl->got_bytes;
+    UVC_ENTER_CRITICAL();
+    s_frame_pool.state[strmh->fill_slot] = POOL_SLOT_READY;
+    UVC_EXIT_CRITICAL();
+    strmh->fill_slot = next;
+    pl->buf = s_frame_pool.frames[next].data;
+    xTaskNotifyGive(strmh->taskh);
+    strmh->seq++;
+    return true;
 }
 
 /**
@@ -2320,6 +2394,30 @@ void _uvc_populate_frame(_uvc_stream_handle_t *strmh)
     memcpy(frame->data, strmh->holdbuf, frame->data_bytes);
 }
 
+/**
+ * @brief Assembler flags selected by Kconfig
+ */
+static uint32_t _uvc_payload_config_flags(void)
+{
+    uint32_t flags = 0;
+#ifdef CONFIG_UVC_CHECK_HEADER_EOH
+    flags |= UVC_PAYLOAD_FLAG_CHECK_EOH;
+#endif
+#if CONFIG_UVC_CHECK_HEADER_EOF
+    flags |= UVC_PAYLOAD_FLAG_CHECK_EOF;
+#endif
+#ifdef CONFIG_UVC_CHECK_BULK_JPEG_HEADER
+    flags |= UVC_PAYLOAD_FLAG_CHECK_BULK_JPEG;
+#endif
+#if CONFIG_UVC_DROP_NO_EOF_FRAME
+    flags |= UVC_PAYLOAD_FLAG_DROP_NO_EOF;
+#endif
+#if CONFIG_UVC_DROP_OVERFLOW_FRAME
+    flags |= UVC_PAYLOAD_FLAG_DROP_OVERFLOW;
+#endif
+    return flags;
+}
+
 /**
  * @brief Process each payload of uvc transfer
  *
@@ -2329,156 +2427,31 @@ void _uvc_populate_frame(_uvc_stream_handle_t *strmh)
  */
 IRAM_ATTR static void _uvc_process_payload(_uvc_stream_handle_t *strmh, size_t req_len, uint8_t *payload, size_t payload_len)
 {
-    size_t header_len = 0;
-    size_t variable_offset = 0;
-    uint8_t header_info = 0;
-    size_t data_len = 0;
-    bool bulk_xfer = (s_usb_dev.uvc->vs_ifc->xfer_type == UVC_XFER_BULK) ? true : false;
-    bool reassemble = (strmh->reassemble_flag) ? true : false;
-    uint8_t flag_lstp = 0;
-    uint8_t flag_zlp = 0;
-    uint8_t flag_rsb = 0;
-
-    // analyze the payload handling logic depending on the transfer type
-    // and the reassembly flag
-    if (bulk_xfer && reassemble) {
-        if (payload_len == req_len) {
-            //payload transfer not complete
-            flag_rsb = 1;
-        } else if (payload_len == 0) {
-            //payload transfer complete with zero length packet
-            flag_zlp = 1;
-            ESP_LOGV(TAG, "payload_len == 0");
-        } else {
-            //payload transfer complete with short packet
-            flag_lstp = 1;
-        }
-    } else if (bulk_xfer && payload_len < req_len) {
-        flag_lstp = 1;
-    } else if (payload_len == 0) {
-        // ignore empty payload for isoc transfer
-        return;
+    uint32_t flags = strmh->payload.flags & ~(UVC_PAYLOAD_FLAG_BULK | UVC_PAYLOAD_FLAG_REASSEMBLE);
+    if (s_usb_dev.uvc->vs_ifc->xfer_type == UVC_XFER_BULK) {
+        flags |= UVC_PAYLOAD_FLAG_BULK;
+    }
+    if (strmh->reassemble_flag) {
+        flags |= UVC_PAYLOAD_FLAG_REASSEMBLE;
     }
+    strmh->payload.flags = flags;
 
 #ifdef CONFIG_UVC_PRINT_PAYLOAD_HEX
     ESP_LOG_BUFFER_HEXDUMP("UVC_HEX", payload, payload_len, ESP_LOG_VERBOSE);
 #endif
-    /********************* processing header *******************/
-    if (!flag_zlp) {
-        ESP_LOGV(TAG, "zlp=%d, lstp=%d, req_len=%d, payload_len=%d, first=0x%02x, second=0x%02x", flag_zlp, flag_lstp, req_len, payload_len, payload[0], payload_len > 1 ? payload[1] : 0);
-        // make sure this is a header, judge from header length and bit field
-        // For SCR, PTS, some vendors not set bit, but also offer 12 Bytes header. so we just check SET condition
-        if (payload_len >= payload[0]
-                && (payload[0] == 12 || (payload[0] == 2 && !(payload[1] & 0x0C)) || (payload[0] == 6 && !(payload[1] & 0x08)))
-                && !(payload[1] & 0x30)
-#ifdef CONFIG_UVC_CHECK_HEADER_EOH
-                /* EOH bit, when set, indicates the end of the BFH fields
-                 * Most camera set this bit to 1 in each header, but some vendors may not set it.
-                 */
-                && (payload[1] & 0x80)
-#endif
-#ifdef CONFIG_UVC_CHECK_BULK_JPEG_HEADER
-                && (!reassemble || ((payload[payload[0]] == 0xff) && (payload[payload[0] + 1] == 0xd8)))
-#endif
-           ) {
-            header_len = payload[0];
-            data_len = payload_len - header_len;
-            /* checking the end-of-header */
-            variable_offset = 2;
-            header_info = payload[1];
-
-            ESP_LOGV(TAG, "header=%u info=0x%02x, payload_len = %u, last_pts = %"PRIu32" , last_scr = %"PRIu32"", header_len, header_info, payload_len, strmh->pts, strmh->last_scr);
-            if (flag_rsb) {
-                ESP_LOGV(TAG, "reassembling start ...");
-                strmh->reassembling = 1;
-            }
-            /* ERR bit defined in Stream Header*/
-            if (header_info & 0x40) {
-                ESP_LOGW(TAG, "bad packet: error bit set");
-                strmh->reassembling = 0;
-                return;
-            }
-        } else if (strmh->reassembling) {
-            ESP_LOGV(TAG, "reassembling %u + %u", strmh->got_bytes, payload_len);
-            data_len = payload_len;
-        } else {
-            if (payload_len > 1) {
-#ifdef CONFIG_UVC_CHECK_HEADER_EOH
-                /* Give warning if EOH check enable, but camera not have*/
-                if (!(payload[1] & 0x80)) {
-                    ESP_LOGD(TAG, "bogus packet: EOH bit not set");
-                }
-#endif
-                ESP_LOGD(TAG, "bogus packet: len = %u %02x %02x...%02x %02x\n", payload_len, payload[0], payload[1], payload[payload_len - 2], payload[payload_len - 1]);
-            }
-            return;
-        }
+    uint32_t events = uvc_payload_process(&strmh->payload, req_len, payload, payload_len);
+    if (events & UVC_PAYLOAD_EV_ERROR) {
+        ESP_LOGW(TAG, "bad packet: error bit set");
     }
-
-    if (header_len >= 2) {
-        if (strmh->fid != (header_info & 1) && strmh->got_bytes != 0) {
-            /* The frame ID bit was flipped, but we have image data sitting
-                around from prior transfers. This means the camera didn't send
-                an EOF for the last transfer of the previous frame. */
-#if CONFIG_UVC_DROP_NO_EOF_FRAME
-            ESP_LOGW(TAG, "DROP NO EOF, got data=%u B", strmh->got_bytes);
-            _uvc_drop_buffers(strmh);
-#else
-            ESP_LOGD(TAG, "SWAP NO EOF %d", strmh->got_bytes);
-            _uvc_swap_buffers(strmh);
-#endif
-        }
-
-        strmh->fid = header_info & 1;
-        if (header_info & (1 << 2)) {
-            strmh->pts = DW_TO_INT(payload + variable_offset);
-            variable_offset += 4;
-        }
-
-        if (header_info & (1 << 3)) {
-            strmh->last_scr = DW_TO_INT(payload + variable_offset);
-            variable_offset += 6;
-        }
+    if (events & UVC_PAYLOAD_EV_BOGUS) {
+        ESP_LOGD(TAG, "bogus packet: len = %u %02x %02x...", payload_len, payload[0], payload_len > 1 ? payload[1] : 0);
     }
-
-    /********************* processing data *****************/
-    if (data_len >= 1) {
-        if (strmh->got_bytes + data_len > s_usb_dev.uvc_cfg.xfer_buffer_size) {
-            /* This means transfer buffer Not enough for whole frame, just drop whole buffer here.
-            Please increase buffer size to handle big frame*/
-#if CONFIG_UVC_DROP_OVERFLOW_FRAME
-            ESP_LOGW(TAG, "Transfer buffer overflow, got data=%u B, last=%u (%02x %02x...%02x %02x)", strmh->got_bytes + data_len, data_len
-                     , payload[0], payload_len > 1 ? payload[1] : 0, payload_len > 1 ? payload[payload_len - 2] : 0, payload_len > 1 ? payload[payload_len - 1] : 0);
-            _uvc_drop_buffers(strmh);
-#else
-            ESP_LOGD(TAG, "SWAP overflow %d", strmh->got_bytes);
-            _uvc_swap_buffers(strmh);
-#endif
-            strmh->reassembling = 0;
-            return;
-        } else {
-            if (payload_len > 1) {
-                ESP_LOGV(TAG, "uvc payload = %02x %02x...%02x %02x\n", payload[header_len], payload[header_len + 1], payload[payload_len - 2], payload[payload_len - 1]);
-            }
-            memcpy(strmh->outbuf + strmh->got_bytes, payload + header_len, data_len);
-        }
-
-        strmh->got_bytes += data_len;
+    if (events & UVC_PAYLOAD_EV_DROP_NO_EOF) {
+        ESP_LOGW(TAG, "DROP NO EOF, seq = %"PRIu32"", strmh->seq);
     }
-
-    if (flag_lstp || flag_zlp) {
-        strmh->reassembling = 0;
+    if (events & UVC_PAYLOAD_EV_DROP_OVERFLOW) {
+        ESP_LOGW(TAG, "Transfer buffer overflow, got data > %"PRIu32" B", s_usb_dev.uvc_cfg.xfer_buffer_size);
     }
-
-#if CONFIG_UVC_CHECK_HEADER_EOF
-    if (header_info & (1 << 1)) {
-        /* The EOF bit is set, so publish the complete frame */
-        if (strmh->got_bytes != 0) {
-            _uvc_swap_buffers(strmh);
-        }
-        strmh->reassembling = 0;
-    }
-#endif
 }
 
 /**
@@ -2504,10 +2477,27 @@ static uvc_error_t uvc_stream_open_ctrl(uvc_device_handle_t *devh, _uvc_stream_h
     strmh->frame.library_owns_data = 1;
     strmh->cur_ctrl = *ctrl;
     strmh->running = 0;
-    strmh->outbuf = s_usb_dev.uvc_cfg.xfer_buffer_a;
-    strmh->holdbuf = s_usb_dev.uvc_cfg.xfer_buffer_b;
-    strmh->frame.data = s_usb_dev.uvc_cfg.frame_buffer;
     strmh->frame_format = s_usb_dev.uvc->frame_format;
+    if (s_frame_pool.num) {
+        /* frames the last stream did not deliver are discarded, the ones held by the user stay */
+        UVC_ENTER_CRITICAL();
+        for (int i = 0; i < s_frame_pool.num; i++) {
+            if (s_frame_pool.state[i] != POOL_SLOT_USER) {
+                s_frame_pool.state[i] = POOL_SLOT_FREE;
+            }
+        }
+        UVC_EXIT_CRITICAL();
+        strmh->fill_slot = _uvc_pool_take(POOL_SLOT_FREE, POOL_SLOT_FILLING);
+        uvc_payload_init(&strmh->payload, _uvc_payload_config_flags(),
+                         (strmh->fill_slot < 0) ? NULL : s_frame_pool.frames[strmh->fill_slot].data,
+                         s_usb_dev.uvc_cfg.xfer_buffer_size, _uvc_pool_frame_done, strmh);
+    } else {
+        strmh->fill_slot = -1;
+        strmh->holdbuf = s_usb_dev.uvc_cfg.xfer_buffer_b;
+        strmh->frame.data = s_usb_dev.uvc_cfg.frame_buffer;
+        uvc_payload_init(&strmh->payload, _uvc_payload_config_flags(), s_usb_dev.uvc_cfg.xfer_buffer_a,
+                         s_usb_dev.uvc_cfg.xfer_buffer_size, _uvc_swap_buffers, strmh);
+    }
 
     strmh->cb_mutex = xSemaphoreCreateMutex();
 
@@ -2548,9 +2538,9 @@ static uvc_error_t uvc_stream_start(_uvc_stream_handle_t *strmh, uvc_frame_callb
 
     strmh->running = 1;
     strmh->seq = 1;
-    strmh->fid = 0;
-    strmh->pts = 0;
-    strmh->last_scr = 0;
+    strmh->payload.fid = 0;
+    strmh->payload.pts = 0;
+    strmh->payload.last_scr = 0;
     strmh->user_cb = cb;
     strmh->user_ptr = user_ptr;
 
@@ -2594,6 +2584,10 @@ static uvc_error_t uvc_stream_stop(_uvc_stream_handle_t *strmh)
  */
 static void uvc_stream_close(_uvc_stream_handle_t *strmh)
 {
+    uvc_payload_stats_t *stats = &strmh->payload.stats;
+    ESP_LOGI(TAG, "UVC stream closed: frames = %"PRIu32", dropped = %"PRIu32", errors = %"PRIu32", copied %"PRIu32" B/frame",
+             stats->frames, stats->dropped, stats->errors,
+             stats->frames ? (uint32_t)(stats->bytes_copied / stats->frames) : 0);
     vSemaphoreDelete(strmh->cb_mutex);
     free(strmh);
     return;
@@ -3800,6 +3794,20 @@ static void _sample_processing_task(void *arg)
 
     xEventGroupClearBits(s_usb_dev.event_group_hdl, UVC_SAMPLE_PROC_STOP_DONE);
     do {
+        if (s_frame_pool.num) {
+            if (!strmh->running) {
+                ESP_LOGI(TAG, "sample processing stop");
+                break;
+            }
+            // zero-copy: pass the pool frames by reference, the user releases them
+            int slot = _uvc_pool_take(POOL_SLOT_READY, POOL_SLOT_USER);
+            if (slot < 0) {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            } else {
+                strmh->user_cb(&s_frame_pool.frames[slot], strmh->user_ptr);
+            }
+            continue;
+        }
         xSemaphoreTake(strmh->cb_mutex, portMAX_DELAY);
 
         while (strmh->running && last_seq == strmh->hold_seq) {
@@ -4007,11 +4015,19 @@ esp_err_t uvc_streaming_config(const uvc_config_t *config)
     UVC_CHECK(config->format < UVC_FORMAT_MAX, "format can't larger than UVC_FORMAT_MAX", ESP_ERR_INVALID_ARG);
     UVC_CHECK(config->frame_height != 0, "frame_height can't 0", ESP_ERR_INVALID_ARG);
     UVC_CHECK(config->frame_width != 0, "frame_width can't 0", ESP_ERR_INVALID_ARG);
-    UVC_CHECK(config->frame_buffer_size != 0, "frame_buffer_size can't 0", ESP_ERR_INVALID_ARG);
     UVC_CHECK(config->xfer_buffer_size != 0, "xfer_buffer_size can't 0", ESP_ERR_INVALID_ARG);
-    UVC_CHECK(config->xfer_buffer_a != NULL, "xfer_buffer_a can't NULL", ESP_ERR_INVALID_ARG);
-    UVC_CHECK(config->xfer_buffer_b != NULL, "xfer_buffer_b can't NULL", ESP_ERR_INVALID_ARG);
-    UVC_CHECK(config->frame_buffer != NULL, "frame_buffer can't NULL", ESP_ERR_INVALID_ARG);
+    if (config->frame_pool_num) {
+        UVC_CHECK(config->frame_pool_num >= 2 && config->frame_pool_num <= UVC_FRAME_POOL_MAX, "frame_pool_num must 2~UVC_FRAME_POOL_MAX", ESP_ERR_INVALID_ARG);
+        UVC_CHECK(config->frame_pool != NULL, "frame_pool can't NULL", ESP_ERR_INVALID_ARG);
+        for (int i = 0; i < config->frame_pool_num; i++) {
+            UVC_CHECK(config->frame_pool[i] != NULL, "frame_pool buffer can't NULL", ESP_ERR_INVALID_ARG);
+        }
+    } else {
+        UVC_CHECK(config->frame_buffer_size != 0, "frame_buffer_size can't 0", ESP_ERR_INVALID_ARG);
+        UVC_CHECK(config->xfer_buffer_a != NULL, "xfer_buffer_a can't NULL", ESP_ERR_INVALID_ARG);
+        UVC_CHECK(config->xfer_buffer_b != NULL, "xfer_buffer_b can't NULL", ESP_ERR_INVALID_ARG);
+        UVC_CHECK(config->frame_buffer != NULL, "frame_buffer can't NULL", ESP_ERR_INVALID_ARG);
+    }
 #ifndef CONFIG_UVC_GET_CONFIG_DESC
     //Additional check for quick start mode
     UVC_CHECK(config->interface, "interface can't 0", ESP_ERR_INVALID_ARG);
@@ -4034,6 +4050,18 @@ esp_err_t uvc_streaming_config(const uvc_config_t *config)
     }
     s_usb_dev.uvc_cfg = *config;
     s_usb_dev.flags |= config->flags;
+    memset(&s_frame_pool, 0, sizeof(s_frame_pool));
+    if (config->frame_pool_num) {
+        if (s_usb_dev.uvc_cfg.frame_buffer_size == 0) {
+            s_usb_dev.uvc_cfg.frame_buffer_size = config->xfer_buffer_size;
+        }
+        s_frame_pool.num = config->frame_pool_num;
+        for (int i = 0; i < config->frame_pool_num; i++) {
+            s_frame_pool.frames[i].data = config->frame_pool[i];
+            s_frame_pool.frames[i].library_owns_data = 0;
+        }
+        ESP_LOGI(TAG, "UVC Frame Pool: %u buffers, zero-copy delivery", config->frame_pool_num);
+    }
     if (s_usb_dev.flags & FLAG_UVC_SUSPEND_AFTER_START) {
         ESP_LOGI(TAG, "UVC Streaming Suspend After Start");
     }
@@ -4045,6 +4073,22 @@ esp_err_t uvc_streaming_config(const uvc_config_t *config)
     return ESP_OK;
 }
 
+esp_err_t uvc_frame_release(uvc_frame_t *frame)
+{
+    UVC_CHECK(s_frame_pool.num != 0, "frame pool not configured", ESP_ERR_INVALID_STATE);
+    UVC_CHECK(frame >= s_frame_pool.frames && frame < s_frame_pool.frames + s_frame_pool.num, "not a frame pool frame", ESP_ERR_INVALID_ARG);
+    size_t slot = frame - s_frame_pool.frames;
+    bool held = false;
+    UVC_ENTER_CRITICAL();
+    if (s_frame_pool.state[slot] == POOL_SLOT_USER) {
+        s_frame_pool.state[slot] = POOL_SLOT_FREE;
+        held = true;
+    }
+    UVC_EXIT_CRITICAL();
+    UVC_CHECK(held, "frame not held by user", ESP_ERR_INVALID_STATE);
+    return ESP_OK;
+}
+
 esp_err_t usb_streaming_start()
 {
     UVC_CHECK(s_usb_dev.event_group_hdl == NULL, "usb streaming is running", ESP_ERR_INVALID_STATE);
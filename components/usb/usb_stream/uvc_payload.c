@@ -0,0 +1,218 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include "uvc_payload.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#else
+#define IRAM_ATTR
+#endif
+
+#define UVC_HEADER_FID      (1 << 0)
+#define UVC_HEADER_EOF      (1 << 1)
+#define UVC_HEADER_PTS      (1 << 2)
+#define UVC_HEADER_SCR      (1 << 3)
+#define UVC_HEADER_ERR      (1 << 6)
+#define UVC_HEADER_EOH      (1 << 7)
+
+static inline uint32_t _dw_to_int(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Publish the assembled frame and restart with an empty one
+ */
+IRAM_ATTR static void _uvc_payload_frame_done(uvc_payload_t *pl)
+{
+    if (pl->got_bytes != 0) {
+        if (pl->frame_done(pl, pl->arg)) {
+            pl->stats.frames++;
+        } else {
+            pl->stats.dropped++;
+        }
+    } else if (pl->no_buffer) {
+        pl->frame_done(pl, pl->arg);
+    }
+    pl->no_buffer = 0;
+    pl->got_bytes = 0;
+    pl->last_scr = 0;
+    pl->pts = 0;
+}
+
+/**
+ * @brief Discard the assembled data
+ */
+IRAM_ATTR static void _uvc_payload_drop(uvc_payload_t *pl)
+{
+    pl->stats.dropped++;
+    pl->got_bytes = 0;
+    pl->last_scr = 0;
+    pl->pts = 0;
+}
+
+void uvc_payload_init(uvc_payload_t *pl, uint32_t flags, uint8_t *buf, size_t buf_size,
+                      uvc_payload_frame_cb_t frame_done, void *arg)
+{
+    memset(pl, 0, sizeof(uvc_payload_t));
+    pl->flags = flags;
+    pl->buf = buf;
+    pl->buf_size = buf_size;
+    pl->frame_done = frame_done;
+    pl->arg = arg;
+}
+
+IRAM_ATTR uint32_t uvc_payload_process(uvc_payload_t *pl, size_t req_len, const uint8_t *payload, size_t payload_len)
+{
+    size_t header_len = 0;
+    size_t variable_offset = 0;
+    uint8_t header_info = 0;
+    size_t data_len = 0;
+    uint32_t events = 0;
+    bool bulk_xfer = (pl->flags & UVC_PAYLOAD_FLAG_BULK) ? true : false;
+    bool reassemble = (pl->flags & UVC_PAYLOAD_FLAG_REASSEMBLE) ? true : false;
+    uint8_t flag_lstp = 0;
+    uint8_t flag_zlp = 0;
+    uint8_t flag_rsb = 0;
+
+    // analyze the payload handling logic depending on the transfer type
+    // and the reassembly flag
+    if (bulk_xfer && reassemble) {
+        if (payload_len == req_len) {
+            //payload transfer not complete
+            flag_rsb = 1;
+        } else if (payload_len == 0) {
+            //payload transfer complete with zero length packet
+            flag_zlp = 1;
+        } else {
+            //payload transfer complete with short packet
+            flag_lstp = 1;
+        }
+    } else if (bulk_xfer && payload_len < req_len) {
+        flag_lstp = 1;
+    } else if (payload_len == 0) {
+        // ignore empty payload for isoc transfer
+        return 0;
+    }
+    pl->stats.payloads++;
+
+    /********************* processing header *******************/
+    if (!flag_zlp) {
+        // make sure this is a header, judge from header length and bit field
+        // For SCR, PTS, some vendors not set bit, but also offer 12 Bytes header. so we just check SET condition
+        if (payload_len >= payload[0]
+                && (payload[0] == 12 || (payload[0] == 2 && !(payload[1] & 0x0C)) || (payload[0] == 6 && !(payload[1] & 0x08)))
+                && !(payload[1] & 0x30)
+                /* EOH bit, when set, indicates the end of the BFH fields
+                 * Most camera set this bit to 1 in each header, but some vendors may not set it.
+                 */
+                && (!(pl->flags & UVC_PAYLOAD_FLAG_CHECK_EOH) || (payload[1] & UVC_HEADER_EOH))
+                && (!(pl->flags & UVC_PAYLOAD_FLAG_CHECK_BULK_JPEG) || !reassemble
+                    || (payload_len >= payload[0] + 2u && payload[payload[0]] == 0xff && payload[payload[0] + 1] == 0xd8))
+           ) {
+            header_len = payload[0];
+            data_len = payload_len - header_len;
+            variable_offset = 2;
+            header_info = payload[1];
+
+            if (flag_rsb) {
+                pl->reassembling = 1;
+            }
+            /* ERR bit defined in Stream Header*/
+            if (header_info & UVC_HEADER_ERR) {
+                pl->stats.errors++;
+                pl->reassembling = 0;
+                return UVC_PAYLOAD_EV_ERROR;
+            }
+        } else if (pl->reassembling) {
+            data_len = payload_len;
+        } else {
+            pl->stats.bogus++;
+            return UVC_PAYLOAD_EV_BOGUS;
+        }
+    }
+
+    if (header_len >= 2) {
+        if (pl->fid != (header_info & UVC_HEADER_FID)) {
+            pl->overflow = 0;
+        }
+        if (pl->fid != (header_info & UVC_HEADER_FID) && pl->no_buffer) {
+            /* Give frame_done a chance to supply a buffer for the new frame */
+            _uvc_payload_frame_done(pl);
+        } else if (pl->fid != (header_info & UVC_HEADER_FID) && pl->got_bytes != 0) {
+            /* The frame ID bit was flipped, but we have image data sitting
+                around from prior transfers. This means the camera didn't send
+                an EOF for the last transfer of the previous frame. */
+            if (pl->flags & UVC_PAYLOAD_FLAG_DROP_NO_EOF) {
+                _uvc_payload_drop(pl);
+                events |= UVC_PAYLOAD_EV_DROP_NO_EOF;
+            } else {
+                _uvc_payload_frame_done(pl);
+                events |= UVC_PAYLOAD_EV_FRAME;
+            }
+        }
+
+        pl->fid = header_info & UVC_HEADER_FID;
+        if (header_info & UVC_HEADER_PTS) {
+            pl->pts = _dw_to_int(payload + variable_offset);
+            variable_offset += 4;
+        }
+
+        if (header_info & UVC_HEADER_SCR) {
+            pl->last_scr = _dw_to_int(payload + variable_offset);
+            variable_offset += 6;
+        }
+    }
+
+    /********************* processing data *****************/
+    if (data_len >= 1) {
+        if (pl->overflow) {
+            // rest of a frame larger than the buffer
+        } else if (pl->buf == NULL) {
+            pl->stats.no_buffer++;
+            pl->no_buffer = 1;
+            events |= UVC_PAYLOAD_EV_NO_BUFFER;
+        } else if (pl->got_bytes + data_len > pl->buf_size) {
+            /* This means transfer buffer Not enough for whole frame, just drop whole buffer here.
+            Please increase buffer size to handle big frame*/
+            if (pl->flags & UVC_PAYLOAD_FLAG_DROP_OVERFLOW) {
+                _uvc_payload_drop(pl);
+                events |= UVC_PAYLOAD_EV_DROP_OVERFLOW;
+            } else {
+                _uvc_payload_frame_done(pl);
+                events |= UVC_PAYLOAD_EV_FRAME;
+            }
+            /* skip the rest of the frame instead of publishing it as a frame of its own */
+            pl->overflow = 1;
+            pl->reassembling = 0;
+            return events;
+        } else {
+            memcpy(pl->buf + pl->got_bytes, payload + header_len, data_len);
+            pl->stats.bytes_copied += data_len;
+            pl->got_bytes += data_len;
+        }
+    }
+
+    if (flag_lstp || flag_zlp) {
+        pl->reassembling = 0;
+    }
+
+    if ((pl->flags & UVC_PAYLOAD_FLAG_CHECK_EOF) && (header_info & UVC_HEADER_EOF)) {
+        /* The EOF bit is set, so publish the complete frame */
+        if (pl->got_bytes != 0) {
+            _uvc_payload_frame_done(pl);
+            events |= UVC_PAYLOAD_EV_FRAME;
+        } else if (pl->no_buffer) {
+            _uvc_payload_frame_done(pl);
+        }
+        pl->overflow = 0;
+        pl->reassembling = 0;
+    }
+    return events;
+}
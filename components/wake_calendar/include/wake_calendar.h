@@ -0,0 +1,98 @@
+#ifndef __WAKE_CALENDAR_H__
+#define __WAKE_CALENDAR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WAKE_CAL_JOB_MAX 8        ///< Jobs registered at once
+
+/**
+ * Scheduled job, it may run anywhere in [due - early, due + late]
+ */
+typedef struct wakeJob {
+    time_t due;            ///< When the job is due, 0 for a free slot
+    uint32_t early;        ///< Seconds it may run before due
+    uint32_t late;         ///< Seconds it may run after due
+    uint8_t todo;          ///< Wakeup todo that runs the job
+    uint8_t priority;      ///< Order among the todos of one wake, 0 first
+} wakeJob_t;
+
+/**
+ * Merge counters
+ */
+typedef struct wakeCalStats {
+    uint32_t wakes;        ///< Timer wakes that ran jobs
+    uint32_t jobs;         ///< Jobs run by them, jobs - wakes is the wakes saved
+    uint32_t merged;       ///< Wakes that ran more than one job
+    uint8_t wakeJobs;      ///< Jobs run by the current wake so far
+} wakeCalStats_t;
+
+/**
+ * Wake calendar, kept in RTC memory
+ */
+typedef struct wakeCalendar {
+    wakeJob_t jobs[WAKE_CAL_JOB_MAX];
+    wakeCalStats_t stats;
+} wakeCalendar_t;
+
+/**
+ * Next wake and the jobs it runs
+ */
+typedef struct wakePlan {
+    time_t wake;                    ///< Wake time, 0 when no job is registered
+    uint8_t count;                  ///< Jobs merged into the wake
+    uint8_t job[WAKE_CAL_JOB_MAX];  ///< Their slots in the calendar
+} wakePlan_t;
+
+/**
+ * Empty the calendar and its counters
+ */
+void wake_cal_init(wakeCalendar_t *cal);
+
+/**
+ * Register a job, replacing the one already registered for the same todo
+ * @param cal Calendar
+ * @param todo Wakeup todo that runs the job
+ * @param priority Order among the todos of one wake, 0 first
+ * @param due When the job is due
+ * @param early Seconds it may run before due
+ * @param late Seconds it may run after due
+ * @return false if the calendar is full
+ */
+bool wake_cal_add(wakeCalendar_t *cal, uint8_t todo, uint8_t priority, time_t due, uint32_t early, uint32_t late);
+
+/**
+ * Drop the job of a todo, if any
+ */
+void wake_cal_remove(wakeCalendar_t *cal, uint8_t todo);
+
+/**
+ * Plan the next wake: the job whose window closes first, together with every
+ * job whose window opens by then. The wake is at the earliest due time among
+ * them that every window still allows. Overdue jobs are due now.
+ * @param cal Calendar
+ * @param now Current time
+ * @param plan Output plan
+ * @return false if no job is registered
+ */
+bool wake_cal_plan(const wakeCalendar_t *cal, time_t now, wakePlan_t *plan);
+
+/**
+ * Drop the job of a todo that has run and count it
+ * @param cal Calendar
+ * @param todo Wakeup todo that ran
+ * @param newWake true for the first todo run by this wake
+ * @return false if the todo had no job registered, nothing is counted then
+ */
+bool wake_cal_ran(wakeCalendar_t *cal, uint8_t todo, bool newWake);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __WAKE_CALENDAR_H__ */
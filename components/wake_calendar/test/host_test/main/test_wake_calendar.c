@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "wake_calendar.h"
+
+/** Wakeup todos of main/sleep.h */
+#define TODO_SNAPSHOT 1
+#define TODO_SCHEDULE 3
+#define TODO_UPLOAD 4
+
+/** Windows main/sleep.c registers its jobs with */
+#define CAPTURE_LATE_S 30
+#define UPLOAD_WINDOW_S (15 * 60)
+#define SCHEDULE_WINDOW_S (30 * 60)
+
+/** Days of the schedule replay */
+#define REPLAY_DAYS 28
+/** Time awake after each wake */
+#define AWAKE_S 20
+/** Any day, not near 1970 so that due times are never 0 */
+#define DAY0 ((time_t)1700006400)
+
+static wakeCalendar_t s_cal;
+
+static void test_add_replaces_same_todo(void)
+{
+    wake_cal_init(&s_cal);
+    TEST_ASSERT_TRUE(wake_cal_add(&s_cal, TODO_UPLOAD, 1, DAY0 + 100, 10, 10));
+    TEST_ASSERT_TRUE(wake_cal_add(&s_cal, TODO_UPLOAD, 1, DAY0 + 500, 10, 10));
+    TEST_ASSERT_FALSE(wake_cal_add(&s_cal, TODO_SNAPSHOT, 0, 0, 0, 0));
+
+    int used = 0;
+    for (int i = 0; i < WAKE_CAL_JOB_MAX; i++) {
+        used += s_cal.jobs[i].due != 0;
+    }
+    TEST_ASSERT_EQUAL_INT(1, used);
+
+    wakePlan_t plan;
+    TEST_ASSERT_TRUE(wake_cal_plan(&s_cal, DAY0, &plan));
+    TEST_ASSERT_EQUAL_INT(DAY0 + 500, plan.wake);
+
+    wake_cal_remove(&s_cal, TODO_UPLOAD);
+    TEST_ASSERT_FALSE(wake_cal_plan(&s_cal, DAY0, &plan));
+    TEST_ASSERT_EQUAL_INT(0, plan.wake);
+}
+
+static void test_full_calendar(void)
+{
+    wake_cal_init(&s_cal);
+    for (int i = 0; i < WAKE_CAL_JOB_MAX; i++) {
+        TEST_ASSERT_TRUE(wake_cal_add(&s_cal, 10 + i, 0, DAY0 + i, 0, 0));
+    }
+    TEST_ASSERT_FALSE(wake_cal_add(&s_cal, 10 + WAKE_CAL_JOB_MAX, 0, DAY0, 0, 0));
+    // a registered todo still moves
+    TEST_ASSERT_TRUE(wake_cal_add(&s_cal, 10, 0, DAY0 + 1000, 0, 0));
+}
+
+static void test_plan_merges_overlapping_windows(void)
+{
+    wakePlan_t plan;
+    wake_cal_init(&s_cal);
+    // capture at +3600, never early; upload at +3000 +/-15 min; schedule at +9000 +/-30 min
+    wake_cal_add(&s_cal, TODO_SNAPSHOT, 0, DAY0 + 3600, 0, CAPTURE_LATE_S);
+    wake_cal_add(&s_cal, TODO_UPLOAD, 1, DAY0 + 3000, UPLOAD_WINDOW_S, UPLOAD_WINDOW_S);
+    wake_cal_add(&s_cal, TODO_SCHEDULE, 2, DAY0 + 9000, SCHEDULE_WINDOW_S, SCHEDULE_WINDOW_S);
+
+    TEST_ASSERT_TRUE(wake_cal_plan(&s_cal, DAY0, &plan));
+    // the upload closes first at +3900, the capture opens by then: both run at +3600
+    TEST_ASSERT_EQUAL_INT(2, plan.count);
+    TEST_ASSERT_EQUAL_INT(DAY0 + 3600, plan.wake);
+    for (int i = 0; i < plan.count; i++) {
+        const wakeJob_t *job = &s_cal.jobs[plan.job[i]];
+        TEST_ASSERT_TRUE(job->todo == TODO_SNAPSHOT || job->todo == TODO_UPLOAD);
+        TEST_ASSERT_TRUE(plan.wake >= job->due - (time_t)job->early);
+        TEST_ASSERT_TRUE(plan.wake <= job->due + (time_t)job->late);
+    }
+
+    // a capture opening after the upload closed keeps its own wake
+    wake_cal_add(&s_cal, TODO_SNAPSHOT, 0, DAY0 + 4000, 0, CAPTURE_LATE_S);
+    TEST_ASSERT_TRUE(wake_cal_plan(&s_cal, DAY0, &plan));
+    TEST_ASSERT_EQUAL_INT(1, plan.count);
+    TEST_ASSERT_EQUAL_INT(DAY0 + 3000, plan.wake);
+}
+
+static void test_overdue_job_runs_now(void)
+{
+    wakePlan_t plan;
+    wake_cal_init(&s_cal);
+    wake_cal_add(&s_cal, TODO_SNAPSHOT, 0, DAY0 - 600, 0, CAPTURE_LATE_S);
+    wake_cal_add(&s_cal, TODO_SCHEDULE, 2, DAY0 + 1000, SCHEDULE_WINDOW_S, SCHEDULE_WINDOW_S);
+
+    TEST_ASSERT_TRUE(wake_cal_plan(&s_cal, DAY0, &plan));
+    TEST_ASSERT_EQUAL_INT(DAY0, plan.wake);
+    // the schedule window is open now as well
+    TEST_ASSERT_EQUAL_INT(2, plan.count);
+}
+
+static void test_ran_counts_merged(void)
+{
+    wake_cal_init(&s_cal);
+    wake_cal_add(&s_cal, TODO_SNAPSHOT, 0, DAY0, 0, 0);
+    wake_cal_add(&s_cal, TODO_UPLOAD, 1, DAY0, 0, 0);
+    wake_cal_add(&s_cal, TODO_SCHEDULE, 2, DAY0 + 100, 0, 0);
+
+    TEST_ASSERT_TRUE(wake_cal_ran(&s_cal, TODO_SNAPSHOT, true));
+    TEST_ASSERT_TRUE(wake_cal_ran(&s_cal, TODO_UPLOAD, false));
+    // no job registered, not counted
+    TEST_ASSERT_FALSE(wake_cal_ran(&s_cal, TODO_UPLOAD, false));
+    TEST_ASSERT_TRUE(wake_cal_ran(&s_cal, TODO_SCHEDULE, true));
+
+    TEST_ASSERT_EQUAL_UINT32(2, s_cal.stats.wakes);
+    TEST_ASSERT_EQUAL_UINT32(3, s_cal.stats.jobs);
+    TEST_ASSERT_EQUAL_UINT32(1, s_cal.stats.merged);
+}
+
+/**
+ * Capture interval, daily upload times and the daily schedule of a configuration
+ */
+typedef struct schedule {
+    const char *name;
+    int captureMin;         ///< Timed capture interval, 0 for none
+    int uploadNum;
+    int uploadMin[6];       ///< Upload times, minutes after midnight
+    int scheduleMin;        ///< Daily schedule time, minutes after midnight
+    uint32_t exactWakes;    ///< Wakes when only jobs due on the same second share one
+    uint32_t calendarWakes; ///< Wakes with the windows of main/sleep.c
+} schedule_t;
+
+/**
+ * First of the daily times strictly after from
+ */
+static time_t next_daily(time_t from, int n, const int *minutes)
+{
+    time_t best = 0;
+    for (int i = 0; i < n; i++) {
+        time_t t = from / 86400 * 86400 + minutes[i] * 60;
+        while (t <= from) {
+            t += 86400;
+        }
+        if (best == 0 || t < best) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+/**
+ * Register the jobs the way calc_wakeup_time_seconds() does, wake as planned,
+ * run the merged jobs and start over, for REPLAY_DAYS
+ */
+static void replay(const schedule_t *s, bool windows, uint32_t *wakes, uint32_t *violations)
+{
+    static const int midnight = 0;
+    time_t now = DAY0;
+    time_t end = DAY0 + REPLAY_DAYS * 86400;
+    time_t lastCapture = 0, lastUpload = 0, lastSchedule = 0;
+    uint32_t w = windows ? 1 : 0;
+
+    wake_cal_init(&s_cal);
+    *wakes = 0;
+    *violations = 0;
+    while (now < end) {
+        wakePlan_t plan;
+        uint8_t todo[WAKE_CAL_JOB_MAX];
+
+        if (s->captureMin) {
+            time_t capture = lastCapture ? lastCapture + s->captureMin * 60 : next_daily(now, 1, &midnight);
+            wake_cal_add(&s_cal, TODO_SNAPSHOT, 0, capture, 0, CAPTURE_LATE_S * w);
+        }
+        // an upload run early by a merged wake already served its slot
+        time_t from = lastUpload + UPLOAD_WINDOW_S + 1 > now ? lastUpload + UPLOAD_WINDOW_S + 1 : now;
+        wake_cal_add(&s_cal, TODO_UPLOAD, 1, next_daily(from, s->uploadNum, s->uploadMin),
+                     UPLOAD_WINDOW_S * w, UPLOAD_WINDOW_S * w);
+        time_t schedule = next_daily(now, 1, &s->scheduleMin);
+        if (schedule < lastSchedule + 3 * 3600) {
+            schedule += 86400;
+        }
+        wake_cal_add(&s_cal, TODO_SCHEDULE, 2, schedule, SCHEDULE_WINDOW_S * w, SCHEDULE_WINDOW_S * w);
+
+        TEST_ASSERT_TRUE(wake_cal_plan(&s_cal, now, &plan));
+        TEST_ASSERT_TRUE(plan.wake >= now);
+        now = plan.wake;
+        (*wakes)++;
+        for (int i = 0; i < plan.count; i++) {
+            const wakeJob_t *job = &s_cal.jobs[plan.job[i]];
+            if (now < job->due - (time_t)job->early || now > job->due + (time_t)job->late) {
+                (*violations)++;
+            }
+            todo[i] = job->todo;
+        }
+        for (int i = 0; i < plan.count; i++) {
+            TEST_ASSERT_TRUE(wake_cal_ran(&s_cal, todo[i], i == 0));
+            if (todo[i] == TODO_SNAPSHOT) {
+                lastCapture = now;
+            } else if (todo[i] == TODO_UPLOAD) {
+                lastUpload = now;
+            } else {
+                lastSchedule = now;
+            }
+        }
+        now += AWAKE_S;
+    }
+    TEST_ASSERT_EQUAL_UINT32(*wakes, s_cal.stats.wakes);
+}
+
+static void test_28_day_schedules(void)
+{
+    static const schedule_t schedules[] = {
+        { "capture 60 min, upload 08:05 20:10, DM 02:50", 60, 2, {485, 1210}, 170, 733, 652 },
+        { "capture 30 min, upload 6x at :07, DM 03:10", 30, 6, {7, 247, 487, 727, 967, 1207}, 190, 1493, 1304 },
+        { "capture 4 h, upload 12:00, DM 00:00", 240, 1, {720}, 0, 164, 164 },
+        { "no capture, upload 00:20 06:00 18:00, DM 00:00", 0, 3, {20, 360, 1080}, 0, 112, 85 },
+        { "capture 15 min, upload 09:00, DM 04:40", 15, 1, {540}, 280, 2622, 2595 },
+    };
+
+    for (size_t i = 0; i < sizeof(schedules) / sizeof(schedules[0]); i++) {
+        const schedule_t *s = &schedules[i];
+        uint32_t exact, calendar, violations;
+
+        replay(s, false, &exact, &violations);
+        TEST_ASSERT_EQUAL_UINT32(0, violations);
+        replay(s, true, &calendar, &violations);
+        printf("%-48s wakes %4lu -> %4lu, jobs %4lu, merged %3lu\n", s->name, (unsigned long)exact,
+               (unsigned long)calendar, (unsigned long)s_cal.stats.jobs, (unsigned long)s_cal.stats.merged);
+        // every job ran inside its window
+        TEST_ASSERT_EQUAL_UINT32(0, violations);
+        TEST_ASSERT_EQUAL_UINT32(s->exactWakes, exact);
+        TEST_ASSERT_EQUAL_UINT32(s->calendarWakes, calendar);
+        TEST_ASSERT_EQUAL_UINT32(s_cal.stats.jobs - s_cal.stats.wakes, s_cal.stats.merged);
+    }
+}
+
+void app_main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_add_replaces_same_todo);
+    RUN_TEST(test_full_calendar);
+    RUN_TEST(test_plan_merges_overlapping_windows);
+    RUN_TEST(test_overdue_job_runs_now);
+    RUN_TEST(test_ran_counts_merged);
+    RUN_TEST(test_28_day_schedules);
+    UNITY_END();
+}
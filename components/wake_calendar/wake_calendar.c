@@ -0,0 +1,120 @@
+/**
+ * Wake calendar
+ *
+ * Every wake pays for the boot and usually the network bring-up, whatever it
+ * does. Jobs are registered with the window they may run in, and jobs whose
+ * windows overlap are run by one wake instead of one wake each.
+ */
+#include <string.h>
+#include "wake_calendar.h"
+
+void wake_cal_init(wakeCalendar_t *cal)
+{
+    memset(cal, 0, sizeof(wakeCalendar_t));
+}
+
+bool wake_cal_add(wakeCalendar_t *cal, uint8_t todo, uint8_t priority, time_t due, uint32_t early, uint32_t late)
+{
+    wakeJob_t *slot = NULL;
+
+    for (int i = 0; i < WAKE_CAL_JOB_MAX; i++) {
+        wakeJob_t *job = &cal->jobs[i];
+        if (job->due != 0 && job->todo == todo) {
+            slot = job;
+            break;
+        }
+        if (job->due == 0 && slot == NULL) {
+            slot = job;
+        }
+    }
+    if (slot == NULL || due == 0) {
+        return false;
+    }
+    slot->due = due;
+    slot->early = early;
+    slot->late = late;
+    slot->todo = todo;
+    slot->priority = priority;
+    return true;
+}
+
+void wake_cal_remove(wakeCalendar_t *cal, uint8_t todo)
+{
+    for (int i = 0; i < WAKE_CAL_JOB_MAX; i++) {
+        if (cal->jobs[i].due != 0 && cal->jobs[i].todo == todo) {
+            memset(&cal->jobs[i], 0, sizeof(wakeJob_t));
+        }
+    }
+}
+
+bool wake_cal_plan(const wakeCalendar_t *cal, time_t now, wakePlan_t *plan)
+{
+    time_t start[WAKE_CAL_JOB_MAX];
+    time_t end[WAKE_CAL_JOB_MAX];
+    time_t close = 0;
+    time_t open = 0;
+    time_t due = 0;
+
+    memset(plan, 0, sizeof(wakePlan_t));
+    for (int i = 0; i < WAKE_CAL_JOB_MAX; i++) {
+        const wakeJob_t *job = &cal->jobs[i];
+        if (job->due == 0) {
+            continue;
+        }
+        start[i] = job->due - (time_t)job->early;
+        end[i] = job->due + (time_t)job->late;
+        if (start[i] < now) {
+            start[i] = now;
+        }
+        if (end[i] < now) {
+            end[i] = now;
+        }
+        if (close == 0 || end[i] < close) {
+            close = end[i];
+        }
+    }
+    if (close == 0) {
+        return false;
+    }
+
+    for (int i = 0; i < WAKE_CAL_JOB_MAX; i++) {
+        const wakeJob_t *job = &cal->jobs[i];
+        if (job->due == 0 || start[i] > close) {
+            continue;
+        }
+        plan->job[plan->count++] = i;
+        if (start[i] > open) {
+            open = start[i];
+        }
+        if (due == 0 || job->due < due) {
+            due = job->due;
+        }
+    }
+    // Every merged window holds [open, close], run at the first due time in it
+    plan->wake = due < open ? open : (due > close ? close : due);
+    return true;
+}
+
+bool wake_cal_ran(wakeCalendar_t *cal, uint8_t todo, bool newWake)
+{
+    bool found = false;
+
+    for (int i = 0; i < WAKE_CAL_JOB_MAX; i++) {
+        if (cal->jobs[i].due != 0 && cal->jobs[i].todo == todo) {
+            found = true;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+    wake_cal_remove(cal, todo);
+    if (newWake) {
+        cal->stats.wakes++;
+        cal->stats.wakeJobs = 0;
+    }
+    cal->stats.jobs++;
+    if (++cal->stats.wakeJobs == 2) {
+        cal->stats.merged++;
+    }
+    return true;
+}
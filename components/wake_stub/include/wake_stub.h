@@ -0,0 +1,116 @@
+/**
+ * Deep sleep wake stub decisions
+ *
+ * A timer wake that lands before its target only has to sleep again, yet a
+ * full boot (bootloader, PSRAM, flash mounts, config) costs far more than the
+ * sleep it saves. The app finds such a wake in sleep_is_will_wakeup_time_reached():
+ * its clock is the RTC counter times the slow clock calibration, corrected at
+ * boot by the drift model. Before sleeping it works out the counter value at
+ * which that clock reaches the target and leaves it here with the calibration.
+ * The wake stub runs from RTC memory before the bootloader and compares the
+ * counter with it, so it re-sleeps exactly the wakes the app would.
+ * The functions are inline so they are placed in RTC memory with the stub. The
+ * ones the stub calls only multiply and shift, the FPU is off and the library
+ * code is not loaded yet.
+ */
+#ifndef __WAKE_STUB_H__
+#define __WAKE_STUB_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WAKE_STUB_INLINE static inline __attribute__((always_inline))
+
+#define WAKE_STUB_CAL_FRACT 19          ///< Fractional bits of the slow clock period (RTC_CLK_CAL_FRACT)
+#define WAKE_STUB_RESLEEP_MAX 8         ///< Sleeps the stub takes before booting anyway
+#define WAKE_STUB_MARGIN_US 2000        ///< Added to every re-sleep, covers rounding and the sleep entry
+#define WAKE_STUB_BOOT_US 100000        ///< Boot before the app checks the target, a shorter remainder boots
+
+/**
+ * State left in RTC memory for the stub by the last sleep
+ */
+typedef struct wakeStubState {
+    uint64_t dueTicks;     ///< RTC counter at which the app finds the target reached, 0 when not armed
+    uint32_t calPeriod;    ///< Slow clock period the app's clock counts with, us with WAKE_STUB_CAL_FRACT fractional bits
+    uint32_t bootTicks;    ///< WAKE_STUB_BOOT_US in ticks
+    uint16_t resleeps;     ///< Sleeps the stub took since the app slept
+} wakeStubState_t;
+
+/**
+ * Stub decision
+ */
+typedef enum wakeStubAction {
+    WAKE_STUB_BOOT = 0,    ///< Run the app
+    WAKE_STUB_SLEEP,       ///< Re-arm the timer and sleep again
+} wakeStubAction_e;
+
+/**
+ * Convert microseconds to slow clock ticks
+ */
+WAKE_STUB_INLINE uint64_t wake_stub_us_to_ticks(uint64_t us, uint32_t calPeriod)
+{
+    return calPeriod == 0 ? 0 : (us << WAKE_STUB_CAL_FRACT) / calPeriod;
+}
+
+/**
+ * Convert slow clock ticks to microseconds
+ */
+WAKE_STUB_INLINE uint64_t wake_stub_ticks_to_us(uint64_t ticks, uint32_t calPeriod)
+{
+    return (ticks * calPeriod) >> WAKE_STUB_CAL_FRACT;
+}
+
+/**
+ * Arm the stub for a timer sleep, call just before sleeping
+ * @param st Stub state
+ * @param nowTicks RTC counter now
+ * @param dueUs RTC microseconds from now until the app's clock reaches the wake target
+ * @param calPeriod Slow clock period
+ */
+WAKE_STUB_INLINE void wake_stub_arm(wakeStubState_t *st, uint64_t nowTicks, int64_t dueUs, uint32_t calPeriod)
+{
+    st->calPeriod = calPeriod;
+    st->bootTicks = wake_stub_us_to_ticks(WAKE_STUB_BOOT_US, calPeriod);
+    st->dueTicks = (dueUs > 0 && calPeriod != 0) ? nowTicks + wake_stub_us_to_ticks(dueUs, calPeriod) : 0;
+    st->resleeps = 0;
+}
+
+/**
+ * Disarm the stub, every wake boots
+ */
+WAKE_STUB_INLINE void wake_stub_disarm(wakeStubState_t *st)
+{
+    st->dueTicks = 0;
+}
+
+/**
+ * Decide what a wake does. Only a timer wake of an armed stub whose target is
+ * further away than the boot takes sleeps again, until the counter reaches it.
+ * @param st Stub state
+ * @param timerOnly The timer is the only wake cause
+ * @param todoQueued Work is queued for the target, else the app plans the next wake itself
+ * @param nowTicks RTC counter now
+ * @param sleepUs Output, microseconds to sleep when WAKE_STUB_SLEEP
+ * @return Decision
+ */
+WAKE_STUB_INLINE wakeStubAction_e wake_stub_decide(const wakeStubState_t *st, bool timerOnly, bool todoQueued,
+                                                   uint64_t nowTicks, uint64_t *sleepUs)
+{
+    if (!timerOnly || !todoQueued || st->dueTicks == 0 || st->calPeriod == 0 ||
+        st->resleeps >= WAKE_STUB_RESLEEP_MAX ||
+        nowTicks + st->bootTicks >= st->dueTicks) {
+        return WAKE_STUB_BOOT;
+    }
+    *sleepUs = wake_stub_ticks_to_us(st->dueTicks - nowTicks, st->calPeriod) + WAKE_STUB_MARGIN_US;
+    return WAKE_STUB_SLEEP;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __WAKE_STUB_H__ */
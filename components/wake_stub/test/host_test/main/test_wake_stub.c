@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "unity.h"
+#include "rtc_drift.h"
+#include "wake_stub.h"
+
+/** 136 kHz RC slow clock, 7.35 us per tick */
+#define CAL_PERIOD ((uint32_t)(7.35 * (1 << WAKE_STUB_CAL_FRACT)))
+/** Counter when the app goes to sleep */
+#define START_TICKS 123456789ULL
+/** Wall clock when the app goes to sleep, with a fraction of a second */
+#define START_US 1760000000400000LL
+
+/**
+ * What sleep_start() does before esp_deep_sleep_start(): program the timer for
+ * realS to the target and arm the stub
+ * @return Counter when the timer fires
+ */
+static uint64_t plan_sleep(const rtcDrift_t *m, uint8_t bucket, uint32_t realS, time_t *target, wakeStubState_t *st)
+{
+    uint32_t rtc = rtc_drift_sleep_for(m, bucket, realS, NULL);
+
+    *target = START_US / 1000000 + realS;
+    double due = rtc_drift_rtc_for(m, bucket, *target - START_US / 1e6);
+    wake_stub_arm(st, START_TICKS, (int64_t)(due * 1e6), CAL_PERIOD);
+    return START_TICKS + wake_stub_us_to_ticks((uint64_t)rtc * 1000000, CAL_PERIOD);
+}
+
+/**
+ * What the app decides on a wake at nowTicks: time_compensation_boot() moves
+ * the clock by the predicted error, sleep_is_will_wakeup_time_reached()
+ * compares it with the target once the boot is done
+ * @param nowS Output, the app's clock at the check
+ */
+static bool app_reached(const rtcDrift_t *m, uint8_t bucket, uint64_t nowTicks, time_t target, double *nowS)
+{
+    rtcDriftPrediction_t p;
+    float slept = wake_stub_ticks_to_us(nowTicks - START_TICKS, CAL_PERIOD) / 1e6f;
+
+    rtc_drift_predict(m, bucket, slept, &p);
+    *nowS = START_US / 1e6 + slept + p.errorS + WAKE_STUB_BOOT_US / 1e6;
+    return target <= (time_t)floor(*nowS);
+}
+
+static void test_tick_conversion(void)
+{
+    static const uint64_t us[] = {1, 1000000, 3600000000ULL, 31ULL * 86400 * 1000000};
+
+    for (size_t i = 0; i < sizeof(us) / sizeof(us[0]); i++) {
+        uint64_t ticks = wake_stub_us_to_ticks(us[i], CAL_PERIOD);
+        uint64_t back = wake_stub_ticks_to_us(ticks, CAL_PERIOD);
+        TEST_ASSERT_TRUE(back <= us[i] && us[i] - back < 10);
+    }
+    // a month at 136 kHz, no overflow on the way
+    TEST_ASSERT_UINT64_WITHIN(2, (uint64_t)(31 * 86400e6 * (1 << WAKE_STUB_CAL_FRACT) / CAL_PERIOD),
+                              wake_stub_us_to_ticks(31ULL * 86400 * 1000000, CAL_PERIOD));
+    TEST_ASSERT_EQUAL_UINT64(0, wake_stub_us_to_ticks(1000, 0));
+}
+
+static void test_boot_cases(void)
+{
+    wakeStubState_t st;
+    uint64_t sleep_us;
+    uint64_t early = START_TICKS + wake_stub_us_to_ticks(60000000, CAL_PERIOD);
+
+    memset(&st, 0, sizeof(st));
+    TEST_ASSERT_EQUAL_INT(WAKE_STUB_BOOT, wake_stub_decide(&st, true, true, early, &sleep_us));
+
+    wake_stub_arm(&st, START_TICKS, 0, CAL_PERIOD);
+    TEST_ASSERT_EQUAL_UINT64(0, st.dueTicks);
+    wake_stub_arm(&st, START_TICKS, 120000000, CAL_PERIOD);
+    TEST_ASSERT_EQUAL_INT(WAKE_STUB_SLEEP, wake_stub_decide(&st, true, true, early, &sleep_us));
+    TEST_ASSERT_EQUAL_INT(WAKE_STUB_BOOT, wake_stub_decide(&st, false, true, early, &sleep_us));
+    TEST_ASSERT_EQUAL_INT(WAKE_STUB_BOOT, wake_stub_decide(&st, true, false, early, &sleep_us));
+    TEST_ASSERT_EQUAL_INT(WAKE_STUB_BOOT, wake_stub_decide(&st, true, true, st.dueTicks, &sleep_us));
+    // a remainder shorter than the boot is over by the time the app checks
+    TEST_ASSERT_EQUAL_INT(WAKE_STUB_BOOT, wake_stub_decide(&st, true, true, st.dueTicks - st.bootTicks, &sleep_us));
+    TEST_ASSERT_EQUAL_INT(WAKE_STUB_SLEEP, wake_stub_decide(&st, true, true, st.dueTicks - st.bootTicks - 1, &sleep_us));
+
+    st.resleeps = WAKE_STUB_RESLEEP_MAX;
+    TEST_ASSERT_EQUAL_INT(WAKE_STUB_BOOT, wake_stub_decide(&st, true, true, early, &sleep_us));
+    wake_stub_disarm(&st);
+    st.resleeps = 0;
+    TEST_ASSERT_EQUAL_INT(WAKE_STUB_BOOT, wake_stub_decide(&st, true, true, early, &sleep_us));
+}
+
+static void test_planned_wake_boots(void)
+{
+    static const float rates[] = {0.0f, 0.004f, -0.004f, 0.05f, -0.05f};
+    static const uint32_t sleeps[] = {2, 60, 600, 3600, 86400};
+    rtcDrift_t m;
+    wakeStubState_t st;
+    time_t target;
+    uint64_t sleep_us;
+
+    // the timer carries the late bias past the target, its own wake always boots
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        rtc_drift_init(&m, rates[r]);
+        for (size_t s = 0; s < sizeof(sleeps) / sizeof(sleeps[0]); s++) {
+            uint64_t fired = plan_sleep(&m, RTC_DRIFT_GLOBAL, sleeps[s], &target, &st);
+            TEST_ASSERT_EQUAL_INT(WAKE_STUB_BOOT, wake_stub_decide(&st, true, true, fired, &sleep_us));
+        }
+    }
+}
+
+static void test_early_wake_sleeps_the_rest(void)
+{
+    rtcDrift_t m;
+    wakeStubState_t st;
+    time_t target;
+    uint64_t sleep_us;
+    double now_s;
+
+    rtc_drift_init(&m, 0.004f);
+    plan_sleep(&m, RTC_DRIFT_GLOBAL, 3600, &target, &st);
+    uint64_t woke = st.dueTicks - wake_stub_us_to_ticks(30000000, CAL_PERIOD);
+    TEST_ASSERT_FALSE(app_reached(&m, RTC_DRIFT_GLOBAL, woke, target, &now_s));
+    TEST_ASSERT_EQUAL_INT(WAKE_STUB_SLEEP, wake_stub_decide(&st, true, true, woke, &sleep_us));
+    TEST_ASSERT_UINT64_WITHIN(10, 30000000 + WAKE_STUB_MARGIN_US, sleep_us);
+
+    // esp_wake_stub_set_wakeup_time() programs the same calibration, the next wake boots into a reached target
+    st.resleeps++;
+    woke += wake_stub_us_to_ticks(sleep_us, CAL_PERIOD);
+    TEST_ASSERT_EQUAL_INT(WAKE_STUB_BOOT, wake_stub_decide(&st, true, true, woke, &sleep_us));
+    TEST_ASSERT_TRUE(app_reached(&m, RTC_DRIFT_GLOBAL, woke, target, &now_s));
+}
+
+/**
+ * Model fitted to 0.4 s per sleep and 0.4%, so that the per-sleep offset is not 0
+ */
+static void fitted_model(rtcDrift_t *m)
+{
+    rtc_drift_init(m, 0);
+    for (int i = 0; i < 20; i++) {
+        rtcDriftSpan_t span;
+        int sleeps = i % 2 ? 1 : 8;
+        float slept_s = i % 2 ? 4 * 3600 : 300;
+        memset(&span, 0, sizeof(span));
+        for (int k = 0; k < sleeps; k++) {
+            rtc_drift_span_add(&span, RTC_DRIFT_GLOBAL, slept_s);
+        }
+        rtc_drift_add(m, &span, 0.4f * sleeps + 0.004f * sleeps * slept_s);
+    }
+}
+
+static void test_same_decision_as_app(void)
+{
+    static const float rates[] = {0.0f, 0.004f, -0.004f, 0.05f, NAN};
+    static const uint32_t sleeps[] = {60, 3600, 86400};
+    rtcDrift_t m;
+    wakeStubState_t st;
+    time_t target;
+    uint64_t sleep_us;
+    double now_s;
+    int wakes = 0, resleeps = 0;
+
+    // wakes from 10 s before to 10 s after the target, in 10 ms steps
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        if (isnan(rates[r])) {
+            fitted_model(&m);
+        } else {
+            rtc_drift_init(&m, rates[r]);
+        }
+        for (size_t s = 0; s < sizeof(sleeps) / sizeof(sleeps[0]); s++) {
+            plan_sleep(&m, RTC_DRIFT_GLOBAL, sleeps[s], &target, &st);
+            for (int ms = -10000; ms <= 10000; ms += 10) {
+                uint64_t woke = st.dueTicks + (int64_t)ms * (int64_t)wake_stub_us_to_ticks(1000, CAL_PERIOD);
+                bool reached = app_reached(&m, RTC_DRIFT_GLOBAL, woke, target, &now_s);
+                bool boot = wake_stub_decide(&st, true, true, woke, &sleep_us) == WAKE_STUB_BOOT;
+                wakes++;
+                resleeps += !boot;
+                // the app's float clock may round either way right at the target
+                if (fabs(now_s - target) > 0.01) {
+                    TEST_ASSERT_EQUAL(reached, boot);
+                }
+            }
+        }
+    }
+    printf("%d wakes around the target, %d slept again in the stub\n", wakes, resleeps);
+}
+
+void app_main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_tick_conversion);
+    RUN_TEST(test_boot_cases);
+    RUN_TEST(test_planned_wake_boots);
+    RUN_TEST(test_early_wake_sleeps_the_rest);
+    RUN_TEST(test_same_decision_as_app);
+    UNITY_END();
+}
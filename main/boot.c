@@ -0,0 +1,127 @@
+/**
+ * Boot init scheduler
+ *
+ * Runs only the init steps the selected mode needs before it starts working,
+ * and pushes the rest onto a low-priority task once the critical path is done
+ * (for snapshot mode: after the shutter).
+ */
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "boot.h"
+#include "debug.h"
+#include "sleep.h"
+
+#define TAG "-->BOOT"
+
+#define BOOT_DEFERRED_DONE_BIT BIT(0)
+
+#define BOOT_STEP_MAX 16
+#define BOOT_DEFERRED_AWAKE_MS (60*1000)  // Backstop for the deferred task's keep-awake token
+
+/**
+ * Boot scheduler state
+ */
+typedef struct mdBoot {
+    const bootStep_t *steps;        ///< Step table
+    uint32_t count;                 ///< Number of steps
+    modeSel_e mode;                 ///< Mode the steps were scheduled for
+    uint32_t costMs[BOOT_STEP_MAX]; ///< Time spent in each step
+    bool deferred[BOOT_STEP_MAX];   ///< Step runs on the background task
+    bool started;                   ///< Background task created
+    sleepToken_t awake;             ///< Held while the deferred steps run (log rotation, flash writes)
+    EventGroupHandle_t eventGroup;  ///< Deferred completion
+} mdBoot_t;
+
+static mdBoot_t g_boot = {0};
+static RTC_DATA_ATTR uint32_t g_lastShutterMs = 0;   // Boot-to-shutter of the last snapshot wake
+
+static void boot_step_exec(uint32_t i)
+{
+    int64_t start = esp_timer_get_time();
+    g_boot.steps[i].init();
+    g_boot.costMs[i] = (uint32_t)((esp_timer_get_time() - start) / 1000);
+    ESP_LOGI(TAG, "%s %s: %lu ms", g_boot.deferred[i] ? "deferred" : "critical",
+             g_boot.steps[i].name, g_boot.costMs[i]);
+}
+
+static void boot_deferred_task(void *arg)
+{
+    uint32_t i;
+
+    for (i = 0; i < g_boot.count; i++) {
+        if (g_boot.deferred[i]) {
+            boot_step_exec(i);
+        }
+    }
+    xEventGroupSetBits(g_boot.eventGroup, BOOT_DEFERRED_DONE_BIT);
+    sleep_release(&g_boot.awake);
+    vTaskDelete(NULL);
+}
+
+static int do_boottime_cmd(int argc, char **argv)
+{
+    uint32_t i;
+
+    ESP_LOGI(TAG, "mode %d, last boot-to-shutter %lu ms", g_boot.mode, g_lastShutterMs);
+    for (i = 0; i < g_boot.count; i++) {
+        ESP_LOGI(TAG, "%-12s %-8s %lu ms", g_boot.steps[i].name,
+                 g_boot.deferred[i] ? "deferred" : "critical", g_boot.costMs[i]);
+    }
+    return ESP_OK;
+}
+
+static esp_console_cmd_t g_cmd[] = {
+    ESP_CONSOLE_CMD_INIT("boottime", "boot step and boot-to-shutter timing", NULL, do_boottime_cmd, NULL),
+};
+
+void boot_run(const bootStep_t *steps, uint32_t count, modeSel_e mode)
+{
+    uint32_t i;
+
+    memset(&g_boot, 0, sizeof(g_boot));
+    g_boot.steps = steps;
+    g_boot.count = count < BOOT_STEP_MAX ? count : BOOT_STEP_MAX;
+    g_boot.mode = mode;
+    g_boot.eventGroup = xEventGroupCreate();
+
+    for (i = 0; i < g_boot.count; i++) {
+        g_boot.deferred[i] = !(steps[i].criticalModes & BOOT_MODE(mode));
+        if (!g_boot.deferred[i]) {
+            boot_step_exec(i);
+        }
+    }
+    debug_cmd_add(g_cmd, sizeof(g_cmd) / sizeof(esp_console_cmd_t));
+    ESP_LOGI(TAG, "critical init done at %lld ms", esp_timer_get_time() / 1000);
+}
+
+void boot_start_deferred(void)
+{
+    if (g_boot.started || !g_boot.eventGroup) {
+        return;
+    }
+    g_boot.started = true;
+    sleep_keep_awake(&g_boot.awake, "boot_deferred", BOOT_DEFERRED_AWAKE_MS);
+    xTaskCreatePinnedToCore(boot_deferred_task, "boot_deferred", 4 * 1024, NULL, 2, NULL, 0);
+}
+
+bool boot_wait_deferred(uint32_t timeout_ms)
+{
+    if (!g_boot.eventGroup) {
+        return true;
+    }
+    boot_start_deferred();
+    EventBits_t uxBits = xEventGroupWaitBits(g_boot.eventGroup, BOOT_DEFERRED_DONE_BIT, false, true,
+                                             pdMS_TO_TICKS(timeout_ms));
+    return (uxBits & BOOT_DEFERRED_DONE_BIT) != 0;
+}
+
+void boot_mark_shutter(void)
+{
+    g_lastShutterMs = (uint32_t)(esp_timer_get_time() / 1000);
+    ESP_LOGI(TAG, "boot-to-shutter %lu ms", g_lastShutterMs);
+    boot_start_deferred();
+}
@@ -0,0 +1,53 @@
+#ifndef __BOOT_H__
+#define __BOOT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "system.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Mode mask helper for bootStep_t.criticalModes */
+#define BOOT_MODE(m) BIT(m)
+
+/**
+ * One init step of the boot sequence
+ */
+typedef struct bootStep {
+    const char *name;           ///< Step name for timing reports
+    void (*init)(void);         ///< Init function
+    uint32_t criticalModes;     ///< BOOT_MODE() mask of modes that need it before the mode handler
+} bootStep_t;
+
+/**
+ * Run the steps that are critical for mode, remember the others as deferred
+ * @param steps Step table (must stay valid)
+ * @param count Number of steps
+ * @param mode Selected operating mode
+ */
+void boot_run(const bootStep_t *steps, uint32_t count, modeSel_e mode);
+
+/**
+ * Start the background task that runs the deferred steps (safe to call more than once)
+ */
+void boot_start_deferred(void);
+
+/**
+ * Wait until all deferred steps have run, starting them if needed
+ * @param timeout_ms Maximum time to wait
+ * @return true if all deferred steps are done
+ */
+bool boot_wait_deferred(uint32_t timeout_ms);
+
+/**
+ * Record the boot-to-shutter time and start the deferred steps
+ */
+void boot_mark_shutter(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BOOT_H__ */
@@ -18,6 +18,7 @@
 #include <string.h>
 #include <inttypes.h>
 #include <esp_timer.h>
+#include <esp_attr.h>
 #include "img_converters.h"
 #include "camera_uvc_controls.h"
 // Support both IDF 5.x
@@ -29,6 +30,7 @@
 #include "misc.h"
 #include "utils.h"
 #include "uvc.h"
+#include "energy.h"
 
 #define TAG "-->CAMERA"  // Logging tag for camera module
 
@@ -72,6 +74,7 @@ typedef struct mdCamera {
     QueueHandle_t out;           // Output queue for captured frames
     SemaphoreHandle_t mutex;     // Mutex for thread-safe operations
     uint8_t captureCount;        // Number of active captures
+    sleepToken_t awake;          // Keep-awake token held while captures are in flight
     EventGroupHandle_t eventGroup; // Event group for camera state
     bool bFlashLedON;            // Flash LED state
     bool bInit;                  // Initialization flag
@@ -82,6 +85,27 @@ typedef struct mdCamera {
 
 static mdCamera_t g_mdCamera = {0};  // Global camera state instance
 
+#define CAMERA_CACHE_MAGIC 0xCA3E
+
+typedef enum camBackend {
+    CAM_BACKEND_NONE = 0,
+    CAM_BACKEND_CSI,
+    CAM_BACKEND_UVC,
+} camBackend_e;
+
+/**
+ * Last known-good camera detection, kept in RTC memory and mirrored to NVS for cold boots
+ */
+typedef struct camCache {
+    uint16_t magic;      // CAMERA_CACHE_MAGIC when loaded
+    uint8_t backend;     // camBackend_e
+    uint8_t sccbAddr;    // CSI sensor SCCB address
+    uint16_t pid;        // CSI sensor PID
+    uint32_t xclkHz;     // XCLK frequency the sensor came up with
+} camCache_t;
+
+static RTC_DATA_ATTR camCache_t g_camCache = {0};
+
 /**
  * Lock camera mutex for thread-safe operations
  */
@@ -137,7 +161,7 @@ static void camera_queue_node_free(queueNode_t *node, nodeEvent_e event)
         camera_lock();
         g_mdCamera.captureCount--;  // Decrement active capture count
         if (g_mdCamera.captureCount == 0) {
-            sleep_set_event_bits(SLEEP_SNAPSHOT_STOP_BIT);  // Signal no active captures
+            sleep_release(&g_mdCamera.awake);  // No active captures
         }
         camera_unlock();
     }
@@ -177,7 +201,7 @@ static queueNode_t *camera_queue_node_malloc(camera_fb_t *frame, snapType_e type
     ESP_LOGI(TAG, "camera_queue_node_malloc (heap copy %zu bytes)", frame->len);
     camera_lock();
     g_mdCamera.captureCount++;
-    sleep_clear_event_bits(SLEEP_SNAPSHOT_STOP_BIT);
+    sleep_keep_awake(&g_mdCamera.awake, "camera", 0);
     camera_unlock();
     return node;
 }
@@ -403,17 +427,77 @@ static const camera_vtable_t VTABLE_UVC = {
 	.set_image = uvc_camera_set_image,
 };
 
+/**
+ * Load the detection cache, from NVS if RTC memory was lost
+ */
+static void camera_cache_load(void)
+{
+    uint32_t detect, xclk;
+
+    if (g_camCache.magic == CAMERA_CACHE_MAGIC) {
+        return;
+    }
+    cfg_get_u32(KEY_CAM_DETECT, &detect, 0);
+    cfg_get_u32(KEY_CAM_XCLK, &xclk, 0);
+    g_camCache.magic = CAMERA_CACHE_MAGIC;
+    g_camCache.backend = detect >> 24;
+    g_camCache.sccbAddr = (detect >> 16) & 0xff;
+    g_camCache.pid = detect & 0xffff;
+    g_camCache.xclkHz = xclk;
+}
+
+/**
+ * Remember the backend that came up, writing NVS only when it changed
+ * @param backend Working backend
+ */
+static void camera_cache_store(camBackend_e backend)
+{
+    camCache_t cache = {CAMERA_CACHE_MAGIC, backend, 0, 0, 0};
+
+    if (backend == CAM_BACKEND_CSI) {
+        sensor_t *s = esp_camera_sensor_get();
+        cache.sccbAddr = s->slv_addr;
+        cache.pid = s->id.PID;
+        cache.xclkHz = s->xclk_freq_hz;
+    }
+    if (memcmp(&cache, &g_camCache, sizeof(cache)) == 0) {
+        return;
+    }
+    g_camCache = cache;
+    cfg_set_u32(KEY_CAM_DETECT, ((uint32_t)cache.backend << 24) | ((uint32_t)cache.sccbAddr << 16) | cache.pid);
+    cfg_set_u32(KEY_CAM_XCLK, cache.xclkHz);
+    ESP_LOGI(TAG, "camera cache updated: backend %d addr 0x%02x pid 0x%04x", cache.backend, cache.sccbAddr, cache.pid);
+}
+
 static esp_err_t init_camera(mdCamera_t *handle)
 {
-    // Try CSI first, then UVC
-    if (VTABLE_CSI.init() == ESP_OK) {
-        handle->vt = &VTABLE_CSI;
-        return ESP_OK;
+    // Go straight to the last known-good backend, fall back to CSI then UVC
+    const camera_vtable_t *order[2] = {&VTABLE_CSI, &VTABLE_UVC};
+
+    camera_cache_load();
+    if (g_camCache.backend == CAM_BACKEND_UVC) {
+        order[0] = &VTABLE_UVC;
+        order[1] = &VTABLE_CSI;
+    } else if (g_camCache.backend == CAM_BACKEND_CSI) {
+        camera_config.sccb_addr_hint = g_camCache.sccbAddr;
+        camera_config.sensor_pid_hint = g_camCache.pid;
+        if (g_camCache.xclkHz) {
+            camera_config.xclk_freq_hz = g_camCache.xclkHz;
+        }
     }
 
-    if (VTABLE_UVC.init() == ESP_OK) {
-        handle->vt = &VTABLE_UVC;
-        return ESP_OK;
+    for (int i = 0; i < 2; i++) {
+        if (order[i]->init() == ESP_OK) {
+            handle->vt = order[i];
+            camera_cache_store(order[i] == &VTABLE_CSI ? CAM_BACKEND_CSI : CAM_BACKEND_UVC);
+            return ESP_OK;
+        }
+        if (i == 0 && g_camCache.backend != CAM_BACKEND_NONE) {
+            ESP_LOGW(TAG, "cached %s camera failed, probing %s", order[0]->name, order[1]->name);
+        }
+        // full probe from here on
+        camera_config.sccb_addr_hint = 0;
+        camera_config.sensor_pid_hint = 0;
     }
 
     handle->vt = NULL;
@@ -424,8 +508,9 @@ static esp_err_t init_camera(mdCamera_t *handle)
 esp_err_t camera_open(QueueHandle_t in, QueueHandle_t out)
 {
     struct mdCamera *handle = &g_mdCamera;
+    energy_phase_begin(ENERGY_PHASE_CAMERA);
     if (ESP_OK != init_camera(handle)) {
-        sleep_set_event_bits(SLEEP_SNAPSHOT_STOP_BIT); // if no subsequent snapshot tasks, will enter sleep;
+        energy_phase_end(ENERGY_PHASE_CAMERA);
         return ESP_FAIL;
     }
     handle->mutex = xSemaphoreCreateMutex();
@@ -444,7 +529,6 @@ esp_err_t camera_open(QueueHandle_t in, QueueHandle_t out)
     }
     ESP_LOGI(TAG, "wait for sensor stable with configurable delay %d ms", (int)capAttr.camWarmupMs);
     vTaskDelay(pdMS_TO_TICKS(capAttr.camWarmupMs));
-    sleep_set_event_bits(SLEEP_SNAPSHOT_STOP_BIT);          // if no subsequent snapshot tasks, will enter sleep;
     misc_get_battery_voltage();
     
     return ESP_OK;
@@ -460,6 +544,7 @@ esp_err_t camera_close()
         h->vt->deinit();
     }
     misc_io_set(CAMERA_POWER_IO,  CAMERA_POWER_OFF);
+    energy_phase_end(ENERGY_PHASE_CAMERA);
     return ESP_OK;
 }
 
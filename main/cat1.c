@@ -13,8 +13,10 @@
 #include "esp_netif.h"
 #include "esp_netif_ppp.h"
 #include "esp_modem_api.h"
+#include "cat1_bringup.h"
 #include "iot_mip.h"
 #include "debug.h"
+#include "energy.h"
 
 #define TAG "-->CAT1"  // Logging tag for CAT1 module
 
@@ -22,7 +24,7 @@
 // (same Quectel AT set: ATD*99***X#, AT+QICSGP, AT+CGDCONT, AT+QNETDEVCTL, etc.)
 
 // CAT1 module configuration
-#define CAT1_BAUD_RATE (921600)  // Default baud rate for CAT1 module
+#define CAT1_BAUD_RATE CAT1_BRINGUP_BAUD_RATE  // Default baud rate for CAT1 module
 
 // Timeout constants
 #define CAT1_POWER_ON_TIMEOUT_MS (30000)  // Max time to power on module
@@ -57,36 +59,6 @@ typedef struct mdCat1 {
 
 static mdCat1_t g_cat1 = {0};  // Global CAT1 module state
 
-/**
- * Check if current operator is Verizon (reference: verizon.c)
- * Verizon US: IMSI prefix 311480 (MCC 311, MNC 480) or operator name contains "Verizon"
- */
-static bool is_verizon_network(void)
-{
-    char atResp[256];
-    esp_err_t err;
-
-    /* Check by IMSI: Verizon US uses MCC 311, MNC 480 (IMSI prefix 311480) */
-    memset(atResp, 0, sizeof(atResp));
-    err = esp_modem_get_imsi(g_cat1.dce, atResp);
-    if (err == ESP_OK && strlen(atResp) >= 6) {
-        if (strncmp(atResp, "311480", 6) == 0) {
-            ESP_LOGI(TAG, "Verizon detected by IMSI prefix 311480");
-            return true;
-        }
-    }
-    /* Check by operator name from AT+COPS? */
-    memset(atResp, 0, sizeof(atResp));
-    err = esp_modem_at(g_cat1.dce, "AT+COPS?", atResp, 1000);
-    if (err == ESP_OK && strstr(atResp, "Verizon") != NULL) {
-        ESP_LOGI(TAG, "Verizon detected by operator name");
-        return true;
-    }
-
-
-    return false;
-}
-
 /**
  * PPP state change handler
  * @param arg Unused
@@ -178,9 +150,10 @@ static void on_ip_event(void *arg, esp_event_base_t event_base, int32_t event_id
 
 /**
  * Configure UART for CAT1 module
+ * @param ctx Unused
  * @param baud_rate Desired baud rate
  */
-static void configure_uart(uint32_t baud_rate)
+static void configure_uart(void *ctx, uint32_t baud_rate)
 {
     uart_config_t uart_config = {};
     uart_config.baud_rate = baud_rate;
@@ -195,8 +168,8 @@ static void configure_uart(uint32_t baud_rate)
 
 /**
  * Send AT command and wait for response
+ * @param ctx Unused
  * @param atCmd AT command string
- * @param atCmdLen Command length
  * @param atResp Response buffer
  * @param atRespLen Response buffer length
  * @param timeout Timeout in ms
@@ -204,9 +177,10 @@ static void configure_uart(uint32_t baud_rate)
  * @param fail_phrase Failure response phrase
  * @return ESP_OK on success
  */
-static esp_err_t cat1_write_at(const char *atCmd, int atCmdLen, char *atResp, int atRespLen, int timeout, const char *pass_phrase, const char *fail_phrase)
+static esp_err_t cat1_write_at(void *ctx, const char *atCmd, char *atResp, int atRespLen, int timeout, const char *pass_phrase, const char *fail_phrase)
 {
     esp_err_t err = ESP_OK;
+    int atCmdLen = strlen(atCmd);
     int txLen = uart_write_bytes(UART_NUM_1, atCmd, atCmdLen);
     if (txLen != atCmdLen) {
         ESP_LOGE(TAG, "uart_write_bytes failed");
@@ -242,93 +216,32 @@ static esp_err_t cat1_write_at(const char *atCmd, int atCmdLen, char *atResp, in
     return err;
 }
 
-/**
- * Get current baud rate from module
- * @return Current baud rate or -1 on error
- */
-static int32_t cat1_get_baud_rate()
+static void cat1_delay_ms(void *ctx, int ms)
 {
-    int32_t baud_rate = -1;
-    char atResp[256];
-
-    memset(atResp, 0, sizeof(atResp));
-    esp_err_t err = cat1_write_at("AT+IPR?\r", strlen("AT+IPR?\r"), atResp, sizeof(atResp), 300, "OK", "ERROR");
-    if (err != ESP_OK) {
-        ESP_LOGI(TAG, "AT+IPR? failed with %d", err);
-        return baud_rate;
-    }
-    ESP_LOGI(TAG, "AT+IPR?=>%s", atResp);
-    char *p = strstr(atResp, "+IPR:");
-    if (p) {
-        p += strlen("+IPR:");
-        baud_rate = atoi(p);
-    }
-    return baud_rate;
+    vTaskDelay(pdMS_TO_TICKS(ms));
 }
 
+static const cat1BringupOps_t g_cat1Ops = {
+    .delay_ms = cat1_delay_ms,
+    .set_baud = configure_uart,
+    .write_at = cat1_write_at,
+};
+
 /**
- * Set module baud rate
- * @param baud_rate Desired baud rate
- * @return ESP_OK on success
+ * Cellular settings of the bring-up, from g_cat1
  */
-static esp_err_t cat1_set_baud_rate(uint32_t baud_rate)
+static cat1BringupParam_t cat1_bringup_param(void)
 {
-    esp_err_t err = ESP_FAIL;
-    char atCmd[64];
-    char atResp[256];
-
-    // Quectel (EC800E/EG915Q) default baud rate is 115200, needs to be changed to 921600
-    int *baud_rate_array = NULL;
-    int baud_rate_len = 0;
-    int baud_rate_index = 0;
-    if (baud_rate != CAT1_BAUD_RATE) {
-        baud_rate_array = (int[]){115200, 230400, 460800, 921600};
-        baud_rate_len = 4;
-    } else {
-        baud_rate_array = (int[]){CAT1_BAUD_RATE};
-        baud_rate_len = 1;
-    }
-    int try_count = 0;
-    while (true) {
-        try_count++;
-        if (try_count > 30) {
-            ESP_LOGE(TAG, "get baud rate failed");
-            break;
-        }
-        // Error handling to avoid failing to find suitable baud rate
-        if (try_count > 20 && baud_rate_len != 4) {
-            baud_rate_array = (int[]){115200, 230400, 460800, 921600};
-            baud_rate_len = 4;
-            baud_rate_index = 0;
-        }
-        ESP_LOGI(TAG, "use baud rate %d to get baud rate", baud_rate_array[baud_rate_index]);
-        configure_uart(baud_rate_array[baud_rate_index]);
-
-        int32_t n = cat1_get_baud_rate();
-        if (n < 0) {
-            baud_rate_index++;
-            if (baud_rate_index >= baud_rate_len) {
-                baud_rate_index = 0;
-            }
-            vTaskDelay(pdMS_TO_TICKS(100));
-            continue;
-        }
-
-        ESP_LOGI(TAG, "current baud rate is %ld", n);
-        err = ESP_OK;
-        if (n != CAT1_BAUD_RATE) {
-            snprintf(atCmd, sizeof(atCmd), "AT+IPR=%d;&W\r", CAT1_BAUD_RATE);
-            err = cat1_write_at(atCmd, strlen(atCmd), atResp, sizeof(atResp), 1000, "OK", "ERROR");
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "AT+IPR failed with %d", err);
-                vTaskDelay(pdMS_TO_TICKS(100));
-                continue;
-            }
-            ESP_LOGI(TAG, "set baud rate to %d", CAT1_BAUD_RATE);
-        }
-        break;
-    }
-    return err;
+    cat1BringupParam_t param = {
+        .cmux = g_cat1.mode == MODE_CONFIG,
+        .pin = g_cat1.param.pin,
+        .isp = g_cat1.param.isp_select,
+        .apn = g_cat1.param.apn,
+        .user = g_cat1.param.user,
+        .password = g_cat1.param.password,
+        .authentication = g_cat1.param.authentication,
+    };
+    return param;
 }
 
 /**
@@ -702,11 +615,11 @@ static esp_err_t check_baud_rate()
     cfg_get_cellular_baud_rate(&baudRate);
     ESP_LOGI(TAG, "Baud rate: %ld", baudRate);
     uart_driver_install(UART_NUM_1, 2048, 2048, 0, NULL, 0);
-    err = cat1_set_baud_rate(baudRate);
+    err = cat1_bringup_baud_rate(&g_cat1Ops, baudRate);
     uart_driver_delete(UART_NUM_1);
     cfg_set_cellular_baud_rate(CAT1_BAUD_RATE);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "cat1_set_baud_rate failed with %d", err);
+        ESP_LOGE(TAG, "cat1_bringup_baud_rate failed with %d", err);
         return err;
     }
 
@@ -717,6 +630,10 @@ static esp_err_t check_baud_rate()
     dte_config.uart_config.rx_io_num = MODEM_UART_RX_PIN;
     dte_config.uart_config.rx_buffer_size = 8192;
     dte_config.uart_config.tx_buffer_size = 8192;
+#if CONFIG_ESP_MODEM_PPP_DIRECT_INPUT
+    // PPP and IP input run in the terminal task instead of the tcpip thread, give it that stack too
+    dte_config.task_stack_size += CONFIG_LWIP_TCPIP_TASK_STACK_SIZE;
+#endif
     esp_modem_dce_config_t dce_config = ESP_MODEM_DCE_DEFAULT_CONFIG(g_cat1.param.apn);
     esp_netif_config_t netif_ppp_config = ESP_NETIF_DEFAULT_PPP();
     g_cat1.esp_netif = esp_netif_new(&netif_ppp_config);
@@ -732,211 +649,20 @@ static esp_err_t check_baud_rate()
  */
 static esp_err_t check_pin_status()
 {
-    char atCmd[256];
-    char atResp[256];
-    esp_err_t err = ESP_OK;
-
-    memset(atResp, 0, sizeof(atResp));
-    snprintf(atCmd, sizeof(atCmd), "%s", "ATE0");
-    err = esp_modem_at(g_cat1.dce, atCmd, atResp, 500);
-    ESP_LOGI(TAG, "%s=>%s", atCmd, atResp);
-
-    // Check if a PIN is required
-    int retry = 0;
-    while (retry++ < 10) {
-        memset(atResp, 0, sizeof(atResp));
-        snprintf(atCmd, sizeof(atCmd), "%s", "AT+CPIN?");
-        err = esp_modem_at(g_cat1.dce, atCmd, atResp, 500);
-        ESP_LOGI(TAG, "%s=>%s", atCmd, atResp);
-        if (err == ESP_OK && strstr(atResp, "+CPIN:") != NULL) {
-            break;
-        }
-        vTaskDelay(pdMS_TO_TICKS(1000));
-    }
-    if (err == ESP_OK) {
-        if (strstr(atResp, "READY") != NULL) {
-            // No PIN required
-            snprintf(g_cat1.status.modemStatus, sizeof(g_cat1.status.modemStatus), "%s", "Ready");
-        } else if (strstr(atResp, "SIM PIN")) {
-            // PIN code is required, try to enter the PIN code
-            if (g_cat1.param.pin[0] == '\0') {
-                err = ESP_FAIL;
-                ESP_LOGE(TAG, "PIN code is required, please set it in the configuration");
-                snprintf(g_cat1.status.modemStatus, sizeof(g_cat1.status.modemStatus), "%s", "PIN Required");
-            } else {
-                memset(atResp, 0, sizeof(atResp));
-                snprintf(atCmd, sizeof(atCmd), "AT+CPIN=%s", g_cat1.param.pin);// compatible with EG912U-GL modification
-                err = esp_modem_at(g_cat1.dce, atCmd, atResp, 5000);
-                ESP_LOGI(TAG, "%s=>%s", atCmd, atResp);
-                if (err == ESP_OK) {
-                    ESP_LOGI(TAG, "esp_modem_at(%s) success", atCmd);
-                    snprintf(g_cat1.status.modemStatus, sizeof(g_cat1.status.modemStatus), "%s", "Ready");
-                } else {
-                    ESP_LOGE(TAG, "esp_modem_at(%s) failed with %d(%s)", atCmd, err, atResp);
-                    snprintf(g_cat1.status.modemStatus, sizeof(g_cat1.status.modemStatus), "%s", "PIN Error");
-                }
-            }
-        } else if (strstr(atResp, "SIM PUK")) {
-            // PUK code is required and needs to be solved by the user
-            err = ESP_FAIL;
-            ESP_LOGE(TAG, "PUK code is required, please contact your service provider");
-            snprintf(g_cat1.status.modemStatus, sizeof(g_cat1.status.modemStatus), "%s", "PUK Required");
-        } else {
-            // Other states are not processed yet and are considered SIM card errors.
-            err = ESP_FAIL;
-            ESP_LOGE(TAG, "PIN status is not supported");
-            snprintf(g_cat1.status.modemStatus, sizeof(g_cat1.status.modemStatus), "%s", "SIM Card Error");
-        }
-    } else {
-        ESP_LOGE(TAG, "SIM card error");
-        int errCode = -1;
-        sscanf(atResp, "+CME ERROR: %d", &errCode);
-        switch (errCode) {
-        case 10:
-            snprintf(g_cat1.status.modemStatus, sizeof(g_cat1.status.modemStatus), "%s", "No SIM Card");
-            break;
-        default:
-            snprintf(g_cat1.status.modemStatus, sizeof(g_cat1.status.modemStatus), "%s", "SIM Card Error");
-        }
-    }
-
-    return err;
+    cat1BringupParam_t param = cat1_bringup_param();
+    return cat1_bringup_pin(&g_cat1Ops, g_cat1.dce, &param,
+                            g_cat1.status.modemStatus, sizeof(g_cat1.status.modemStatus));
 }
 
 /**
- * Establish network connection
- *
- * Quectel (EC800E/EG915Q) Verizon compatibility (ref: verizon.c, Quectel LTE TCP/IP App Note):
- * 1. PDP context 3: Verizon requires context 3 for data (OTA-DM uses ctx1 for attach, ctx3 for bearer)
- * 2. AT+CGDCONT: define PDP context (APN). Empty APN ok for Verizon auto-provision.
- * 3. AT+QICSGP: configure TCP/IP context (context_id, protocol, APN, user, pass, auth)
- * 4. AT+QNETDEVCTL=1,3,1: activate context 3 before dial (in udhcpcd_dialer)
- * 5. ATD*99***3#: dial using context 3 (via esp_modem pdp context_id)
- *
+ * Establish network connection, see cat1_bringup_network()
  * @return ESP_OK on success
  */
 esp_err_t connect_to_network()
 {
-    char atCmd[256];
-    char atResp[256];
-    esp_err_t err = ESP_OK;
-    int reg_state = 0;
-    int reg_retry = 0;
-    int max_retry = 10; 
-    int context_id = 1;  /* Default context 1; use 3 for Verizon */
-
-    /* Verizon compatibility: use PDP context 3 when isp_select=verizon or (isp_select=auto/empty and network detected as Verizon) */
-    bool force_verizon = (strcmp(g_cat1.param.isp_select, "verizon") == 0);
-    bool auto_verizon = is_verizon_network();
-    bool is_auto = (g_cat1.param.isp_select[0] == '\0' || strcmp(g_cat1.param.isp_select, "auto") == 0);
-    if (force_verizon || (is_auto && auto_verizon)) {
-        context_id = 3;
-        ESP_LOGI(TAG, "Using PDP context 3 (isp_select=%s, force=%d, auto_detect=%d)",
-                 g_cat1.param.isp_select, (int)force_verizon, (int)auto_verizon);
-
-        /* Verizon: clear context 1 before configuring context 3 (ref: AT+QICSGP=1,3,"","","",0) */
-        memset(atResp, 0, sizeof(atResp));
-        err = esp_modem_at(g_cat1.dce, "AT+QICSGP=1,3,\"\",\"\",\"\",0", atResp, 500);
-        ESP_LOGI(TAG, "AT+QICSGP=1,3,\"\",\"\",\"\",0=>%s", atResp);
-        if (err != ESP_OK) {
-            ESP_LOGW(TAG, "AT+QICSGP clear ctx1 failed %d(%s)", err, atResp);
-        }
-    }
-
-    /* Configure PDP context (required for Verizon context 3 even when APN is empty)
-     * 1. esp_modem_configure_pdp_context: updates internal pdp context (used by setup_data_mode)
-     * 2. esp_modem_set_pdp_context: sends AT+CGDCONT + sets dial context (ATD*99***X#)
-     * 3. AT+QICSGP: configure TCP/IP context
-     */
-    const char *apn = (g_cat1.param.apn[0] != '\0') ? g_cat1.param.apn : "";
-
-    /* Configure internal PDP context (updates GenericModule::pdp member) */
-    esp_modem_PdpContext_t pdp_ctx = {
-        .context_id = context_id,
-        .protocol_type = "IP",
-        .apn = apn,
-    };
-    err = esp_modem_configure_pdp_context(g_cat1.dce, &pdp_ctx);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "esp_modem_configure_pdp_context failed %d", err);
-        snprintf(g_cat1.status.modemStatus, sizeof(g_cat1.status.modemStatus), "%s", "SIM Card Error");
-    }
-    /* AT+QICSGP: context_id, protocol_type(1=IPv4), APN, user, pass, auth  */
-    memset(atResp, 0, sizeof(atResp));
-    snprintf(atCmd, sizeof(atCmd), "AT+QICSGP=%d,1,\"%s\",\"%s\",\"%s\",%d",
-             context_id, apn, g_cat1.param.user, g_cat1.param.password, g_cat1.param.authentication);
-    err = esp_modem_at(g_cat1.dce, atCmd, atResp, 500);
-    ESP_LOGI(TAG, "%s=>%s", atCmd, atResp);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "esp_modem_at(%s) failed with %d(%s)", atCmd, err, atResp);
-        snprintf(g_cat1.status.modemStatus, sizeof(g_cat1.status.modemStatus), "%s", "SIM Card Error");
-    }
-
-    // Activate roaming service
-    memset(atResp, 0, sizeof(atResp));
-    snprintf(atCmd, sizeof(atCmd), "%s", "AT+QCFG=\"roamservice\",2,1");
-    err = esp_modem_at(g_cat1.dce, atCmd, atResp, 500);
-    ESP_LOGI(TAG, "%s=>%s", atCmd, atResp);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "esp_modem_at(%s) failed with %d(%s)", atCmd, err, atResp);
-        snprintf(g_cat1.status.modemStatus, sizeof(g_cat1.status.modemStatus), "%s", "SIM Card Error");
-    }
-
-    // Enable network registration with location information, otherwise LAC and Cell ID cannot be obtained
-    memset(atResp, 0, sizeof(atResp));
-    snprintf(atCmd, sizeof(atCmd), "%s", "AT+CREG=2");
-    err = esp_modem_at(g_cat1.dce, atCmd, atResp, 500);
-    ESP_LOGI(TAG, "%s=>%s", atCmd, atResp);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "esp_modem_at(%s) failed with %d(%s)", atCmd, err, atResp);
-    }
-    /* Wait for network registration before entering PPP data mode.
-     * When the module is still searching (CREG/CEREG=2 or QENG: "SEARCH"/"NOCONN"),
-     * forcing DATA mode often fails with ESP_FAIL. Here we poll the registration
-     * state for a short period; if it never reaches Registered(1/5), we skip PPP
-     * for this cycle and let upper layers treat it as "no network, save to flash".
-     */
-    while (reg_retry++ < max_retry) {
-        if (esp_modem_get_network_registration_state(g_cat1.dce, &reg_state) == ESP_OK &&
-            (reg_state == 1 || reg_state == 5)) {
-            ESP_LOGI(TAG, "Network registered, state=%d", reg_state);
-            break;
-        }
-        ESP_LOGI(TAG, "Network not registered yet, state=%d, retry=%d/%d",
-                 reg_state, reg_retry, max_retry);
-        vTaskDelay(pdMS_TO_TICKS(1000));
-    }
-
-    if (!(reg_state == 1 || reg_state == 5)) {
-        ESP_LOGW(TAG, "Network still not registered, skip PPP dialing this cycle");
-        snprintf(g_cat1.status.modemStatus, sizeof(g_cat1.status.modemStatus), "%s", "Network Searching");
-        return ESP_FAIL;
-    }
-    
-    reg_retry = 0;
-    max_retry = 5;
-    while (reg_retry++ < max_retry) {
-        ESP_LOGI(TAG, "Setting mode, retry=%d/%d", reg_retry, max_retry);
-        if (g_cat1.mode == MODE_CONFIG) {
-            ESP_LOGI(TAG, "Using CMUX mode");
-            err = esp_modem_set_mode(g_cat1.dce, ESP_MODEM_MODE_CMUX);
-            if (err == ESP_OK) {
-                ESP_LOGI(TAG, "CMUX mode enabled successfully");
-                break;
-            }
-        } else {
-            ESP_LOGI(TAG, "Using DATA mode");
-            err = esp_modem_set_mode(g_cat1.dce, ESP_MODEM_MODE_DATA);
-            if (err == ESP_OK) {
-                ESP_LOGI(TAG, "DATA mode enabled successfully");
-                break;
-            } 
-        }
-        esp_modem_set_mode(g_cat1.dce, ESP_MODEM_MODE_UNDEF);
-        vTaskDelay(pdMS_TO_TICKS(1000));
-    }
-
-    return ESP_OK;
+    cat1BringupParam_t param = cat1_bringup_param();
+    return cat1_bringup_network(&g_cat1Ops, g_cat1.dce, &param,
+                                g_cat1.status.modemStatus, sizeof(g_cat1.status.modemStatus));
 }
 
 /**
@@ -1012,6 +738,7 @@ void cat1_open()
     xEventGroupClearBits(g_cat1.event_group, CAT1_POWER_ON_BIT);
     xEventGroupClearBits(g_cat1.event_group, CAT1_STA_CONNECT_BIT);
     xEventGroupClearBits(g_cat1.event_group, CAT1_STA_DISCONNECT_BIT);
+    energy_phase_begin(ENERGY_PHASE_CAT1);  // modem stays powered until deep sleep
     BaseType_t task = xTaskCreatePinnedToCore((TaskFunction_t)task_start_modem, TAG, 8 * 1024, NULL, 5, NULL, 0);
     if (task == pdPASS) {
     } else {
@@ -1044,6 +771,7 @@ void cat1_close(void)
 {
     // esp_modem_destroy(g_cat1.dce);
     // esp_netif_destroy(g_cat1.esp_netif);
+    energy_phase_end(ENERGY_PHASE_CAT1);
 }
 
 /**
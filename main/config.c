@@ -19,7 +19,20 @@
 // Handles for NVS namespaces
 static nvs_handle_t g_userHandle = 0;      ///< Handle for user configuration namespace
 static nvs_handle_t g_factoryHandle = 0;   ///< Handle for factory configuration namespace
-static SemaphoreHandle_t g_mutex = 0;      ///< Mutex for thread-safe access
+static SemaphoreHandle_t g_mutex = 0;      ///< Recursive mutex for thread-safe access, held across a batch
+
+// Longest stored value compared before a batched write, longer values are always written
+#define CFG_BATCH_CMP_LEN 128
+
+/**
+ * Batched userspace update state, see cfg_batch_begin()
+ */
+typedef struct cfgBatch {
+    bool active;       ///< Userspace commits are deferred to cfg_batch_end()
+    uint32_t changed;  ///< Keys whose stored value differed from the written one
+} cfgBatch_t;
+
+static cfgBatch_t g_batch = {0};
 
 /**
  * Create configuration mutex
@@ -27,7 +40,7 @@ static SemaphoreHandle_t g_mutex = 0;      ///< Mutex for thread-safe access
  */
 static void mutex_create(void)
 {
-    g_mutex = xSemaphoreCreateMutex();
+    g_mutex = xSemaphoreCreateRecursiveMutex();
 }
 
 /**
@@ -46,7 +59,7 @@ static void mutex_free(void)
 static void mutex_lock(void)
 {
     if (g_mutex) {
-        xSemaphoreTake(g_mutex, portMAX_DELAY);
+        xSemaphoreTakeRecursive(g_mutex, portMAX_DELAY);
     }
 }
 
@@ -57,18 +70,22 @@ static void mutex_lock(void)
 static void mutex_unlock(void)
 {
     if (g_mutex) {
-        xSemaphoreGive(g_mutex);
+        xSemaphoreGiveRecursive(g_mutex);
     }
 }
 
 /**
  * Commit configuration changes to NVS
+ * Userspace commits are deferred while a batch is open
  * @param handle NVS namespace handle
  * @return ESP_OK on success, error code otherwise
  */
 static esp_err_t commit_cfg(nvs_handle_t handle)
 {
     esp_err_t err = ESP_OK;
+    if (g_batch.active && handle == g_userHandle) {
+        return ESP_OK;
+    }
     err = nvs_commit(handle);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "commit failed");
@@ -208,6 +225,28 @@ static esp_err_t cfg_reopen_userspace(void)
 //     return err;
 // }
 
+/**
+ * Store a value string
+ * While a batch is open, userspace keys that already hold the value are skipped
+ * and the others are counted as changed
+ * @param handle NVS namespace handle
+ * @param key Key name
+ * @param value Value string
+ * @return ESP_OK on success, error code otherwise
+ */
+static esp_err_t write_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    if (g_batch.active && handle == g_userHandle) {
+        char cur[CFG_BATCH_CMP_LEN];
+        size_t len = sizeof(cur);
+        if (nvs_get_str(handle, key, cur, &len) == ESP_OK && strcmp(cur, value) == 0) {
+            return ESP_OK;
+        }
+        g_batch.changed++;
+    }
+    return nvs_set_str(handle, key, value);
+}
+
 static esp_err_t get_u32(nvs_handle_t handle, const char *key, uint32_t *value, uint32_t def)
 {
     esp_err_t err = ESP_OK;
@@ -229,7 +268,7 @@ static esp_err_t set_u32(nvs_handle_t handle, const char *key, uint32_t value)
     char in_value[32] = {0};
 
     snprintf(in_value, sizeof(in_value), "%lu", value);
-    err = nvs_set_str(handle, key, in_value);
+    err = write_str(handle, key, in_value);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "set key:%s value:%ld failed", key, value);
     }
@@ -257,7 +296,7 @@ static esp_err_t set_i32(nvs_handle_t handle, const char *key, int32_t value)
     char in_value[32] = {0};
 
     snprintf(in_value, sizeof(in_value), "%ld", value);
-    err = nvs_set_str(handle, key, in_value);
+    err = write_str(handle, key, in_value);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "set key:%s value:%ld failed", key, value);
     }
@@ -286,7 +325,7 @@ static esp_err_t set_u8(nvs_handle_t handle, const char *key, uint8_t value)
     char in_value[32] = {0};
 
     snprintf(in_value, sizeof(in_value), "%u", value);
-    err = nvs_set_str(handle, key, in_value);
+    err = write_str(handle, key, in_value);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "set key:%s value:%d failed", key, value);
     }
@@ -315,7 +354,7 @@ static esp_err_t set_i8(nvs_handle_t handle, const char *key, int8_t value)
     char in_value[32] = {0};
 
     snprintf(in_value, sizeof(in_value), "%d", value);
-    err = nvs_set_str(handle, key, in_value);
+    err = write_str(handle, key, in_value);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "set key:%s value:%d failed", key, value);
     }
@@ -339,7 +378,7 @@ static esp_err_t get_str(nvs_handle_t handle, const char *key, char *value, size
 static esp_err_t set_str(nvs_handle_t handle, const char *key, const char *value)
 {
     esp_err_t err = ESP_OK;
-    err = nvs_set_str(handle, key, value);
+    err = write_str(handle, key, value);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "set key:%s value:%s failed", key, value);
     }
@@ -504,6 +543,61 @@ void cfg_erase_key(const char *key)
     mutex_unlock();
 }
 
+/**
+ * Open a batched userspace update
+ * Holds the config lock until cfg_batch_end(); cfg_set_* calls made by this
+ * task in between only write keys whose value changes and share one commit
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if a batch is already open
+ */
+esp_err_t cfg_batch_begin(void)
+{
+    mutex_lock();
+    if (g_batch.active) {
+        mutex_unlock();
+        return ESP_ERR_INVALID_STATE;
+    }
+    g_batch.active = true;
+    g_batch.changed = 0;
+    return ESP_OK;
+}
+
+/**
+ * Close a batched userspace update: commit the written keys and release the config lock
+ * NVS writes each cfg_set_* value when it is called, a batch cannot be discarded
+ * @param changed Output number of keys written, may be NULL
+ * @return ESP_OK on success, error code of the commit otherwise
+ */
+esp_err_t cfg_batch_end(uint32_t *changed)
+{
+    esp_err_t err = ESP_OK;
+
+    if (!g_batch.active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    g_batch.active = false;
+    if (g_batch.changed) {
+        err = commit_cfg(g_userHandle);
+        if (err != ESP_OK && cfg_reopen_userspace() != ESP_OK) {
+            ESP_LOGE(TAG, "cfg_reopen_userspace failed after batch");
+        }
+    }
+    if (changed) {
+        *changed = g_batch.changed;
+    }
+    mutex_unlock();
+    return err;
+}
+
+/**
+ * Keys written so far by the open batch
+ * Sampled around a group of cfg_set_* calls to tell whether the group changed anything
+ * @return Number of keys whose stored value differed, 0 when no batch is open
+ */
+uint32_t cfg_batch_changed(void)
+{
+    return g_batch.active ? g_batch.changed : 0;
+}
+
 void cfg_dump()
 {
     nvs_iterator_t it = NULL;
@@ -661,10 +755,13 @@ static int do_debug_cmd(int argc, char **argv)
         printf("invalid argvment, eg: debug on\n");
         return ESP_OK;
     }
+    static sleepToken_t debugAwake = SLEEP_TOKEN_INVALID;
     if (strcmp(argv[1], "off") == 0) {
-        sleep_set_event_bits(SLEEP_NO_DEBUG_BIT);
+        sleep_release(&debugAwake);
     } else if (strcmp(argv[1], "on") == 0) {
-        sleep_clear_event_bits(SLEEP_NO_DEBUG_BIT);
+        // optional: debug on <minutes>, auto-release after the given time
+        uint32_t minutes = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+        sleep_keep_awake(&debugAwake, "debug", minutes * 60 * 1000);
     }
     printf("debug %s\n", argv[1]);
     return ESP_OK;
@@ -713,7 +810,7 @@ static esp_console_cmd_t g_cmd[] = {
     {"date", "show system date", NULL, do_date_cmd, NULL},
     {"rpsurl", "set rps url", NULL, do_rpsurl_cmd, NULL},
     {"sys_reset", "system reset", NULL, do_reset_cmd, NULL},
-    {"debug", "debug on/off", NULL, do_debug_cmd, NULL},
+    {"debug", "debug on [minutes]/off", NULL, do_debug_cmd, NULL},
     {"snap", "snapshot", NULL, do_snap_cmd, NULL},
     {"mode", "set mode", NULL, do_mode_cmd, NULL},
 };
@@ -1304,6 +1401,38 @@ esp_err_t cfg_get_time_err_rate(int32_t *err_rate)
     return ESP_OK;
 }
 
+esp_err_t cfg_set_time_drift_model(const void *model, size_t len)
+{
+    esp_err_t err;
+
+    mutex_lock();
+    err = nvs_set_blob(g_factoryHandle, KEY_SYS_TIME_DRIFT, model, len);
+    if (err == ESP_OK) {
+        err = commit_cfg(g_factoryHandle);
+    } else {
+        ESP_LOGE(TAG, "set key:%s failed[%s]", KEY_SYS_TIME_DRIFT, esp_err_to_name(err));
+    }
+    mutex_unlock();
+    return err;
+}
+
+esp_err_t cfg_get_time_drift_model(void *model, size_t len)
+{
+    esp_err_t err;
+    size_t stored = 0;
+
+    mutex_lock();
+    err = nvs_get_blob(g_factoryHandle, KEY_SYS_TIME_DRIFT, NULL, &stored);
+    if (err == ESP_OK && stored != len) {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    if (err == ESP_OK) {
+        err = nvs_get_blob(g_factoryHandle, KEY_SYS_TIME_DRIFT, model, &stored);
+    }
+    mutex_unlock();
+    return err;
+}
+
 esp_err_t cfg_set_ntp_sync(uint8_t enable)
 {
     mutex_lock();
@@ -76,6 +76,8 @@ extern "C" {
 #define KEY_CAP_INTERVAL_U  "cap:iUnit"
 #define KEY_CAP_INTERVAL_ANCHOR "cap:iAnchor" // Interval capture anchor time "HH:MM"
 #define KEY_CAP_CAM_WARMUP_MS "cap:camWarmupMs"
+#define KEY_CAM_DETECT      "cam:detect"    // Last camera backend/SCCB address/PID, see camera.c
+#define KEY_CAM_XCLK        "cam:xclk"
 #define KEY_UPLOAD_MODE     "upload:mode"
 #define KEY_UPLOAD_COUNT    "upload:count"
 #define KEY_UPLOAD_INTERVAL_V "upload:iValue"
@@ -106,6 +108,7 @@ extern "C" {
 #define KEY_SYS_SCHE_TIME   "sys:scheTime"
 #define KEY_SYS_TIME_ZONE   "sys:tz"
 #define KEY_SYS_TIME_ERR_RATE "sys:errRate"
+#define KEY_SYS_TIME_DRIFT  "sys:driftMdl"
 #define KEY_SYS_NTP_SYNC    "sys:bNtpSync"
 #define KEY_CFG_CRC32       "cfg:crc32"
 #define KEY_CAT1_IMEI       "cat1:imei"
@@ -123,6 +126,15 @@ extern "C" {
 #define KEY_PIR_WINDOW      "pir:window"
 #define KEY_PUSH_MODE       "push:mode"     // 0=MQTT (default), 1=Webhook
 #define KEY_WEBHOOK_URL     "whk:url"
+#define KEY_ENERGY_CPU      "energy:cpuUa"
+#define KEY_ENERGY_CAMERA   "energy:camUa"
+#define KEY_ENERGY_LED      "energy:ledUa"
+#define KEY_ENERGY_WIFI_TX  "energy:txUa"
+#define KEY_ENERGY_WIFI_RX  "energy:rxUa"
+#define KEY_ENERGY_CAT1     "energy:cat1Ua"
+#define KEY_ENERGY_SLEEP    "energy:sleepUa"
+#define KEY_ENERGY_TX_KBPS  "energy:txKbps"
+#define KEY_ENERGY_BATTERY  "energy:batMah"
 #define KEY_WEBHOOK_HEADER  "whk:header"    // Full "Key: Value" string
 
 
@@ -390,6 +402,9 @@ void cfg_get_i8(const char *key, int8_t *value, int8_t def);
 void cfg_get_u32(const char *key, uint32_t *value, uint32_t def);
 void cfg_get_str(const char *key, char *value, size_t length, const char *def);
 void cfg_erase_key(const char *key);
+esp_err_t cfg_batch_begin(void);
+esp_err_t cfg_batch_end(uint32_t *changed);
+uint32_t cfg_batch_changed(void);
 
 esp_err_t cfg_import(char *data, size_t len);
 esp_err_t cfg_export_userspace_ini(char *buf, size_t buf_sz, size_t *written);
@@ -404,6 +419,8 @@ esp_err_t cfg_set_timezone(char *tz);
 esp_err_t cfg_get_timezone(char *tz);
 esp_err_t cfg_set_time_err_rate(int32_t err_rate);
 esp_err_t cfg_get_time_err_rate(int32_t *err_rate);
+esp_err_t cfg_set_time_drift_model(const void *model, size_t len);
+esp_err_t cfg_get_time_drift_model(void *model, size_t len);
 esp_err_t cfg_get_device_info(deviceInfo_t *device);
 esp_err_t cfg_set_device_info(deviceInfo_t *device);
 esp_err_t cfg_get_image_attr(imgAttr_t *image);
@@ -27,11 +27,17 @@
  */
 #define PROMPT_STR "ne101"
 
+/* Command tables added before the console is opened (console init may be deferred) */
+#define DEBUG_PENDING_MAX 24
+
 /**
  * Debug module state structure
  */
 typedef struct mdDebug {
     bool isInit;    ///< Initialization flag
+    esp_console_cmd_t *pending[DEBUG_PENDING_MAX]; ///< Command tables waiting for debug_open()
+    uint32_t pendingCount[DEBUG_PENDING_MAX];      ///< Number of commands in each table
+    uint32_t pendingNum;                           ///< Number of waiting tables
 } mdDebug_t;
 
 static mdDebug_t g_debug = {0};
@@ -180,12 +186,17 @@ static void taskfunc(void *argv)
 void debug_open(void)
 {
     // return ;
-    memset(&g_debug, 0, sizeof(g_debug));
+    uint32_t i;
+
     initialize_console();
     /* Register commands */
     esp_console_register_help_command();
     xTaskCreatePinnedToCore((TaskFunction_t)taskfunc, TAG, 8 * 1024, NULL, 6, NULL, 1);
     g_debug.isInit = true;
+    for (i = 0; i < g_debug.pendingNum; i++) {
+        debug_cmd_add(g_debug.pending[i], g_debug.pendingCount[i]);
+    }
+    g_debug.pendingNum = 0;
 }
 
 /**
@@ -210,5 +221,12 @@ void debug_cmd_add(esp_console_cmd_t *cmd, uint32_t count)
         for (i = 0; i < count; i++) {
             esp_console_cmd_register(&cmd[i]);
         }
+    } else if (g_debug.pendingNum < DEBUG_PENDING_MAX) {
+        // Tables are static, keep the pointer until the console is up
+        g_debug.pending[g_debug.pendingNum] = cmd;
+        g_debug.pendingCount[g_debug.pendingNum] = count;
+        g_debug.pendingNum++;
+    } else {
+        ESP_LOGW(TAG, "console not open, drop %lu commands", count);
     }
 }
@@ -0,0 +1,315 @@
+/**
+ * Per-wake energy accounting
+ *
+ * Estimates charge drawn per wake from the time spent in each power state and
+ * a configurable current profile. Totals survive deep sleep in RTC memory and
+ * are scaled by a factor learned from the battery voltage trend.
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_console.h"
+#include "freertos/FreeRTOS.h"
+#include "energy.h"
+#include "config.h"
+#include "debug.h"
+#include "misc.h"
+
+#define TAG "-->ENERGY"
+
+#define ENERGY_RTC_MAGIC 0x454e5247          // "ENRG"
+#define ENERGY_UAS_PER_MAH 3600000.0f        // uA*s in one mAh
+#define ENERGY_SLEEP_MAX_SEC (7 * 24 * 3600) // Ignore sleep intervals beyond this (clock jumps)
+#define ENERGY_CAL_MIN_DROP 5                // Battery percent drop needed for a calibration step
+#define ENERGY_CAL_WEIGHT 0.3f               // Weight of a new calibration sample
+#define ENERGY_CAL_MIN 0.25f                 // Calibration factor bounds
+#define ENERGY_CAL_MAX 4.0f
+
+// Default current profile (uA), override with the energy:* config keys
+#define ENERGY_DEF_CPU_UA     40000
+#define ENERGY_DEF_CAMERA_UA  60000
+#define ENERGY_DEF_LED_UA     250000
+#define ENERGY_DEF_WIFI_TX_UA 190000
+#define ENERGY_DEF_WIFI_RX_UA 80000
+#define ENERGY_DEF_CAT1_UA    90000
+#define ENERGY_DEF_SLEEP_UA   50
+#define ENERGY_DEF_TX_KBPS    2000
+#define ENERGY_DEF_BATTERY_MAH 5000
+
+/**
+ * Totals kept across deep sleep
+ */
+typedef struct energyRtc {
+    uint32_t magic;       // ENERGY_RTC_MAGIC when valid
+    uint32_t wakes;       // Wakes since windowStart
+    time_t windowStart;   // Wall time accounting started
+    time_t sleepStart;    // Wall time deep sleep was entered, 0 if unknown
+    uint64_t totalUas;    // Estimated charge since windowStart, uncalibrated
+    uint32_t lastWakeUas; // Active part of the previous wake
+    uint32_t lastSleepUas;// Previous deep sleep
+    uint8_t calPercent;   // Battery percent at the calibration reference, 0 if none
+    uint64_t calUas;      // totalUas at the calibration reference
+    float calFactor;      // Observed / estimated charge
+} energyRtc_t;
+
+/**
+ * Energy module state
+ */
+typedef struct mdEnergy {
+    energyProfile_t profile;                 // Current profile
+    int64_t phaseStartUs[ENERGY_PHASE_MAX];  // Phase entry time, 0 when not in the phase
+    int64_t phaseUs[ENERGY_PHASE_MAX];       // Time spent per phase this wake
+    uint8_t ledDuty;                         // Current fill light duty
+    int64_t ledSinceUs;                      // Time of the last duty change
+    int64_t ledDutyUs;                       // Sum of duty percent x microseconds
+    uint64_t txBytes;                        // Bytes sent over Wi-Fi this wake
+    bool bOpen;                              // energy_open() done
+} mdEnergy_t;
+
+static mdEnergy_t g_energy = {0};
+static RTC_DATA_ATTR energyRtc_t g_energyRtc = {0};
+static portMUX_TYPE g_energyLock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *g_phaseName[ENERGY_PHASE_MAX] = {"camera", "wifi", "cat1"};
+
+static void energy_load_profile(energyProfile_t *p)
+{
+    cfg_get_u32(KEY_ENERGY_CPU, &p->cpuUa, ENERGY_DEF_CPU_UA);
+    cfg_get_u32(KEY_ENERGY_CAMERA, &p->cameraUa, ENERGY_DEF_CAMERA_UA);
+    cfg_get_u32(KEY_ENERGY_LED, &p->flashLedUa, ENERGY_DEF_LED_UA);
+    cfg_get_u32(KEY_ENERGY_WIFI_TX, &p->wifiTxUa, ENERGY_DEF_WIFI_TX_UA);
+    cfg_get_u32(KEY_ENERGY_WIFI_RX, &p->wifiRxUa, ENERGY_DEF_WIFI_RX_UA);
+    cfg_get_u32(KEY_ENERGY_CAT1, &p->cat1Ua, ENERGY_DEF_CAT1_UA);
+    cfg_get_u32(KEY_ENERGY_SLEEP, &p->sleepUa, ENERGY_DEF_SLEEP_UA);
+    cfg_get_u32(KEY_ENERGY_TX_KBPS, &p->wifiTxKbps, ENERGY_DEF_TX_KBPS);
+    cfg_get_u32(KEY_ENERGY_BATTERY, &p->batteryMah, ENERGY_DEF_BATTERY_MAH);
+    if (p->wifiTxKbps == 0) {
+        p->wifiTxKbps = ENERGY_DEF_TX_KBPS;
+    }
+}
+
+static void energy_rtc_reset(time_t now)
+{
+    memset(&g_energyRtc, 0, sizeof(g_energyRtc));
+    g_energyRtc.magic = ENERGY_RTC_MAGIC;
+    g_energyRtc.windowStart = now;
+    g_energyRtc.calFactor = 1.0f;
+}
+
+/**
+ * Charge drawn by the current wake so far, must hold g_energyLock
+ * @param now Current esp_timer time
+ * @param phaseUs Output time per phase, may be NULL
+ * @return Charge in uA*s
+ */
+static float energy_wake_uas(int64_t now, int64_t *phaseUs)
+{
+    const energyProfile_t *p = &g_energy.profile;
+    int64_t us[ENERGY_PHASE_MAX];
+    float uas;
+
+    for (int i = 0; i < ENERGY_PHASE_MAX; i++) {
+        us[i] = g_energy.phaseUs[i];
+        if (g_energy.phaseStartUs[i]) {
+            us[i] += now - g_energy.phaseStartUs[i];
+        }
+        if (phaseUs) {
+            phaseUs[i] = us[i];
+        }
+    }
+    int64_t ledDutyUs = g_energy.ledDutyUs + (int64_t)g_energy.ledDuty * (now - g_energy.ledSinceUs);
+    // TX time is bounded by the time the radio was on at all
+    int64_t txUs = (int64_t)(g_energy.txBytes * 8000 / p->wifiTxKbps);
+    if (txUs > us[ENERGY_PHASE_WIFI]) {
+        txUs = us[ENERGY_PHASE_WIFI];
+    }
+
+    uas = (float)p->cpuUa * now
+        + (float)p->cameraUa * us[ENERGY_PHASE_CAMERA]
+        + (float)p->wifiRxUa * (us[ENERGY_PHASE_WIFI] - txUs)
+        + (float)p->wifiTxUa * txUs
+        + (float)p->cat1Ua * us[ENERGY_PHASE_CAT1]
+        + (float)p->flashLedUa * ledDutyUs / 100.0f;
+    return uas / 1000000.0f;
+}
+
+static int do_energy_cmd(int argc, char **argv)
+{
+    energyReport_t report;
+
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        energy_rtc_reset(time(NULL));
+    }
+    energy_get_report(&report);
+    ESP_LOGI(TAG, "this wake %.3fmAh (%lums active)", report.wakeMah, report.activeMs);
+    for (int i = 0; i < ENERGY_PHASE_MAX; i++) {
+        ESP_LOGI(TAG, "  %-6s %lums", g_phaseName[i], report.phaseMs[i]);
+    }
+    ESP_LOGI(TAG, "last wake %.3fmAh, last sleep %.3fmAh", report.lastWakeMah, report.lastSleepMah);
+    ESP_LOGI(TAG, "total %.1fmAh, %.2fmAh/day, %lu wakes, calibration %.2f",
+             report.totalMah, report.mahPerDay, report.wakes, report.calibration);
+    return ESP_OK;
+}
+
+static esp_console_cmd_t g_cmd[] = {
+    ESP_CONSOLE_CMD_INIT("energy", "energy estimate, 'energy reset' restarts the totals", NULL, do_energy_cmd, NULL),
+};
+
+void energy_open(void)
+{
+    time_t now = time(NULL);
+
+    energy_load_profile(&g_energy.profile);
+    if (g_energyRtc.magic != ENERGY_RTC_MAGIC) {
+        energy_rtc_reset(now);
+    } else if (g_energyRtc.sleepStart) {
+        time_t slept = now - g_energyRtc.sleepStart;
+        if (slept > 0 && slept < ENERGY_SLEEP_MAX_SEC) {
+            g_energyRtc.lastSleepUas = g_energy.profile.sleepUa * (uint32_t)slept;
+            g_energyRtc.totalUas += g_energyRtc.lastSleepUas;
+        }
+    }
+    g_energyRtc.sleepStart = 0;
+    g_energy.bOpen = true;
+    debug_cmd_add(g_cmd, sizeof(g_cmd) / sizeof(esp_console_cmd_t));
+}
+
+void energy_phase_begin(energyPhase_e phase)
+{
+    if (phase >= ENERGY_PHASE_MAX) {
+        return;
+    }
+    portENTER_CRITICAL(&g_energyLock);
+    if (g_energy.phaseStartUs[phase] == 0) {
+        g_energy.phaseStartUs[phase] = esp_timer_get_time();
+    }
+    portEXIT_CRITICAL(&g_energyLock);
+}
+
+void energy_phase_end(energyPhase_e phase)
+{
+    if (phase >= ENERGY_PHASE_MAX) {
+        return;
+    }
+    portENTER_CRITICAL(&g_energyLock);
+    if (g_energy.phaseStartUs[phase]) {
+        g_energy.phaseUs[phase] += esp_timer_get_time() - g_energy.phaseStartUs[phase];
+        g_energy.phaseStartUs[phase] = 0;
+    }
+    portEXIT_CRITICAL(&g_energyLock);
+}
+
+void energy_led_duty(uint8_t duty)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&g_energyLock);
+    g_energy.ledDutyUs += (int64_t)g_energy.ledDuty * (now - g_energy.ledSinceUs);
+    g_energy.ledDuty = duty;
+    g_energy.ledSinceUs = now;
+    portEXIT_CRITICAL(&g_energyLock);
+}
+
+void energy_add_tx_bytes(size_t bytes)
+{
+    portENTER_CRITICAL(&g_energyLock);
+    if (g_energy.phaseStartUs[ENERGY_PHASE_WIFI]) {
+        g_energy.txBytes += bytes;
+    }
+    portEXIT_CRITICAL(&g_energyLock);
+}
+
+/**
+ * Update the calibration factor from the battery percent trend.
+ * A drop of ENERGY_CAL_MIN_DROP percent of the configured capacity is compared
+ * with the estimate over the same span; charging or external power resets it.
+ * Wakes that did not open the ADC (sleep-only boots) leave it alone.
+ */
+static void energy_calibrate(void)
+{
+    if (misc_get_battery_voltage() == 0) {
+        return;
+    }
+    uint8_t percent = misc_get_battery_voltage_rate();
+
+    if (percent <= 1 || percent > g_energyRtc.calPercent) {
+        // external power, charging or first sample: restart the reference
+        g_energyRtc.calPercent = percent > 1 ? percent : 0;
+        g_energyRtc.calUas = g_energyRtc.totalUas;
+        return;
+    }
+    if (g_energyRtc.calPercent - percent < ENERGY_CAL_MIN_DROP) {
+        return;
+    }
+    float estimated = (g_energyRtc.totalUas - g_energyRtc.calUas) / ENERGY_UAS_PER_MAH;
+    float observed = (g_energyRtc.calPercent - percent) * g_energy.profile.batteryMah / 100.0f;
+    if (estimated > 0) {
+        float factor = observed / estimated;
+        factor = factor < ENERGY_CAL_MIN ? ENERGY_CAL_MIN : (factor > ENERGY_CAL_MAX ? ENERGY_CAL_MAX : factor);
+        g_energyRtc.calFactor = g_energyRtc.calFactor * (1.0f - ENERGY_CAL_WEIGHT) + factor * ENERGY_CAL_WEIGHT;
+        ESP_LOGI(TAG, "calibration: %d%% -> %d%%, est %.1fmAh obs %.1fmAh, factor %.2f",
+                 g_energyRtc.calPercent, percent, estimated, observed, g_energyRtc.calFactor);
+    }
+    g_energyRtc.calPercent = percent;
+    g_energyRtc.calUas = g_energyRtc.totalUas;
+}
+
+void energy_wake_end(void)
+{
+    if (!g_energy.bOpen) {
+        return;
+    }
+    portENTER_CRITICAL(&g_energyLock);
+    float uas = energy_wake_uas(esp_timer_get_time(), NULL);
+    portEXIT_CRITICAL(&g_energyLock);
+
+    g_energyRtc.lastWakeUas = (uint32_t)uas;
+    g_energyRtc.totalUas += g_energyRtc.lastWakeUas;
+    g_energyRtc.wakes++;
+    energy_calibrate();
+    g_energyRtc.sleepStart = time(NULL);
+    ESP_LOGI(TAG, "wake %.3fmAh, total %.1fmAh over %lu wakes", uas / ENERGY_UAS_PER_MAH,
+             g_energyRtc.totalUas * g_energyRtc.calFactor / ENERGY_UAS_PER_MAH, g_energyRtc.wakes);
+}
+
+void energy_get_report(energyReport_t *report)
+{
+    int64_t phaseUs[ENERGY_PHASE_MAX];
+    int64_t now = esp_timer_get_time();
+    float wakeUas = 0;
+
+    memset(report, 0, sizeof(*report));
+    if (!g_energy.bOpen) {
+        return;
+    }
+    portENTER_CRITICAL(&g_energyLock);
+    wakeUas = energy_wake_uas(now, phaseUs);
+    portEXIT_CRITICAL(&g_energyLock);
+
+    float cal = g_energyRtc.calFactor;
+    float totalMah = (g_energyRtc.totalUas + wakeUas) * cal / ENERGY_UAS_PER_MAH;
+    time_t elapsed = time(NULL) - g_energyRtc.windowStart;
+
+    report->wakeMah = wakeUas / ENERGY_UAS_PER_MAH;
+    report->lastWakeMah = g_energyRtc.lastWakeUas / ENERGY_UAS_PER_MAH;
+    report->lastSleepMah = g_energyRtc.lastSleepUas / ENERGY_UAS_PER_MAH;
+    report->totalMah = totalMah;
+    report->calibration = cal;
+    report->wakes = g_energyRtc.wakes;
+    if (elapsed > 3600) {
+        report->mahPerDay = totalMah * 86400.0f / elapsed;
+        report->days = elapsed / 86400;
+    }
+    for (int i = 0; i < ENERGY_PHASE_MAX; i++) {
+        report->phaseMs[i] = phaseUs[i] / 1000;
+    }
+    report->activeMs = now / 1000;
+}
+
+void energy_get_profile(energyProfile_t *profile)
+{
+    *profile = g_energy.profile;
+}
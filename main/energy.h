@@ -0,0 +1,103 @@
+#ifndef __ENERGY_H__
+#define __ENERGY_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Power states timed per wake, on top of the CPU being active
+ */
+typedef enum energyPhase {
+    ENERGY_PHASE_CAMERA = 0,   ///< Camera sensor powered
+    ENERGY_PHASE_WIFI,         ///< Wi-Fi radio on (listening, RX current)
+    ENERGY_PHASE_CAT1,         ///< CAT1 modem powered
+    ENERGY_PHASE_MAX,
+} energyPhase_e;
+
+/**
+ * Current profile, one average current per state
+ */
+typedef struct energyProfile {
+    uint32_t cpuUa;        ///< CPU active current (uA)
+    uint32_t cameraUa;     ///< Camera sensor current (uA)
+    uint32_t flashLedUa;   ///< Fill light current at 100% duty (uA)
+    uint32_t wifiTxUa;     ///< Wi-Fi transmit current (uA)
+    uint32_t wifiRxUa;     ///< Wi-Fi receive/listen current (uA)
+    uint32_t cat1Ua;       ///< CAT1 connected average current (uA)
+    uint32_t sleepUa;      ///< Deep sleep current (uA)
+    uint32_t wifiTxKbps;   ///< Effective uplink rate used to turn bytes into TX time
+    uint32_t batteryMah;   ///< Battery capacity used for voltage calibration
+} energyProfile_t;
+
+/**
+ * Energy estimate snapshot
+ */
+typedef struct energyReport {
+    float wakeMah;         ///< Current wake so far
+    float lastWakeMah;     ///< Previous wake, active part
+    float lastSleepMah;    ///< Previous deep sleep
+    float totalMah;        ///< Since accounting started, calibrated
+    float mahPerDay;       ///< Average daily consumption, calibrated
+    float calibration;     ///< Factor from the battery voltage trend (1.0 = uncalibrated)
+    uint32_t wakes;        ///< Wakes since accounting started
+    uint32_t days;         ///< Whole days since accounting started
+    uint32_t phaseMs[ENERGY_PHASE_MAX]; ///< Current wake time per phase
+    uint32_t activeMs;     ///< Current wake CPU active time
+} energyReport_t;
+
+/**
+ * Account the deep sleep that just ended; call early at boot
+ */
+void energy_open(void);
+
+/**
+ * Mark a power state as entered (nested calls are ignored)
+ * @param phase Power state
+ */
+void energy_phase_begin(energyPhase_e phase);
+
+/**
+ * Mark a power state as left
+ * @param phase Power state
+ */
+void energy_phase_end(energyPhase_e phase);
+
+/**
+ * Record a fill light duty change
+ * @param duty Duty in percent, 0 when off
+ */
+void energy_led_duty(uint8_t duty);
+
+/**
+ * Record bytes sent over Wi-Fi, converted to TX time with the profile rate
+ * @param bytes Payload size
+ */
+void energy_add_tx_bytes(size_t bytes);
+
+/**
+ * Close the wake: fold it into the RTC totals, calibrate against the battery
+ * voltage and remember the sleep start. Called right before deep sleep.
+ */
+void energy_wake_end(void);
+
+/**
+ * Get the current estimate
+ * @param report Output report
+ */
+void energy_get_report(energyReport_t *report);
+
+/**
+ * Get the active current profile
+ * @param profile Output profile
+ */
+void energy_get_profile(energyProfile_t *profile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ENERGY_H__ */
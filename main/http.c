@@ -1,4 +1,5 @@
 #include <sys/param.h>
+#include <inttypes.h>
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_console.h"
@@ -19,6 +20,7 @@
 #include "misc.h"
 #include "morse.h"
 #include "s2j.h"
+#include "s2j_arena.h"
 #include "iot_mip.h"
 #include "cat1.h"
 #include "ping.h"
@@ -27,6 +29,7 @@
 #include "session_log.h"
 #include "utils.h"
 #include "pir.h"
+#include "energy.h"
 
 #define TAG "-->HTTP"  // Logging tag for HTTP module
 
@@ -35,15 +38,34 @@
 
 // Maximum HTTP buffer size
 #define HTTP_BUFF_MAX_SIZE (8192)
-// Embedded web resources
-extern const char root_start[] asm("_binary_index_html_start");
-extern const char root_end[] asm("_binary_index_html_end");
-extern const char favicon_start[] asm("_binary_favicon_ico_start");
-extern const char favicon_end[] asm("_binary_favicon_ico_end");
-extern const char js_start[] asm("_binary_index_js_start");
-extern const char js_end[] asm("_binary_index_js_end");
-extern const char css_start[] asm("_binary_index_css_start");
-extern const char css_end[] asm("_binary_index_css_end");
+
+// cJSON arena for /api handlers, reset after every request
+#define WEB_JSON_ARENA_SIZE (16 * 1024)
+// Embedded web resources, gzip compressed at build time
+extern const char root_start[] asm("_binary_index_html_gz_start");
+extern const char root_end[] asm("_binary_index_html_gz_end");
+extern const char favicon_start[] asm("_binary_favicon_ico_gz_start");
+extern const char favicon_end[] asm("_binary_favicon_ico_gz_end");
+extern const char js_start[] asm("_binary_index_js_gz_start");
+extern const char js_end[] asm("_binary_index_js_gz_end");
+extern const char css_start[] asm("_binary_index_css_gz_start");
+extern const char css_end[] asm("_binary_index_css_gz_end");
+
+/**
+ * Embedded static asset
+ */
+typedef struct webAsset {
+    const char *start;    ///< Compressed data
+    const char *end;
+    const char *type;     ///< Content-Type
+    bool versioned;       ///< Referenced as ?v=<etag> from index.html, cacheable forever
+    char etag[11];        ///< Quoted CRC32 of the compressed data, filled on first request
+} webAsset_t;
+
+static webAsset_t g_assetRoot = {root_start, root_end, "text/html", false};
+static webAsset_t g_assetFavicon = {favicon_start, favicon_end, "image/x-icon", false};
+static webAsset_t g_assetJs = {js_start, js_end, "text/javascript", true};
+static webAsset_t g_assetCss = {css_start, css_end, "text/css", true};
 
 /**
  * HTTP response structure
@@ -60,10 +82,23 @@ typedef struct mdHttp {
     esp_timer_handle_t timer;    ///< Timeout timer handle
     bool isLiveView;             ///< Live view streaming status
     bool hasClient;              ///< Client connection status
+    sleepToken_t awake;          ///< Keep-awake token held until the web session ends
 } mdHttp_t;
 
 static mdHttp_t g_http = {0};  // Global HTTP server state
 
+/**
+ * cJSON allocation statistics of one API handler
+ */
+typedef struct webJsonStat {
+    uint32_t calls;       ///< Requests handled
+    uint32_t allocs;      ///< Allocations of the last request
+    uint32_t heapAllocs;  ///< Allocations that overflowed the arena, all requests
+    uint32_t peak;        ///< Highest arena usage in bytes
+} webJsonStat_t;
+
+S2J_ARENA_DEFINE(g_webArena, "web", WEB_JSON_ARENA_SIZE);
+
 // MJPEG stream constants
 #define PART_BOUNDARY "123456789000000000000987654321"
 static const char *_STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=" PART_BOUNDARY;
@@ -132,6 +167,45 @@ static void http_send_json_response(httpd_req_t *req, uint32_t result)
     cJSON_free(str);
     s2j_delete_json_obj(json_obj);
 }
+
+/**
+ * Send an embedded asset, or 304 when the client copy is current
+ * @param req HTTP request handle
+ * @param asset Asset to send
+ * @return ESP_OK on success
+ */
+static esp_err_t web_asset_send(httpd_req_t *req, webAsset_t *asset)
+{
+    const uint32_t len = asset->end - asset->start;
+    char value[64];
+    char version[12];
+
+    clear_timeout();
+    if (asset->etag[0] == '\0') {
+        snprintf(asset->etag, sizeof(asset->etag), "\"%08" PRIx32 "\"",
+                 esp_rom_crc32_le(0, (const uint8_t *)asset->start, len));
+    }
+    httpd_resp_set_hdr(req, "ETag", asset->etag);
+    /* index.html names the current JS/CSS by ETag; anything else is revalidated. */
+    if (asset->versioned &&
+        httpd_req_get_url_query_str(req, value, sizeof(value)) == ESP_OK &&
+        httpd_query_key_value(value, "v", version, sizeof(version)) == ESP_OK &&
+        strncmp(version, asset->etag + 1, 8) == 0) {
+        httpd_resp_set_hdr(req, "Cache-Control", "public, max-age=31536000, immutable");
+    } else {
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    }
+
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", value, sizeof(value)) == ESP_OK &&
+        strstr(value, asset->etag) != NULL) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    httpd_resp_set_type(req, asset->type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, asset->start, len);
+}
+
 /**
  * Root page GET handler
  * @param req HTTP request handle
@@ -139,14 +213,8 @@ static void http_send_json_response(httpd_req_t *req, uint32_t result)
  */
 static esp_err_t get_root_handler(httpd_req_t *req)
 {
-    const uint32_t len = root_end - root_start;
-    clear_timeout();
-    httpd_resp_set_type(req, "text/html");
-    /* Avoid stale shell: dist HTML carries ?v= on JS/CSS; must not cache HTML long. */
-    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
-    httpd_resp_send(req, root_start, len);
     ESP_LOGI(TAG, "Serve root");
-    return ESP_OK;
+    return web_asset_send(req, &g_assetRoot);
 }
 
 /**
@@ -156,11 +224,7 @@ static esp_err_t get_root_handler(httpd_req_t *req)
  */
 static esp_err_t get_favicon_handler(httpd_req_t *req)
 {
-    const uint32_t len = favicon_end - favicon_start;
-    clear_timeout();
-    httpd_resp_set_type(req, "image/x-icon");
-    httpd_resp_send(req, (const char *)favicon_start, len);
-    return ESP_OK;
+    return web_asset_send(req, &g_assetFavicon);
 }
 
 /**
@@ -170,13 +234,7 @@ static esp_err_t get_favicon_handler(httpd_req_t *req)
  */
 static esp_err_t get_js_handler(httpd_req_t *req)
 {
-    const uint32_t len = js_end - js_start;
-    clear_timeout();
-    httpd_resp_set_type(req, "text/javascript");
-    /* Do not long-cache: URL may repeat across builds; OTA users must pick up new bundle. */
-    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
-    httpd_resp_send(req, (const char *)js_start, len);
-    return ESP_OK;
+    return web_asset_send(req, &g_assetJs);
 }
 /**
  * CSS GET handler
@@ -185,12 +243,7 @@ static esp_err_t get_js_handler(httpd_req_t *req)
  */
 static esp_err_t get_css_handler(httpd_req_t *req)
 {
-    const uint32_t len = css_end - css_start;
-    clear_timeout();
-    httpd_resp_set_type(req, "text/css");
-    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
-    httpd_resp_send(req, (const char *)css_start, len);
-    return ESP_OK;
+    return web_asset_send(req, &g_assetCss);
 }
 /**
  * 404 Error handler - Redirects to root page
@@ -204,6 +257,282 @@ static esp_err_t error_404_handler(httpd_req_t *req, httpd_err_code_t err)
     return ESP_OK;
 }
 
+/**
+ * Serialize image attributes into a JSON object
+ * @param json_obj Target JSON object
+ * @param image Image attributes
+ */
+static void image_attr_to_json(cJSON *json_obj, imgAttr_t *image)
+{
+    s2j_json_set_basic_element(json_obj, image, int, brightness);
+    s2j_json_set_basic_element(json_obj, image, int, contrast);
+    s2j_json_set_basic_element(json_obj, image, int, saturation);
+    s2j_json_set_basic_element(json_obj, image, int, aeLevel);
+    s2j_json_set_basic_element(json_obj, image, int, bAgc);
+    s2j_json_set_basic_element(json_obj, image, int, gain);
+    s2j_json_set_basic_element(json_obj, image, int, gainCeiling);
+    s2j_json_set_basic_element(json_obj, image, int, bHorizonetal);
+    s2j_json_set_basic_element(json_obj, image, int, bVertical);
+    s2j_json_set_basic_element(json_obj, image, int, frameSize);
+    // Apply camera settings
+    s2j_json_set_basic_element(json_obj, image, int, quality);
+    s2j_json_set_basic_element(json_obj, image, int, sharpness);
+    s2j_json_set_basic_element(json_obj, image, int, denoise);
+    s2j_json_set_basic_element(json_obj, image, int, specialEffect);
+    s2j_json_set_basic_element(json_obj, image, int, bAwb);
+    s2j_json_set_basic_element(json_obj, image, int, bAwbGain);
+    s2j_json_set_basic_element(json_obj, image, int, wbMode);
+    s2j_json_set_basic_element(json_obj, image, int, bAec);
+    s2j_json_set_basic_element(json_obj, image, int, bAec2);
+    s2j_json_set_basic_element(json_obj, image, int, aecValue);
+    s2j_json_set_basic_element(json_obj, image, int, bBpc);
+    s2j_json_set_basic_element(json_obj, image, int, bWpc);
+    s2j_json_set_basic_element(json_obj, image, int, bRawGma);
+    s2j_json_set_basic_element(json_obj, image, int, bLenc);
+    s2j_json_set_basic_element(json_obj, image, int, bDcw);
+    s2j_json_set_basic_element(json_obj, image, int, bColorbar);
+    s2j_json_set_basic_element(json_obj, image, int, hdrEnable);
+}
+
+/**
+ * Merge the settable image attributes present in a JSON object
+ * @param json Source JSON object
+ * @param image Image attributes, holds the current values on entry
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if a value is out of range
+ */
+static esp_err_t json_to_image_attr(cJSON *json, imgAttr_t *image)
+{
+    cJSON *json_temp = NULL;
+
+    s2j_struct_get_basic_element(image, json, int, brightness);
+    s2j_struct_get_basic_element(image, json, int, contrast);
+    s2j_struct_get_basic_element(image, json, int, saturation);
+    s2j_struct_get_basic_element(image, json, int, aeLevel);
+    s2j_struct_get_basic_element(image, json, int, bAgc);
+    s2j_struct_get_basic_element(image, json, int, gain);
+    s2j_struct_get_basic_element(image, json, int, gainCeiling);
+    s2j_struct_get_basic_element(image, json, int, bHorizonetal);
+    s2j_struct_get_basic_element(image, json, int, bVertical);
+    s2j_struct_get_basic_element(image, json, int, frameSize);
+    s2j_struct_get_basic_element(image, json, int, quality);
+    s2j_struct_get_basic_element(image, json, int, hdrEnable);
+
+    if (image->frameSize >= FRAMESIZE_INVALID || image->quality > 63) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Apply JPEG quality limit for resolutions > 3MP
+    camera_apply_jpeg_quality_limit((framesize_t)image->frameSize, &image->quality);
+    return ESP_OK;
+}
+
+/**
+ * Serialize flash light attributes into a JSON object
+ * @param json_obj Target JSON object
+ * @param light Light attributes
+ */
+static void light_attr_to_json(cJSON *json_obj, lightAttr_t *light)
+{
+    s2j_json_set_basic_element(json_obj, light, int, lightMode);
+    s2j_json_set_basic_element(json_obj, light, int, threshold);
+    s2j_json_set_basic_element(json_obj, light, int, value);
+    s2j_json_set_basic_element(json_obj, light, int, duty);
+    s2j_json_set_basic_element(json_obj, light, string, startTime);
+    s2j_json_set_basic_element(json_obj, light, string, endTime);
+}
+
+/**
+ * Merge the flash light attributes present in a JSON object
+ * @param json Source JSON object
+ * @param light Light attributes, holds the current values on entry
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if a value is out of range
+ */
+static esp_err_t json_to_light_attr(cJSON *json, lightAttr_t *light)
+{
+    cJSON *json_temp = NULL;
+
+    s2j_struct_get_basic_element(light, json, int, lightMode);
+    s2j_struct_get_basic_element(light, json, int, threshold);
+    s2j_struct_get_basic_element(light, json, int, duty);
+    s2j_struct_get_basic_element(light, json, string, startTime);
+    s2j_struct_get_basic_element(light, json, string, endTime);
+
+    // camera_flash_led_ctrl() knows modes 0-3 only
+    return light->lightMode > 3 ? ESP_ERR_INVALID_ARG : ESP_OK;
+}
+
+static cJSON *struct_to_json_timedNode_t(void *struct_obj)
+{
+    s2j_create_json_obj(json_obj_);
+    timedNode_t *struct_obj_ = (timedNode_t *)struct_obj;
+    s2j_json_set_basic_element(json_obj_, struct_obj_, int, day);
+    s2j_json_set_basic_element(json_obj_, struct_obj_, string, time);
+    return json_obj_;
+}
+
+void *json_to_struct_timedNode_t(cJSON *json_obj)
+{
+    s2j_create_struct_obj(struct_obj_, timedNode_t);
+    s2j_struct_get_basic_element(struct_obj_, json_obj, int, day);
+    s2j_struct_get_basic_element(struct_obj_, json_obj, string, time);
+    return struct_obj_;
+}
+
+/**
+ * Serialize capture attributes into a JSON object
+ * @param json_obj Target JSON object
+ * @param capture Capture attributes
+ */
+static void cap_attr_to_json(cJSON *json_obj, capAttr_t *capture)
+{
+    s2j_json_set_basic_element(json_obj, capture, int, bScheCap);
+    s2j_json_set_basic_element(json_obj, capture, int, bAlarmInCap);
+    s2j_json_set_basic_element(json_obj, capture, int, bButtonCap);
+    s2j_json_set_basic_element(json_obj, capture, int, scheCapMode);
+    s2j_json_set_basic_element(json_obj, capture, int, intervalValue);
+    s2j_json_set_basic_element(json_obj, capture, int, intervalUnit);
+    s2j_json_set_basic_element(json_obj, capture, string, intervalAnchorTime);
+    s2j_json_set_basic_element(json_obj, capture, int, camWarmupMs);
+    s2j_json_set_basic_element(json_obj, capture, int, timedCount);
+    s2j_json_set_struct_array_element_by_func(json_obj, capture, timedNode_t, timedNodes, capture->timedCount);
+}
+
+/**
+ * Merge the capture attributes present in a JSON object
+ * @param json Source JSON object
+ * @param capture Capture attributes, holds the current values on entry
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if a value is out of range
+ */
+static esp_err_t json_to_cap_attr(cJSON *json, capAttr_t *capture)
+{
+    cJSON *json_temp = NULL;
+
+    s2j_struct_get_basic_element(capture, json, int, bScheCap);
+    s2j_struct_get_basic_element(capture, json, int, bAlarmInCap);
+    s2j_struct_get_basic_element(capture, json, int, bButtonCap);
+    s2j_struct_get_basic_element(capture, json, int, scheCapMode);
+    s2j_struct_get_basic_element(capture, json, int, intervalValue);
+    s2j_struct_get_basic_element(capture, json, int, intervalUnit);
+    if (cJSON_HasObjectItem(json, "intervalAnchorTime")) {
+        s2j_struct_get_basic_element(capture, json, string, intervalAnchorTime);
+    }
+    if (cJSON_HasObjectItem(json, "camWarmupMs")) {
+        s2j_struct_get_basic_element(capture, json, int, camWarmupMs);
+    }
+    s2j_struct_get_basic_element(capture, json, int, timedCount);
+    if (cJSON_HasObjectItem(json, "timedNodes")) {
+        s2j_struct_get_struct_array_element_by_func(capture, json, timedNode_t, timedNodes);
+    }
+
+    if (capture->timedCount > S2J_ARRAY_SIZE(capture->timedNodes)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Serialize scheduled upload attributes into a JSON object
+ * @param json_obj Target JSON object
+ * @param upload Upload attributes
+ */
+static void upload_attr_to_json(cJSON *json_obj, uploadAttr_t *upload)
+{
+    s2j_json_set_basic_element(json_obj, upload, int, uploadMode);
+    s2j_json_set_basic_element(json_obj, upload, int, retryCount);
+    s2j_json_set_basic_element(json_obj, upload, int, timedCount);
+    s2j_json_set_struct_array_element_by_func(json_obj, upload, timedNode_t, timedNodes, upload->timedCount);
+}
+
+/**
+ * Merge the scheduled upload attributes present in a JSON object
+ * @param json Source JSON object
+ * @param upload Upload attributes, holds the current values on entry
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if a value is out of range
+ */
+static esp_err_t json_to_upload_attr(cJSON *json, uploadAttr_t *upload)
+{
+    cJSON *json_temp = NULL;
+
+    s2j_struct_get_basic_element(upload, json, int, uploadMode);
+    s2j_struct_get_basic_element(upload, json, int, retryCount);
+    s2j_struct_get_basic_element(upload, json, int, timedCount);
+    if (cJSON_HasObjectItem(json, "timedNodes")) {
+        s2j_struct_get_struct_array_element_by_func(upload, json, timedNode_t, timedNodes);
+    }
+
+    if (upload->timedCount > S2J_ARRAY_SIZE(upload->timedNodes)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Serialize trigger mode and PIR attributes into a JSON object
+ * @param json_obj Target JSON object
+ * @param trigger_mode Trigger mode
+ * @param pir_attr PIR attributes
+ */
+static void trigger_attr_to_json(cJSON *json_obj, uint8_t trigger_mode, pirAttr_t *pir_attr)
+{
+    cJSON_AddNumberToObject(json_obj, "trigger_mode", trigger_mode);
+    s2j_json_set_basic_element(json_obj, pir_attr, int, sens);
+    s2j_json_set_basic_element(json_obj, pir_attr, int, blind);
+    s2j_json_set_basic_element(json_obj, pir_attr, int, pulse);
+    s2j_json_set_basic_element(json_obj, pir_attr, int, window);
+}
+
+/**
+ * Merge the trigger mode and PIR attributes present in a JSON object
+ * Out of range values are clamped, not rejected
+ * @param json Source JSON object
+ * @param trigger_mode Trigger mode, holds the current value on entry
+ * @param pir_attr PIR attributes, holds the current values on entry
+ */
+static void json_to_trigger_attr(cJSON *json, uint8_t *trigger_mode, pirAttr_t *pir_attr)
+{
+    // Update trigger mode if provided
+    if (cJSON_HasObjectItem(json, "trigger_mode")) {
+        *trigger_mode = cJSON_GetObjectItem(json, "trigger_mode")->valueint;
+        if (*trigger_mode > TRIGGER_MODE_PIR) {
+            *trigger_mode = TRIGGER_MODE_DISABLED;
+        }
+    }
+
+    // Update PIR parameters if provided with validation
+    // Sensitivity: 0-255, recommended > 20, minimum 10 (no interference)
+    // Smaller values = more sensitive but easier false alarms
+    if (cJSON_HasObjectItem(json, "sens")) {
+        int sens_val = cJSON_GetObjectItem(json, "sens")->valueint;
+        if (sens_val < 0) sens_val = 0;
+        if (sens_val > 255) sens_val = 255;
+        pir_attr->sens = (uint8_t)sens_val;
+    }
+    // Blind time: 0-15 (4 bits), range 0.5s ~ 8s
+    // Formula: interrupt time = register value * 0.5s + 0.5s
+    if (cJSON_HasObjectItem(json, "blind")) {
+        int blind_val = cJSON_GetObjectItem(json, "blind")->valueint;
+        if (blind_val < 0) blind_val = 0;
+        if (blind_val > 15) blind_val = 15;
+        pir_attr->blind = (uint8_t)(blind_val & 0x0F);
+    }
+    // Pulse count: 0-3 (2 bits), range 1 ~ 4
+    // Formula: pulse count = register value + 1
+    // Larger value = stronger anti-interference but slightly reduced sensitivity
+    if (cJSON_HasObjectItem(json, "pulse")) {
+        int pulse_val = cJSON_GetObjectItem(json, "pulse")->valueint;
+        if (pulse_val < 0) pulse_val = 0;
+        if (pulse_val > 3) pulse_val = 3;
+        pir_attr->pulse = (uint8_t)(pulse_val & 0x03);
+    }
+    // Window time: 0-3 (2 bits), range 2s ~ 8s
+    // Formula: window time = register value * 2s + 2s
+    if (cJSON_HasObjectItem(json, "window")) {
+        int window_val = cJSON_GetObjectItem(json, "window")->valueint;
+        if (window_val < 0) window_val = 0;
+        if (window_val > 3) window_val = 3;
+        pir_attr->window = (uint8_t)(window_val & 0x03);
+    }
+}
+
 esp_err_t get_cam_param_handle(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "%s", req->uri);
@@ -216,34 +545,7 @@ esp_err_t get_cam_param_handle(httpd_req_t *req)
     /* create Student JSON object */
     s2j_create_json_obj(json_obj);
     /* serialize data to JSON object. */
-    s2j_json_set_basic_element(json_obj, &image, int, brightness);
-    s2j_json_set_basic_element(json_obj, &image, int, contrast);
-    s2j_json_set_basic_element(json_obj, &image, int, saturation);
-    s2j_json_set_basic_element(json_obj, &image, int, aeLevel);
-    s2j_json_set_basic_element(json_obj, &image, int, bAgc);
-    s2j_json_set_basic_element(json_obj, &image, int, gain);
-    s2j_json_set_basic_element(json_obj, &image, int, gainCeiling);
-    s2j_json_set_basic_element(json_obj, &image, int, bHorizonetal);
-    s2j_json_set_basic_element(json_obj, &image, int, bVertical);
-    s2j_json_set_basic_element(json_obj, &image, int, frameSize);
-    // Apply camera settings
-    s2j_json_set_basic_element(json_obj, &image, int, quality);
-    s2j_json_set_basic_element(json_obj, &image, int, sharpness);
-    s2j_json_set_basic_element(json_obj, &image, int, denoise);
-    s2j_json_set_basic_element(json_obj, &image, int, specialEffect);
-    s2j_json_set_basic_element(json_obj, &image, int, bAwb);
-    s2j_json_set_basic_element(json_obj, &image, int, bAwbGain);
-    s2j_json_set_basic_element(json_obj, &image, int, wbMode);
-    s2j_json_set_basic_element(json_obj, &image, int, bAec);
-    s2j_json_set_basic_element(json_obj, &image, int, bAec2);
-    s2j_json_set_basic_element(json_obj, &image, int, aecValue);
-    s2j_json_set_basic_element(json_obj, &image, int, bBpc);
-    s2j_json_set_basic_element(json_obj, &image, int, bWpc);
-    s2j_json_set_basic_element(json_obj, &image, int, bRawGma);
-    s2j_json_set_basic_element(json_obj, &image, int, bLenc);
-    s2j_json_set_basic_element(json_obj, &image, int, bDcw);
-    s2j_json_set_basic_element(json_obj, &image, int, bColorbar);
-    s2j_json_set_basic_element(json_obj, &image, int, hdrEnable);
+    image_attr_to_json(json_obj, &image);
 
     str = cJSON_PrintUnformatted(json_obj);
     httpd_resp_sendstr(req, str);
@@ -262,25 +564,7 @@ esp_err_t set_cam_param_handle(httpd_req_t *req)
         cfg_get_image_attr(image);
         /* deserialize data to Student structure object. */
         cJSON *json = cJSON_Parse(content);
-        s2j_struct_get_basic_element(image, json, int, brightness);
-        s2j_struct_get_basic_element(image, json, int, contrast);
-        s2j_struct_get_basic_element(image, json, int, saturation);
-        s2j_struct_get_basic_element(image, json, int, aeLevel);
-        s2j_struct_get_basic_element(image, json, int, bAgc);
-        s2j_struct_get_basic_element(image, json, int, gain);
-        s2j_struct_get_basic_element(image, json, int, gainCeiling);
-        s2j_struct_get_basic_element(image, json, int, bHorizonetal);
-        s2j_struct_get_basic_element(image, json, int, bVertical);
-        s2j_struct_get_basic_element(image, json, int, frameSize);
-        s2j_struct_get_basic_element(image, json, int, quality);
-        s2j_struct_get_basic_element(image, json, int, hdrEnable);
-
-        // Apply JPEG quality limit for resolutions > 3MP
-        if (image->frameSize < FRAMESIZE_INVALID && image->quality <= 63) {
-            camera_apply_jpeg_quality_limit((framesize_t)image->frameSize, &image->quality);
-        }
-
-        if (camera_set_image(image) == ESP_OK) {
+        if (json_to_image_attr(json, image) == ESP_OK && camera_set_image(image) == ESP_OK) {
             http_send_json_response(req, RES_OK);
             cfg_set_image_attr(image);
         } else {
@@ -308,12 +592,7 @@ esp_err_t get_light_param_handle(httpd_req_t *req)
     /* create Student JSON object */
     s2j_create_json_obj(json_obj);
     /* serialize data to JSON object. */
-    s2j_json_set_basic_element(json_obj, &light, int, lightMode);
-    s2j_json_set_basic_element(json_obj, &light, int, threshold);
-    s2j_json_set_basic_element(json_obj, &light, int, value);
-    s2j_json_set_basic_element(json_obj, &light, int, duty);
-    s2j_json_set_basic_element(json_obj, &light, string, startTime);
-    s2j_json_set_basic_element(json_obj, &light, string, endTime);
+    light_attr_to_json(json_obj, &light);
     str = cJSON_PrintUnformatted(json_obj);
     httpd_resp_sendstr(req, str);
     cJSON_free(str);
@@ -331,18 +610,13 @@ esp_err_t set_light_param_handle(httpd_req_t *req)
         /* deserialize data to Student structure object. */
         cJSON *json = cJSON_Parse(content);
         cfg_get_light_attr(light);
-        s2j_struct_get_basic_element(light, json, int, lightMode);
-        s2j_struct_get_basic_element(light, json, int, threshold);
-        s2j_struct_get_basic_element(light, json, int, duty);
-        s2j_struct_get_basic_element(light, json, string, startTime);
-        s2j_struct_get_basic_element(light, json, string, endTime);
-        if (camera_flash_led_ctrl(light) == ESP_OK) {
+        if (json_to_light_attr(json, light) == ESP_OK && camera_flash_led_ctrl(light) == ESP_OK) {
             http_send_json_response(req, RES_OK);
             cfg_set_light_attr(light);
+            misc_set_flash_duty(light->duty); /* update current duty cycle in real-time */
         } else {
             http_send_json_response(req, RES_FAIL);
         }
-        misc_set_flash_duty(light->duty); /* update current duty cycle in real-time */
         s2j_delete_struct_obj(light);
         s2j_delete_json_obj(json);
         http_free_content(content);
@@ -351,15 +625,6 @@ esp_err_t set_light_param_handle(httpd_req_t *req)
     return ESP_FAIL;
 }
 
-static cJSON *struct_to_json_timedNode_t(void *struct_obj)
-{
-    s2j_create_json_obj(json_obj_);
-    timedNode_t *struct_obj_ = (timedNode_t *)struct_obj;
-    s2j_json_set_basic_element(json_obj_, struct_obj_, int, day);
-    s2j_json_set_basic_element(json_obj_, struct_obj_, string, time);
-    return json_obj_;
-}
-
 esp_err_t get_cap_param_handle(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "%s", req->uri);
@@ -373,16 +638,7 @@ esp_err_t get_cap_param_handle(httpd_req_t *req)
     /* create Student JSON object */
     s2j_create_json_obj(json_obj);
     /* serialize data to JSON object. */
-    s2j_json_set_basic_element(json_obj, &capture, int, bScheCap);
-    s2j_json_set_basic_element(json_obj, &capture, int, bAlarmInCap);
-    s2j_json_set_basic_element(json_obj, &capture, int, bButtonCap);
-    s2j_json_set_basic_element(json_obj, &capture, int, scheCapMode);
-    s2j_json_set_basic_element(json_obj, &capture, int, intervalValue);
-    s2j_json_set_basic_element(json_obj, &capture, int, intervalUnit);
-    s2j_json_set_basic_element(json_obj, &capture, string, intervalAnchorTime);
-    s2j_json_set_basic_element(json_obj, &capture, int, camWarmupMs);
-    s2j_json_set_basic_element(json_obj, &capture, int, timedCount);
-    s2j_json_set_struct_array_element_by_func(json_obj, &capture, timedNode_t, timedNodes, capture.timedCount);
+    cap_attr_to_json(json_obj, &capture);
 
     str = cJSON_PrintUnformatted(json_obj);
     httpd_resp_sendstr(req, str);
@@ -392,14 +648,6 @@ esp_err_t get_cap_param_handle(httpd_req_t *req)
     return ESP_OK;
 }
 
-void *json_to_struct_timedNode_t(cJSON *json_obj)
-{
-    s2j_create_struct_obj(struct_obj_, timedNode_t);
-    s2j_struct_get_basic_element(struct_obj_, json_obj, int, day);
-    s2j_struct_get_basic_element(struct_obj_, json_obj, string, time);
-    return struct_obj_;
-}
-
 esp_err_t set_cap_param_handle(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "%s", req->uri);
@@ -411,23 +659,13 @@ esp_err_t set_cap_param_handle(httpd_req_t *req)
         /* deserialize data to Student structure object. */
         cJSON *json = cJSON_Parse(content);
         cfg_get_cap_attr(capture);
-        s2j_struct_get_basic_element(capture, json, int, bScheCap);
-        s2j_struct_get_basic_element(capture, json, int, bAlarmInCap);
-        s2j_struct_get_basic_element(capture, json, int, bButtonCap);
-        s2j_struct_get_basic_element(capture, json, int, scheCapMode);
-        s2j_struct_get_basic_element(capture, json, int, intervalValue);
-        s2j_struct_get_basic_element(capture, json, int, intervalUnit);
-        if (cJSON_HasObjectItem(json, "intervalAnchorTime")) {
-            s2j_struct_get_basic_element(capture, json, string, intervalAnchorTime);
-        }
-        if (cJSON_HasObjectItem(json, "camWarmupMs")) {
-            s2j_struct_get_basic_element(capture, json, int, camWarmupMs);
+        if (json_to_cap_attr(json, capture) == ESP_OK) {
+            http_send_json_response(req, RES_OK);
+            cfg_set_cap_attr(capture);
+            sleep_set_last_capture_time(time(NULL));
+        } else {
+            http_send_json_response(req, RES_FAIL);
         }
-        s2j_struct_get_basic_element(capture, json, int, timedCount);
-        s2j_struct_get_struct_array_element_by_func(capture, json, timedNode_t, timedNodes);
-        http_send_json_response(req, RES_OK);
-        cfg_set_cap_attr(capture);
-        sleep_set_last_capture_time(time(NULL));
         s2j_delete_struct_obj(capture);
         s2j_delete_json_obj(json);
         http_free_content(content);
@@ -451,11 +689,7 @@ esp_err_t get_trigger_param_handle(httpd_req_t *req)
 
     /* create JSON object */
     s2j_create_json_obj(json_obj);
-    cJSON_AddNumberToObject(json_obj, "trigger_mode", trigger_mode);
-    s2j_json_set_basic_element(json_obj, &pir_attr, int, sens);
-    s2j_json_set_basic_element(json_obj, &pir_attr, int, blind);
-    s2j_json_set_basic_element(json_obj, &pir_attr, int, pulse);
-    s2j_json_set_basic_element(json_obj, &pir_attr, int, window);
+    trigger_attr_to_json(json_obj, trigger_mode, &pir_attr);
 
     str = cJSON_PrintUnformatted(json_obj);
     httpd_resp_sendstr(req, str);
@@ -485,50 +719,10 @@ esp_err_t set_trigger_param_handle(httpd_req_t *req)
         cfg_get_trigger_mode(&trigger_mode);
         cfg_get_pir_attr(&pir_attr);
 
-        // Update trigger mode if provided
+        json_to_trigger_attr(json, &trigger_mode, &pir_attr);
         if (cJSON_HasObjectItem(json, "trigger_mode")) {
-            trigger_mode = cJSON_GetObjectItem(json, "trigger_mode")->valueint;
-            if (trigger_mode > TRIGGER_MODE_PIR) {
-                trigger_mode = TRIGGER_MODE_DISABLED;
-            }
             cfg_set_trigger_mode(trigger_mode);
         }
-
-        // Update PIR parameters if provided with validation
-        // Sensitivity: 0-255, recommended > 20, minimum 10 (no interference)
-        // Smaller values = more sensitive but easier false alarms
-        if (cJSON_HasObjectItem(json, "sens")) {
-            int sens_val = cJSON_GetObjectItem(json, "sens")->valueint;
-            if (sens_val < 0) sens_val = 0;
-            if (sens_val > 255) sens_val = 255;
-            pir_attr.sens = (uint8_t)sens_val;
-        }
-        // Blind time: 0-15 (4 bits), range 0.5s ~ 8s
-        // Formula: interrupt time = register value * 0.5s + 0.5s
-        if (cJSON_HasObjectItem(json, "blind")) {
-            int blind_val = cJSON_GetObjectItem(json, "blind")->valueint;
-            if (blind_val < 0) blind_val = 0;
-            if (blind_val > 15) blind_val = 15;
-            pir_attr.blind = (uint8_t)(blind_val & 0x0F);
-        }
-        // Pulse count: 0-3 (2 bits), range 1 ~ 4
-        // Formula: pulse count = register value + 1
-        // Larger value = stronger anti-interference but slightly reduced sensitivity
-        if (cJSON_HasObjectItem(json, "pulse")) {
-            int pulse_val = cJSON_GetObjectItem(json, "pulse")->valueint;
-            if (pulse_val < 0) pulse_val = 0;
-            if (pulse_val > 3) pulse_val = 3;
-            pir_attr.pulse = (uint8_t)(pulse_val & 0x03);
-        }
-        // Window time: 0-3 (2 bits), range 2s ~ 8s
-        // Formula: window time = register value * 2s + 2s
-        if (cJSON_HasObjectItem(json, "window")) {
-            int window_val = cJSON_GetObjectItem(json, "window")->valueint;
-            if (window_val < 0) window_val = 0;
-            if (window_val > 3) window_val = 3;
-            pir_attr.window = (uint8_t)(window_val & 0x03);
-        }
-
         cfg_set_pir_attr(&pir_attr);
         
         // Update PIR configuration if in PIR mode
@@ -557,10 +751,7 @@ esp_err_t get_upload_param_handle(httpd_req_t *req)
     /* create Student JSON object */
     s2j_create_json_obj(json_obj);
     /* serialize data to JSON object. */
-    s2j_json_set_basic_element(json_obj, &upload, int, uploadMode);
-    s2j_json_set_basic_element(json_obj, &upload, int, retryCount);
-    s2j_json_set_basic_element(json_obj, &upload, int, timedCount);
-    s2j_json_set_struct_array_element_by_func(json_obj, &upload, timedNode_t, timedNodes, upload.timedCount);
+    upload_attr_to_json(json_obj, &upload);
     str = cJSON_PrintUnformatted(json_obj);
     httpd_resp_sendstr(req, str);
     cJSON_free(str);
@@ -579,16 +770,16 @@ esp_err_t set_upload_param_handle(httpd_req_t *req)
         /* deserialize data to Student structure object. */
         cJSON *json = cJSON_Parse(content);
         cfg_get_upload_attr(upload);
-        s2j_struct_get_basic_element(upload, json, int, uploadMode);
-        s2j_struct_get_basic_element(upload, json, int, retryCount);
-        s2j_struct_get_basic_element(upload, json, int, timedCount);
-        s2j_struct_get_struct_array_element_by_func(upload, json, timedNode_t, timedNodes);
-        http_send_json_response(req, RES_OK);
-        cfg_set_upload_attr(upload);
-        if (upload->uploadMode == 0) {
-            storage_upload_start();
+        if (json_to_upload_attr(json, upload) == ESP_OK) {
+            http_send_json_response(req, RES_OK);
+            cfg_set_upload_attr(upload);
+            if (upload->uploadMode == 0) {
+                storage_upload_start();
+            } else {
+                storage_upload_stop();
+            }
         } else {
-            storage_upload_stop();
+            http_send_json_response(req, RES_FAIL);
         }
         s2j_delete_struct_obj(upload);
         s2j_delete_json_obj(json);
@@ -1185,6 +1376,48 @@ esp_err_t get_dev_battery_handle(httpd_req_t *req)
     return ESP_OK;
 }
 
+esp_err_t get_dev_energy_handle(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "%s", req->uri);
+    energyReport_t report;
+    energyProfile_t profile;
+    char *str = NULL;
+    clear_timeout();
+
+    httpd_resp_set_type(req, "application/json");
+
+    energy_get_report(&report);
+    energy_get_profile(&profile);
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "wakeMah", report.wakeMah);
+    cJSON_AddNumberToObject(json, "lastWakeMah", report.lastWakeMah);
+    cJSON_AddNumberToObject(json, "lastSleepMah", report.lastSleepMah);
+    cJSON_AddNumberToObject(json, "totalMah", report.totalMah);
+    cJSON_AddNumberToObject(json, "mahPerDay", report.mahPerDay);
+    cJSON_AddNumberToObject(json, "calibration", report.calibration);
+    cJSON_AddNumberToObject(json, "wakes", report.wakes);
+    cJSON_AddNumberToObject(json, "days", report.days);
+    cJSON_AddNumberToObject(json, "activeMs", report.activeMs);
+    cJSON_AddNumberToObject(json, "cameraMs", report.phaseMs[ENERGY_PHASE_CAMERA]);
+    cJSON_AddNumberToObject(json, "wifiMs", report.phaseMs[ENERGY_PHASE_WIFI]);
+    cJSON_AddNumberToObject(json, "cat1Ms", report.phaseMs[ENERGY_PHASE_CAT1]);
+    cJSON *prof = cJSON_AddObjectToObject(json, "profile");
+    cJSON_AddNumberToObject(prof, "cpuUa", profile.cpuUa);
+    cJSON_AddNumberToObject(prof, "cameraUa", profile.cameraUa);
+    cJSON_AddNumberToObject(prof, "flashLedUa", profile.flashLedUa);
+    cJSON_AddNumberToObject(prof, "wifiTxUa", profile.wifiTxUa);
+    cJSON_AddNumberToObject(prof, "wifiRxUa", profile.wifiRxUa);
+    cJSON_AddNumberToObject(prof, "cat1Ua", profile.cat1Ua);
+    cJSON_AddNumberToObject(prof, "sleepUa", profile.sleepUa);
+    cJSON_AddNumberToObject(prof, "wifiTxKbps", profile.wifiTxKbps);
+    cJSON_AddNumberToObject(prof, "batteryMah", profile.batteryMah);
+    str = cJSON_PrintUnformatted(json);
+    httpd_resp_sendstr(req, str);
+    cJSON_free(str);
+    cJSON_Delete(json);
+    return ESP_OK;
+}
+
 esp_err_t get_dev_time_handle(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "%s", req->uri);
@@ -1238,7 +1471,7 @@ esp_err_t set_dev_sleep_handle(httpd_req_t *req)
     ESP_LOGI(TAG, "%s", req->uri);
     clear_timeout();
     http_send_json_response(req, RES_OK);
-    sleep_set_event_bits(SLEEP_NO_OPERATION_TIMEOUT_BIT);
+    http_allow_sleep();
     return ESP_OK;
 }
 
@@ -1791,6 +2024,288 @@ esp_err_t set_push_mode_handle(httpd_req_t *req)
     return ESP_FAIL;
 }
 
+// Groups handled by getAllParams/setParams, also the JSON object names
+#define WEB_PARAM_IMAGE     (1 << 0)
+#define WEB_PARAM_LIGHT     (1 << 1)
+#define WEB_PARAM_CAPTURE   (1 << 2)
+#define WEB_PARAM_UPLOAD    (1 << 3)
+#define WEB_PARAM_TRIGGER   (1 << 4)
+#define WEB_PARAM_WEBHOOK   (1 << 5)
+#define WEB_PARAM_PUSH_MODE (1 << 6)
+
+/**
+ * Whole configuration exchanged by getAllParams/setParams
+ * Network settings are left out, their set handlers run connection tests
+ */
+typedef struct webParams {
+    imgAttr_t image;
+    lightAttr_t light;
+    capAttr_t capture;
+    uploadAttr_t upload;
+    uint8_t triggerMode;
+    pirAttr_t pir;
+    webhookAttr_t webhook;
+    uint8_t pushMode;
+} webParams_t;
+
+/**
+ * Read every group of the configuration
+ * @param params Output configuration
+ */
+static void web_params_load(webParams_t *params)
+{
+    memset(params, 0, sizeof(webParams_t));
+    cfg_get_image_attr(&params->image);
+    cfg_get_light_attr(&params->light);
+    cfg_get_cap_attr(&params->capture);
+    cfg_get_upload_attr(&params->upload);
+    cfg_get_trigger_mode(&params->triggerMode);
+    cfg_get_pir_attr(&params->pir);
+    cfg_get_webhook_attr(&params->webhook);
+    cfg_get_u8(KEY_PUSH_MODE, &params->pushMode, 0);
+}
+
+/**
+ * Merge and validate the groups present in a setParams request
+ * @param json Request body
+ * @param params Configuration, holds the current values on entry
+ * @param groups Output WEB_PARAM_* bits of the groups found in the request
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if a group is malformed or out of range
+ */
+static esp_err_t web_params_from_json(cJSON *json, webParams_t *params, uint32_t *groups)
+{
+    cJSON *json_temp = NULL;
+    cJSON *item = NULL;
+    esp_err_t err = ESP_OK;
+
+    *groups = 0;
+    if (!cJSON_IsObject(json)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((item = cJSON_GetObjectItem(json, "image")) != NULL) {
+        *groups |= WEB_PARAM_IMAGE;
+        err = cJSON_IsObject(item) ? json_to_image_attr(item, &params->image) : ESP_ERR_INVALID_ARG;
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "setParams: invalid image");
+            return err;
+        }
+    }
+    if ((item = cJSON_GetObjectItem(json, "light")) != NULL) {
+        *groups |= WEB_PARAM_LIGHT;
+        err = cJSON_IsObject(item) ? json_to_light_attr(item, &params->light) : ESP_ERR_INVALID_ARG;
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "setParams: invalid light");
+            return err;
+        }
+    }
+    if ((item = cJSON_GetObjectItem(json, "capture")) != NULL) {
+        *groups |= WEB_PARAM_CAPTURE;
+        err = cJSON_IsObject(item) ? json_to_cap_attr(item, &params->capture) : ESP_ERR_INVALID_ARG;
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "setParams: invalid capture");
+            return err;
+        }
+    }
+    if ((item = cJSON_GetObjectItem(json, "upload")) != NULL) {
+        *groups |= WEB_PARAM_UPLOAD;
+        err = cJSON_IsObject(item) ? json_to_upload_attr(item, &params->upload) : ESP_ERR_INVALID_ARG;
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "setParams: invalid upload");
+            return err;
+        }
+    }
+    if ((item = cJSON_GetObjectItem(json, "trigger")) != NULL) {
+        *groups |= WEB_PARAM_TRIGGER;
+        if (!cJSON_IsObject(item)) {
+            ESP_LOGE(TAG, "setParams: invalid trigger");
+            return ESP_ERR_INVALID_ARG;
+        }
+        json_to_trigger_attr(item, &params->triggerMode, &params->pir);
+    }
+    if ((item = cJSON_GetObjectItem(json, "webhook")) != NULL) {
+        *groups |= WEB_PARAM_WEBHOOK;
+        if (!cJSON_IsObject(item)) {
+            ESP_LOGE(TAG, "setParams: invalid webhook");
+            return ESP_ERR_INVALID_ARG;
+        }
+        s2j_struct_get_basic_element(&params->webhook, item, string, url);
+        s2j_struct_get_basic_element(&params->webhook, item, string, header);
+    }
+    if ((item = cJSON_GetObjectItem(json, "pushMode")) != NULL) {
+        *groups |= WEB_PARAM_PUSH_MODE;
+        item = cJSON_GetObjectItem(item, "mode");
+        if (!cJSON_IsNumber(item)) {
+            ESP_LOGE(TAG, "setParams: invalid pushMode");
+            return ESP_ERR_INVALID_ARG;
+        }
+        params->pushMode = (uint8_t)item->valueint;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Find the groups whose merged value differs from the stored one
+ * @param cur Stored configuration
+ * @param next Merged configuration
+ * @param groups WEB_PARAM_* bits present in the request
+ * @return WEB_PARAM_* bits that need writing
+ */
+static uint32_t web_params_diff(webParams_t *cur, webParams_t *next, uint32_t groups)
+{
+    uint32_t changed = 0;
+
+    if (memcmp(&cur->image, &next->image, sizeof(imgAttr_t))) changed |= WEB_PARAM_IMAGE;
+    if (memcmp(&cur->light, &next->light, sizeof(lightAttr_t))) changed |= WEB_PARAM_LIGHT;
+    if (memcmp(&cur->capture, &next->capture, sizeof(capAttr_t))) changed |= WEB_PARAM_CAPTURE;
+    if (memcmp(&cur->upload, &next->upload, sizeof(uploadAttr_t))) changed |= WEB_PARAM_UPLOAD;
+    if (cur->triggerMode != next->triggerMode ||
+        memcmp(&cur->pir, &next->pir, sizeof(pirAttr_t))) changed |= WEB_PARAM_TRIGGER;
+    if (memcmp(&cur->webhook, &next->webhook, sizeof(webhookAttr_t))) changed |= WEB_PARAM_WEBHOOK;
+    if (cur->pushMode != next->pushMode) changed |= WEB_PARAM_PUSH_MODE;
+    return changed & groups;
+}
+
+/**
+ * Write the changed groups with a single NVS commit
+ * @param params Merged configuration
+ * @param changed WEB_PARAM_* bits to write
+ * @param keys Output number of NVS keys written
+ * @return ESP_OK on success, error code otherwise
+ */
+static esp_err_t web_params_store(webParams_t *params, uint32_t changed, uint32_t *keys)
+{
+    esp_err_t err = cfg_batch_begin();
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (changed & WEB_PARAM_IMAGE) cfg_set_image_attr(&params->image);
+    if (changed & WEB_PARAM_LIGHT) cfg_set_light_attr(&params->light);
+    if (changed & WEB_PARAM_CAPTURE) cfg_set_cap_attr(&params->capture);
+    if (changed & WEB_PARAM_UPLOAD) cfg_set_upload_attr(&params->upload);
+    if (changed & WEB_PARAM_TRIGGER) {
+        cfg_set_trigger_mode(params->triggerMode);
+        cfg_set_pir_attr(&params->pir);
+    }
+    if (changed & WEB_PARAM_WEBHOOK) cfg_set_webhook_attr(&params->webhook);
+    if (changed & WEB_PARAM_PUSH_MODE) cfg_set_u8(KEY_PUSH_MODE, params->pushMode);
+    return cfg_batch_end(keys);
+}
+
+/**
+ * Apply the runtime side effects of the written groups
+ * Same actions as the per-group set handlers
+ * @param params Merged configuration
+ * @param changed WEB_PARAM_* bits that were written
+ */
+static void web_params_apply(webParams_t *params, uint32_t changed)
+{
+    if (changed & WEB_PARAM_LIGHT) {
+        /* the light mode has been applied by set_params_handle() already */
+        misc_set_flash_duty(params->light.duty); /* update current duty cycle in real-time */
+    }
+    if (changed & WEB_PARAM_CAPTURE) {
+        sleep_set_last_capture_time(time(NULL));
+    }
+    if (changed & WEB_PARAM_UPLOAD) {
+        if (params->upload.uploadMode == 0) {
+            storage_upload_start();
+        } else {
+            storage_upload_stop();
+        }
+    }
+    if ((changed & WEB_PARAM_TRIGGER) && params->triggerMode == TRIGGER_MODE_PIR) {
+        pir_update_config();
+    }
+    if ((changed & WEB_PARAM_WEBHOOK) && (wifi_sta_is_connected() || netModule_is_cat1())) {
+        push_restart();
+    }
+}
+
+esp_err_t get_all_params_handle(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "%s", req->uri);
+    char *str = NULL;
+    clear_timeout();
+
+    httpd_resp_set_type(req, "application/json");
+
+    webParams_t *params = malloc(sizeof(webParams_t));
+    if (params == NULL) {
+        return ESP_FAIL;
+    }
+    web_params_load(params);
+    params->light.value = misc_get_light_value_rate();
+
+    s2j_create_json_obj(json_obj);
+    image_attr_to_json(cJSON_AddObjectToObject(json_obj, "image"), &params->image);
+    light_attr_to_json(cJSON_AddObjectToObject(json_obj, "light"), &params->light);
+    cap_attr_to_json(cJSON_AddObjectToObject(json_obj, "capture"), &params->capture);
+    upload_attr_to_json(cJSON_AddObjectToObject(json_obj, "upload"), &params->upload);
+    trigger_attr_to_json(cJSON_AddObjectToObject(json_obj, "trigger"), params->triggerMode, &params->pir);
+    cJSON *json_webhook = cJSON_AddObjectToObject(json_obj, "webhook");
+    s2j_json_set_basic_element(json_webhook, &params->webhook, string, url);
+    s2j_json_set_basic_element(json_webhook, &params->webhook, string, header);
+    cJSON_AddNumberToObject(cJSON_AddObjectToObject(json_obj, "pushMode"), "mode", params->pushMode);
+
+    str = cJSON_PrintUnformatted(json_obj);
+    httpd_resp_sendstr(req, str);
+    cJSON_free(str);
+    s2j_delete_json_obj(json_obj);
+    free(params);
+    return ESP_OK;
+}
+
+esp_err_t set_params_handle(httpd_req_t *req)
+{
+    ESP_LOGI(TAG, "%s", req->uri);
+    clear_timeout();
+
+    char *content = http_get_content_from_req(req);
+    if (content == NULL) {
+        return ESP_FAIL;
+    }
+
+    // Validate the whole request before anything is written
+    webParams_t *cur = malloc(sizeof(webParams_t));
+    webParams_t *next = malloc(sizeof(webParams_t));
+    cJSON *json = cJSON_Parse(content);
+    uint32_t groups = 0, changed = 0, keys = 0;
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = (cur && next) ? ESP_OK : ESP_ERR_NO_MEM;
+
+    if (err == ESP_OK) {
+        web_params_load(cur);
+        memcpy(next, cur, sizeof(webParams_t));
+        err = web_params_from_json(json, next, &groups);
+    }
+    if (err == ESP_OK) {
+        changed = web_params_diff(cur, next, groups);
+        // The sensor and the flash light may refuse a valid value, as in the per-group handlers
+        if ((changed & WEB_PARAM_IMAGE) && camera_set_image(&next->image) != ESP_OK) {
+            err = ESP_FAIL;
+        } else if ((groups & WEB_PARAM_LIGHT) && camera_flash_led_ctrl(&next->light) != ESP_OK) {
+            err = ESP_FAIL;
+        }
+    }
+    if (err == ESP_OK && changed) {
+        err = web_params_store(next, changed, &keys);
+    }
+    if (err == ESP_OK) {
+        web_params_apply(next, changed);
+        ESP_LOGI(TAG, "setParams: groups 0x%02" PRIx32 " changed 0x%02" PRIx32 ", %" PRIu32 " keys in %" PRId64 " us",
+                 groups, changed, keys, esp_timer_get_time() - start);
+    } else {
+        ESP_LOGE(TAG, "setParams failed: %s", esp_err_to_name(err));
+    }
+    http_send_json_response(req, err == ESP_OK ? RES_OK : RES_FAIL);
+
+    cJSON_Delete(json);
+    free(next);
+    free(cur);
+    http_free_content(content);
+    return ESP_OK;
+}
+
 static const httpd_uri_t g_webHandlers[] = {
     {
         .uri = "/",
@@ -1952,6 +2467,11 @@ static const httpd_uri_t g_webHandlers[] = {
         .method = HTTP_GET,
         .handler = get_dev_battery_handle,
     },
+    {
+        .uri = "/api/v1/system/getDevEnergy",
+        .method = HTTP_GET,
+        .handler = get_dev_energy_handle,
+    },
     {
         .uri = "/api/v1/system/setDevTime",
         .method = HTTP_POST,
@@ -2043,6 +2563,16 @@ static const httpd_uri_t g_webHandlers[] = {
         .method = HTTP_POST,
         .handler = set_push_mode_handle,
     },
+    {
+        .uri = "/api/v1/system/getAllParams",
+        .method = HTTP_GET,
+        .handler = get_all_params_handle,
+    },
+    {
+        .uri = "/api/v1/system/setParams",
+        .method = HTTP_POST,
+        .handler = set_params_handle,
+    },
 };
 
 static const httpd_uri_t g_streamHandlers[] = {
@@ -2053,6 +2583,54 @@ static const httpd_uri_t g_streamHandlers[] = {
     },
 };
 
+#define WEB_HANDLER_COUNT (sizeof(g_webHandlers) / sizeof(httpd_uri_t))
+
+static webJsonStat_t g_webJsonStats[WEB_HANDLER_COUNT];
+
+/**
+ * Run an API handler with its cJSON trees in the web arena
+ * @param req HTTP request handle, user_ctx holds the g_webHandlers index
+ * @return Handler result
+ */
+static esp_err_t web_json_scope_handler(httpd_req_t *req)
+{
+    int idx = (int)(intptr_t)req->user_ctx;
+    webJsonStat_t *stat = &g_webJsonStats[idx];
+    S2jArenaStats scope;
+    bool scoped = s2j_arena_begin(&g_webArena);
+    esp_err_t ret = g_webHandlers[idx].handler(req);
+
+    if (scoped) {
+        s2j_arena_end(&g_webArena, &scope);
+        stat->calls++;
+        stat->allocs = scope.allocs;
+        stat->heapAllocs += scope.heap_allocs;
+        if (scope.peak > stat->peak) {
+            stat->peak = scope.peak;
+        }
+        if (scope.heap_allocs) {
+            ESP_LOGW(TAG, "%s: %" PRIu32 " json allocs overflowed the arena", g_webHandlers[idx].uri, scope.heap_allocs);
+        }
+    }
+    return ret;
+}
+
+static int do_webjson_cmd(int argc, char **argv)
+{
+    for (int i = 0; i < WEB_HANDLER_COUNT; i++) {
+        if (g_webJsonStats[i].calls) {
+            ESP_LOGI(TAG, "%-36s calls %4" PRIu32 " allocs %4" PRIu32 " heap %3" PRIu32 " peak %6" PRIu32,
+                     g_webHandlers[i].uri, g_webJsonStats[i].calls, g_webJsonStats[i].allocs,
+                     g_webJsonStats[i].heapAllocs, g_webJsonStats[i].peak);
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_console_cmd_t g_cmd[] = {
+    ESP_CONSOLE_CMD_INIT("webjson", "cJSON arena usage per web API handler", NULL, do_webjson_cmd, NULL),
+};
+
 /**
  * Start web server
  * @param port Port to listen on
@@ -2061,9 +2639,10 @@ static const httpd_uri_t g_streamHandlers[] = {
 static esp_err_t web_server_start(uint16_t port)
 {
     int i;
+    httpd_uri_t uri;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.max_open_sockets = 6;
-    config.max_uri_handlers = sizeof(g_webHandlers) / sizeof(httpd_uri_t);
+    config.max_uri_handlers = WEB_HANDLER_COUNT;
     config.lru_purge_enable = true;
     config.keep_alive_enable = true;
     config.server_port = port;
@@ -2071,7 +2650,12 @@ static esp_err_t web_server_start(uint16_t port)
     ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
     if (httpd_start(&g_webServer, &config) == ESP_OK) {
         for (i = 0; i < config.max_uri_handlers; i++) {
-            httpd_register_uri_handler(g_webServer, &g_webHandlers[i]);
+            uri = g_webHandlers[i];
+            if (strncmp(uri.uri, "/api/", 5) == 0) {
+                uri.handler = web_json_scope_handler;
+                uri.user_ctx = (void *)(intptr_t)i;
+            }
+            httpd_register_uri_handler(g_webServer, &uri);
         }
         httpd_register_err_handler(g_webServer, HTTPD_404_NOT_FOUND, error_404_handler);
     } else {
@@ -2118,7 +2702,7 @@ static void timer_cb(void *arg)
     mdHttp_t *http = (mdHttp_t *)arg;
     if (http->webTimeoutSeconds++ >= WEB_TIMEOUT_SECONDS) {
         ESP_LOGI(TAG, "web has nothing to do over %ds, will go to sleep", WEB_TIMEOUT_SECONDS);
-        sleep_set_event_bits(SLEEP_NO_OPERATION_TIMEOUT_BIT);
+        sleep_release(&http->awake);
     }
 }
 
@@ -2145,13 +2729,22 @@ static void http_timer_start()
 esp_err_t http_open(void)
 {
     memset(&g_http, 0, sizeof(g_http));
+    sleep_keep_awake(&g_http.awake, "web", 0);
     web_server_start(80);
     stream_server_start(8080);
     http_timer_start();
-    sleep_set_event_bits(SLEEP_NO_DEBUG_BIT);
+    debug_cmd_add(g_cmd, sizeof(g_cmd) / sizeof(esp_console_cmd_t));
     return ESP_OK;
 }
 
+/**
+ * Release the web session keep-awake token
+ */
+void http_allow_sleep(void)
+{
+    sleep_release(&g_http.awake);
+}
+
 /**
  * Stop HTTP servers
  * @return ESP_OK on success
@@ -39,6 +39,11 @@ bool http_hasClient(void);
  */
 void http_clear_timeout(void);
 
+/**
+ * End the web session's hold on the device so it may enter sleep
+ */
+void http_allow_sleep(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,6 +8,7 @@
 #include "iot_mip.h"
 #include "pthread.h"
 #include "esp_timer.h"
+#include <stdlib.h>
 
 /* Logging tag for MIP module */
 #define TAG "-->IOT_MIP"
@@ -17,6 +18,9 @@
 #define MIP_DM_START_BIT BIT(1)       // Device management start flag  
 #define MIP_API_TOKEN_BIT BIT(2)      // API token received flag
 
+/* Room for the changed key names listed in the profile apply log */
+#define PROFILE_CHANGED_KEYS_LEN 256
+
 /* Queue node structure for async operations */
 typedef struct qNode {
     int8_t (*cb)(void *param);    // Callback function
@@ -41,6 +45,7 @@ typedef struct iot_mip_attr {
     pthread_mutex_t time_mutex;   // Time-related mutex
     esp_timer_handle_t timer;     // Timer handle
     int8_t timeout_sec;           // Timeout in seconds
+    sleepToken_t awake;           // Keep-awake token held until the countdown expires
     bool autop_enable;            // Auto-provisioning enabled flag
     bool dm_enable;               // Device management enabled flag
     bool autop_started;           // Auto-provisioning started flag
@@ -342,6 +347,46 @@ remap_t g_remap[] = {
     {"cat1_isp_select", KEY_CAT1_ISP_SELECT, apply_str_value, fetch_str_value, "auto"},
 };
 
+#define REMAP_COUNT (sizeof(g_remap) / sizeof(remap_t))
+
+/* g_remap entries sorted by upload name, built on first use */
+static remap_t *g_remap_index[REMAP_COUNT] = {0};
+static bool g_remap_indexed = false;
+
+static int remap_cmp(const void *a, const void *b)
+{
+    const remap_t *ra = *(const remap_t * const *)a;
+    const remap_t *rb = *(const remap_t * const *)b;
+    return strcmp(ra->upload_name, rb->upload_name);
+}
+
+static int remap_key_cmp(const void *key, const void *elem)
+{
+    const remap_t *r = *(const remap_t * const *)elem;
+    return strcmp((const char *)key, r->upload_name);
+}
+
+/**
+ * Find the remap entry of an uploaded key
+ * Callers hold g_iot_mip_attr.mutex, which also guards building the index
+ * @param upload_name Key name used in profiles
+ * @return Remap entry, NULL if the key is unknown
+ */
+static remap_t *remap_find(const char *upload_name)
+{
+    remap_t **found = NULL;
+
+    if (!g_remap_indexed) {
+        for (int i = 0; i < REMAP_COUNT; i++) {
+            g_remap_index[i] = &g_remap[i];
+        }
+        qsort(g_remap_index, REMAP_COUNT, sizeof(remap_t *), remap_cmp);
+        g_remap_indexed = true;
+    }
+    found = bsearch(upload_name, g_remap_index, REMAP_COUNT, sizeof(remap_t *), remap_key_cmp);
+    return found ? *found : NULL;
+}
+
 // --------------------iot mip--------------------
 static void timer_cb(void *arg)
 {
@@ -352,7 +397,7 @@ static void timer_cb(void *arg)
         attr->timeout_sec--;
         if (attr->timeout_sec == 0) {
             ESP_LOGI(TAG, "mip timer timeout");
-            sleep_set_event_bits(SLEEP_MIP_DONE_BIT);
+            sleep_release(&attr->awake);
         }
     }
     pthread_mutex_unlock(&attr->time_mutex);
@@ -362,7 +407,7 @@ static void mip_timer_pause()
 {
     pthread_mutex_lock(&g_iot_mip_attr.time_mutex);
     g_iot_mip_attr.timeout_sec = -1;
-    sleep_clear_event_bits(SLEEP_MIP_DONE_BIT);
+    sleep_keep_awake(&g_iot_mip_attr.awake, "mip", 0);
     pthread_mutex_unlock(&g_iot_mip_attr.time_mutex);
 }
 
@@ -370,6 +415,7 @@ static void mip_timer_resume(int8_t sec)
 {
     pthread_mutex_lock(&g_iot_mip_attr.time_mutex);
     g_iot_mip_attr.timeout_sec = sec;
+    sleep_keep_awake(&g_iot_mip_attr.awake, "mip", 0);
     pthread_mutex_unlock(&g_iot_mip_attr.time_mutex);
 }
 
@@ -388,7 +434,7 @@ static void mip_timer_start()
         true,
     };
     g_iot_mip_attr.timeout_sec = 3;
-    sleep_clear_event_bits(SLEEP_MIP_DONE_BIT);
+    sleep_keep_awake(&g_iot_mip_attr.awake, "mip", 0);
     esp_timer_create(&timer_args, &g_iot_mip_attr.timer);
     esp_timer_start_periodic(g_iot_mip_attr.timer, 1000 * 1000); //1s
     timer_started = true;
@@ -486,7 +532,6 @@ int8_t iot_mip_init()
     ESP_LOGI(TAG, "rps url: %s", g_iot_mip_attr.rps_url);
     iot_mip_autop_init();
     iot_mip_dm_init();
-    sleep_set_event_bits(SLEEP_MIP_DONE_BIT);
     // xTaskCreatePinnedToCore(mip_task, "mip_task", 1024 * 10, NULL, 5, NULL, 1);
     return 0;
 }
@@ -511,26 +556,70 @@ static void autop_resp_got(char *resp)
     ESP_LOGI(TAG, "autop_resp_got: %s", resp);
 }
 
-static void profile_apply(char *profile)
+/**
+ * Apply the values of a downloaded profile
+ * All values are written in one config batch: keys that already hold the value
+ * are skipped and the changed ones share a single NVS commit
+ * @param profile Profile JSON
+ * @param done_key Flag key set to 1 in the same commit, may be NULL
+ * @return Number of changed profile values, -1 on error
+ */
+static int profile_apply(char *profile, const char *done_key)
 {
+    int64_t start = esp_timer_get_time();
+    char changed_keys[PROFILE_CHANGED_KEYS_LEN] = {0};
+    size_t keys_len = 0;
+    int total = 0, changed = 0;
+    uint32_t written = 0;
+    esp_err_t err = ESP_OK;
+
     cJSON *root = cJSON_Parse(profile);
+    if (root == NULL) {
+        ESP_LOGE(TAG, "profile parse failed");
+        return -1;
+    }
+    err = cfg_batch_begin();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "cfg_batch_begin failed: %s", esp_err_to_name(err));
+        cJSON_Delete(root);
+        return -1;
+    }
     cJSON *item = cJSON_GetObjectItem(root, "values");
-    if (item) {
-        for (int i = 0; i < cJSON_GetArraySize(item); i++) {
-            cJSON *subitem = cJSON_GetArrayItem(item, i);
-            cJSON *key = cJSON_GetObjectItem(subitem, "key");
-            cJSON *value = cJSON_GetObjectItem(subitem, "value");
-            ESP_LOGI(TAG, "----------->key: %s", key->valuestring);
-            if (key && value) {
-                for (int j = 0; j < sizeof(g_remap) / sizeof(remap_t); j++) {
-                    if (g_remap[j].upload_name && strcmp(key->valuestring, g_remap[j].upload_name) == 0) {
-                        g_remap[j].apply_cb(g_remap[j].local_name, value);
-                    }
-                }
+    for (int i = 0; i < cJSON_GetArraySize(item); i++) {
+        cJSON *subitem = cJSON_GetArrayItem(item, i);
+        cJSON *key = cJSON_GetObjectItem(subitem, "key");
+        cJSON *value = cJSON_GetObjectItem(subitem, "value");
+        if (!cJSON_IsString(key) || value == NULL) {
+            continue;
+        }
+        remap_t *remap = remap_find(key->valuestring);
+        if (remap == NULL) {
+            ESP_LOGW(TAG, "profile key %s unknown", key->valuestring);
+            continue;
+        }
+        uint32_t before = cfg_batch_changed();
+        remap->apply_cb(remap->local_name, value);
+        total++;
+        if (cfg_batch_changed() != before) {
+            changed++;
+            if (keys_len < sizeof(changed_keys)) {
+                keys_len += snprintf(changed_keys + keys_len, sizeof(changed_keys) - keys_len, "%s%s",
+                                     keys_len ? "," : "", remap->upload_name);
             }
         }
     }
+    if (done_key) {
+        cfg_set_u8(done_key, 1);
+    }
+    err = cfg_batch_end(&written);
     cJSON_Delete(root);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "profile commit failed: %s", esp_err_to_name(err));
+        return -1;
+    }
+    ESP_LOGI(TAG, "profile applied: %d/%d values changed, %lu keys written in %lld ms [%s]",
+             changed, total, written, (esp_timer_get_time() - start) / 1000, changed_keys);
+    return changed;
 }
 
 static void profile_fetch(char **profile)
@@ -551,20 +640,17 @@ static void profile_fetch(char **profile)
 static int8_t autop_pofile_downloaded()
 {
     ESP_LOGI(TAG, "autop profile downloaded");
-    IoTAttr_t iot;
+    int ret = 0;
     char *profile = filesystem_read(MIP_AUTOP_PROFILE_PATH);
     if (profile == NULL) {
         ESP_LOGE(TAG, "autop profile is NULL");
         return -1;
     }
     pthread_mutex_lock(&g_iot_mip_attr.mutex);
-    profile_apply(profile);
+    ret = profile_apply(profile, KEY_IOT_AUTOP_DONE);
     free(profile);
-    cfg_get_iot_attr(&iot);
-    iot.autop_done = 1;
-    cfg_set_iot_attr(&iot);
     pthread_mutex_unlock(&g_iot_mip_attr.mutex);
-    return 0;
+    return ret < 0 ? -1 : 0;
 }
 
 int8_t iot_mip_autop_init()
@@ -740,8 +826,13 @@ static void dm_profile_update(dm_downlink_header_t dh, cJSON *ddata, dm_downlink
     content = filesystem_read(path);
     if (content) {
         ESP_LOGD(TAG, "profile content:\n %s", content);
-        snprintf(dres->status, sizeof(dres->status), DM_DOWNLINK_RES_SUCCESS);
-        profile_apply(content);
+        if (profile_apply(content, NULL) < 0) {
+            dres->err_code = ERR_RESOURCE_FORMAT;
+            snprintf(dres->status, sizeof(dres->status), DM_DOWNLINK_RES_FAILED);
+            snprintf(dres->err_msg, sizeof(dres->err_msg), "%s", mip_get_err_msg(ERR_RESOURCE_FORMAT));
+        } else {
+            snprintf(dres->status, sizeof(dres->status), DM_DOWNLINK_RES_SUCCESS);
+        }
         free(content);
     }
     pthread_mutex_unlock(&g_iot_mip_attr.mutex);
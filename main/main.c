@@ -43,6 +43,9 @@
 #include "utils.h"
 #include "storage.h"
 #include "session_log.h"
+#include "boot.h"
+#include "energy.h"
+#include "s2j_arena.h"
 
 #define TAG "-->MAIN"
 
@@ -54,6 +57,9 @@
 #define STATUS_LED_BLINK_COUNT    1
 #define STATUS_LED_BLINK_INTERVAL 1000
 
+// Deferred init must finish before the network comes up
+#define BOOT_DEFERRED_TIMEOUT_MS  10000
+
 modeSel_e main_mode;
 
 /**
@@ -343,7 +349,7 @@ void crash_handler(void)
 
 
 /**
- * @brief Common initialization for all operational modes
+ * @brief Common initialization needed before mode selection
  */
 static void common_init(void)
 {
@@ -351,12 +357,68 @@ static void common_init(void)
     esp_register_shutdown_handler(crash_handler);
     srand(esp_random());
 
-    debug_open();
+    s2j_arena_install();
     cfg_init();
     sleep_open();
+    energy_open();
+}
+
+static void boot_iot_mip_init(void)
+{
     iot_mip_init();
 }
 
+#define BOOT_MODES_NET (BOOT_MODE(MODE_CONFIG) | BOOT_MODE(MODE_SCHEDULE) | BOOT_MODE(MODE_UPLOAD))
+
+/**
+ * Init steps after mode selection. Anything not critical for the selected mode
+ * runs on a background task (snapshot mode: after the shutter).
+ */
+static const bootStep_t g_bootSteps[] = {
+    {"session_log", session_log_init,  BOOT_MODES_NET},     // rotate + open log file
+    {"console",     debug_open,        BOOT_MODES_NET},
+    {"iot_mip",     boot_iot_mip_init, BOOT_MODES_NET},
+    {"adc",         misc_adc_prepare,  0},                  // otherwise calibrated on first read
+};
+
+/**
+ * @brief Check whether the wake calendar merged a network job into this wake
+ * @return true if an upload or schedule todo is queued
+ */
+static bool has_merged_net_todo(void)
+{
+    wakeupTodo_e todo = sleep_peek_wakeup_todo();
+    return todo == WAKEUP_TODO_UPLOAD || todo == WAKEUP_TODO_SCHEDULE;
+}
+
+/**
+ * @brief Let the push task send stored frames if an upload is merged into this wake.
+ * Runs before the network opens, push_dispatch() must not see the decision change under it.
+ */
+static void prepare_merged_todos(void)
+{
+    if (sleep_wakeup_todo_queued(WAKEUP_TODO_UPLOAD)) {
+        push_set_scheduled_upload();
+    }
+}
+
+/**
+ * @brief Run the network jobs the wake calendar merged into this wake
+ */
+static void run_merged_todos(void)
+{
+    while (has_merged_net_todo()) {
+        wakeupTodo_e todo = sleep_get_wakeup_todo();
+        if (todo == WAKEUP_TODO_UPLOAD) {
+            ESP_LOGI(TAG, "merged upload");
+            system_upload_todo();
+        } else {
+            ESP_LOGI(TAG, "merged schedule");
+            system_schedule_todo();
+        }
+    }
+}
+
 /**
  * @brief Handle snapshot mode operations (image capture)
  * @param snapType Type of snapshot trigger
@@ -387,14 +449,18 @@ static void handle_snapshot_mode(snapType_e snapType, QueueHandle_t xQueueMqtt,
     }
 
     camera_snapshot(snapType, 1);
+    boot_mark_shutter();
     camera_close();
     misc_flash_led_close();
     
-    if (need_netModule) {
+    if (need_netModule || has_merged_net_todo()) {
+        boot_wait_deferred(BOOT_DEFERRED_TIMEOUT_MS);
+        prepare_merged_todos();
         netModule_open(main_mode);
+        run_merged_todos();
     }
     
-    sleep_wait_event_bits(SLEEP_SNAPSHOT_STOP_BIT | SLEEP_STORAGE_UPLOAD_STOP_BIT | SLEEP_MIP_DONE_BIT, true);
+    sleep_wait_awake_released();
 }
 
 /**
@@ -415,8 +481,7 @@ static void handle_config_mode(snapType_e snapType, QueueHandle_t xQueueMqtt)
     if (snapType == SNAP_BUTTON) {
         camera_snapshot(snapType, 1);
     }
-    sleep_wait_event_bits(SLEEP_SNAPSHOT_STOP_BIT | SLEEP_STORAGE_UPLOAD_STOP_BIT | 
-                          SLEEP_NO_OPERATION_TIMEOUT_BIT | SLEEP_MIP_DONE_BIT | SLEEP_NO_DEBUG_BIT, true);
+    sleep_wait_awake_released();
 }
 
 /**
@@ -426,9 +491,11 @@ static void handle_schedule_mode(void)
 {
     ESP_LOGI(TAG, "schedule mode");
     
+    prepare_merged_todos();
     netModule_open(main_mode);
     system_schedule_todo();
-    sleep_wait_event_bits(SLEEP_SCHEDULE_DONE_BIT | SLEEP_STORAGE_UPLOAD_STOP_BIT | SLEEP_MIP_DONE_BIT, true);
+    run_merged_todos();
+    sleep_wait_awake_released();
 }
 
 /**
@@ -440,7 +507,8 @@ static void handle_upload_mode(void)
     
     netModule_open(main_mode);
     system_upload_todo();
-    sleep_wait_event_bits(SLEEP_STORAGE_UPLOAD_STOP_BIT | SLEEP_MIP_DONE_BIT, true);
+    run_merged_todos();
+    sleep_wait_awake_released();
 }
 
 
@@ -486,9 +554,9 @@ static esp_err_t init_queues_and_services(QueueHandle_t *xQueueMqtt, QueueHandle
 
 void app_main(void)
 {
-    /* Mount LittleFS and start session log file (truncated each boot) before other init. */
+    /* Mount LittleFS and buffer early log lines; the session log file is rotated/opened by the boot scheduler. */
     if (storage_ensure_mounted() == ESP_OK) {
-        session_log_init();
+        session_log_begin();
     }
 
     // Initialize common components
@@ -505,6 +573,14 @@ void app_main(void)
         return;
     }
 
+    // main_mode = MODE_CONFIG; //TODO: for test
+    modeSel_e temp_mode = system_get_temporary_mode();
+    if (temp_mode != MODE_UNDEFINED) {
+        main_mode = temp_mode;
+        ESP_LOGI(TAG, "temporary mode: %d", main_mode);
+    }
+    boot_run(g_bootSteps, sizeof(g_bootSteps) / sizeof(g_bootSteps[0]), main_mode);
+
     // Initialize queues and services for operational modes
     QueueHandle_t xQueueMqtt = NULL, xQueueStorage = NULL;
     esp_err_t ret = init_queues_and_services(&xQueueMqtt, &xQueueStorage);
@@ -512,14 +588,12 @@ void app_main(void)
         ESP_LOGE(TAG, "Failed to initialize queues and services: %s", esp_err_to_name(ret));
         goto cleanup;
     }
+    // Deferred steps use misc (ADC), start them once it is open
+    if (main_mode != MODE_SNAPSHOT) {
+        boot_start_deferred();
+    }
 
     // Handle different operational modes
-    // main_mode = MODE_CONFIG; //TODO: for test
-    modeSel_e temp_mode = system_get_temporary_mode();
-    if (temp_mode != MODE_UNDEFINED) {
-        main_mode = temp_mode;
-        ESP_LOGI(TAG, "temporary mode: %d", main_mode);
-    }
     switch (main_mode) {
         case MODE_SNAPSHOT:
             handle_snapshot_mode(snapType, xQueueMqtt, xQueueStorage);
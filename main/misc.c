@@ -13,12 +13,14 @@
 // limitations under the License.
 
 #include "stdio.h"
+#include <math.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "freertos/timers.h"
 #include "freertos/semphr.h"
 #include "driver/ledc.h"
+#include "driver/temperature_sensor.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "iot_button.h"
@@ -31,6 +33,7 @@
 #include "debug.h"
 #include "esp_sleep.h"
 #include "session_log.h"
+#include "energy.h"
 #include "pir.h"
 #include "http.h"
 #include "wifi.h"
@@ -48,6 +51,26 @@ typedef enum {
     LED_MODE_LIGHT,
 } LED_MODE_E;
 
+float misc_get_chip_temperature()
+{
+    temperature_sensor_handle_t sensor = NULL;
+    temperature_sensor_config_t cfg = TEMPERATURE_SENSOR_CONFIG_DEFAULT(-10, 80);
+    float celsius = NAN;
+
+    if (temperature_sensor_install(&cfg, &sensor) != ESP_OK) {
+        ESP_LOGW(TAG, "temperature sensor unavailable");
+        return NAN;
+    }
+    if (temperature_sensor_enable(sensor) == ESP_OK) {
+        if (temperature_sensor_get_celsius(sensor, &celsius) != ESP_OK) {
+            celsius = NAN;
+        }
+        temperature_sensor_disable(sensor);
+    }
+    temperature_sensor_uninstall(sensor);
+    return celsius;
+}
+
 static void misc_pwm_ctrl(uint8_t enable, uint8_t duty);
 
 ledc_timer_config_t ledc_timer = {
@@ -103,6 +126,7 @@ typedef struct mdMisc {
     adc_oneshot_unit_handle_t adc2_unit_handle; ///< ADC2 unit handle  
     adc_cali_handle_t adc1_cali_handle; ///< ADC1 calibration handle
     adc_cali_handle_t adc2_cali_handle; ///< ADC2 calibration handle
+    SemaphoreHandle_t adc_mutex;    ///< Guards lazy ADC unit setup
     bool reset_flag;                ///< Flag indicating reset requested
 } mdMisc_t;
 
@@ -172,6 +196,7 @@ static void button_start()
         .gpio_button_config = {
             .gpio_num = BUTTON_IO,
             .active_level = BUTTON_ACTIVE,
+            .enable_power_save = true,  // scan timer runs only while the button is in use
         },
     };
     g_misc.btn.handle = iot_button_create(&cfg);
@@ -251,8 +276,16 @@ static void adc_calibration_delete(adc_cali_handle_t handle)
 #endif
 }
 
-static bool adc_calibration_init(void)
+/**
+ * Set up ADC1 (light sensor) on first use
+ */
+static void adc_light_ready(void)
 {
+    xSemaphoreTake(g_misc.adc_mutex, portMAX_DELAY);
+    if (g_misc.adc1_unit_handle) {
+        xSemaphoreGive(g_misc.adc_mutex);
+        return;
+    }
 //-------------ADC1 Init---------------//
     adc_oneshot_unit_init_cfg_t init_config1 = {
         .unit_id = ADC_UNIT_1,
@@ -267,9 +300,23 @@ static bool adc_calibration_init(void)
     ESP_ERROR_CHECK(adc_oneshot_config_channel(g_misc.adc1_unit_handle, LIGHT_DET_ADC1_CHN, &config));
 
     //-------------ADC1 Calibration Init---------------//
-    bool do_calibration1_chan0 = adc_calibration_new(ADC_UNIT_1, LIGHT_DET_ADC1_CHN, ADC_ATTEN, &g_misc.adc1_cali_handle);
+    if (!adc_calibration_new(ADC_UNIT_1, LIGHT_DET_ADC1_CHN, ADC_ATTEN, &g_misc.adc1_cali_handle)) {
+        ESP_LOGW(TAG, "adc1 calibration init failed");
+    }
+    xSemaphoreGive(g_misc.adc_mutex);
+}
 
-    //-------------ADC2 Init---------------//
+/**
+ * Set up ADC2 (battery) on first use
+ */
+static void adc_battery_ready(void)
+{
+    xSemaphoreTake(g_misc.adc_mutex, portMAX_DELAY);
+    if (g_misc.adc2_unit_handle) {
+        xSemaphoreGive(g_misc.adc_mutex);
+        return;
+    }
+//-------------ADC2 Init---------------//
     adc_oneshot_unit_init_cfg_t init_config2 = {
         .unit_id = ADC_UNIT_2,
         .ulp_mode = ADC_ULP_MODE_DISABLE,
@@ -277,19 +324,36 @@ static bool adc_calibration_init(void)
     ESP_ERROR_CHECK(adc_oneshot_new_unit(&init_config2, &g_misc.adc2_unit_handle));
 
     //-------------ADC2 Calibration Init---------------//
-    bool do_calibration2 = adc_calibration_new(ADC_UNIT_2, BATTERY_DET_ADC2_CHN, ADC_ATTEN, &g_misc.adc2_cali_handle);
+    if (!adc_calibration_new(ADC_UNIT_2, BATTERY_DET_ADC2_CHN, ADC_ATTEN, &g_misc.adc2_cali_handle)) {
+        ESP_LOGW(TAG, "adc2 calibration init failed");
+    }
     //-------------ADC2 Config---------------//
+    adc_oneshot_chan_cfg_t config = {
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+        .atten = ADC_ATTEN,
+    };
     ESP_ERROR_CHECK(adc_oneshot_config_channel(g_misc.adc2_unit_handle, BATTERY_DET_ADC2_CHN, &config));
-
-    return do_calibration1_chan0 && do_calibration2;
+    xSemaphoreGive(g_misc.adc_mutex);
 }
 
 static void adc_calibration_deinit(void)
 {
-    adc_calibration_delete(g_misc.adc1_cali_handle);
-    adc_calibration_delete(g_misc.adc2_cali_handle);
-    adc_oneshot_del_unit(g_misc.adc1_unit_handle);
-    adc_oneshot_del_unit(g_misc.adc2_unit_handle);
+    if (g_misc.adc1_unit_handle) {
+        if (g_misc.adc1_cali_handle) {
+            adc_calibration_delete(g_misc.adc1_cali_handle);
+        }
+        adc_oneshot_del_unit(g_misc.adc1_unit_handle);
+    }
+    if (g_misc.adc2_unit_handle) {
+        if (g_misc.adc2_cali_handle) {
+            adc_calibration_delete(g_misc.adc2_cali_handle);
+        }
+        adc_oneshot_del_unit(g_misc.adc2_unit_handle);
+    }
+    g_misc.adc1_unit_handle = NULL;
+    g_misc.adc2_unit_handle = NULL;
+    g_misc.adc1_cali_handle = NULL;
+    g_misc.adc2_cali_handle = NULL;
 }
 
 static int  get_adc_voltage_mv()
@@ -300,6 +364,7 @@ static int  get_adc_voltage_mv()
     int raw;
     uint8_t n = ADC_SUM_N;
 
+    adc_battery_ready();
     // misc_io_set(BATTERY_POWER_IO, BATTERY_POWER_ON);
     // vTaskDelay(pdMS_TO_TICKS(50));
     while (n) {
@@ -321,11 +386,8 @@ static int  get_adc_voltage_mv()
 
 static void adc_start()
 {
-    if (adc_calibration_init()) {
-        ESP_LOGI(TAG, "adc calibration init success");
-    } else {
-        ESP_LOGW(TAG, "adc calibration init failed");
-    }
+    // ADC units and calibration are set up on first read (or by misc_adc_prepare), off the boot path
+    g_misc.adc_mutex = xSemaphoreCreateMutex();
     misc_io_cfg(LIGHT_POWER_IO, 0, 1);
     misc_io_set(LIGHT_POWER_IO, LIGHT_POWER_ON);
     misc_io_cfg(BATTERY_POWER_IO, 0, 1);
@@ -389,6 +451,7 @@ uint8_t misc_get_light_value_rate()
     bool prev_light_state = false;
     LED_MODE_E prev_mode = LED_MODE_LIGHT;
 
+    adc_light_ready();
     // misc_io_set(LIGHT_POWER_IO, LIGHT_POWER_ON);
     // vTaskDelay(pdMS_TO_TICKS(20));
 
@@ -460,9 +523,19 @@ uint8_t  misc_get_battery_voltage_rate()
     return rate;
 }
 
+void misc_adc_prepare(void)
+{
+    if (g_misc.adc_mutex == NULL) {
+        ESP_LOGW(TAG, "ADC prepare before misc_open, left to the first read");
+        return;
+    }
+    adc_light_ready();
+    adc_battery_ready();
+}
+
 int misc_get_battery_voltage()
 {
-    if (g_misc.voltage == 0) {
+    if (g_misc.voltage == 0 && g_misc.isInit) {
         g_misc.voltage = get_adc_voltage_mv() * 2;
     }
     return g_misc.voltage;
@@ -482,6 +555,7 @@ static void misc_pwm_ctrl(uint8_t enable, uint8_t duty)
         duty = 99;
     }
     // ESP_LOGI(TAG,"misc_pwm_ctrl enable:%d duty:%d\r\n",enable , duty);
+    energy_led_duty(duty);
     _duty = (1024 - 1) * (duty) / 100;
     ledc_set_duty(ledc_channel.speed_mode, ledc_channel.channel, _duty);
     ledc_update_duty(ledc_channel.speed_mode, ledc_channel.channel);
@@ -89,8 +89,12 @@ void misc_led_blink(uint8_t blink_cnt, uint16_t blink_interval);
 uint8_t misc_get_light_value_rate();
 /* Get battery voltage as percentage */
 uint8_t misc_get_battery_voltage_rate();
-/* Get actual battery voltage in mV */
+/* Get actual battery voltage in mV, 0 before misc_open() */
 int misc_get_battery_voltage();
+/* Read the chip temperature sensor in degrees C, NAN if it fails */
+float misc_get_chip_temperature();
+/* Set up both ADC units and their calibration ahead of the first read */
+void misc_adc_prepare(void);
 /* Set flash LED PWM duty cycle */
 void misc_set_flash_duty(int duty);
 #ifdef __cplusplus
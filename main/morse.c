@@ -1,19 +1,28 @@
 #include <stdio.h>
 #include <string.h>
 #include "esp_event.h"
+#include "esp_heap_caps.h"
+#include "esp_console.h"
 #include "esp_wifi.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "config.h"
 #include "system.h"
 #include "utils.h"
+#include "debug.h"
+#include "pkt_pool.h"
 #include "mmwlan_regdb.def"
 #include "mmosal.h"
+#include "mmosal_mempool.h"
+#include "wlan_hal.h"
 #include "mmwlan.h"
 #include "morse.h"
 
 #define TAG "-->MORSE"
 
+#define MM_RX_POOL_NUM      8       ///< Receive buffers kept in internal RAM
+#define MM_RX_BUF_SIZE      1536    ///< Ethernet header + 1500 MTU, rounded; bigger frames use the heap
+
 struct mm_netif_driver {
     esp_netif_driver_base_t base;
     void *handle;
@@ -39,12 +48,12 @@ struct mm_wifi_config g_mm_wifi_config = {
     .country_code = "EU"
 };
 
+static pktPool_t g_rx_pool;
+
 /*--------------------------------------------wifi interface-----------------------------------------*/
 static void wifi_free(void *h, void *buffer)
 {
-    if (buffer) {
-        free(buffer);
-    }
+    pkt_pool_free(&g_rx_pool, buffer);
 }
 
 static esp_err_t wifi_transmit(void *h, void *buffer, size_t len)
@@ -128,13 +137,12 @@ static esp_err_t wifi_set_default_sta_handlers(void)
 static void wifi_rx_cb(uint8_t *pHeader, unsigned head_size, uint8_t *pPayload, unsigned len, void *arg)
 {
     esp_netif_t *esp_netif = (esp_netif_t *)arg;
-    uint8_t *buffer = calloc(1, head_size + len);
+    /* Freed by wifi_free() once lwIP is done with the pbuf */
+    uint8_t *buffer = pkt_pool_alloc_frame(&g_rx_pool, pHeader, head_size, pPayload, len);
     if (buffer == NULL) {
-        ESP_LOGE(TAG, "No memory to create a wifi interface handle");
+        ESP_LOGE(TAG, "No memory for a %u byte rx buffer", head_size + len);
         return;
     }
-    memcpy(buffer, pHeader, head_size);
-    memcpy(buffer + head_size, pPayload, len);
     esp_netif_receive(esp_netif, buffer, head_size + len, buffer);
     // ESP_LOGI(TAG, "--------->Received %d bytes from morse", head_size + len);
 }
@@ -231,6 +239,69 @@ static void wifi_scan_completed_cb(enum mmwlan_scan_state state, void *arg)
     mmosal_semb_give(args->semaphore);
 }
 
+static int do_rxpool_cmd(int argc, char **argv)
+{
+    pktPoolStats_t stats;
+    pkt_pool_stats(&g_rx_pool, &stats);
+    uint32_t allocs = stats.poolAllocs + stats.heapAllocs;
+    uint32_t mb = (uint32_t)(stats.bytes >> 20);
+    ESP_LOGI(TAG, "rx pool %lu/%lu in use, peak %lu", stats.inUse, stats.count, stats.peak);
+    ESP_LOGI(TAG, "rx buffers %lu: pool %lu, heap %lu (%lu failed), %lu MB, %lu heap allocs/MB",
+             allocs, stats.poolAllocs, stats.heapAllocs, stats.heapFails, mb,
+             mb ? stats.heapAllocs / mb : stats.heapAllocs);
+    return ESP_OK;
+}
+
+static int do_mempool_cmd(int argc, char **argv)
+{
+    struct mmosal_mempool_stats stats;
+    for (unsigned i = 0; mmosal_mempool_get_stats(i, &stats); i++) {
+        ESP_LOGI(TAG, "%4lu B x %3lu: %3lu in use, high water %3lu, hits %lu, misses %lu",
+                 stats.block_size, stats.block_count, stats.in_use, stats.high_water, stats.hits, stats.misses);
+    }
+    ESP_LOGI(TAG, "oversize (heap) %lu", mmosal_mempool_get_oversize_count());
+    return ESP_OK;
+}
+
+static int do_spistat_cmd(int argc, char **argv)
+{
+    struct wlan_hal_spi_stats stats;
+    wlan_hal_spi_get_stats(&stats);
+    ESP_LOGI(TAG, "spi transactions %lu: polling %lu, dma %lu, %llu bytes, %llu B/transaction, busy %llu ms",
+             stats.transactions, stats.polling_transactions, stats.dma_transactions, stats.bytes,
+             stats.transactions ? stats.bytes / stats.transactions : 0, stats.busy_us / 1000);
+    ESP_LOGI(TAG, "cs assertions %lu, max %lu transactions in one, coalesced %lu bytes, bounced %lu chunks",
+             stats.cs_assertions, stats.max_assertion_transactions, stats.coalesced_bytes, stats.bounced_chunks);
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        wlan_hal_spi_reset_stats();
+    }
+    return ESP_OK;
+}
+
+static esp_console_cmd_t g_cmd[] = {
+    ESP_CONSOLE_CMD_INIT("rxpool", "HaLow receive buffer pool counters", NULL, do_rxpool_cmd, NULL),
+    ESP_CONSOLE_CMD_INIT("mempool", "HaLow driver block pool counters", NULL, do_mempool_cmd, NULL),
+    ESP_CONSOLE_CMD_INIT("spistat", "HaLow SPI counters, 'spistat reset' clears them after printing", NULL, do_spistat_cmd, NULL),
+};
+
+/**
+ * Set up the receive buffer pool, once: buffers may still be held by lwIP across a deinit
+ */
+static void wifi_rx_pool_init(void)
+{
+    static bool initialized = false;
+    if (initialized) {
+        return;
+    }
+    void *storage = heap_caps_malloc(MM_RX_POOL_NUM * MM_RX_BUF_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (storage == NULL) {
+        ESP_LOGW(TAG, "No internal RAM for the rx pool, using the heap");
+    }
+    pkt_pool_init(&g_rx_pool, storage, MM_RX_BUF_SIZE, MM_RX_POOL_NUM);
+    debug_cmd_add(g_cmd, sizeof(g_cmd) / sizeof(esp_console_cmd_t));
+    initialized = true;
+}
+
 /*--------------------------------------------netif interface------------------------- ----------------*/
 
 static esp_err_t netif_attach_wifi_station(esp_netif_t *esp_netif)
@@ -283,6 +354,7 @@ esp_err_t mm_wifi_init(esp_netif_t *esp_netif, uint8_t *mac_addr, const char *co
     mmhal_init();
     mmwlan_init();
     mm_wifi_set_mac(mac_addr);
+    wifi_rx_pool_init();
 
     status = mmwlan_register_rx_cb(wifi_rx_cb, esp_netif);
     if (status != MMWLAN_SUCCESS) {
@@ -6,9 +6,11 @@
  */
 #include <string.h>
 #include <time.h>
+#include <inttypes.h>
 #include "esp_log.h"
 #include "esp_system.h"
 #include "esp_netif.h"
+#include "esp_timer.h"
 // #include "esp_tls.h"
 #include "esp_tls_crypto.h"
 #include "esp_crt_bundle.h"
@@ -17,19 +19,20 @@
 #include "config.h"
 #include "system.h"
 #include "s2j.h"
+#include "s2j_arena.h"
 #include "misc.h"
 #include "mqtt.h"
 #include "debug.h"
 #include "utils.h"
 #include "iot_mip.h"
 #include "push.h"
+#include "energy.h"
 
 // Event bit definitions for MQTT state tracking
 #define MQTT_START_BIT BIT(0)          // Client started
 #define MQTT_STOP_BIT BIT(1)           // Client stopped
 #define MQTT_CONNECT_BIT BIT(2)        // Connected to broker
 #define MQTT_DISCONNECT_BIT BIT(3)     // Disconnected from broker
-#define MQTT_PUBLISHED_BIT BIT(4)      // Message published
 
 // Timeout constants (milliseconds)
 #define MQTT_START_TIMEOUT_MS (1000)           // Start timeout
@@ -37,6 +40,12 @@
 #define MQTT_DISCONNECT_TIMEOUT_MS (2000)      // Disconnect timeout
 #define MQTT_STOP_TIMEOUT_MS (1000)            // Stop timeout
 #define MQTT_PUBLISHED_TIMEOUT_MS (20000)      // Publish timeout
+#define MQTT_OUTBOX_POLL_MS (50)               // Outbox drain poll period
+
+// In-flight slot states, see MQTT_INFLIGHT_MAX
+#define MQTT_INFLIGHT_FREE (-1)                // Slot unused
+#define MQTT_INFLIGHT_PENDING (-2)             // Slot reserved, msg_id not known yet
+#define MQTT_EARLY_ACK_MS (2000)               // Forget an early ack nobody claimed after this
 
 // Buffer sizes
 #define MQTT_RECV_BUFFER_SIZE 8192       // Receive buffer size (used by MIP)
@@ -52,6 +61,27 @@ typedef struct subscribe_s {
     sub_notify_cb notify_cb; // Callback for received messages
 } subscribe_t;
 
+/**
+ * In-flight publish tracking slot
+ */
+typedef struct mqttInflight {
+    int msgId;                         // Broker msg_id (QoS1/2), 0 for QoS0, or MQTT_INFLIGHT_*
+    int qos;                           // QoS the message was enqueued with
+    int64_t startUs;                   // Enqueue time
+    int64_t deadlineUs;                // Fail the publish after this time
+    queueNode_t *node;                 // Node being published
+    mqtt_publish_done_cb cb;           // Completion callback
+    void *arg;                         // Completion callback argument
+} mqttInflight_t;
+
+/**
+ * Broker ack that arrived before its publish recorded the msg_id
+ */
+typedef struct mqttEarlyAck {
+    int msgId;                         // Acked msg_id, 0 when unused
+    int64_t expireUs;                  // Drop it after this time
+} mqttEarlyAck_t;
+
 /**
  * MQTT module state
  */
@@ -69,15 +99,23 @@ typedef struct mdMqtt {
     connect_status_cb status_cb;       // Connection status callback
     mqtt_t *mip;                       // MIP configuration
     esp_mqtt_client_config_t cfg;      // ESP MQTT client config
+    mqttInflight_t inflight[MQTT_INFLIGHT_MAX]; // In-flight image publishes
+    mqttEarlyAck_t earlyAck[MQTT_INFLIGHT_MAX]; // PUBACKs seen before their slot got its msg_id
+    SemaphoreHandle_t inflightSem;     // Counts free in-flight slots
+    esp_timer_handle_t outboxTimer;    // Polls outbox drain and publish deadlines
 } mdMqtt_t;
 
 static RTC_DATA_ATTR int g_sned_total = 0;
 static RTC_DATA_ATTR int g_sned_success = 0;
 
 static mdMqtt_t g_MQ = {0};
+S2J_ARENA_DEFINE(g_payloadArena, "payload", 4 * 1024);  // Payload metadata nodes, reset per payload
 static int buff_index = 0;
 static char event_topic[128];
 
+static void mqtt_inflight_acked(mdMqtt_t *m, int msg_id);
+static void mqtt_inflight_fail_all(mdMqtt_t *m);
+
 /**
  * MQTT event handler callback
  * @param event MQTT event data
@@ -113,6 +151,7 @@ static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event, void *hand
                 mqtt->status_cb(false);
             }
             mqtt->isConnected = false;
+            mqtt_inflight_fail_all(mqtt);
             storage_upload_stop();
             break;
 
@@ -133,7 +172,7 @@ static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event, void *hand
             break;
         case MQTT_EVENT_PUBLISHED:
             ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
-            xEventGroupSetBits(mqtt->eventGroup, MQTT_PUBLISHED_BIT);
+            mqtt_inflight_acked(mqtt, event->msg_id);
             break;
         case MQTT_EVENT_DATA:
             ESP_LOGI(TAG, "MQTT_EVENT_DATA");
@@ -226,6 +265,7 @@ char *push_build_json_payload(queueNode_t *node)
         return NULL;
     }
 
+    bool scoped = s2j_arena_begin(&g_payloadArena);
     cfg_get_device_info(&device);
     time_t t = node->pts / 1000;
     strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", localtime(&t));
@@ -239,61 +279,296 @@ char *push_build_json_payload(queueNode_t *node)
     cJSON_AddStringToObject(subJson, "fwVersion", device.softVersion);
     cJSON_AddNumberToObject(subJson, "battery", misc_get_battery_voltage_rate());
     cJSON_AddNumberToObject(subJson, "batteryVoltage", misc_get_battery_voltage());
+    energyReport_t energy;
+    energy_get_report(&energy);
+    // Previous wake plus the deep sleep that followed it
+    cJSON_AddNumberToObject(subJson, "energyCycleMah", energy.lastWakeMah + energy.lastSleepMah);
+    cJSON_AddNumberToObject(subJson, "energyDayMah", energy.mahPerDay);
     cJSON_AddStringToObject(subJson, "snapType", snapType);
     cJSON_AddStringToObject(subJson, "localtime", time_str);
     cJSON_AddNumberToObject(subJson, "imageSize", picSize + strlen(header));
-    cJSON_AddStringToObject(subJson, "image", (char *)g_MQ.sendBuf);
+    // Reference the encoded image in sendBuf instead of duplicating it
+    cJSON_AddItemToObject(subJson, "image", cJSON_CreateStringReference((char *)g_MQ.sendBuf));
     cJSON_AddNumberToObject(json, "ts", node->pts);
     cJSON_AddItemToObject(json, "values", subJson);
 
-    char *str = cJSON_PrintUnformatted(json);
+    // Print into one heap buffer sized for the image rather than growing it step by step
+    size_t strSize = picSize + header_len + 1024;
+    char *str = malloc(strSize);
+    if (str && !cJSON_PrintPreallocated(json, str, strSize, false)) {
+        free(str);
+        str = NULL;
+    }
+    if (str == NULL) {
+        str = s2j_arena_detach(cJSON_PrintUnformatted(json));
+    }
     cJSON_Delete(json);
+    if (scoped) {
+        S2jArenaStats stats;
+        s2j_arena_end(&g_payloadArena, &stats);
+        ESP_LOGD(TAG, "payload json: %" PRIu32 " allocs, %" PRIu32 " on heap, arena peak %u",
+                 stats.allocs, stats.heap_allocs, (unsigned)stats.peak);
+    }
     return str;
 }
 
 /**
- * Publish a queueNode_t as JSON via MQTT
+ * Release the slot of an in-flight publish, call with the mutex held
+ * @param m MQTT state
+ * @param idx Slot index
+ * @param done Output copy of the publish, to pass to mqtt_inflight_finish()
+ * @return false if the slot holds no publish
+ */
+static bool mqtt_inflight_take(mdMqtt_t *m, int idx, mqttInflight_t *done)
+{
+    *done = m->inflight[idx];
+    if (done->msgId == MQTT_INFLIGHT_FREE || done->msgId == MQTT_INFLIGHT_PENDING) {
+        return false;
+    }
+    m->inflight[idx].msgId = MQTT_INFLIGHT_FREE;
+    m->inflight[idx].node = NULL;
+    return true;
+}
+
+/**
+ * Report a publish taken by mqtt_inflight_take(), without the mutex held
+ * @param m MQTT state
+ * @param done Publish
+ * @param res Publish result passed to the completion callback
+ */
+static void mqtt_inflight_finish(mdMqtt_t *m, const mqttInflight_t *done, esp_err_t res)
+{
+    ESP_LOGI(TAG, "publish done, msg_id=%d qos=%d res=%d, %lld ms", done->msgId, done->qos, res,
+             (esp_timer_get_time() - done->startUs) / 1000);
+    if (res == ESP_OK) {
+        g_sned_success += 1;
+    }
+    xSemaphoreGive(m->inflightSem);
+    if (done->cb) {
+        done->cb(done->node, res, done->arg);
+    }
+}
+
+/**
+ * Finish an in-flight publish and release its slot
+ * @param m MQTT state
+ * @param idx Slot index
+ * @param res Publish result passed to the completion callback
+ */
+static void mqtt_inflight_complete(mdMqtt_t *m, int idx, esp_err_t res)
+{
+    mqttInflight_t done;
+    bool taken;
+
+    xSemaphoreTake(m->mutex, portMAX_DELAY);
+    taken = mqtt_inflight_take(m, idx, &done);
+    xSemaphoreGive(m->mutex);
+    if (taken) {
+        mqtt_inflight_finish(m, &done, res);
+    }
+}
+
+/**
+ * Complete the in-flight QoS1/2 publish matching a broker ack
+ * @param m MQTT state
+ * @param msg_id Acked message id
+ */
+static void mqtt_inflight_acked(mdMqtt_t *m, int msg_id)
+{
+    int i;
+    int idx = -1;
+    bool pending = false;
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(m->mutex, portMAX_DELAY);
+    for (i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (m->inflight[i].qos > 0 && m->inflight[i].msgId == msg_id) {
+            idx = i;
+            break;
+        }
+        pending |= (m->inflight[i].msgId == MQTT_INFLIGHT_PENDING);
+    }
+    if (idx < 0 && pending) {
+        // The ack may beat the publisher recording its msg_id, remember it for a while.
+        // Acks of untracked publishes (status, DM) only land here during that window.
+        mqttEarlyAck_t *slot = &m->earlyAck[0];
+        for (i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+            if (m->earlyAck[i].msgId == 0 || m->earlyAck[i].expireUs < now) {
+                slot = &m->earlyAck[i];
+                break;
+            }
+            if (m->earlyAck[i].expireUs < slot->expireUs) {
+                slot = &m->earlyAck[i];
+            }
+        }
+        slot->msgId = msg_id;
+        slot->expireUs = now + MQTT_EARLY_ACK_MS * 1000LL;
+    }
+    xSemaphoreGive(m->mutex);
+
+    if (idx >= 0) {
+        mqtt_inflight_complete(m, idx, ESP_OK);
+    }
+}
+
+/**
+ * Fail every in-flight publish (disconnect or stop)
+ * @param m MQTT state
+ */
+static void mqtt_inflight_fail_all(mdMqtt_t *m)
+{
+    int i;
+
+    if (!m->mutex) {
+        return;
+    }
+    for (i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        mqtt_inflight_complete(m, i, ESP_FAIL);
+    }
+    xSemaphoreTake(m->mutex, portMAX_DELAY);
+    memset(m->earlyAck, 0, sizeof(m->earlyAck));
+    xSemaphoreGive(m->mutex);
+}
+
+/**
+ * Periodic check: QoS0 publishes complete once the outbox has drained,
+ * any publish fails once its deadline passes
+ * @param arg Pointer to mdMqtt_t state
+ */
+static void mqtt_outbox_timer_cb(void *arg)
+{
+    mdMqtt_t *m = (mdMqtt_t *)arg;
+    int64_t now = esp_timer_get_time();
+    int outbox = m->client ? esp_mqtt_client_get_outbox_size(m->client) : 0;
+    mqttInflight_t done[MQTT_INFLIGHT_MAX];
+    esp_err_t res[MQTT_INFLIGHT_MAX];
+    int count = 0;
+    bool busy = false;
+    int i;
+
+    // The slots are filled and acked from other tasks, decide and release them under the mutex
+    xSemaphoreTake(m->mutex, portMAX_DELAY);
+    for (i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        mqttInflight_t *f = &m->inflight[i];
+        if (f->msgId == MQTT_INFLIGHT_FREE || f->msgId == MQTT_INFLIGHT_PENDING) {
+            busy |= (f->msgId == MQTT_INFLIGHT_PENDING);
+            continue;
+        }
+        if (f->qos == 0 && outbox == 0) {
+            res[count] = ESP_OK;
+        } else if (now > f->deadlineUs) {
+            ESP_LOGW(TAG, "publish timeout, msg_id=%d qos=%d outbox=%d", f->msgId, f->qos, outbox);
+            res[count] = ESP_FAIL;
+        } else {
+            busy = true;
+            continue;
+        }
+        mqtt_inflight_take(m, i, &done[count++]);
+    }
+    xSemaphoreGive(m->mutex);
+
+    for (i = 0; i < count; i++) {
+        mqtt_inflight_finish(m, &done[i], res[i]);
+    }
+    if (!busy) {
+        esp_timer_stop(m->outboxTimer);
+    }
+}
+
+/**
+ * Publish a queueNode_t as JSON via MQTT without waiting for delivery.
+ * Blocks only while all in-flight slots are taken.
  * @param node Queue node containing image data
- * @return ESP_OK on success, ESP_FAIL on error
+ * @param cb Completion callback, called exactly once if ESP_OK is returned
+ * @param arg Completion callback argument
+ * @return ESP_OK if the publish was queued, ESP_FAIL on error (cb not called)
  */
-esp_err_t mqtt_publish_node(queueNode_t *node)
+esp_err_t mqtt_publish_node_async(queueNode_t *node, mqtt_publish_done_cb cb, void *arg)
 {
+    int i;
+    int idx = -1;
+    int msg_id;
+    mqttAttr_t mqtt;
+
     if (!g_MQ.isConnected) {
         return ESP_FAIL;
     }
+    if (xSemaphoreTake(g_MQ.inflightSem, pdMS_TO_TICKS(MQTT_PUBLISHED_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "no free in-flight slot");
+        return ESP_FAIL;
+    }
 
     char *json_str = push_build_json_payload(node);
     if (json_str == NULL) {
+        xSemaphoreGive(g_MQ.inflightSem);
         return ESP_FAIL;
     }
+    g_sned_total += 1;
 
-    esp_err_t res;
     if (iot_mip_dm_is_enable()) {
-        res = iot_mip_dm_uplink_picture(json_str);
-    } else {
-        mqttAttr_t mqtt;
-        cfg_get_mqtt_attr(&mqtt);
-        res = esp_mqtt_client_publish(g_MQ.client, mqtt.topic, json_str, 0, mqtt.qos, 0);
-        if (mqtt.qos == 0) {
-            vTaskDelay(pdMS_TO_TICKS(500));
+        // DM uplink goes over HTTP and is complete when it returns
+        esp_err_t res = iot_mip_dm_uplink_picture(json_str) < 0 ? ESP_FAIL : ESP_OK;
+        cJSON_free(json_str);
+        xSemaphoreGive(g_MQ.inflightSem);
+        if (res != ESP_OK) {
+            return ESP_FAIL;
         }
+        g_sned_success += 1;
+        if (cb) {
+            cb(node, ESP_OK, arg);
+        }
+        return ESP_OK;
     }
-    cJSON_free(json_str);
 
-    if (res < 0) {
+    cfg_get_mqtt_attr(&mqtt);
+    xSemaphoreTake(g_MQ.mutex, portMAX_DELAY);
+    for (i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (g_MQ.inflight[i].msgId == MQTT_INFLIGHT_FREE) {
+            idx = i;
+            g_MQ.inflight[i].msgId = MQTT_INFLIGHT_PENDING;
+            break;
+        }
+    }
+    xSemaphoreGive(g_MQ.mutex);
+    assert(idx >= 0);
+
+    // Enqueue (store) so QoS0 is tracked by the outbox too; the MQTT task does the sending
+    msg_id = esp_mqtt_client_enqueue(g_MQ.client, mqtt.topic, json_str, 0, mqtt.qos, 0, true);
+    cJSON_free(json_str);
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "enqueue failed %d", msg_id);
+        xSemaphoreTake(g_MQ.mutex, portMAX_DELAY);
+        g_MQ.inflight[idx].msgId = MQTT_INFLIGHT_FREE;
+        xSemaphoreGive(g_MQ.mutex);
+        xSemaphoreGive(g_MQ.inflightSem);
         return ESP_FAIL;
     }
 
-    // For QoS > 0 and non-MIP, wait for publish ACK
-    mqttAttr_t mqtt;
-    cfg_get_mqtt_attr(&mqtt);
-    if (mqtt.qos == 0 || iot_mip_dm_is_enable()) {
-        return ESP_OK;
+    bool acked = false;
+    xSemaphoreTake(g_MQ.mutex, portMAX_DELAY);
+    g_MQ.inflight[idx].qos = mqtt.qos;
+    g_MQ.inflight[idx].startUs = esp_timer_get_time();
+    g_MQ.inflight[idx].deadlineUs = g_MQ.inflight[idx].startUs + MQTT_PUBLISHED_TIMEOUT_MS * 1000LL;
+    g_MQ.inflight[idx].node = node;
+    g_MQ.inflight[idx].cb = cb;
+    g_MQ.inflight[idx].arg = arg;
+    g_MQ.inflight[idx].msgId = msg_id;
+    for (i = 0; mqtt.qos > 0 && i < MQTT_INFLIGHT_MAX; i++) {
+        if (g_MQ.earlyAck[i].msgId == msg_id && g_MQ.earlyAck[i].expireUs >= g_MQ.inflight[idx].startUs) {
+            g_MQ.earlyAck[i].msgId = 0;
+            acked = true;
+            break;
+        }
     }
+    xSemaphoreGive(g_MQ.mutex);
+    ESP_LOGI(TAG, "publish queued, msg_id=%d qos=%d", msg_id, mqtt.qos);
 
-    EventBits_t uxBits = xEventGroupWaitBits(g_MQ.eventGroup, MQTT_PUBLISHED_BIT, true, true,
-                                              pdMS_TO_TICKS(MQTT_PUBLISHED_TIMEOUT_MS));
-    return (uxBits & MQTT_PUBLISHED_BIT) ? ESP_OK : ESP_FAIL;
+    if (acked) {
+        mqtt_inflight_complete(&g_MQ, idx, ESP_OK);
+    } else if (!esp_timer_is_active(g_MQ.outboxTimer)) {
+        esp_timer_start_periodic(g_MQ.outboxTimer, MQTT_OUTBOX_POLL_MS * 1000);
+    }
+    return ESP_OK;
 }
 
 /**
@@ -431,9 +706,23 @@ static esp_console_cmd_t g_cmd[] = {
 
 void mqtt_open(void)
 {
+    int i;
+
     memset(&g_MQ, 0, sizeof(mdMqtt_t));
     g_MQ.eventGroup = xEventGroupCreate();
     g_MQ.mutex = xSemaphoreCreateMutex();
+    g_MQ.inflightSem = xSemaphoreCreateCounting(MQTT_INFLIGHT_MAX, MQTT_INFLIGHT_MAX);
+    for (i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        g_MQ.inflight[i].msgId = MQTT_INFLIGHT_FREE;
+    }
+    const esp_timer_create_args_t timer_args = {
+        mqtt_outbox_timer_cb,
+        &g_MQ,
+        ESP_TIMER_TASK,
+        "mqtt_outbox",
+        true,
+    };
+    esp_timer_create(&timer_args, &g_MQ.outboxTimer);
     g_MQ.sendBuf = malloc(PUSH_SEND_BUFFER_SIZE);
     assert(g_MQ.sendBuf);
     g_MQ.sendBufSize = PUSH_SEND_BUFFER_SIZE;
@@ -456,6 +745,11 @@ void mqtt_start()
 
 void mqtt_stop()
 {
+    // Settle in-flight publishes before the client (and its outbox) goes away
+    if (g_MQ.outboxTimer) {
+        esp_timer_stop(g_MQ.outboxTimer);
+    }
+    mqtt_inflight_fail_all(&g_MQ);
     if (iot_mip_dm_is_enable()) {
         iot_mip_dm_stop();
     } else {
@@ -473,6 +767,11 @@ void mqtt_restart()
 
 void mqtt_close(void)
 {
+    if (g_MQ.outboxTimer) {
+        esp_timer_stop(g_MQ.outboxTimer);
+        esp_timer_delete(g_MQ.outboxTimer);
+        g_MQ.outboxTimer = NULL;
+    }
     if (g_MQ.sendBuf) {
         free(g_MQ.sendBuf);
         g_MQ.sendBuf = NULL;
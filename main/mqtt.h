@@ -18,6 +18,9 @@ extern "C" {
 // Send buffer size for JSON payload construction (shared with push.c)
 #define PUSH_SEND_BUFFER_SIZE  (1536000)
 
+// In-flight image publishes tracked for completion, at most this many completion callbacks are pending
+#define MQTT_INFLIGHT_MAX 3
+
 /**
  * Initialize MQTT module (allocates send buffer, no queue management)
  */
@@ -44,11 +47,23 @@ void mqtt_stop(void);
 void mqtt_restart(void);
 
 /**
- * Publish a queueNode_t as JSON via MQTT
+ * Completion callback of mqtt_publish_node_async().
+ * Runs on the MQTT event task or the esp_timer task, keep it short.
+ * @param node Queue node that was published
+ * @param res ESP_OK once acked (QoS1/2) or flushed from the outbox (QoS0),
+ *            ESP_FAIL on disconnect or timeout
+ * @param arg User argument
+ */
+typedef void (*mqtt_publish_done_cb)(queueNode_t *node, esp_err_t res, void *arg);
+
+/**
+ * Publish a queueNode_t as JSON via MQTT without waiting for delivery
  * @param node Queue node containing image data
- * @return ESP_OK on success, ESP_FAIL on error
+ * @param cb Completion callback, called exactly once when ESP_OK is returned
+ * @param arg Completion callback argument
+ * @return ESP_OK if queued, ESP_FAIL on error (cb is not called)
  */
-esp_err_t mqtt_publish_node(queueNode_t *node);
+esp_err_t mqtt_publish_node_async(queueNode_t *node, mqtt_publish_done_cb cb, void *arg);
 
 /**
  * Build JSON payload string from a queueNode_t.
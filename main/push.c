@@ -6,6 +6,7 @@
  */
 #include <string.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
@@ -18,6 +19,8 @@
 #include "storage.h"
 #include "iot_mip.h"
 #include "camera.h"
+#include "debug.h"
+#include "energy.h"
 
 #define TAG "-->PUSH"
 
@@ -26,14 +29,58 @@
 
 #define PUSH_READY_TIMEOUT_MS 90000
 
+// Nodes drained from the input queue and waiting to be dispatched by priority
+#define PUSH_PENDING_MAX 8
+// Completions posted back to push_task. push_task drains them before every dispatch, so at most
+// the publishes in flight at the drain and the one dispatched after it complete in between
+#define PUSH_DONE_MAX (MQTT_INFLIGHT_MAX + 1)
+
+/**
+ * Dispatch priority, lower value is sent first
+ */
+typedef enum pushPrio {
+    PUSH_PRIO_LIVE_EVENT = 0,   ///< Fresh alarm-in/PIR/button frame
+    PUSH_PRIO_LIVE_TIMER,       ///< Fresh timer frame
+    PUSH_PRIO_STORED_EVENT,     ///< Backlog event frame from flash
+    PUSH_PRIO_STORED_TIMER,     ///< Backlog timer frame from flash
+    PUSH_PRIO_MAX,
+} pushPrio_e;
+
+/**
+ * Dispatch-to-done latency per priority class
+ */
+typedef struct pushLatency {
+    uint32_t count;
+    uint32_t sumMs;
+    uint32_t maxMs;
+} pushLatency_t;
+
+/**
+ * Push completion, handed from the MQTT callbacks to push_task
+ */
+typedef struct pushDone {
+    queueNode_t *node;
+    esp_err_t res;
+} pushDone_t;
+
 static EventGroupHandle_t g_eventGroup = NULL;
 static QueueHandle_t g_in = NULL;
+static QueueHandle_t g_done = NULL;
 static QueueHandle_t g_out = NULL;
 static TaskHandle_t g_taskHandle = NULL;
 static bool g_isRunning = false;
 
 static RTC_DATA_ATTR int g_send_total = 0;
 static RTC_DATA_ATTR int g_send_success = 0;
+static RTC_DATA_ATTR pushLatency_t g_latency[PUSH_PRIO_MAX];
+
+static queueNode_t *g_pending[PUSH_PENDING_MAX];
+static int g_pendingCnt = 0;
+static volatile int g_liveCnt = 0;   // Camera nodes received but not finished yet
+static volatile bool g_scheduledUpload = false;  // Scheduled upload merged into this wake
+static portMUX_TYPE g_statLock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *g_prioName[PUSH_PRIO_MAX] = {"live-event", "live-timer", "stored-event", "stored-timer"};
 
 static uint8_t get_push_mode(void)
 {
@@ -42,77 +89,239 @@ static uint8_t get_push_mode(void)
     return mode;
 }
 
+static pushPrio_e push_node_prio(const queueNode_t *node)
+{
+    bool event = node->type != SNAP_TIMER;
+    if (node->from == FROM_CAMERA) {
+        return event ? PUSH_PRIO_LIVE_EVENT : PUSH_PRIO_LIVE_TIMER;
+    }
+    return event ? PUSH_PRIO_STORED_EVENT : PUSH_PRIO_STORED_TIMER;
+}
+
+/**
+ * Account a node leaving the dispatcher
+ * @param node Queue node
+ * @param pushed true if a push was attempted, false if it went straight to storage
+ */
+static void push_node_leave(queueNode_t *node, bool pushed)
+{
+    pushPrio_e prio = push_node_prio(node);
+
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - node->dispatch_us) / 1000);
+
+    // Read from other tasks by pushstat and push_live_pending
+    portENTER_CRITICAL(&g_statLock);
+    if (pushed) {
+        g_latency[prio].count += 1;
+        g_latency[prio].sumMs += ms;
+        if (ms > g_latency[prio].maxMs) {
+            g_latency[prio].maxMs = ms;
+        }
+    }
+    if (node->from == FROM_CAMERA) {
+        g_liveCnt--;
+    }
+    portEXIT_CRITICAL(&g_statLock);
+    if (pushed) {
+        ESP_LOGI(TAG, "%s latency %lu ms", g_prioName[prio], ms);
+    }
+}
+
+/**
+ * Hand a node back once its push has finished
+ * @param node Queue node
+ * @param res Push result
+ */
+static void push_node_done(queueNode_t *node, esp_err_t res)
+{
+    push_node_leave(node, true);
+    if (res != ESP_OK) {
+        if (g_out) {
+            ESP_LOGI(TAG, "PUSH FAIL, save to flash");
+            xQueueSend(g_out, &node, portMAX_DELAY);
+        } else {
+            ESP_LOGW(TAG, "PUSH FAIL, no storage queue");
+            node->free_handler(node, EVENT_FAIL);
+        }
+    } else {
+        ESP_LOGI(TAG, "PUSH SUCCESS");
+        node->free_handler(node, EVENT_OK);
+        g_send_success += 1;
+    }
+}
+
+/**
+ * MQTT completion, runs on the esp_timer or MQTT event task: the save or free
+ * is left to push_task. g_done has room for every completion that can be
+ * pending, the send does not wait, but it never drops a node either
+ */
+static void push_mqtt_done_cb(queueNode_t *node, esp_err_t res, void *arg)
+{
+    pushDone_t done = {node, res};
+    queueNode_t *wake = NULL;
+
+    xQueueSend(g_done, &done, portMAX_DELAY);
+    // A NULL node wakes push_task if it is blocked on the input queue
+    xQueueSendToFront(g_in, &wake, 0);
+}
+
+/**
+ * Finish the pushes whose completion was posted by push_mqtt_done_cb
+ */
+static void push_done_drain(void)
+{
+    pushDone_t done;
+
+    while (xQueueReceive(g_done, &done, 0)) {
+        push_node_done(done.node, done.res);
+    }
+}
+
+/**
+ * Take the most urgent pending node: lowest priority class first,
+ * then the one that has waited longest
+ * @return Node, or NULL if nothing is pending
+ */
+static queueNode_t *push_pending_take(void)
+{
+    int i;
+    int best = -1;
+
+    for (i = 0; i < g_pendingCnt; i++) {
+        if (best < 0) {
+            best = i;
+            continue;
+        }
+        pushPrio_e a = push_node_prio(g_pending[i]);
+        pushPrio_e b = push_node_prio(g_pending[best]);
+        if (a < b || (a == b && g_pending[i]->dispatch_us < g_pending[best]->dispatch_us)) {
+            best = i;
+        }
+    }
+    if (best < 0) {
+        return NULL;
+    }
+    queueNode_t *node = g_pending[best];
+    g_pendingCnt--;
+    memmove(&g_pending[best], &g_pending[best + 1], (g_pendingCnt - best) * sizeof(queueNode_t *));
+    return node;
+}
+
+static void push_dispatch(queueNode_t *node)
+{
+    // Correct timestamp if not NTP-synced
+    if (node->from == FROM_CAMERA && node->ntp_sync_flag == 0) {
+        node->pts = node->pts + (system_get_time_delta() * 1000);
+        node->ntp_sync_flag = system_get_ntp_sync_flag();
+    }
+
+    uploadAttr_t upload;
+    cfg_get_upload_attr(&upload);
+    modeSel_e currentMode = system_get_mode();
+
+    if (upload.uploadMode == 0 || currentMode == MODE_UPLOAD || g_scheduledUpload) {
+        ESP_LOGI(TAG, "PUSH %s ... (mode: %d, pushMode: %d)", g_prioName[push_node_prio(node)],
+                 currentMode, get_push_mode());
+        energy_add_tx_bytes(node->len * 4 / 3);  // image goes out base64 encoded
+
+        if (get_push_mode() == 1) {
+            // Webhook mode
+            esp_err_t res = ESP_FAIL;
+            char *json_str = push_build_json_payload(node);
+            if (json_str != NULL) {
+                res = (webhook_publish(json_str) == 0) ? ESP_OK : ESP_FAIL;
+                cJSON_free(json_str);
+            }
+            push_node_done(node, res);
+        } else {
+            // MQTT mode: node is released from push_mqtt_done_cb once the bytes are out
+            if (mqtt_publish_node_async(node, push_mqtt_done_cb, NULL) != ESP_OK) {
+                push_node_done(node, ESP_FAIL);
+            }
+        }
+    } else {
+        ESP_LOGI(TAG, "PUSH SKIP (mode: %d, uploadMode: %d)", currentMode, upload.uploadMode);
+        push_node_leave(node, false);
+        if (g_out) {
+            xQueueSend(g_out, &node, portMAX_DELAY);
+        } else {
+            ESP_LOGW(TAG, "No storage queue for scheduled upload");
+            node->free_handler(node, EVENT_FAIL);
+        }
+    }
+    g_send_total += 1;
+}
+
 static void push_task(void *arg)
 {
     xEventGroupWaitBits(g_eventGroup, PUSH_READY_BIT | PUSH_EXIT_BIT, true, false, PUSH_READY_TIMEOUT_MS);
     ESP_LOGI(TAG, "push task started, mode=%s", get_push_mode() == 1 ? "Webhook" : "MQTT");
     while (true) {
         queueNode_t *node;
-        if (xQueueReceive(g_in, &node, portMAX_DELAY)) {
-            // Correct timestamp if not NTP-synced
-            if (node->from == FROM_CAMERA && node->ntp_sync_flag == 0) {
-                node->pts = node->pts + (system_get_time_delta() * 1000);
-                node->ntp_sync_flag = system_get_ntp_sync_flag();
+        // Drain everything that is queued so a fresh event frame can overtake backlog
+        TickType_t wait = g_pendingCnt ? 0 : portMAX_DELAY;
+        while (g_pendingCnt < PUSH_PENDING_MAX && xQueueReceive(g_in, &node, wait)) {
+            wait = 0;
+            if (node == NULL) {
+                continue;   // Completion wake-up
             }
-
-            uploadAttr_t upload;
-            cfg_get_upload_attr(&upload);
-            modeSel_e currentMode = system_get_mode();
-
-            if (upload.uploadMode == 0 || currentMode == MODE_UPLOAD) {
-                ESP_LOGI(TAG, "PUSH ... (mode: %d, pushMode: %d)", currentMode, get_push_mode());
-
-                esp_err_t res = ESP_FAIL;
-                if (get_push_mode() == 1) {
-                    // Webhook mode
-                    char *json_str = push_build_json_payload(node);
-                    if (json_str != NULL) {
-                        res = (webhook_publish(json_str) == 0) ? ESP_OK : ESP_FAIL;
-                        cJSON_free(json_str);
-                    }
-                } else {
-                    // MQTT mode
-                    res = mqtt_publish_node(node);
-                }
-
-                if (res != ESP_OK) {
-                    if (g_out) {
-                        ESP_LOGI(TAG, "PUSH FAIL, save to flash");
-                        xQueueSend(g_out, &node, portMAX_DELAY);
-                    } else {
-                        ESP_LOGW(TAG, "PUSH FAIL, no storage queue");
-                        node->free_handler(node, EVENT_FAIL);
-                    }
-                } else {
-                    ESP_LOGI(TAG, "PUSH SUCCESS");
-                    node->free_handler(node, EVENT_OK);
-                    g_send_success += 1;
-                }
-            } else {
-                ESP_LOGI(TAG, "PUSH SKIP (mode: %d, uploadMode: %d)", currentMode, upload.uploadMode);
-                if (g_out) {
-                    xQueueSend(g_out, &node, portMAX_DELAY);
-                } else {
-                    ESP_LOGW(TAG, "No storage queue for scheduled upload");
-                    node->free_handler(node, EVENT_FAIL);
-                }
+            node->dispatch_us = esp_timer_get_time();
+            if (node->from == FROM_CAMERA) {
+                portENTER_CRITICAL(&g_statLock);
+                g_liveCnt++;
+                portEXIT_CRITICAL(&g_statLock);
             }
-            g_send_total += 1;
+            g_pending[g_pendingCnt++] = node;
+        }
+        push_done_drain();
+        node = push_pending_take();
+        if (node) {
+            push_dispatch(node);
         }
     }
     xEventGroupClearBits(g_eventGroup, PUSH_READY_BIT);
 }
 
+static int do_pushstat_cmd(int argc, char **argv)
+{
+    int i;
+
+    ESP_LOGI(TAG, "Push: %d/%d, pending %d, live %d", g_send_success, g_send_total, g_pendingCnt, g_liveCnt);
+    for (i = 0; i < PUSH_PRIO_MAX; i++) {
+        ESP_LOGI(TAG, "%-12s cnt %lu avg %lu ms max %lu ms", g_prioName[i], g_latency[i].count,
+                 g_latency[i].count ? g_latency[i].sumMs / g_latency[i].count : 0, g_latency[i].maxMs);
+    }
+    return ESP_OK;
+}
+
+static esp_console_cmd_t g_cmd[] = {
+    ESP_CONSOLE_CMD_INIT("pushstat", "push latency per priority class", NULL, do_pushstat_cmd, NULL),
+};
+
+bool push_live_pending(void)
+{
+    return g_liveCnt > 0;
+}
+
+void push_set_scheduled_upload(void)
+{
+    g_scheduledUpload = true;
+}
+
 void push_open(QueueHandle_t in, QueueHandle_t out)
 {
     g_in = in;
     g_out = out;
+    if (g_done == NULL) {
+        g_done = xQueueCreate(PUSH_DONE_MAX, sizeof(pushDone_t));
+    }
 
     mqtt_open();
     webhook_open();
     g_eventGroup = xEventGroupCreate();
     xEventGroupClearBits(g_eventGroup, PUSH_READY_BIT | PUSH_EXIT_BIT);
     xTaskCreatePinnedToCore(push_task, TAG, 8 * 1024, NULL, 4, &g_taskHandle, 1);
+    debug_cmd_add(g_cmd, sizeof(g_cmd) / sizeof(esp_console_cmd_t));
     g_isRunning = true;
 }
 
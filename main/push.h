@@ -1,6 +1,7 @@
 #ifndef __PUSH_H__
 #define __PUSH_H__
 
+#include <stdbool.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 
@@ -16,6 +17,19 @@ void push_exit(void);
 void push_close(void);
 void push_restart(void);
 
+/**
+ * Check whether freshly captured frames are still waiting to be pushed.
+ * Backlog uploads yield between files while this is true.
+ * @return true if live frames are pending or in flight
+ */
+bool push_live_pending(void);
+
+/**
+ * Push stored frames as in upload mode until the next boot, for a scheduled
+ * upload merged into a snapshot or schedule wake. Call before the network opens.
+ */
+void push_set_scheduled_upload(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,6 +15,7 @@
 #include "freertos/semphr.h"
 
 #include "storage.h"
+#include "utils.h"
 #include "session_log.h"
 
 #define TAG_SESSION_LOG "session_log"
@@ -25,6 +26,10 @@ static FILE *s_log_fp;
 static SemaphoreHandle_t s_log_mutex;
 static vprintf_like_t s_prev_vprintf;
 static bool s_inited;
+/* Logs captured in RAM between session_log_begin() and the (deferred) file open */
+static char s_early_buf[SESSION_LOG_EARLY_BUF_SIZE];
+static size_t s_early_len;
+static bool s_early_on;
 
 static void session_log_build_path(char *buf, size_t buflen, int slot)
 {
@@ -36,7 +41,7 @@ static void session_log_build_path(char *buf, size_t buflen, int slot)
  * session_log_0 -> _1, _1 -> _2, delete previous _2, then open new _0.
  */
 /** First line of each boot log file: wall-clock date/time (may be unset before NTP). */
-static void session_log_write_boot_first_line(void)
+static void session_log_write_boot_first_line(FILE *fp)
 {
     time_t ts = time(NULL);
     char tbuf[48];
@@ -49,8 +54,7 @@ static void session_log_write_boot_first_line(void)
         tbuf[sizeof(tbuf) - 1] = '\0';
     }
 
-    fprintf(s_log_fp, "===== boot log start: %s =====\n", tbuf);
-    fflush(s_log_fp);
+    fprintf(fp, "===== boot log start: %s =====\n", tbuf);
 }
 
 static void session_log_rotate_boot_files(void)
@@ -82,44 +86,80 @@ static int session_log_vprintf(const char *fmt, va_list args)
     ret = s_prev_vprintf ? s_prev_vprintf(fmt, copy) : vprintf(fmt, copy);
     va_end(copy);
 
-    if (s_log_fp && s_log_mutex) {
+    if ((s_log_fp || s_early_on) && s_log_mutex) {
         if (xSemaphoreTakeRecursive(s_log_mutex, portMAX_DELAY) == pdTRUE) {
             va_copy(copy, args);
-            (void)vfprintf(s_log_fp, fmt, copy);
+            if (s_log_fp) {
+                (void)vfprintf(s_log_fp, fmt, copy);
+                (void)fflush(s_log_fp);
+            } else if (s_early_on && s_early_len < sizeof(s_early_buf) - 1) {
+                int n = vsnprintf(s_early_buf + s_early_len, sizeof(s_early_buf) - s_early_len, fmt, copy);
+                if (n > 0) {
+                    s_early_len = MIN(s_early_len + n, sizeof(s_early_buf) - 1);
+                }
+            }
             va_end(copy);
-            (void)fflush(s_log_fp);
             xSemaphoreGiveRecursive(s_log_mutex);
         }
     }
     return ret;
 }
 
+void session_log_begin(void)
+{
+    if (s_log_mutex) {
+        return;
+    }
+    s_log_mutex = xSemaphoreCreateRecursiveMutex();
+    if (!s_log_mutex) {
+        ESP_LOGE(TAG_SESSION_LOG, "mutex create failed");
+        return;
+    }
+    s_early_len = 0;
+    s_early_on = true;
+    s_prev_vprintf = esp_log_set_vprintf(session_log_vprintf);
+}
+
 void session_log_init(void)
 {
     char path[72];
+    FILE *fp;
 
     if (s_inited) {
         return;
     }
     s_inited = true;
 
-    s_log_mutex = xSemaphoreCreateRecursiveMutex();
+    session_log_begin();
     if (!s_log_mutex) {
-        ESP_LOGE(TAG_SESSION_LOG, "mutex create failed");
         return;
     }
 
+    /* Rotate and open without the mutex, lines logged meanwhile keep going to the early buffer */
     session_log_rotate_boot_files();
     session_log_build_path(path, sizeof(path), SESSION_LOG_SLOT_CURRENT);
-    s_log_fp = fopen(path, "w");
-    if (!s_log_fp) {
+    fp = fopen(path, "w");
+    if (fp) {
+        session_log_write_boot_first_line(fp);
+    }
+
+    xSemaphoreTakeRecursive(s_log_mutex, portMAX_DELAY);
+    if (fp && s_early_len) {
+        fwrite(s_early_buf, 1, s_early_len, fp);
+    }
+    if (fp) {
+        fflush(fp);
+    }
+    s_log_fp = fp;
+    s_early_on = false;
+    s_early_len = 0;
+    xSemaphoreGiveRecursive(s_log_mutex);
+
+    if (!fp) {
         ESP_LOGE(TAG_SESSION_LOG, "open %s failed", path);
         return;
     }
 
-    session_log_write_boot_first_line();
-
-    s_prev_vprintf = esp_log_set_vprintf(session_log_vprintf);
     ESP_LOGI(TAG_SESSION_LOG,
              "Session log: %s (keeping last %d boots, slot 0 = this boot)",
              path, SESSION_LOG_BOOT_SLOTS);
@@ -166,12 +206,14 @@ void session_log_resume_after_stat(bool paused)
     if (!paused) {
         return;
     }
-    /* Reopen slot0 for this boot and continue mirroring logs. */
+    /* Reopen slot0 for this boot and continue mirroring logs, unless session_log_init() has not opened it yet. */
     char path[72];
-    session_log_build_path(path, sizeof(path), SESSION_LOG_SLOT_CURRENT);
-    s_log_fp = fopen(path, "a");
-    if (!s_log_fp) {
-        ESP_LOGE(TAG_SESSION_LOG, "resume open %s failed", path);
+    if (!s_early_on) {
+        session_log_build_path(path, sizeof(path), SESSION_LOG_SLOT_CURRENT);
+        s_log_fp = fopen(path, "a");
+        if (!s_log_fp) {
+            ESP_LOGE(TAG_SESSION_LOG, "resume open %s failed", path);
+        }
     }
     xSemaphoreGiveRecursive(s_log_mutex);
 }
@@ -181,6 +223,8 @@ void session_log_close_for_sleep(void)
     if (!s_log_mutex) {
         return;
     }
+    /* Sleep-only boots return before the boot steps, write out their early lines */
+    session_log_init();
     if (xSemaphoreTakeRecursive(s_log_mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
         return;
     }
@@ -260,8 +304,10 @@ esp_err_t session_log_http_export(httpd_req_t *req)
     }
 
     if (!any) {
-        session_log_build_path(path, sizeof(path), SESSION_LOG_SLOT_CURRENT);
-        s_log_fp = fopen(path, "a");
+        if (!s_early_on) {
+            session_log_build_path(path, sizeof(path), SESSION_LOG_SLOT_CURRENT);
+            s_log_fp = fopen(path, "a");
+        }
         xSemaphoreGiveRecursive(s_log_mutex);
         httpd_resp_set_status(req, "404 Not Found");
         httpd_resp_set_type(req, "text/plain");
@@ -299,10 +345,12 @@ esp_err_t session_log_http_export(httpd_req_t *req)
     }
 
 reopen:
-    session_log_build_path(path, sizeof(path), SESSION_LOG_SLOT_CURRENT);
-    s_log_fp = fopen(path, "a");
-    if (!s_log_fp) {
-        ESP_LOGE(TAG_SESSION_LOG, "reopen %s for append failed", path);
+    if (!s_early_on) {
+        session_log_build_path(path, sizeof(path), SESSION_LOG_SLOT_CURRENT);
+        s_log_fp = fopen(path, "a");
+        if (!s_log_fp) {
+            ESP_LOGE(TAG_SESSION_LOG, "reopen %s for append failed", path);
+        }
     }
 
     if (httpd_resp_send_chunk(req, NULL, 0) != ESP_OK) {
@@ -9,13 +9,25 @@
 #define SESSION_LOG_BOOT_SLOTS 5
 #endif
 
+/** RAM kept for log lines written before session_log_init() opens the file. */
+#ifndef SESSION_LOG_EARLY_BUF_SIZE
+#define SESSION_LOG_EARLY_BUF_SIZE 4096
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * Start mirroring ESP_LOG output into a RAM buffer. Cheap enough for the boot critical path;
+ * the buffer is written out when session_log_init() opens the file.
+ */
+void session_log_begin(void);
+
 /**
  * Rotate session_log_{0..N-1}.txt (drop oldest), then open session_log_0.txt for this boot
- * and mirror ESP_LOG output to it (and UART).
+ * and mirror ESP_LOG output to it (and UART). Early lines from session_log_begin() go first.
+ * Logging does not wait for the rotation, only for the switch from the early buffer to the file.
  */
 void session_log_init(void);
 
@@ -39,6 +51,7 @@ void session_log_resume_after_stat(bool paused);
 
 /**
  * Close writer before deep sleep (flush+fsync+fclose). No reopen.
+ * Runs session_log_init() first if no boot step did, so the early lines of sleep-only boots are kept.
  */
 void session_log_close_for_sleep(void);
 
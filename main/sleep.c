@@ -14,9 +14,13 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_sleep.h"
+#include "esp_wake_stub.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "driver/rtc_io.h"
 #include "soc/rtc.h"
+#include "soc/rtc_cntl_reg.h"
+#include "esp_private/esp_clk.h"
 #include "sleep.h"
 #include "config.h"
 #include "utils.h"
@@ -29,31 +33,71 @@
 #include "pir.h"
 #include "net_module.h"
 #include "session_log.h"
+#include "energy.h"
+#include "debug.h"
+#include "rtc_drift.h"
+#include "wake_calendar.h"
+#include "wake_stub.h"
 
 #define TAG "-->SLEEP"  // Logging tag
 
-#define SLEEP_WAIT_TIMEOUT_MS (30*60*1000) // 30 minute timeout
+#define SLEEP_WAIT_TIMEOUT_MS (30*60*1000) // 30 minute backstop for leaked keep-awake tokens
+#define SLEEP_TOKEN_MAX 16                 // Concurrent keep-awake tokens
+#define SLEEP_HOLDER_MAX 16                // Distinct holder names tracked for diagnostics
+#define SLEEP_HOLDER_TOP 3                 // Holders reported before sleeping
+#define SLEEP_HOLDER_LOG_MS (60*1000)      // Report active holders while waiting this long
+#define SLEEP_TOKEN_CHANGED_BIT BIT(0)     // A token was released
 #define uS_TO_S_FACTOR 1000000ULL          // Microseconds to seconds conversion
 
 
-#define MAX_HISTORY   5      // Keep last 5 error records
-#define WRITE_CFG_CNT 10    // Every 20 records are written to config.
-#define ALPHA 0.4f  // Error value smoothing factor (0-1), the larger the value, the higher the weight of recent data
+#define WRITE_CFG_CNT 10                   // Save the drift model every 10 samples
+#define SLEEP_SLEPT_MAX_S (31*24*60*60)    // Longer sleeps are a broken clock, not drift
+
+#define SLEEP_CAPTURE_LATE_S 30            // Timed captures may run this late, never early
+#define SLEEP_UPLOAD_WINDOW_S (15*60)      // Scheduled uploads may run this early or late
+#define SLEEP_SCHEDULE_WINDOW_S (30*60)    // Device management may run this early or late
+
+/**
+ * Clock state since the last NTP sync, kept in RTC memory
+ * At the next sync the RTC error over it becomes one drift model sample
+ */
+typedef struct sleepClock {
+    time_t syncReal;                          // Real time of the last sync, 0 before the first
+    int64_t sleepStartUs;                     // System time the last sleep started, 0 when none
+    float corrS;                              // Corrections applied to the clock at boot since the sync
+    rtcDriftSpan_t span;                      // Sleeps since the sync
+    int batteryMv;                            // Last battery reading, 0 before the first
+    uint8_t bucket;                           // Conditions of the current sleep
+} sleepClock_t;
+
+/**
+ * Active keep-awake token slot
+ */
+typedef struct sleepHold {
+    const char *name;      // Holder name, NULL when the slot is free
+    uint32_t seq;          // Sequence number encoded in the token handle
+    int64_t acquiredUs;    // Acquire time
+    int64_t deadlineUs;    // Auto-release time, 0 for none
+} sleepHold_t;
+
+/**
+ * Accumulated hold time per holder name
+ */
+typedef struct sleepHolder {
+    const char *name;      // Holder name
+    int64_t heldUs;        // Total time held this boot
+    uint32_t count;        // Number of acquisitions
+} sleepHolder_t;
 
-/* Time compensation controller structure
- * Maintains timing references and error history for drift compensation */
-typedef struct {
-    time_t real_prev;       // Last synchronized real time
-    float errors[MAX_HISTORY]; // Error rate history (circular buffer)
-    int err_index;         // Current index in error buffer
-    int err_count;         // Valid error records count
-    uint32_t total_count;         // Total records count
-} TimeCompensator;
 /**
  * Sleep module state structure
  */
 typedef struct mdSleep {
-    EventGroupHandle_t eventGroup;  // Event group for sleep synchronization
+    EventGroupHandle_t eventGroup;            // Signals token releases to the waiter
+    sleepHold_t holds[SLEEP_TOKEN_MAX];       // Active tokens
+    sleepHolder_t holders[SLEEP_HOLDER_MAX];  // Per-name hold statistics
+    uint32_t seq;                             // Last issued sequence number
+    uint8_t holdCount;                        // Number of active tokens
 } mdSleep_t;
 
 // RTC memory preserved variables
@@ -62,194 +106,197 @@ static RTC_DATA_ATTR time_t g_lastCapTime = 0;          // Timestamp of last cap
 static RTC_DATA_ATTR time_t g_lastUploadTime = 0;       // Timestamp of last upload
 static RTC_DATA_ATTR time_t g_lastScheduleTime = 0;      // Timestamp of last schedule
 static RTC_DATA_ATTR time_t g_willWakeupTime = 0;       // Timestamp of will wakeup
-static RTC_DATA_ATTR TimeCompensator g_TimeCompensator = {0};
+static RTC_DATA_ATTR rtcDrift_t g_drift = {0};              // RTC drift model
+static RTC_DATA_ATTR sleepClock_t g_clock = {0};            // Clock state since the last sync
+static RTC_DATA_ATTR wakeCalendar_t g_calendar = {0};       // Jobs of the timer wakes
+static RTC_DATA_ATTR wakeStubState_t g_stub = {0};          // Early timer wakes the wake stub sleeps through
 
 static mdSleep_t g_sleep = {0};  // Global sleep state
+static portMUX_TYPE g_sleepLock = portMUX_INITIALIZER_UNLOCKED;  // Guards token table
+static time_t g_wakeTarget = 0;  // Target of the timer wake that started this boot, 0 otherwise
+static bool g_wakeCounted = false;  // A calendar job already ran this boot
 
-/* Initialize compensation controller */
-void comp_init()
+/**
+ * Save the drift model, and the global rate in the old format for older firmware
+ */
+static void comp_save(void)
 {
-    int32_t err_rate;
-    g_TimeCompensator.real_prev = 0;
-    g_TimeCompensator.err_index = 0;
-    g_TimeCompensator.err_count = 0;
-    g_TimeCompensator.total_count = 0;
-    for(int i=0; i<MAX_HISTORY; i++) g_TimeCompensator.errors[i] = 0;
+    rtcDriftPrediction_t p;
 
-    cfg_get_time_err_rate(&err_rate);
-    if(err_rate != 0){
-        g_TimeCompensator.err_count = 1;
-        g_TimeCompensator.errors[0] = err_rate / (float)(10000);
-        g_TimeCompensator.err_index = 1;
-        ESP_LOGI(TAG, "Default error rate: %.2f%%", g_TimeCompensator.errors[0]*100);
-    }
+    rtc_drift_predict(&g_drift, RTC_DRIFT_GLOBAL, 3600, &p);
+    cfg_set_time_drift_model(&g_drift, sizeof(g_drift));
+    cfg_set_time_err_rate((int32_t)(p.errorS / 3600 * 10000));
+    ESP_LOGI(TAG, "Drift model saved, %+.3f s/h", p.errorS);
 }
 
-/* Calculate smoothed error rate using moving average
- * @return Weighted error rates */
-static float get_smoothed_error() 
+/* Initialize compensation controller */
+void comp_init()
 {
-    if(g_TimeCompensator.err_count == 0) {
-        ESP_LOGD(TAG, "No error history available");
-        return 0.0f;
-    }
+    int32_t err_rate;
 
-    float weighted_error = 0;
-    float total_weight = 0;
-    float weight = 1.0f;  // Initial weights for recent data
-    
-    // Calculate the weighted average from the newest to the oldest data
-    for(int i = 0; i < g_TimeCompensator.err_count; i++) {
-        int idx = (g_TimeCompensator.err_index - 1 - i + MAX_HISTORY) % MAX_HISTORY;
-        weighted_error += g_TimeCompensator.errors[idx] * weight;
-        total_weight += weight;
-        weight *= (1.0f - ALPHA);  // Gradually decay weight
-        
-        ESP_LOGD(TAG, "[%d] err=%.2f%% weight=%.2f", 
-                i, g_TimeCompensator.errors[idx]*100, weight);
+    memset(&g_clock, 0, sizeof(g_clock));
+    if (cfg_get_time_drift_model(&g_drift, sizeof(g_drift)) == ESP_OK && rtc_drift_valid(&g_drift)) {
+        ESP_LOGI(TAG, "Drift model loaded, %u samples", g_drift.fit[RTC_DRIFT_GLOBAL].samples);
+        return;
     }
-
-    float result = weighted_error / total_weight;
-    ESP_LOGI(TAG, "Weighted error: %.2f%% (α=%.1f, %d samples)", 
-            result*100, ALPHA, g_TimeCompensator.err_count);
-    return result;
+    cfg_get_time_err_rate(&err_rate);
+    rtc_drift_init(&g_drift, err_rate / (float)(10000));
+    ESP_LOGI(TAG, "Drift model seeded, error rate: %.2f%%", g_drift.seedRate * 100);
 }
 
 /* Process time synchronization event
  * @param real_now Actual real time from reliable source
  * @param sys_now  Current system time */
-void record_time_sync(time_t real_now, time_t sys_now) 
+void record_time_sync(time_t real_now, time_t sys_now)
 {
-    ESP_LOGI(TAG,"Sync event - real: %lld, sys: %lld", real_now, sys_now);
-    // Initial synchronization
-    if(g_TimeCompensator.real_prev == 0) {
-        g_TimeCompensator.real_prev = real_now;
-        return;
+    float slept = 0;
+    uint32_t sleeps = 0;
+
+    // The RTC error is what is left plus what the boot corrections already took out
+    float errorS = (float)(real_now - sys_now) + g_clock.corrS;
+    for (int i = 0; i <= RTC_DRIFT_BUCKET_NUM; i++) {
+        slept += g_clock.span.sleptS[i];
+        sleeps += g_clock.span.sleeps[i];
     }
-
-    // Calculate time deltas
-    time_t delta_real = real_now - g_TimeCompensator.real_prev;
-    time_t delta_sys = sys_now - g_TimeCompensator.real_prev;
-    ESP_LOGI(TAG,"Time deltas - real: %lld, sys: %lld", delta_real, delta_sys);
-
-    // Handle abnormal cases (time rollback)
-    if(delta_sys <= 0 || delta_real < 0) {
-        g_TimeCompensator.err_count = 0;  // Reset error history
-        g_TimeCompensator.real_prev = real_now;
-        return;
+    ESP_LOGI(TAG, "Sync event - real: %lld, sys: %lld, RTC error %+.1fs over %lu sleeps (%.0fs)",
+             real_now, sys_now, errorS, sleeps, slept);
+
+    if (g_wakeTarget) {
+        time_t woke = real_now - (time_t)(esp_timer_get_time() / uS_TO_S_FACTOR);
+        rtc_drift_wake_landed(&g_drift, (float)(woke - g_wakeTarget));
+        ESP_LOGI(TAG, "Timer wake landed %+llds from its target", woke - g_wakeTarget);
+        g_wakeTarget = 0;
     }
 
-    // Calculate error rate: (real_delta - sys_delta)/sys_delta
-    float err_rate = (delta_real - delta_sys)/(float)delta_sys;
-    //If the error rate exceeds the threshold or the time delta is too small, the data will be discarded.
-    if( (delta_real < 300 || delta_sys < 300) || 
-        err_rate < -0.1f || err_rate > 0.1f){
-        g_TimeCompensator.real_prev = real_now;
-        return;
+    if (g_clock.syncReal != 0 && real_now > g_clock.syncReal) {
+        if (rtc_drift_add(&g_drift, &g_clock.span, errorS)) {
+            ESP_LOGI(TAG, "Drift sample added");
+            if ((g_drift.fit[RTC_DRIFT_GLOBAL].samples % WRITE_CFG_CNT) == 0) {
+                comp_save();
+            }
+        } else {
+            ESP_LOGI(TAG, "Drift sample discarded");
+        }
     }
-    ESP_LOGI(TAG, "New error rate calculated: %.2f%%", err_rate*100);
-
-    // Update circular buffer
-    g_TimeCompensator.errors[g_TimeCompensator.err_index] = err_rate;
-    g_TimeCompensator.err_index = (g_TimeCompensator.err_index + 1) % MAX_HISTORY;
-    if(g_TimeCompensator.err_count < MAX_HISTORY) g_TimeCompensator.err_count++;
 
-    g_TimeCompensator.total_count++;
-    if((g_TimeCompensator.total_count % WRITE_CFG_CNT) == 0){
-        int32_t w_rate = (int32_t)(get_smoothed_error() * 10000);
-        cfg_set_time_err_rate(w_rate);
-        ESP_LOGI(TAG, "write cfg rate: %.2f%%", (float)(w_rate/100));
-    }
-    // Update time references
-    g_TimeCompensator.real_prev = real_now;
+    memset(&g_clock.span, 0, sizeof(g_clock.span));
+    g_clock.corrS = 0;
+    g_clock.syncReal = real_now;
 }
 
-/**
- * @brief Calculate the time compensation value based on historical error
- * @param interval The nominal sleep interval in seconds
- * @return The calculated compensation value in seconds (positive means system is slow, negative means fast)
- */
-static int calculate_compensation(time_t interval)
+void record_time_set(void)
 {
-    float err = get_smoothed_error();
-    
-    // When the sleep time is too long, manually compensate for the error to make the system wake up later.
-    if(interval > (5 * 3600)){
-        err -= 0.001f;
-    }
-    // Calculate raw compensation value (in seconds)
-    float compensation = interval * err;  // err = (real_delta - sys_delta)/sys_delta
-    
-    // Apply safety bounds (adjust these values as needed)
-    const float MAX_COMPENSATION = interval * 0.3f; // Limit to ±30% of interval
-    if (compensation > MAX_COMPENSATION) {
-        compensation = MAX_COMPENSATION;
-        ESP_LOGI(TAG, "Compensation clamped to +%.1fs (upper bound)", MAX_COMPENSATION);
-    } else if (compensation < -MAX_COMPENSATION) {
-        compensation = -MAX_COMPENSATION;
-        ESP_LOGI(TAG, "Compensation clamped to -%.1fs (lower bound)", MAX_COMPENSATION);
-    }
-
-    // Round to nearest second
-    int final_compensation = (int)(compensation + (compensation > 0 ? 0.5f : -0.5f));
-    
-
-    ESP_LOGI(TAG, "Compensation calc: nominal=%lld, err=%.3f%%, comp=%+.1fs (%+ds)", 
-             interval, err*100, compensation, final_compensation);
-    
-    return final_compensation;
+    memset(&g_clock.span, 0, sizeof(g_clock.span));
+    g_clock.corrS = 0;
+    g_clock.syncReal = 0;
 }
 
 /**
- * @brief Adjusts the system time at boot based on the predicted drift since the last recorded time.
+ * @brief Adjusts the system time at boot by the predicted RTC error of the sleep that just ended.
  */
-void time_compensation_boot() 
+void time_compensation_boot()
 {
-    time_t now = time(NULL);
+    rtcDriftPrediction_t p;
+    struct timeval tv;
 
-    if(now <= g_TimeCompensator.real_prev || g_TimeCompensator.real_prev == 0)
+    if (g_clock.sleepStartUs == 0) {
         return;
+    }
+    gettimeofday(&tv, NULL);
+    int64_t nowUs = (int64_t)tv.tv_sec * uS_TO_S_FACTOR + tv.tv_usec;
+    float slept = (nowUs - esp_timer_get_time() - g_clock.sleepStartUs) / (float)uS_TO_S_FACTOR;
+    g_clock.sleepStartUs = 0;
+    if (slept <= 0 || slept > SLEEP_SLEPT_MAX_S) {
+        ESP_LOGW(TAG, "Implausible sleep of %.0fs, clock not adjusted", slept);
+        return;
+    }
 
-    int predicted_drift = calculate_compensation(now - g_TimeCompensator.real_prev);
-    time_t adjusted_time = now + predicted_drift;
-
-    ESP_LOGI(TAG, "Boot time adjustment: sys=%lld, pred=%lld (drift=%ds)",
-                now, adjusted_time, predicted_drift);
-    
-    struct timeval tv = { .tv_sec = adjusted_time };
+    rtc_drift_predict(&g_drift, g_clock.bucket, slept, &p);
+    nowUs += (int64_t)(p.errorS * uS_TO_S_FACTOR);
+    tv.tv_sec = nowUs / uS_TO_S_FACTOR;
+    tv.tv_usec = nowUs % uS_TO_S_FACTOR;
     settimeofday(&tv, NULL);
-    ESP_LOGI(TAG, "System time adjusted by %+lld seconds",adjusted_time - now);
 
+    g_clock.corrS += p.errorS;
+    rtc_drift_span_add(&g_clock.span, g_clock.bucket, slept);
+    ESP_LOGI(TAG, "Slept %.0fs in bucket %d, clock adjusted by %+.2fs (+/-%.2fs, fit %d)",
+             slept, g_clock.bucket, p.errorS, p.sigmaS, p.bucket);
 }
 
-int time_compensation(time_t time_sec) 
+static int do_drift_cmd(int argc, char **argv)
 {
-    if(time_sec <= g_TimeCompensator.real_prev || g_TimeCompensator.real_prev == 0)
-        return 0;
+    rtcDriftPrediction_t offset, hour;
+    const rtcDriftWakes_t *w = &g_drift.wakes;
+    char name[16];
 
-    int predicted_drift = calculate_compensation(time_sec - g_TimeCompensator.real_prev);
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        rtc_drift_init(&g_drift, 0);
+        comp_save();
+    }
+    ESP_LOGI(TAG, "seed rate %.3f%%", g_drift.seedRate * 100);
+    for (int i = 0; i <= RTC_DRIFT_BUCKET_NUM; i++) {
+        if (g_drift.fit[i].weight < RTC_DRIFT_MIN_WEIGHT && i != RTC_DRIFT_GLOBAL) {
+            continue;
+        }
+        rtc_drift_predict(&g_drift, i, 0, &offset);
+        rtc_drift_predict(&g_drift, i, 3600, &hour);
+        if (i == RTC_DRIFT_GLOBAL) {
+            snprintf(name, sizeof(name), "all");
+        } else {
+            snprintf(name, sizeof(name), "T%d V%d", i / RTC_DRIFT_VOLT_NUM, i % RTC_DRIFT_VOLT_NUM);
+        }
+        ESP_LOGI(TAG, "  %-5s %+.2fs/sleep %+.3fs/h +/-%.2fs, %u samples", name,
+                 offset.errorS, hour.errorS - offset.errorS, hour.sigmaS, g_drift.fit[i].samples);
+    }
+    ESP_LOGI(TAG, "wakes: %lu measured, %lu early, %lu on time, %lu late, %lu slept again",
+             w->measured, w->early, w->onTime, w->late, w->resleeps);
+    if (w->measured > w->early) {
+        ESP_LOGI(TAG, "lateness: mean %.1fs, max %.1fs", w->lateSum / (w->measured - w->early), w->lateMax);
+    }
+    return ESP_OK;
+}
 
-    ESP_LOGI(TAG, "compensation drift=%ds", predicted_drift);
-    return predicted_drift;
+static int do_wakecal_cmd(int argc, char **argv)
+{
+    const wakeCalStats_t *st = &g_calendar.stats;
+    energyReport_t report;
+    time_t now = time(NULL);
+
+    for (int i = 0; i < WAKE_CAL_JOB_MAX; i++) {
+        const wakeJob_t *job = &g_calendar.jobs[i];
+        if (job->due != 0) {
+            ESP_LOGI(TAG, "  todo %d prio %d due in %llds, -%lus/+%lus",
+                     job->todo, job->priority, job->due - now, job->early, job->late);
+        }
+    }
+    energy_get_report(&report);
+    ESP_LOGI(TAG, "%lu jobs on %lu wakes, %lu merged, %lu wakes saved (~%.2fmAh)",
+             st->jobs, st->wakes, st->merged, st->jobs - st->wakes,
+             (st->jobs - st->wakes) * report.lastWakeMah);
+    return ESP_OK;
 }
 
+static esp_console_cmd_t g_cmd[] = {
+    ESP_CONSOLE_CMD_INIT("drift", "RTC drift model, 'drift reset' forgets the samples", NULL, do_drift_cmd, NULL),
+    ESP_CONSOLE_CMD_INIT("wakecal", "Wake calendar jobs and merge savings", NULL, do_wakecal_cmd, NULL),
+};
+
 /**
  * Find the most recent time interval for scheduled wakeups
  * @param timedCount Number of scheduled time nodes
  * @param timedNodes Array of scheduled time configurations
- * @return Seconds until next scheduled wakeup
+ * @param now Time to search from
+ * @return Seconds from now until next scheduled wakeup
  */
-static uint32_t find_most_recent_time_interval(uint8_t timedCount, const timedNode_t *timedNodes)
+static uint32_t find_most_recent_time_interval(uint8_t timedCount, const timedNode_t *timedNodes, time_t now)
 {
     int Hour, Minute, Second;
     struct tm timeinfo;
     uint8_t i = 0;
-    time_t now;
     time_t tmp;
     time_t now2sunday;
     time_t intervalSeconds = 0;
 
-    time(&now);
     localtime_r(&now, &timeinfo);
     // Calculate seconds since last Sunday 00:00:00
     now2sunday = ((timeinfo.tm_wday * 24 + timeinfo.tm_hour) * 60 + timeinfo.tm_min) * 60 + timeinfo.tm_sec;
@@ -467,7 +514,7 @@ static uint32_t calculate_capture_wakeup(const capAttr_t *capture, time_t lastCa
             return 0;
         }
         ESP_LOGD(TAG, "Time-based capture mode with %d scheduled times", capture->timedCount);
-        return find_most_recent_time_interval(capture->timedCount, capture->timedNodes);
+        return find_most_recent_time_interval(capture->timedCount, capture->timedNodes, now);
     } else {
         ESP_LOGW(TAG, "Unknown capture schedule mode: %d", capture->scheCapMode);
     }
@@ -503,7 +550,9 @@ static uint32_t calculate_upload_wakeup(const uploadAttr_t *upload, time_t lastU
             return 0;
         }
         ESP_LOGD(TAG, "Time-based upload with %d scheduled times", upload->timedCount);
-        return find_most_recent_time_interval(upload->timedCount, upload->timedNodes);
+        // An upload run early by a merged wake already served its slot
+        time_t from = MAX(now, lastUploadTime + SLEEP_UPLOAD_WINDOW_S + 1);
+        return from - now + find_most_recent_time_interval(upload->timedCount, upload->timedNodes, from);
     } else {
         ESP_LOGW(TAG, "Scheduled upload mode enabled but no timed configuration found");
     }
@@ -521,7 +570,7 @@ static uint32_t calculate_upload_wakeup(const uploadAttr_t *upload, time_t lastU
 static uint32_t calculate_schedule_wakeup(const timedNode_t *scheTimeNode, time_t lastScheduleTime, time_t now)
 {
     time_t tmp;
-    tmp = find_most_recent_time_interval(1, scheTimeNode);
+    tmp = find_most_recent_time_interval(1, scheTimeNode, now);
     // if the next schedule time is less than 3 hours from the last schedule time, next day schedule
     if (now + tmp < lastScheduleTime + 3 * 60 * 60) {
         return tmp + 24 * 60 * 60;
@@ -530,33 +579,17 @@ static uint32_t calculate_schedule_wakeup(const timedNode_t *scheTimeNode, time_
     }
 }
 /**
- * Update the wakeup todo list with the earliest wakeup time and corresponding action with automatic conflict resolution
- * @param capture_time Capture wakeup time in seconds
- * @param upload_time Upload wakeup time in seconds  
- * @param schedule_time Schedule wakeup time in seconds
+ * Register the job of one module, or drop it when the module has nothing scheduled
+ * @param seconds Seconds until the job is due, 0 for none
  */
-static void update_wakeup_todo_list(uint32_t earliest_time, uint32_t capture_time, uint32_t upload_time, uint32_t schedule_time)
+static void calendar_update(wakeupTodo_e todo, uint8_t priority, time_t now, uint32_t seconds,
+                            uint32_t early, uint32_t late)
 {
-
-    // add all tasks scheduled at earliest time to queue, sorted by priority
-    if (capture_time == earliest_time) {
-        sleep_set_wakeup_todo(WAKEUP_TODO_SNAPSHOT, 0);  // highest priority
-        ESP_LOGI(TAG, "Scheduled SNAPSHOT at time %lu with priority 0", earliest_time);
-    }
-    
-    if (upload_time == earliest_time) {
-        sleep_set_wakeup_todo(WAKEUP_TODO_UPLOAD, 1);    // medium priority
-        ESP_LOGI(TAG, "Scheduled UPLOAD at time %lu with priority 1", earliest_time);
+    if (seconds == 0) {
+        wake_cal_remove(&g_calendar, todo);
+    } else if (!wake_cal_add(&g_calendar, todo, priority, now + seconds, early, late)) {
+        ESP_LOGW(TAG, "Wake calendar full, todo %d not scheduled", todo);
     }
-    
-    if (schedule_time == earliest_time) {
-        sleep_set_wakeup_todo(WAKEUP_TODO_SCHEDULE, 2);  // lowest priority
-        ESP_LOGI(TAG, "Scheduled SCHEDULE at time %lu with priority 2", earliest_time);
-    }
-
-    ESP_LOGI(TAG, "Wakeup times - Capture: %lu, Upload: %lu, Schedule: %lu, Selected: %lu, Queued tasks: 0x%08lx",
-             capture_time, upload_time, schedule_time, earliest_time, g_wakeupTodo);
-
 }
 
 /**
@@ -569,7 +602,6 @@ uint32_t  calc_wakeup_time_seconds(bool bUpdateWakeupTodo)
     capAttr_t capture;
     uploadAttr_t upload;
     timedNode_t scheTimeNode;
-    uint32_t earliest_wakeup = 0;
     time_t lastCapTime = sleep_get_last_capture_time();
     time_t now = time(NULL);
 
@@ -589,30 +621,32 @@ uint32_t  calc_wakeup_time_seconds(bool bUpdateWakeupTodo)
     uint32_t capture_wakeup = calculate_capture_wakeup(&capture, lastCapTime, now);
     uint32_t upload_wakeup = calculate_upload_wakeup(&upload, lastUploadTime, now);
     uint32_t schedule_wakeup = calculate_schedule_wakeup(&scheTimeNode, lastScheduleTime, now);
-    // uint32_t schedule_wakeup = find_most_recent_time_interval(1, &scheTimeNode);
-        
-    // find earliest execution time
-    if (capture_wakeup > 0 && (earliest_wakeup == 0 || capture_wakeup < earliest_wakeup)) {
-        earliest_wakeup = capture_wakeup;
-    }
-    if (upload_wakeup > 0 && (earliest_wakeup == 0 || upload_wakeup < earliest_wakeup)) {
-        earliest_wakeup = upload_wakeup;
-    }
-    if (schedule_wakeup > 0 && (earliest_wakeup == 0 || schedule_wakeup < earliest_wakeup)) {
-        earliest_wakeup = schedule_wakeup;
-    }
+    wakePlan_t plan;
+
+    calendar_update(WAKEUP_TODO_SNAPSHOT, 0, now, capture_wakeup, 0, SLEEP_CAPTURE_LATE_S);
+    calendar_update(WAKEUP_TODO_UPLOAD, 1, now, upload_wakeup, SLEEP_UPLOAD_WINDOW_S, SLEEP_UPLOAD_WINDOW_S);
+    calendar_update(WAKEUP_TODO_SCHEDULE, 2, now, schedule_wakeup, SLEEP_SCHEDULE_WINDOW_S, SLEEP_SCHEDULE_WINDOW_S);
+    ESP_LOGI(TAG, "Wakeup times - Capture: %lu, Upload: %lu, Schedule: %lu",
+             capture_wakeup, upload_wakeup, schedule_wakeup);
 
-    if (earliest_wakeup == 0) {
+    if (!wake_cal_plan(&g_calendar, now, &plan)) {
         ESP_LOGW(TAG, "No valid wakeup times found");
         return 0;
     }
 
-    // Determine the earliest wakeup time
+    // Every job of the plan runs on the same wake, highest priority first
     if (bUpdateWakeupTodo) {
-        update_wakeup_todo_list(earliest_wakeup, capture_wakeup, upload_wakeup, schedule_wakeup);
+        for (int i = 0; i < plan.count; i++) {
+            const wakeJob_t *job = &g_calendar.jobs[plan.job[i]];
+            sleep_set_wakeup_todo((wakeupTodo_e)job->todo, job->priority);
+        }
+    }
+    if (plan.count > 1) {
+        ESP_LOGI(TAG, "%d jobs merged into one wake, %lu wakes saved so far",
+                 plan.count, g_calendar.stats.jobs - g_calendar.stats.wakes);
     }
 
-    return earliest_wakeup;
+    return plan.wake > now ? plan.wake - now : 1;
 }
 
 /**
@@ -643,24 +677,32 @@ void sleep_start(void)
     /* Ensure all LEDs are off before entering deep sleep. */
     misc_led_off();
     misc_flash_led_close();
+    energy_wake_end();
     
     // Calculate and set timer wakeup
-    
-    int wakeup_time_sec = 0;
-    int calculate_sec;
+    uint32_t wakeup_time_sec = 0;
+    uint32_t rtc_sec;
+    float bias;
 
     if (sleep_has_wakeup_todo()) {
-        wakeup_time_sec = 1;
+        // Woke before the target: sleep the rest of the way, else run the queued todo right away
+        wakeup_time_sec = g_willWakeupTime > now ? g_willWakeupTime - now : 1;
     } else {
         wakeup_time_sec = calc_wakeup_time_seconds(true);
     }
-    calculate_sec = calculate_compensation(wakeup_time_sec);
-    wakeup_time_sec -= calculate_sec;
+    // Sleep-only boots do not open the ADC, the battery of the last wake that read it stands in
+    int battery_mv = misc_get_battery_voltage();
+    if (battery_mv > 0) {
+        g_clock.batteryMv = battery_mv;
+    }
+    g_clock.bucket = rtc_drift_bucket(misc_get_chip_temperature(), g_clock.batteryMv);
     if (wakeup_time_sec > 0) {
-        esp_sleep_enable_timer_wakeup(wakeup_time_sec * uS_TO_S_FACTOR);
-        g_willWakeupTime = now + wakeup_time_sec + calculate_sec;
+        rtc_sec = rtc_drift_sleep_for(&g_drift, g_clock.bucket, wakeup_time_sec, &bias);
+        esp_sleep_enable_timer_wakeup(rtc_sec * uS_TO_S_FACTOR);
+        g_willWakeupTime = now + wakeup_time_sec;
         misc_show_time("wake will at", g_willWakeupTime);
-        ESP_LOGI(TAG, "Enabling TIMER wakeup on %ds", wakeup_time_sec);
+        ESP_LOGI(TAG, "Enabling TIMER wakeup on %lus for %lus (late bias %.1fs, bucket %d)",
+                 rtc_sec, wakeup_time_sec, bias, g_clock.bucket);
     }
 
     // Configure button wakeup
@@ -705,9 +747,49 @@ void sleep_start(void)
     }
     ESP_LOGI(TAG, "Entering deep sleep");
     session_log_close_for_sleep();
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    g_clock.sleepStartUs = (int64_t)tv.tv_sec * uS_TO_S_FACTOR + tv.tv_usec;
+    if (wakeup_time_sec > 0) {
+        // RTC time until the clock, as time_compensation_boot() corrects it, reaches the target
+        double due_sec = rtc_drift_rtc_for(&g_drift, g_clock.bucket,
+                                           g_willWakeupTime - g_clock.sleepStartUs / (double)uS_TO_S_FACTOR);
+        wake_stub_arm(&g_stub, rtc_time_get(), (int64_t)(due_sec * uS_TO_S_FACTOR), esp_clk_slowclk_cal_get());
+    } else {
+        wake_stub_disarm(&g_stub);
+    }
     esp_deep_sleep_start();
 }
 
+/**
+ * Read the RTC counter from the wake stub, the IDF helpers are not loaded yet
+ */
+static uint64_t RTC_IRAM_ATTR wake_stub_rtc_ticks(void)
+{
+    SET_PERI_REG_MASK(RTC_CNTL_TIME_UPDATE_REG, RTC_CNTL_TIME_UPDATE);
+    uint64_t ticks = READ_PERI_REG(RTC_CNTL_TIME0_REG);
+    ticks |= (uint64_t)READ_PERI_REG(RTC_CNTL_TIME1_REG) << 32;
+    return ticks;
+}
+
+/**
+ * Deep sleep wake stub, runs from RTC memory before the bootloader
+ * A timer wake that sleep_is_will_wakeup_time_reached() would send back to sleep sleeps again without booting
+ */
+void RTC_IRAM_ATTR esp_wake_deep_sleep(void)
+{
+    uint64_t sleep_us;
+
+    esp_default_wake_deep_sleep();
+    if (wake_stub_decide(&g_stub, esp_wake_stub_get_wakeup_cause() == RTC_TIMER_TRIG_EN,
+                         g_wakeupTodo != 0, wake_stub_rtc_ticks(), &sleep_us) != WAKE_STUB_SLEEP) {
+        return;
+    }
+    g_stub.resleeps++;
+    esp_wake_stub_set_wakeup_time(sleep_us);
+    esp_wake_stub_sleep(&esp_wake_deep_sleep);
+}
+
 /**
  * Determine wakeup source
  * @return Type of wakeup that occurred
@@ -749,39 +831,205 @@ void sleep_open()
 {
     memset(&g_sleep, 0, sizeof(g_sleep));
     g_sleep.eventGroup = xEventGroupCreate();
+
+    if (!rtc_drift_valid(&g_drift)) {
+        comp_init();
+    }
+    if (g_stub.resleeps > 0) {
+        ESP_LOGI(TAG, "Wake stub slept %u more times before this boot", g_stub.resleeps);
+        g_drift.wakes.resleeps += g_stub.resleeps;
+        g_stub.resleeps = 0;
+    }
+    wake_stub_disarm(&g_stub);
+    if (g_clock.sleepStartUs != 0) {
+        if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER) {
+            g_wakeTarget = g_willWakeupTime;
+        }
+        if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_UNDEFINED) {
+            time_compensation_boot();
+        }
+        g_clock.sleepStartUs = 0;
+    }
+    debug_cmd_add(g_cmd, sizeof(g_cmd) / sizeof(esp_console_cmd_t));
 }
 
 /**
- * Wait for specified event bits before sleeping
- * @param bits Event bits to wait for
- * @param bWaitAll True to wait for all bits, false for any bit
+ * Resolve a token handle to its slot, must hold g_sleepLock
+ * @return Slot index, or -1 if the token is not currently held
  */
-void sleep_wait_event_bits(sleepBits_e bits, bool bWaitAll)
+static int sleep_token_slot(sleepToken_t token)
 {
-    ESP_LOGI(TAG, "WAIT for event bits to sleep ... ");
-    EventBits_t uxBits = xEventGroupWaitBits(g_sleep.eventGroup, bits, \
-                                             true, bWaitAll, \
-                                             pdMS_TO_TICKS(SLEEP_WAIT_TIMEOUT_MS));
-    ESP_LOGI(TAG, "sleep right now, bits=%lu", uxBits);
-    sleep_start();
+    if (token == SLEEP_TOKEN_INVALID) {
+        return -1;
+    }
+    uint32_t slot = token & 0xff;
+    if (slot >= SLEEP_TOKEN_MAX || g_sleep.holds[slot].name == NULL ||
+        g_sleep.holds[slot].seq != (token >> 8)) {
+        return -1;
+    }
+    return slot;
 }
 
 /**
- * Set sleep event bits
- * @param bits Event bits to set
+ * Free a token slot and account its hold time, must hold g_sleepLock
  */
-void sleep_set_event_bits(sleepBits_e bits)
+static void sleep_token_free(int slot, int64_t now)
+{
+    sleepHold_t *hold = &g_sleep.holds[slot];
+    for (int i = 0; i < SLEEP_HOLDER_MAX; i++) {
+        sleepHolder_t *holder = &g_sleep.holders[i];
+        if (holder->name == NULL || strcmp(holder->name, hold->name) == 0) {
+            holder->name = hold->name;
+            holder->heldUs += now - hold->acquiredUs;
+            holder->count++;
+            break;
+        }
+    }
+    hold->name = NULL;
+    g_sleep.holdCount--;
+}
+
+void sleep_keep_awake(sleepToken_t *token, const char *name, uint32_t deadline_ms)
+{
+    int64_t now = esp_timer_get_time();
+    bool full = true;
+
+    portENTER_CRITICAL(&g_sleepLock);
+    if (sleep_token_slot(*token) >= 0) {
+        portEXIT_CRITICAL(&g_sleepLock);
+        return;
+    }
+    for (int i = 0; i < SLEEP_TOKEN_MAX; i++) {
+        sleepHold_t *hold = &g_sleep.holds[i];
+        if (hold->name != NULL) {
+            continue;
+        }
+        if (++g_sleep.seq > (UINT32_MAX >> 8)) {
+            g_sleep.seq = 1;
+        }
+        hold->name = name;
+        hold->seq = g_sleep.seq;
+        hold->acquiredUs = now;
+        hold->deadlineUs = deadline_ms ? now + (int64_t)deadline_ms * 1000 : 0;
+        g_sleep.holdCount++;
+        *token = (hold->seq << 8) | i;
+        full = false;
+        break;
+    }
+    portEXIT_CRITICAL(&g_sleepLock);
+
+    if (full) {
+        *token = SLEEP_TOKEN_INVALID;
+        ESP_LOGE(TAG, "keep awake table full, %s not held", name);
+    } else {
+        ESP_LOGD(TAG, "keep awake %s (deadline %lums)", name, deadline_ms);
+    }
+}
+
+void sleep_release(sleepToken_t *token)
 {
-    xEventGroupSetBits(g_sleep.eventGroup, bits);
+    bool released = false;
+
+    portENTER_CRITICAL(&g_sleepLock);
+    int slot = sleep_token_slot(*token);
+    if (slot >= 0) {
+        sleep_token_free(slot, esp_timer_get_time());
+        released = true;
+    }
+    *token = SLEEP_TOKEN_INVALID;
+    portEXIT_CRITICAL(&g_sleepLock);
+
+    if (released && g_sleep.eventGroup) {
+        xEventGroupSetBits(g_sleep.eventGroup, SLEEP_TOKEN_CHANGED_BIT);
+    }
 }
 
 /**
- * Clear sleep event bits
- * @param bits Event bits to clear
+ * Log tokens still held and the holders that kept the device awake longest
  */
-void sleep_clear_event_bits(sleepBits_e bits)
+static void sleep_log_holders(void)
+{
+    sleepHold_t holds[SLEEP_TOKEN_MAX];
+    sleepHolder_t holders[SLEEP_HOLDER_MAX];
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&g_sleepLock);
+    memcpy(holds, g_sleep.holds, sizeof(holds));
+    memcpy(holders, g_sleep.holders, sizeof(holders));
+    portEXIT_CRITICAL(&g_sleepLock);
+
+    for (int i = 0; i < SLEEP_TOKEN_MAX; i++) {
+        if (holds[i].name) {
+            ESP_LOGI(TAG, "awake held by %s for %lldms", holds[i].name,
+                     (now - holds[i].acquiredUs) / 1000);
+        }
+    }
+    for (int n = 0; n < SLEEP_HOLDER_TOP; n++) {
+        int top = -1;
+        for (int i = 0; i < SLEEP_HOLDER_MAX && holders[i].name; i++) {
+            if (holders[i].heldUs > 0 && (top < 0 || holders[i].heldUs > holders[top].heldUs)) {
+                top = i;
+            }
+        }
+        if (top < 0) {
+            break;
+        }
+        ESP_LOGI(TAG, "awake top%d: %s %lldms (%lu holds)", n + 1, holders[top].name,
+                 holders[top].heldUs / 1000, holders[top].count);
+        holders[top].heldUs = 0;
+    }
+}
+
+void sleep_wait_awake_released(void)
 {
-    xEventGroupClearBits(g_sleep.eventGroup, bits);
+    int64_t start = esp_timer_get_time();
+    int64_t backstop = start + (int64_t)SLEEP_WAIT_TIMEOUT_MS * 1000;
+
+    ESP_LOGI(TAG, "WAIT for keep awake tokens to sleep ... ");
+    while (true) {
+        int64_t now = esp_timer_get_time();
+        int64_t wake = backstop;
+        uint8_t count;
+        int expired = 0;
+
+        portENTER_CRITICAL(&g_sleepLock);
+        for (int i = 0; i < SLEEP_TOKEN_MAX; i++) {
+            sleepHold_t *hold = &g_sleep.holds[i];
+            if (hold->name == NULL || hold->deadlineUs == 0) {
+                continue;
+            }
+            if (hold->deadlineUs <= now) {
+                sleep_token_free(i, now);
+                expired++;
+            } else if (hold->deadlineUs < wake) {
+                wake = hold->deadlineUs;
+            }
+        }
+        count = g_sleep.holdCount;
+        portEXIT_CRITICAL(&g_sleepLock);
+
+        if (expired) {
+            ESP_LOGW(TAG, "%d keep awake token(s) expired", expired);
+        }
+        if (count == 0) {
+            break;
+        }
+        if (now >= backstop) {
+            ESP_LOGW(TAG, "keep awake backstop reached with %d token(s) held", count);
+            break;
+        }
+        if (wake > now + (int64_t)SLEEP_HOLDER_LOG_MS * 1000) {
+            wake = now + (int64_t)SLEEP_HOLDER_LOG_MS * 1000;
+        }
+        EventBits_t uxBits = xEventGroupWaitBits(g_sleep.eventGroup, SLEEP_TOKEN_CHANGED_BIT,
+                                                 true, false, pdMS_TO_TICKS((wake - now) / 1000) + 1);
+        if (!(uxBits & SLEEP_TOKEN_CHANGED_BIT)) {
+            sleep_log_holders();
+        }
+    }
+    ESP_LOGI(TAG, "sleep right now, waited %lldms", (esp_timer_get_time() - start) / 1000);
+    sleep_log_holders();
+    sleep_start();
 }
 
 /**
@@ -808,6 +1056,9 @@ wakeupTodo_e sleep_get_wakeup_todo()
             
             // clear this task
             g_wakeupTodo &= ~mask;
+            if (wake_cal_ran(&g_calendar, todo, !g_wakeCounted)) {
+                g_wakeCounted = true;
+            }
             
             ESP_LOGI(TAG, "Retrieved todo %d from priority %d, remaining: 0x%lx", 
                      todo, priority, g_wakeupTodo);
@@ -819,6 +1070,54 @@ wakeupTodo_e sleep_get_wakeup_todo()
     return WAKEUP_TODO_NOTHING;
 }
 
+/**
+ * Get the next action to perform after wakeup without taking it
+ * @return Scheduled wakeup action
+ */
+wakeupTodo_e sleep_peek_wakeup_todo(void)
+{
+    for (uint8_t priority = 0; priority < 8; priority++) {
+        uint32_t todo_bits = (g_wakeupTodo >> (priority * 4)) & 0x0F;
+        if (todo_bits != 0) {
+            return (wakeupTodo_e)todo_bits;
+        }
+    }
+    return WAKEUP_TODO_NOTHING;
+}
+
+bool sleep_wakeup_todo_queued(wakeupTodo_e todo)
+{
+    for (uint8_t priority = 0; priority < 8; priority++) {
+        if (((g_wakeupTodo >> (priority * 4)) & 0x0F) == todo) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Register a job in the wake calendar
+ * @param todo Action that runs the job
+ * @param priority Priority of the action when it shares a wake
+ * @param due When the job is due
+ * @param early Seconds it may run before due
+ * @param late Seconds it may run after due
+ * @return false if the calendar is full
+ */
+bool sleep_calendar_add(wakeupTodo_e todo, uint8_t priority, time_t due, uint32_t early, uint32_t late)
+{
+    return wake_cal_add(&g_calendar, todo, priority, due, early, late);
+}
+
+/**
+ * Drop the job of an action from the wake calendar
+ * @param todo Action
+ */
+void sleep_calendar_remove(wakeupTodo_e todo)
+{
+    wake_cal_remove(&g_calendar, todo);
+}
+
 /**
  * Set action to perform after wakeup
  * @param todo Action to perform
@@ -974,5 +1273,12 @@ uint32_t sleep_is_alramin_goto_restart()
  */
 bool sleep_is_will_wakeup_time_reached(void)
 {
-    return g_willWakeupTime <= time(NULL);
+    time_t now = time(NULL);
+
+    if (g_willWakeupTime <= now) {
+        return true;
+    }
+    g_drift.wakes.resleeps++;
+    ESP_LOGW(TAG, "Timer wake %llds before its target", g_willWakeupTime - now);
+    return false;
 }
@@ -17,16 +17,10 @@ extern "C" {
 #define PIR_WAKEUP_LEVEL PIR_IN_ACTIVE
 
 /**
- * Sleep event bits for synchronization
+ * Keep-awake token handle, SLEEP_TOKEN_INVALID when not held
  */
-typedef enum sleepBits {
-    SLEEP_SNAPSHOT_STOP_BIT = BIT(0),          // Snapshot complete
-    SLEEP_STORAGE_UPLOAD_STOP_BIT =  BIT(1),   // Storage upload complete
-    SLEEP_NO_OPERATION_TIMEOUT_BIT = BIT(2),   // No operation timeout
-    SLEEP_SCHEDULE_DONE_BIT = BIT(3),          // Scheduled tasks complete
-    SLEEP_MIP_DONE_BIT = BIT(4),               // MIP operations complete
-    SLEEP_NO_DEBUG_BIT = BIT(5),               // No debug mode
-} sleepBits_e;
+typedef uint32_t sleepToken_t;
+#define SLEEP_TOKEN_INVALID 0
 
 /**
  * Wakeup source types
@@ -60,14 +54,14 @@ void comp_init();
 void record_time_sync(time_t real_now, time_t sys_now);
 
 /**
- * @brief Adjusts the system time at boot based on the predicted drift since the last recorded time.
+ * @brief Adjusts the system time at boot by the predicted RTC error of the sleep that just ended.
  */
 void time_compensation_boot();
 
 /**
- * @brief Compensates the current time based on the synchronization time.
+ * Process a clock set from a source other than NTP, the RTC error since the last sync is dropped
  */
-int time_compensation(time_t time_sec);
+void record_time_set(void);
 
 /**
  * Calculate next wakeup time in seconds
@@ -94,23 +88,26 @@ wakeupType_e sleep_wakeup_case();
 void sleep_open();
 
 /**
- * Wait for specified sleep event bits
- * @param bits Event bits to wait for
- * @param bWaitAll True to wait for all bits, false for any bit
+ * Take a keep-awake token; the device will not sleep while any token is held.
+ * Does nothing if *token is still held, so callers may re-arm without tracking state.
+ * @param token Token storage, set to the new handle
+ * @param name Holder name for diagnostics, must be a static string
+ * @param deadline_ms Auto-release after this many milliseconds, 0 for no deadline
  */
-void sleep_wait_event_bits(sleepBits_e bits, bool bWaitAll);
+void sleep_keep_awake(sleepToken_t *token, const char *name, uint32_t deadline_ms);
 
 /**
- * Set sleep event bits
- * @param bits Event bits to set
+ * Release a keep-awake token and reset it to SLEEP_TOKEN_INVALID.
+ * Safe to call on invalid or already expired tokens.
+ * @param token Token to release
  */
-void sleep_set_event_bits(sleepBits_e bits);
+void sleep_release(sleepToken_t *token);
 
 /**
- * Clear sleep event bits
- * @param bits Event bits to clear
+ * Block until all keep-awake tokens are released (or the backstop timeout
+ * expires), log the longest holders, then enter deep sleep
  */
-void sleep_clear_event_bits(sleepBits_e bits);
+void sleep_wait_awake_released(void);
 
 /**
  * Enter sleep mode
@@ -123,6 +120,36 @@ void sleep_start();
  */
 wakeupTodo_e sleep_get_wakeup_todo();
 
+/**
+ * Get the next action to perform after wakeup without taking it
+ * @return Wakeup action
+ */
+wakeupTodo_e sleep_peek_wakeup_todo(void);
+
+/**
+ * Check whether an action is queued at any priority
+ * @param todo Wakeup action
+ * @return true if it is queued
+ */
+bool sleep_wakeup_todo_queued(wakeupTodo_e todo);
+
+/**
+ * Register a job in the wake calendar. Jobs whose windows overlap run on one wake.
+ * @param todo Wakeup action that runs the job, replaces its previous job
+ * @param priority Priority of the action when it shares a wake, 0 is the highest
+ * @param due When the job is due
+ * @param early Seconds it may run before due
+ * @param late Seconds it may run after due
+ * @return false if the calendar is full
+ */
+bool sleep_calendar_add(wakeupTodo_e todo, uint8_t priority, time_t due, uint32_t early, uint32_t late);
+
+/**
+ * Drop the job of a wakeup action from the wake calendar
+ * @param todo Wakeup action
+ */
+void sleep_calendar_remove(wakeupTodo_e todo);
+
 /**
  * @param todo Wakeup action
  * @param priority Priority of the action, 0 is the highest priority, 7 is the lowest priority
@@ -22,11 +22,13 @@
 #include "misc.h"
 #include "debug.h"
 #include "session_log.h"
+#include "push.h"
 
 #define STORAGE_UPLOAD_START_BIT BIT(0)
 #define STORAGE_UPLOAD_STOP_BIT BIT(1)
 #define STORAGE_UPLOAD_DONE_BIT BIT(2)
 #define STORAGE_UPLOAD_DONE_TIMEOUT_MS  (30000) // 30s
+#define STORAGE_UPLOAD_YIELD_MS  (100)          // Poll period while live frames go first
 #define PATH_MAX_lEN (266)
 
 
@@ -37,6 +39,7 @@ typedef struct mdStorage {
     QueueHandle_t in;
     QueueHandle_t out;
     SemaphoreHandle_t mutex;
+    sleepToken_t awake;  // Held from upload request until the pass over flash ends
 } mdStorage_t;
 
 static mdStorage_t g_mdStorage;
@@ -315,9 +318,7 @@ static void upload(mdStorage_t *self)
 
     ESP_LOGI(TAG, "upload Start");
     while (true) {
-        sleep_set_event_bits(SLEEP_STORAGE_UPLOAD_STOP_BIT); // if no remaining images to upload in flash, will enter sleep
         xEventGroupWaitBits(self->eventGroup, STORAGE_UPLOAD_START_BIT, true, true, portMAX_DELAY);
-        sleep_clear_event_bits(SLEEP_STORAGE_UPLOAD_STOP_BIT);
         struct dirent *entry;
         DIR *dir = opendir(STORAGE_ROOT);
         while ((entry = readdir(dir)) != NULL) {
@@ -326,6 +327,11 @@ static void upload(mdStorage_t *self)
                 continue;
             }
             sprintf(path, "%s/%s", STORAGE_ROOT, entry->d_name);
+            // Yield between files while live frames are being pushed, bounded so backlog still drains
+            for (int waited = 0; push_live_pending() && waited < STORAGE_UPLOAD_DONE_TIMEOUT_MS;
+                 waited += STORAGE_UPLOAD_YIELD_MS) {
+                vTaskDelay(pdMS_TO_TICKS(STORAGE_UPLOAD_YIELD_MS));
+            }
             ESP_LOGI(TAG, "upload file %s", path);
             xSemaphoreTake(self->mutex, portMAX_DELAY);
             if (storage_upload_file(path, pts, type) != ESP_OK) {
@@ -347,6 +353,7 @@ static void upload(mdStorage_t *self)
         }
         ESP_LOGI(TAG, "upload nothing");
         closedir(dir);
+        sleep_release(&self->awake); // no remaining images to upload in flash
     }
     ESP_LOGI(TAG, "Stop");
     vTaskDelete(NULL);
@@ -385,6 +392,7 @@ static esp_console_cmd_t g_cmd[] = {
 void storage_upload_start()
 {
     ESP_LOGI(TAG, "storage_upload_start");
+    sleep_keep_awake(&g_mdStorage.awake, "upload", 0);
     xEventGroupClearBits(g_mdStorage.eventGroup, STORAGE_UPLOAD_STOP_BIT);
     xEventGroupSetBits(g_mdStorage.eventGroup, STORAGE_UPLOAD_START_BIT);
 }
@@ -394,6 +402,7 @@ void storage_upload_stop()
     ESP_LOGI(TAG, "storage_upload_stop");
     xEventGroupClearBits(g_mdStorage.eventGroup, STORAGE_UPLOAD_START_BIT);
     xEventGroupSetBits(g_mdStorage.eventGroup, STORAGE_UPLOAD_STOP_BIT);
+    sleep_release(&g_mdStorage.awake);
 }
 
 void storage_format()
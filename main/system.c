@@ -112,6 +112,7 @@ esp_err_t system_set_time(timeAttr_t *tAttr)
     // Set system time
     struct timeval epoch = {t_of_day, 0};
     settimeofday(&epoch, NULL);
+    record_time_set();
     
     // Log the new time
     strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime(&t_of_day));
@@ -249,7 +250,6 @@ void system_schedule_todo()
         }
     }
     sleep_set_last_schedule_time(time(NULL));
-    sleep_set_event_bits(SLEEP_SCHEDULE_DONE_BIT);  // Signal completion
 }
 
 /**
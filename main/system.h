@@ -73,6 +73,7 @@ typedef struct queueNode {
     void *data;                ///< Data pointer
     size_t len;                ///< Data length
     char ntp_sync_flag;        ///< Check whether there is a flag for ntp synchronization. If not, the timestamp will be corrected during upload.
+    int64_t dispatch_us;       ///< Time the push dispatcher received the node (esp_timer, us)
 } queueNode_t;
 
 /**
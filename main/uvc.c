@@ -19,14 +19,13 @@
 #endif
 #include "uvc.h"
 #include "camera_uvc_controls.h"
+#include "frame_slot.h"
 
 static const char *TAG = "UVC";
 
 #define ENABLE_UVC_FRAME_RESOLUTION_ANY   1        /* Use any resolution supported by the camera */
 
-#define BIT0_FRAME_START     (0x01 << 0)
-#define BIT1_NEW_FRAME_START (0x01 << 1)
-#define BIT2_NEW_FRAME_END   (0x01 << 2)
+#define BIT0_NEW_FRAME       (0x01 << 0)
 
 static EventGroupHandle_t s_evt_handle;
 
@@ -39,15 +38,26 @@ static EventGroupHandle_t s_evt_handle;
 #endif
 
 #define DEMO_UVC_XFER_BUFFER_SIZE (1024 * 1024)
+#define DEMO_UVC_FRAME_POOL_NUM   3   /* Frame buffers, frames are assembled in place and passed by reference */
 
 #define FRAME_XFER_DIV 3          /* Frame transfer interval divisor */
 #define FRAME_SAVE_CNT 1          /* Number of frames to buffer */
 #define UVC_CON_TIMEOUT 10        /* Connection timeout in seconds */
+#define UVC_FB_TIMEOUT_MS 3000    /* Longest wait for a new frame */
+#define UVC_FB_WAIT_SLICE_MS 50   /* Bounds a wake-up lost to another consumer clearing the bit */
 
-static camera_fb_t s_fb = {0};
+/* A pool buffer as seen by the consumers, fb must stay the first member */
+typedef struct uvcFb {
+    camera_fb_t fb;
+    uvc_frame_t *frame;
+} uvcFb_t;
+
+static uvcFb_t s_uvc_fb[DEMO_UVC_FRAME_POOL_NUM] = {0};
+static frameSlot_t s_slot;
 
 static camera_fb_t cap_fb[FRAME_SAVE_CNT] = {0};
 static int frame_index = 0;
+static uint8_t *s_frame_pool[DEMO_UVC_FRAME_POOL_NUM] = {0};
 
 /**
  * @brief Extract JPEG resolution from buffer data
@@ -89,13 +99,24 @@ int readJPEGResolutionFromBuffer(const unsigned char *buf, size_t size)
 
 /**
  * @brief Get frame buffer for streaming
- * @return Pointer to frame buffer structure
+ *
+ * Waits for the next frame from the camera, several consumers may hold the same frame.
+ * @return Pointer to frame buffer structure, NULL if no frame arrived in UVC_FB_TIMEOUT_MS
  */
 camera_fb_t *uvc_stream_fb_get()
 {
-    xEventGroupSetBits(s_evt_handle, BIT0_FRAME_START);
-    xEventGroupWaitBits(s_evt_handle, BIT1_NEW_FRAME_START, true, true, portMAX_DELAY);
-    return &s_fb;
+    uint32_t seq = frame_slot_seq(&s_slot);
+    int64_t deadline = esp_timer_get_time() + UVC_FB_TIMEOUT_MS * 1000LL;
+
+    do {
+        uvcFb_t *ufb = (uvcFb_t *)frame_slot_get(&s_slot, &seq);
+        if (ufb) {
+            return &ufb->fb;
+        }
+        xEventGroupWaitBits(s_evt_handle, BIT0_NEW_FRAME, pdTRUE, pdFALSE, pdMS_TO_TICKS(UVC_FB_WAIT_SLICE_MS));
+    } while (esp_timer_get_time() < deadline);
+    ESP_LOGW(TAG, "No frame in %d ms", UVC_FB_TIMEOUT_MS);
+    return NULL;
 }
 
 /**
@@ -117,18 +138,46 @@ camera_fb_t *uvc_capture_fb_get()
  */
 void uvc_stream_fb_return(camera_fb_t *fb)
 {
-    xEventGroupSetBits(s_evt_handle, BIT2_NEW_FRAME_END);
-    return;
+    if (fb) {
+        frame_slot_put(&s_slot, (uvcFb_t *)fb);
+    }
+}
+
+/**
+ * @brief Give a frame no longer used by the consumers back to usb_stream
+ * @param frame uvcFb_t of the frame
+ * @param arg Unused
+ */
+static void uvc_fb_release(void *frame, void *arg)
+{
+    uvcFb_t *ufb = (uvcFb_t *)frame;
+    uvc_frame_release(ufb->frame);
 }
 
 /**
- * @brief UVC frame callback handler
- * @param frame Received frame data
+ * @brief Find the consumer view of a pool frame
+ * @param frame Frame from usb_stream
+ * @return uvcFb_t of the pool buffer, NULL if the frame is not from the pool
+ */
+static uvcFb_t *uvc_fb_from_frame(uvc_frame_t *frame)
+{
+    for (int i = 0; i < DEMO_UVC_FRAME_POOL_NUM; i++) {
+        if (frame->data == s_frame_pool[i]) {
+            return &s_uvc_fb[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief UVC frame callback handler, publishes the frame without waiting for the consumers
+ * @param frame Received frame data, a frame pool buffer
  * @param ptr User context pointer
  */
 static void uvc_frame_cb(uvc_frame_t *frame, void *ptr)
 {
     static int retry = 0;
+    uvcFb_t *ufb = NULL;
     ESP_LOGV(TAG, "uvc callback! frame_format = %d, seq = %"PRIu32", width = %"PRIu32", height = %"PRIu32", length = %u, ptr = %d",
              frame->frame_format, frame->sequence, frame->width, frame->height, frame->data_bytes, (int) ptr);
 
@@ -148,10 +197,6 @@ static void uvc_frame_cb(uvc_frame_t *frame, void *ptr)
     // }
     frame_index++;
 
-    if (!(xEventGroupGetBits(s_evt_handle) & BIT0_FRAME_START)) {
-        return;
-    }
-
     switch (frame->frame_format) {
     case UVC_FRAME_FORMAT_MJPEG:
         // Frame filtering example (currently commented)
@@ -160,32 +205,60 @@ static void uvc_frame_cb(uvc_frame_t *frame, void *ptr)
         //         break;
         // }
 
-        s_fb.buf = frame->data;
-        s_fb.len = frame->data_bytes;
-        s_fb.width = frame->width;
-        s_fb.height = frame->height;
-        s_fb.format = PIXFORMAT_JPEG;
-        s_fb.timestamp.tv_sec = frame->sequence;
-        if(readJPEGResolutionFromBuffer(s_fb.buf, s_fb.len) != 0){
+        ufb = uvc_fb_from_frame(frame);
+        if (ufb == NULL) {
+            break;
+        }
+        if(readJPEGResolutionFromBuffer(frame->data, frame->data_bytes) != 0){
             if(retry < 3){
                 retry++;
-                return;
+                break;
             }
         }
         retry = 0;
-        xEventGroupSetBits(s_evt_handle, BIT1_NEW_FRAME_START);
+        ufb->frame = frame;
+        ufb->fb.buf = frame->data;
+        ufb->fb.len = frame->data_bytes;
+        ufb->fb.width = frame->width;
+        ufb->fb.height = frame->height;
+        ufb->fb.format = PIXFORMAT_JPEG;
+        ufb->fb.timestamp.tv_sec = frame->sequence;
+        /* The slot owns the frame from here, the previous latest frame goes back to usb_stream */
+        frame_slot_publish(&s_slot, ufb);
+        xEventGroupSetBits(s_evt_handle, BIT0_NEW_FRAME);
         ESP_LOGV(TAG, "send frame = %"PRIu32"", frame->sequence);
-        xEventGroupWaitBits(s_evt_handle, BIT2_NEW_FRAME_END, true, true, portMAX_DELAY);
-        ESP_LOGV(TAG, "send frame done = %"PRIu32"", frame->sequence);
-        break;
+        return;
     default:
         ESP_LOGW(TAG, "Unsupported format");
         assert(0);
         break;
     }
+    uvc_frame_release(frame);
     ESP_LOGV(TAG, "uvc callback end!");
 }
 
+/**
+ * @brief Log the latest-frame slot counters
+ */
+static void uvc_fb_stats_log(void)
+{
+    frameSlotStats_t stats;
+    frame_slot_stats(&s_slot, &stats);
+    ESP_LOGI(TAG, "frames published %"PRIu32", taken %"PRIu32", overwritten %"PRIu32", dropped %"PRIu32,
+             stats.published, stats.taken, stats.overwritten, stats.dropped);
+}
+
+/**
+ * @brief Free the frame pool buffers
+ */
+static void uvc_frame_pool_free(void)
+{
+    for (int i = 0; i < DEMO_UVC_FRAME_POOL_NUM; i++) {
+        free(s_frame_pool[i]);
+        s_frame_pool[i] = NULL;
+    }
+}
+
 /**
  * @brief Handle stream state changes
  * @param event Stream state event
@@ -214,6 +287,8 @@ static void stream_state_changed_cb(usb_stream_state_t event, void *arg)
     }
     case STREAM_DISCONNECTED:
         ESP_LOGI(TAG, "Device disconnected");
+        frame_slot_flush(&s_slot);
+        uvc_fb_stats_log();
         break;
     default:
         ESP_LOGE(TAG, "Unknown event");
@@ -240,17 +315,16 @@ esp_err_t uvc_init(void)
         return ESP_FAIL;
     }
 
-    /* Allocate transfer buffers */
-    uint8_t *xfer_buffer_a = (uint8_t *)malloc(DEMO_UVC_XFER_BUFFER_SIZE);
-    uint8_t *xfer_buffer_b = (uint8_t *)malloc(DEMO_UVC_XFER_BUFFER_SIZE);
-    uint8_t *frame_buffer = (uint8_t *)malloc(DEMO_UVC_XFER_BUFFER_SIZE);
+    frame_slot_init(&s_slot, uvc_fb_release, NULL);
 
-    if(xfer_buffer_a == NULL || xfer_buffer_b == NULL || frame_buffer == NULL){
-        ESP_LOGE(TAG, "line-%u: Memory allocation failed", __LINE__);
-        free(xfer_buffer_a);
-        free(xfer_buffer_b);
-        free(frame_buffer);
-        return ESP_FAIL;
+    /* Allocate frame buffers */
+    for (int i = 0; i < DEMO_UVC_FRAME_POOL_NUM; i++) {
+        s_frame_pool[i] = (uint8_t *)malloc(DEMO_UVC_XFER_BUFFER_SIZE);
+        if (s_frame_pool[i] == NULL) {
+            ESP_LOGE(TAG, "line-%u: Memory allocation failed", __LINE__);
+            uvc_frame_pool_free();
+            return ESP_FAIL;
+        }
     }
 
     uvc_config_t uvc_config = {
@@ -259,10 +333,9 @@ esp_err_t uvc_init(void)
         .frame_height = DEMO_UVC_FRAME_HEIGHT,
         .frame_interval = FPS2INTERVAL(15),
         .xfer_buffer_size = DEMO_UVC_XFER_BUFFER_SIZE,
-        .xfer_buffer_a = xfer_buffer_a,
-        .xfer_buffer_b = xfer_buffer_b,
         .frame_buffer_size = DEMO_UVC_XFER_BUFFER_SIZE,
-        .frame_buffer = frame_buffer,
+        .frame_pool_num = DEMO_UVC_FRAME_POOL_NUM,
+        .frame_pool = s_frame_pool,
         .frame_cb = &uvc_frame_cb,
         .frame_cb_arg = NULL,
     };
@@ -270,36 +343,28 @@ esp_err_t uvc_init(void)
     ret = uvc_streaming_config(&uvc_config);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "UVC streaming config failed");
-        free(xfer_buffer_a);
-        free(xfer_buffer_b);
-        free(frame_buffer);
+        uvc_frame_pool_free();
         return ESP_FAIL;
     }
 
     ret = usb_streaming_state_register(&stream_state_changed_cb, NULL);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "UVC state callback registration failed");
-        free(xfer_buffer_a);
-        free(xfer_buffer_b);
-        free(frame_buffer);
+        uvc_frame_pool_free();
         return ESP_FAIL;
     }
 
     ret = usb_streaming_start();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "UVC streaming start failed");
-        free(xfer_buffer_a);
-        free(xfer_buffer_b);
-        free(frame_buffer);
+        uvc_frame_pool_free();
         return ESP_FAIL;
     }
 
     ret = usb_streaming_connect_wait((UVC_CON_TIMEOUT * 1000) / portTICK_PERIOD_MS); 
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "UVC connection timeout");
-        free(xfer_buffer_a);
-        free(xfer_buffer_b);
-        free(frame_buffer);
+        uvc_frame_pool_free();
         return ESP_FAIL;
     }
     
@@ -311,6 +376,7 @@ esp_err_t uvc_init(void)
  */
 void uvc_deinit(void)
 {
+    uvc_fb_stats_log();
     // usb_streaming_control(STREAM_UVC, CTRL_SUSPEND, NULL);
     // usb_streaming_stop();
     // vEventGroupDelete(s_evt_handle);
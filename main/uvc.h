@@ -19,13 +19,13 @@ esp_err_t uvc_init(void);
 void uvc_deinit(void);
 
 /**
- * @brief Get frame buffer for streaming
- * @return Pointer to frame buffer structure
+ * @brief Get the next frame, several consumers may hold it at once
+ * @return Pointer to frame buffer structure, NULL on timeout
  */
 camera_fb_t *uvc_stream_fb_get();
 
 /**
- * @brief Return frame buffer after processing
+ * @brief Return frame buffer after processing, every frame got must be returned
  * @param fb Pointer to frame buffer structure
  */
 void uvc_stream_fb_return(camera_fb_t *fb);
@@ -0,0 +1,50 @@
+#!/usr/bin/env python3
+# Compress the built web UI for embedding in the firmware.
+#
+# usage: gzip_dist.py <dist dir> <favicon> <output dir>
+#
+# JS/CSS references in index.html get ?v=<crc32 of the compressed asset>, the
+# same value the firmware serves as the asset ETag, so the server can mark a
+# request for the current bundle as immutable.
+
+import gzip
+import os
+import re
+import sys
+import zlib
+
+
+def compress(data):
+    # mtime=0 keeps the output, and so the ETags, identical across builds
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def write(path, data):
+    with open(path, 'wb') as f:
+        f.write(data)
+
+
+def main():
+    if len(sys.argv) != 4:
+        sys.exit('usage: gzip_dist.py <dist dir> <favicon> <output dir>')
+    dist, favicon, out = sys.argv[1:]
+    os.makedirs(out, exist_ok=True)
+
+    with open(os.path.join(dist, 'index.html'), 'rb') as f:
+        html = f.read()
+
+    for name in ('index.js', 'index.css'):
+        with open(os.path.join(dist, 'assets', name), 'rb') as f:
+            gz = compress(f.read())
+        write(os.path.join(out, name + '.gz'), gz)
+        version = b'%08x' % (zlib.crc32(gz) & 0xffffffff)
+        pattern = re.compile(rb'(assets/' + re.escape(name.encode()) + rb')(\?v=[0-9A-Za-z]*)?')
+        html = pattern.sub(lambda m: m.group(1) + b'?v=' + version, html)
+
+    write(os.path.join(out, 'index.html.gz'), compress(html))
+    with open(favicon, 'rb') as f:
+        write(os.path.join(out, 'favicon.ico.gz'), compress(f.read()))
+
+
+if __name__ == '__main__':
+    main()
@@ -110,6 +110,9 @@ const URL = {
     exportSessionLog: baseUrl + "/system/exportSessionLog",
     exportConfig: baseUrl + "/system/exportConfig",
     importConfig: baseUrl + "/system/importConfig",
+    // whole config in one request: { image, light, capture, upload, trigger, webhook, pushMode }
+    getAllParams: baseUrl + "/system/getAllParams",
+    setParams: baseUrl + "/system/setParams",
 
     // Cellular
     getCellularParam: baseUrl + "/network/getCellularParam",
@@ -1,6 +1,6 @@
 import { translate as $t, getCurLang } from './i18n';
 import { createApp, nextTick } from '/src/lib/petite-vue.es.js';
-import { postData, URL } from './api';
+import { getData, postData, URL } from './api';
 import MsDialog from './components/dialog';
 import DialogUtil from './components/dialog/util';
 import MsSelect from './components/select';
@@ -49,13 +49,15 @@ const App = {
         try {
             await this.setDevTime(); // first sync time
             await this.getDeviceInfo();
-            await this.getImageInfo();
-            await this.getCaptureInfo(); // This will also call getTriggerInfo internally
-            await this.getUploadInfo();
+            // one request for all config pages, older firmware falls back to per-page requests
+            const all = await getData(URL.getAllParams).catch(() => null);
+            await this.getImageInfo(all);
+            await this.getCaptureInfo(all); // This will also call getTriggerInfo internally
+            await this.getUploadInfo(all);
             await this.getDataReport();
-            await this.getPushModeInfo();
+            await this.getPushModeInfo(all);
             if (this.pushMode === 1) {
-                await this.getWebhookInfo();
+                await this.getWebhookInfo(all);
             }
             if (this.netmod === 'cat1') {
                 await this.getCellularInfo();
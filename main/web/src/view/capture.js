@@ -165,9 +165,9 @@ function Capture() {
                 .label;
         },
 
-        async getCaptureInfo() {
+        async getCaptureInfo(all) {
             try {
-                const res = await getData(URL.getCapParam);
+                const res = all ? all.capture : await getData(URL.getCapParam);
                 this.scheduledCaptureEnable = res.bScheCap ? true : false;
                 this.captureMode = res.scheCapMode; // 0: Timed Capture 1 : Interval Capture
                 this.timeCaptureList = res.timedNodes;
@@ -183,7 +183,7 @@ function Capture() {
                 this.capAlarmInEnable = res.bAlarmInCap ? true : false;
                 this.capButtonEnable = res.bButtonCap ? true : false;
                 this.camWarmupMs = res.camWarmupMs || 5000;
-                await this.getTriggerInfo();
+                await this.getTriggerInfo(all);
             } catch (error) {
                 console.error('Failed to get capture info:', error);
             } finally {
@@ -191,9 +191,9 @@ function Capture() {
                 this.timeIntervalUnitMount = true;
             }
         },
-        async getTriggerInfo() {
+        async getTriggerInfo(all) {
             try {
-                const res = await getData(URL.getTriggerParam);
+                const res = all ? all.trigger : await getData(URL.getTriggerParam);
                 // Only set trigger mode if trigger capture is enabled
                 if (this.capAlarmInEnable) {
                     // Ensure trigger mode is valid (1 or 2, not 0)
@@ -229,43 +229,47 @@ function Capture() {
                 this.triggerMount = true;
             }
         },
+        /** trigger/PIR settings in register units, as stored by the device */
+        getTriggerPayload() {
+            // Validate and convert display values to register values
+            // Sensitivity: 0-255, recommended > 20, minimum 10 (no interference)
+            let sens = Number(this.pirSens);
+            if (isNaN(sens) || sens < 0) sens = 15;
+            if (sens > 255) sens = 255;
+            // Note: Values < 10 may cause false alarms, > 20 is recommended
+            
+            // Blind time: display range 0.5s ~ 8s, reg range 0-15
+            // Formula: interrupt time = register value * 0.5s + 0.5s
+            let blindDisplay = Number(this.pirBlind);
+            if (isNaN(blindDisplay) || blindDisplay < 0.5) blindDisplay = 0.5;
+            if (blindDisplay > 8) blindDisplay = 8;
+            const blind = Math.round((blindDisplay - 0.5) * 2);
+            
+            // Pulse count: display range 1 ~ 4, reg range 0-3
+            // Formula: pulse count = register value + 1
+            let pulseDisplay = Number(this.pirPulse);
+            if (isNaN(pulseDisplay) || pulseDisplay < 1) pulseDisplay = 1;
+            if (pulseDisplay > 4) pulseDisplay = 4;
+            const pulse = pulseDisplay - 1;
+            
+            // Window time: display range 2s ~ 8s, reg range 0-3
+            // Formula: window time = register value * 2s + 2s
+            let windowDisplay = Number(this.pirWindow);
+            if (isNaN(windowDisplay) || windowDisplay < 2) windowDisplay = 2;
+            if (windowDisplay > 8) windowDisplay = 8;
+            const window = Math.round((windowDisplay - 2) / 2);
+            
+            return {
+                trigger_mode: Number(this.triggerMode),
+                sens: sens,
+                blind: blind,
+                pulse: pulse,
+                window: window,
+            };
+        },
         async setTriggerInfo() {
             try {
-                // Validate and convert display values to register values
-                // Sensitivity: 0-255, recommended > 20, minimum 10 (no interference)
-                let sens = Number(this.pirSens);
-                if (isNaN(sens) || sens < 0) sens = 15;
-                if (sens > 255) sens = 255;
-                // Note: Values < 10 may cause false alarms, > 20 is recommended
-                
-                // Blind time: display range 0.5s ~ 8s, reg range 0-15
-                // Formula: interrupt time = register value * 0.5s + 0.5s
-                let blindDisplay = Number(this.pirBlind);
-                if (isNaN(blindDisplay) || blindDisplay < 0.5) blindDisplay = 0.5;
-                if (blindDisplay > 8) blindDisplay = 8;
-                const blind = Math.round((blindDisplay - 0.5) * 2);
-                
-                // Pulse count: display range 1 ~ 4, reg range 0-3
-                // Formula: pulse count = register value + 1
-                let pulseDisplay = Number(this.pirPulse);
-                if (isNaN(pulseDisplay) || pulseDisplay < 1) pulseDisplay = 1;
-                if (pulseDisplay > 4) pulseDisplay = 4;
-                const pulse = pulseDisplay - 1;
-                
-                // Window time: display range 2s ~ 8s, reg range 0-3
-                // Formula: window time = register value * 2s + 2s
-                let windowDisplay = Number(this.pirWindow);
-                if (isNaN(windowDisplay) || windowDisplay < 2) windowDisplay = 2;
-                if (windowDisplay > 8) windowDisplay = 8;
-                const window = Math.round((windowDisplay - 2) / 2);
-                
-                await postData(URL.setTriggerParam, {
-                    trigger_mode: Number(this.triggerMode),
-                    sens: sens,
-                    blind: blind,
-                    pulse: pulse,
-                    window: window,
-                });
+                await postData(URL.setTriggerParam, this.getTriggerPayload());
             } catch (error) {
                 this.alertMessage("error");
             }
@@ -280,8 +284,8 @@ function Capture() {
                 this.setTriggerInfo();
             }
         },
-        async getUploadInfo() {
-            const res = await getData(URL.getUploadParam);
+        async getUploadInfo(all) {
+            const res = all ? all.upload : await getData(URL.getUploadParam);
             this.uploadMode = res.uploadMode;
             this.uploadModeMount = true;
             this.timeUploadList = res.timedNodes;
@@ -319,18 +323,20 @@ function Capture() {
 
         async setCaptureInfo() {
             try {
-                await postData(URL.setCapParam, {
-                    bScheCap: Number(this.scheduledCaptureEnable),
-                    scheCapMode: Number(this.captureMode),
-                    timedNodes: this.timeCaptureList,
-                    timedCount: this.timeCaptureList.length,
-                    intervalValue: Number(this.timeIntervalNum),
-                    intervalUnit: Number(this.timeIntervalUnit),
-                    intervalAnchorTime: `${this.intervalAnchorHour}:${this.intervalAnchorMinute}`,
-                    bAlarmInCap: Number(this.capAlarmInEnable),
-                    bButtonCap: Number(this.capButtonEnable),
-                    camWarmupMs: Number(this.camWarmupMs),
-                });
+                const params = {
+                    capture: {
+                        bScheCap: Number(this.scheduledCaptureEnable),
+                        scheCapMode: Number(this.captureMode),
+                        timedNodes: this.timeCaptureList,
+                        timedCount: this.timeCaptureList.length,
+                        intervalValue: Number(this.timeIntervalNum),
+                        intervalUnit: Number(this.timeIntervalUnit),
+                        intervalAnchorTime: `${this.intervalAnchorHour}:${this.intervalAnchorMinute}`,
+                        bAlarmInCap: Number(this.capAlarmInEnable),
+                        bButtonCap: Number(this.capButtonEnable),
+                        camWarmupMs: Number(this.camWarmupMs),
+                    },
+                };
                 // If trigger capture is disabled, save current trigger mode and set to 0
                 if (!this.capAlarmInEnable) {
                     // Save current trigger mode before disabling
@@ -338,8 +344,11 @@ function Capture() {
                         this.savedTriggerMode = this.triggerMode;
                     }
                     this.triggerMode = 0;
-                    await this.setTriggerInfo();
-                } else {
+                    // stored together with the capture settings in one commit
+                    params.trigger = this.getTriggerPayload();
+                }
+                await postData(URL.setParams, params);
+                if (this.capAlarmInEnable) {
                     // If trigger capture is re-enabled, restore saved trigger mode first
                     if (this.triggerMode === 0 && this.savedTriggerMode > 0) {
                         this.triggerMode = this.savedTriggerMode;
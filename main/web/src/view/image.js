@@ -117,9 +117,9 @@ function Image() {
 
         lightMount: false,
         _thresholdLightSaveTimer: null,
-        async getImageInfo() {
+        async getImageInfo(all) {
             try {
-                const lightRes = await getData(URL.getLightParam);
+                const lightRes = all ? all.light : await getData(URL.getLightParam);
                 this.supLight = lightRes.lightMode; // 0 - auto 1 - customize 2 - ON 3 - OFF
                 this.luminoSensity = lightRes.value;
                 this.threshold = lightRes.threshold;
@@ -129,7 +129,7 @@ function Image() {
                 this.endTimeHour = lightRes.endTime.split(":")[0];
                 this.endTimeMinute = lightRes.endTime.split(":")[1];
 
-                const camRes = await getData(URL.getCamParam);
+                const camRes = all ? all.image : await getData(URL.getCamParam);
                 this.brightness = camRes.brightness;
 
                 this.contrast = camRes.contrast;
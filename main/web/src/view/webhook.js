@@ -17,17 +17,17 @@ function Webhook() {
         webhookUrlError: false,
         ...DialogUtil,
 
-        async getWebhookInfo() {
+        async getWebhookInfo(all) {
             try {
-                const res = await getData(URL.getWebhookParam);
+                const res = all ? all.webhook : await getData(URL.getWebhookParam);
                 if (res) this.webhook = { url: res.url || '', header: res.header || '' };
             } catch (e) {
                 console.error('getWebhookInfo error', e);
             }
         },
-        async getPushModeInfo() {
+        async getPushModeInfo(all) {
             try {
-                const res = await getData(URL.getPushMode);
+                const res = all ? all.pushMode : await getData(URL.getPushMode);
                 if (res && typeof res.mode === 'number') {
                     this.pushMode = res.mode;
                 }
@@ -13,6 +13,7 @@
 #include "lwip/netdb.h"
 #include "iot_mip.h"
 #include "net_module.h"
+#include "energy.h"
 
 #define TAG "-->WIFI"  // Logging tag for WiFi module
 
@@ -197,7 +198,7 @@ static void timer_cb(void *arg)
         wifi->apTimeoutSeconds = 0;
     }
     if (wifi->apTimeoutSeconds >= AP_TIMEOUT_SECONDS) {
-        sleep_set_event_bits(SLEEP_NO_OPERATION_TIMEOUT_BIT);
+        http_allow_sleep();
     }
 }
 
@@ -472,6 +473,7 @@ void wifi_open(wifi_mode_t mode)
         ESP_ERROR_CHECK(esp_wifi_start());
     else
         mm_wifi_connect();
+    energy_phase_begin(ENERGY_PHASE_WIFI);
 
     ESP_LOGI(TAG, "wifi init finished.");
     debug_cmd_add(g_cmd, sizeof(g_cmd) / sizeof(esp_console_cmd_t));
@@ -559,6 +561,7 @@ void wifi_close()
         if(netModule_is_mmwifi())
             mm_wifi_shutdown();
     }
+    energy_phase_end(ENERGY_PHASE_WIFI);
 
 }
 